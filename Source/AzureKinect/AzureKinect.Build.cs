@@ -1,5 +1,7 @@
 // Copyright Epic Games, Inc. All Rights Reserved.
 
+using System;
+using System.Diagnostics;
 using System.IO;
 using UnrealBuildTool;
 
@@ -9,46 +11,47 @@ public class AzureKinect : ModuleRules
 	{
 		PCHUsage = ModuleRules.PCHUsageMode.UseExplicitOrSharedPCHs;
 
-		if (Target.Platform == UnrealTargetPlatform.Win64)
+		// Building without the SDKs has to be asked for on Windows, where a missing SDK is a broken install
+		bool bNoSdk = Environment.GetEnvironmentVariable("AZUREKINECT_NO_SDK") == "1";
+
+		bool bHasSdk = false;
+		if (Target.Platform == UnrealTargetPlatform.Win64 && !bNoSdk)
 		{
-			string sdkPath = System.Environment.GetEnvironmentVariable("AZUREKINECT_SDK");
-			string bodySdkPath = System.Environment.GetEnvironmentVariable("AZUREKINECT_BODY_SDK");
-
-			PublicIncludePaths.AddRange(
-				new string[] {
-					Path.Combine(sdkPath, "sdk", "include"),
-					Path.Combine(bodySdkPath, "sdk", "include")
-				});
-
-			PublicAdditionalLibraries.AddRange(
-				new string[] {
-					Path.Combine(sdkPath, "sdk", "windows-desktop", "amd64", "release", "lib", "k4a.lib"),
-					Path.Combine(sdkPath, "sdk", "windows-desktop", "amd64", "release", "lib", "k4arecord.lib"),
-					Path.Combine(bodySdkPath, "sdk", "windows-desktop", "amd64", "release", "lib", "k4abt.lib")
-				});
-			
-			string depthEngineDllPath = Path.Combine(sdkPath, "sdk", "windows-desktop", "amd64", "release", "bin", "depthengine_2_0.dll");
-			string k4aDllPath = Path.Combine(sdkPath, "sdk", "windows-desktop", "amd64", "release", "bin", "k4a.dll");
-			string k4abtDllPath = Path.Combine(bodySdkPath, "sdk", "windows-desktop", "amd64", "release", "bin", "k4abt.dll");
-
-			PublicDelayLoadDLLs.AddRange(
-				new string[] {
-					depthEngineDllPath,
-					k4aDllPath,
-					k4abtDllPath,
-				});
-
-			RuntimeDependencies.Add(depthEngineDllPath);
-			RuntimeDependencies.Add(k4aDllPath);
-			RuntimeDependencies.Add(k4abtDllPath);
+			bHasSdk = AddWindowsSdk();
+			if (!bHasSdk)
+			{
+				throw new BuildException("AzureKinect: AZUREKINECT_SDK and AZUREKINECT_BODY_SDK must point to the Sensor and Body Tracking SDKs. " +
+					"Set AZUREKINECT_NO_SDK=1 to build without device support.");
+			}
+		}
+		else if (Target.Platform == UnrealTargetPlatform.Linux && !bNoSdk)
+		{
+			bHasSdk = AddLinuxSdk();
 		}
 
+		// Without the SDK, everything but the native frame source still builds (see AzureKinectSdk.h)
+		if (!bHasSdk)
+		{
+			Console.WriteLine("AzureKinect: Sensor or Body Tracking SDK not found, building without device support.");
+		}
+		PublicDefinitions.Add("WITH_AZUREKINECT_SDK=" + (bHasSdk ? "1" : "0"));
+
 		PrivateIncludePaths.AddRange(
 			new string[]
 			{
 				"AzureKinect/Private",
 			});
 
+		// Niagara types show up in the data interface header, procedural mesh in the depth mesh component
+		PublicDependencyModuleNames.AddRange(
+			new string[]
+			{
+				"Niagara",
+				"NiagaraCore",
+				"VectorVM",
+				"ProceduralMeshComponent",
+			});
+
 		PrivateDependencyModuleNames.AddRange(
 			new string[]
 			{
@@ -58,7 +61,158 @@ public class AzureKinect : ModuleRules
 				"RenderCore",
 				"RHI",
 				"AnimGraphRuntime",
+				"AssetRegistry",
+				"ImageWrapper",
 			});
-		
+
+	}
+
+	private bool AddWindowsSdk()
+	{
+		string sdkPath = Environment.GetEnvironmentVariable("AZUREKINECT_SDK");
+		string bodySdkPath = Environment.GetEnvironmentVariable("AZUREKINECT_BODY_SDK");
+		if (string.IsNullOrEmpty(sdkPath) || string.IsNullOrEmpty(bodySdkPath))
+		{
+			return false;
+		}
+
+		PublicIncludePaths.AddRange(
+			new string[] {
+				Path.Combine(sdkPath, "sdk", "include"),
+				Path.Combine(bodySdkPath, "sdk", "include")
+			});
+
+		PublicAdditionalLibraries.AddRange(
+			new string[] {
+				Path.Combine(sdkPath, "sdk", "windows-desktop", "amd64", "release", "lib", "k4a.lib"),
+				Path.Combine(sdkPath, "sdk", "windows-desktop", "amd64", "release", "lib", "k4arecord.lib"),
+				Path.Combine(bodySdkPath, "sdk", "windows-desktop", "amd64", "release", "lib", "k4abt.lib")
+			});
+
+		string depthEngineDllPath = Path.Combine(sdkPath, "sdk", "windows-desktop", "amd64", "release", "bin", "depthengine_2_0.dll");
+		string k4aDllPath = Path.Combine(sdkPath, "sdk", "windows-desktop", "amd64", "release", "bin", "k4a.dll");
+		string k4abtDllPath = Path.Combine(bodySdkPath, "sdk", "windows-desktop", "amd64", "release", "bin", "k4abt.dll");
+
+		PublicDelayLoadDLLs.AddRange(
+			new string[] {
+				depthEngineDllPath,
+				k4aDllPath,
+				k4abtDllPath,
+			});
+
+		RuntimeDependencies.Add(depthEngineDllPath);
+		RuntimeDependencies.Add(k4aDllPath);
+		RuntimeDependencies.Add(k4abtDllPath);
+		return true;
+	}
+
+	/**
+	 * AZUREKINECT_SDK and AZUREKINECT_BODY_SDK point to install prefixes (include, lib) when set,
+	 * otherwise the Debian packages (libk4a-dev, libk4abt-dev) are looked up with pkg-config and in the system prefixes.
+	 */
+	private bool AddLinuxSdk()
+	{
+		string[] systemIncludeDirs = { "/usr/include", "/usr/local/include" };
+		string[] systemLibDirs = { "/usr/lib/x86_64-linux-gnu", "/usr/lib", "/usr/local/lib" };
+
+		string sdkPath = Environment.GetEnvironmentVariable("AZUREKINECT_SDK");
+		string bodySdkPath = Environment.GetEnvironmentVariable("AZUREKINECT_BODY_SDK");
+		bool bCustomSdk = !string.IsNullOrEmpty(sdkPath);
+		bool bCustomBodySdk = !string.IsNullOrEmpty(bodySdkPath);
+
+		string[] includeDirs = bCustomSdk ? new string[] { Path.Combine(sdkPath, "include") } : Concat(PkgConfig("--variable=includedir k4a"), systemIncludeDirs);
+		string[] libDirs = bCustomSdk ? new string[] { Path.Combine(sdkPath, "lib") } : Concat(PkgConfig("--variable=libdir k4a"), systemLibDirs);
+		string[] bodyIncludeDirs = bCustomBodySdk ? new string[] { Path.Combine(bodySdkPath, "include") } : systemIncludeDirs;
+		string[] bodyLibDirs = bCustomBodySdk ? new string[] { Path.Combine(bodySdkPath, "lib") } : systemLibDirs;
+
+		string includeDir = FindDirectoryWith(Path.Combine("k4a", "k4a.hpp"), includeDirs);
+		string bodyIncludeDir = FindDirectoryWith("k4abt.hpp", bodyIncludeDirs);
+		string k4aLib = FindFile("libk4a.so", libDirs);
+		string k4arecordLib = FindFile("libk4arecord.so", libDirs);
+		string k4abtLib = FindFile("libk4abt.so", bodyLibDirs);
+		if (includeDir == null || bodyIncludeDir == null || k4aLib == null || k4arecordLib == null || k4abtLib == null)
+		{
+			return false;
+		}
+
+		PublicIncludePaths.Add(includeDir);
+		if (bodyIncludeDir != includeDir)
+		{
+			PublicIncludePaths.Add(bodyIncludeDir);
+		}
+		PublicAdditionalLibraries.AddRange(new string[] { k4aLib, k4arecordLib, k4abtLib });
+
+		// Libraries from the system prefixes are found by the loader, staged ones have to be shipped
+		if (bCustomSdk)
+		{
+			AddRuntimeLibraries(Path.GetDirectoryName(k4aLib), "libk4a.so*", "libk4arecord.so*", "libdepthengine.so*");
+		}
+		if (bCustomBodySdk)
+		{
+			AddRuntimeLibraries(Path.GetDirectoryName(k4abtLib), "libk4abt.so*", "*.onnx");
+		}
+		return true;
+	}
+
+	private void AddRuntimeLibraries(string Directory, params string[] Patterns)
+	{
+		foreach (string pattern in Patterns)
+		{
+			foreach (string file in System.IO.Directory.GetFiles(Directory, pattern))
+			{
+				RuntimeDependencies.Add(file);
+			}
+		}
+	}
+
+	private static string PkgConfig(string Arguments)
+	{
+		try
+		{
+			ProcessStartInfo startInfo = new ProcessStartInfo("pkg-config", Arguments);
+			startInfo.RedirectStandardOutput = true;
+			startInfo.UseShellExecute = false;
+			using (Process process = Process.Start(startInfo))
+			{
+				string output = process.StandardOutput.ReadToEnd().Trim();
+				process.WaitForExit();
+				return process.ExitCode == 0 && output.Length > 0 ? output : null;
+			}
+		}
+		catch (Exception)
+		{
+			// pkg-config isn't installed
+			return null;
+		}
+	}
+
+	private static string[] Concat(string First, string[] Rest)
+	{
+		if (First == null)
+		{
+			return Rest;
+		}
+		string[] result = new string[Rest.Length + 1];
+		result[0] = First;
+		Rest.CopyTo(result, 1);
+		return result;
+	}
+
+	private static string FindDirectoryWith(string RelativePath, string[] Directories)
+	{
+		foreach (string directory in Directories)
+		{
+			if (File.Exists(Path.Combine(directory, RelativePath)))
+			{
+				return directory;
+			}
+		}
+		return null;
+	}
+
+	private static string FindFile(string FileName, string[] Directories)
+	{
+		string directory = FindDirectoryWith(FileName, Directories);
+		return directory != null ? Path.Combine(directory, FileName) : null;
 	}
 }
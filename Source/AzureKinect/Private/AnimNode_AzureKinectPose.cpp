@@ -3,7 +3,7 @@
 #include "AnimNode_AzureKinectPose.h"
 #include "Animation/AnimInstanceProxy.h"
 #include "AnimationRuntime.h"
-#include "k4abttypes.h"
+#include "AzureKinectSdk.h"
 
 DEFINE_LOG_CATEGORY(AzureKinectAnimNodeLog);
 
@@ -0,0 +1,147 @@
+#include "AzureKinectBackgroundModel.h"
+#include "Async/ParallelFor.h"
+
+#if PLATFORM_CPU_X86_FAMILY
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+	/** Pixels per task, big enough to amortize scheduling. */
+	constexpr int32 ChunkSize = 64 * 1024;
+
+	int32 ProcessScalar(const uint16* Depth, uint16* Background, uint8* Mask, int32 Num, bool bLearning, uint16 Step, uint16 Threshold)
+	{
+		int32 Count = 0;
+		for (int32 i = 0; i < Num; i++)
+		{
+			const uint16 D = Depth[i];
+			uint16& B = Background[i];
+
+			if (bLearning)
+			{
+				B = FMath::Max(B, D);
+				Mask[i] = 0x00;
+				continue;
+			}
+
+			const bool bForeground = D != 0 && B > D && B - D > Threshold;
+			Mask[i] = bForeground ? 0xFF : 0x00;
+			Count += bForeground ? 1 : 0;
+
+			if (D != 0 && !bForeground)
+			{
+				if (B == 0)
+				{
+					B = D;
+				}
+				else
+				{
+					B = static_cast<uint16>(D > B ? B + FMath::Min<int32>(D - B, Step) : B - FMath::Min<int32>(B - D, Step));
+				}
+			}
+		}
+		return Count;
+	}
+
+#if PLATFORM_CPU_X86_FAMILY
+	FORCEINLINE __m128i MinU16(__m128i A, __m128i B)
+	{
+		// SSE2 has no unsigned 16bit min
+		return _mm_sub_epi16(A, _mm_subs_epu16(A, B));
+	}
+
+	int32 ProcessSSE2(const uint16* Depth, uint16* Background, uint8* Mask, int32 Num, bool bLearning, uint16 Step, uint16 Threshold)
+	{
+		const __m128i Zero = _mm_setzero_si128();
+		const __m128i StepV = _mm_set1_epi16(static_cast<short>(Step));
+		const __m128i ThresholdV = _mm_set1_epi16(static_cast<short>(Threshold));
+
+		int32 Count = 0;
+		int32 i = 0;
+		for (; i + 8 <= Num; i += 8)
+		{
+			const __m128i D = _mm_loadu_si128(reinterpret_cast<const __m128i*>(Depth + i));
+			__m128i B = _mm_loadu_si128(reinterpret_cast<const __m128i*>(Background + i));
+
+			if (bLearning)
+			{
+				// max(B, D)
+				B = _mm_add_epi16(_mm_subs_epu16(B, D), D);
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(Background + i), B);
+				_mm_storel_epi64(reinterpret_cast<__m128i*>(Mask + i), Zero);
+				continue;
+			}
+
+			const __m128i Invalid = _mm_cmpeq_epi16(D, Zero);
+			const __m128i Nearer = _mm_subs_epu16(B, D);
+			// Nearer > Threshold, and D is valid
+			const __m128i Foreground = _mm_andnot_si128(Invalid, _mm_andnot_si128(_mm_cmpeq_epi16(_mm_subs_epu16(Nearer, ThresholdV), Zero), _mm_set1_epi16(-1)));
+
+			_mm_storel_epi64(reinterpret_cast<__m128i*>(Mask + i), _mm_packs_epi16(Foreground, Zero));
+			Count += FPlatformMath::CountBits(static_cast<uint64>(_mm_movemask_epi8(Foreground))) / 2;
+
+			// Step background toward valid, non-foreground samples. Unknown background takes the sample as is.
+			const __m128i Farther = _mm_subs_epu16(D, B);
+			__m128i Updated = _mm_sub_epi16(_mm_add_epi16(B, MinU16(Farther, StepV)), MinU16(Nearer, StepV));
+			const __m128i Unknown = _mm_cmpeq_epi16(B, Zero);
+			Updated = _mm_or_si128(_mm_and_si128(Unknown, D), _mm_andnot_si128(Unknown, Updated));
+
+			const __m128i Keep = _mm_or_si128(Invalid, Foreground);
+			B = _mm_or_si128(_mm_and_si128(Keep, B), _mm_andnot_si128(Keep, Updated));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(Background + i), B);
+		}
+
+		return Count + ProcessScalar(Depth + i, Background + i, Mask + i, Num - i, bLearning, Step, Threshold);
+	}
+#endif
+}
+
+void FAzureKinectBackgroundModel::Reset()
+{
+	Background.Reset();
+	NumLearnedFrames = 0;
+}
+
+int32 FAzureKinectBackgroundModel::Process(const uint16* Depth, int32 Width, int32 Height, const FAzureKinectBackgroundSettings& Settings, uint8* OutMask)
+{
+	const int32 Num = Width * Height;
+	if (Background.Num() != Num)
+	{
+		// Resolution changed, learn again
+		Background.SetNumZeroed(Num);
+		NumLearnedFrames = 0;
+	}
+
+	const bool bLearning = IsLearning(Settings);
+	const uint16 Step = static_cast<uint16>(FMath::Clamp(Settings.UpdateRate, 0, 0xFFFF));
+	const uint16 Threshold = static_cast<uint16>(FMath::Clamp(Settings.Threshold, 0, 0xFFFF));
+
+	const int32 NumChunks = FMath::DivideAndRoundUp(Num, ChunkSize);
+	TArray<int32, TInlineAllocator<64>> Counts;
+	Counts.SetNumZeroed(NumChunks);
+
+	uint16* BackgroundData = Background.GetData();
+	ParallelFor(NumChunks, [&](int32 Chunk)
+	{
+		const int32 Start = Chunk * ChunkSize;
+		const int32 ChunkNum = FMath::Min(ChunkSize, Num - Start);
+#if PLATFORM_CPU_X86_FAMILY
+		Counts[Chunk] = ProcessSSE2(Depth + Start, BackgroundData + Start, OutMask + Start, ChunkNum, bLearning, Step, Threshold);
+#else
+		Counts[Chunk] = ProcessScalar(Depth + Start, BackgroundData + Start, OutMask + Start, ChunkNum, bLearning, Step, Threshold);
+#endif
+	});
+
+	if (bLearning)
+	{
+		NumLearnedFrames++;
+	}
+
+	int32 Count = 0;
+	for (int32 ChunkCount : Counts)
+	{
+		Count += ChunkCount;
+	}
+	return Count;
+}
@@ -0,0 +1,164 @@
+#include "AzureKinectBodyGeometry.h"
+#include "Async/ParallelFor.h"
+
+namespace
+{
+	/** Rows per task, a 512x512 map makes 16 tasks. */
+	constexpr int32 RowsPerTask = 32;
+
+	/** Moore neighbourhood starting east, counter-clockwise on screen. */
+	constexpr int32 NeighbourX[] = { 1, 1, 0, -1, -1, -1, 0, 1 };
+	constexpr int32 NeighbourY[] = { 0, -1, -1, -1, 0, 1, 1, 1 };
+}
+
+void FAzureKinectBodyGeometryExtractor::SetXYTable(TArray<float>&& InXYTable, int32 Width, int32 Height)
+{
+	check(InXYTable.Num() == Width * Height * 2);
+	XYTable = MoveTemp(InXYTable);
+	TableWidth = Width;
+	TableHeight = Height;
+}
+
+void FAzureKinectBodyGeometryExtractor::ResetXYTable()
+{
+	XYTable.Empty();
+	TableWidth = 0;
+	TableHeight = 0;
+}
+
+void FAzureKinectBodyGeometryExtractor::Extract(const uint8* BodyIndexMap, const uint16* Depth, int32 Width, int32 Height, const FMatrix& PointToWorld,
+	int32 NumBodies, const FAzureKinectBodyGeometrySettings& Settings, TArray<FAzureKinectBodyGeometry>& OutGeometries)
+{
+	OutGeometries.SetNum(NumBodies, false);
+	if (NumBodies <= 0 || !HasXYTable(Width, Height))
+	{
+		for (FAzureKinectBodyGeometry& Geometry : OutGeometries)
+		{
+			Geometry.Bounds.Init();
+			Geometry.Centroid = FVector::ZeroVector;
+			Geometry.NumPixels = 0;
+			Geometry.Contour.Reset();
+		}
+		return;
+	}
+
+	const int32 NumChunks = FMath::DivideAndRoundUp(Height, RowsPerTask);
+	Accumulators.SetNumUninitialized(NumChunks * NumBodies, false);
+
+	ParallelFor(NumChunks, [&](int32 Chunk)
+	{
+		FAccumulator* ChunkAccumulators = &Accumulators[Chunk * NumBodies];
+		for (int32 b = 0; b < NumBodies; b++)
+		{
+			ChunkAccumulators[b] = { FVector(BIG_NUMBER), FVector(-BIG_NUMBER), FVector::ZeroVector, 0, INDEX_NONE };
+		}
+
+		const int32 EndRow = FMath::Min((Chunk + 1) * RowsPerTask, Height);
+		for (int32 i = Chunk * RowsPerTask * Width; i < EndRow * Width; i++)
+		{
+			// Background is 255
+			const uint8 BodyIndex = BodyIndexMap[i];
+			if (BodyIndex >= NumBodies) continue;
+
+			FAccumulator& Acc = ChunkAccumulators[BodyIndex];
+			if (Acc.FirstPixel == INDEX_NONE)
+			{
+				Acc.FirstPixel = i;
+			}
+
+			const float D = Depth[i];
+			const float RayX = XYTable[i * 2];
+			if (D == 0.f || FMath::IsNaN(RayX)) continue;
+
+			const FVector Point = PointToWorld.TransformPosition(FVector(RayX * D, XYTable[i * 2 + 1] * D, D));
+			Acc.Min = Acc.Min.ComponentMin(Point);
+			Acc.Max = Acc.Max.ComponentMax(Point);
+			// Chunk local sums stay small enough for float
+			Acc.Sum += Point;
+			Acc.Count++;
+		}
+	});
+
+	for (int32 b = 0; b < NumBodies; b++)
+	{
+		FAzureKinectBodyGeometry& Geometry = OutGeometries[b];
+		Geometry.Bounds.Init();
+		double SumX = 0.0, SumY = 0.0, SumZ = 0.0;
+		int32 Count = 0;
+		int32 FirstPixel = INDEX_NONE;
+
+		for (int32 Chunk = 0; Chunk < NumChunks; Chunk++)
+		{
+			const FAccumulator& Acc = Accumulators[Chunk * NumBodies + b];
+			if (FirstPixel == INDEX_NONE)
+			{
+				FirstPixel = Acc.FirstPixel;
+			}
+			if (Acc.Count == 0) continue;
+
+			Geometry.Bounds += FBox(Acc.Min, Acc.Max);
+			SumX += Acc.Sum.X;
+			SumY += Acc.Sum.Y;
+			SumZ += Acc.Sum.Z;
+			Count += Acc.Count;
+		}
+
+		Geometry.NumPixels = Count;
+		Geometry.Centroid = Count > 0 ? FVector(SumX / Count, SumY / Count, SumZ / Count) : FVector::ZeroVector;
+		Geometry.Contour.Reset();
+		if (Settings.bContour && FirstPixel != INDEX_NONE)
+		{
+			TraceContour(BodyIndexMap, Width, Height, static_cast<uint8>(b), FirstPixel, Settings.MaxContourPoints, Geometry.Contour);
+		}
+	}
+}
+
+void FAzureKinectBodyGeometryExtractor::TraceContour(const uint8* BodyIndexMap, int32 Width, int32 Height, uint8 BodyIndex, int32 StartPixel, int32 MaxPoints, TArray<FVector2D>& OutContour)
+{
+	// Moore neighbour tracing. The start is the first pixel in scan order, so the pixels above and to its left are background.
+	const int32 StartX = StartPixel % Width;
+	const int32 StartY = StartPixel / Width;
+	int32 X = StartX, Y = StartY;
+	int32 Direction = 7;
+
+	TArray<FIntPoint, TInlineAllocator<1024>> Boundary;
+	Boundary.Emplace(X, Y);
+
+	// Bound the walk in case of a malformed map
+	const int32 MaxSteps = 4 * Width * Height;
+	for (int32 Step = 0; Step < MaxSteps; Step++)
+	{
+		// Resume the search from the background neighbour we came past
+		const int32 Search = (Direction & 1) == 0 ? (Direction + 7) & 7 : (Direction + 6) & 7;
+		bool bFound = false;
+		for (int32 n = 0; n < 8; n++)
+		{
+			const int32 Candidate = (Search + n) & 7;
+			const int32 NX = X + NeighbourX[Candidate];
+			const int32 NY = Y + NeighbourY[Candidate];
+			if (NX >= 0 && NX < Width && NY >= 0 && NY < Height && BodyIndexMap[NY * Width + NX] == BodyIndex)
+			{
+				X = NX;
+				Y = NY;
+				Direction = Candidate;
+				bFound = true;
+				break;
+			}
+		}
+
+		if (!bFound || (X == StartX && Y == StartY))
+		{
+			break;
+		}
+		Boundary.Emplace(X, Y);
+	}
+
+	// Decimate evenly, keeping the start
+	const int32 NumPoints = FMath::Min(Boundary.Num(), FMath::Max(MaxPoints, 1));
+	OutContour.SetNumUninitialized(NumPoints, false);
+	for (int32 i = 0; i < NumPoints; i++)
+	{
+		const FIntPoint& Point = Boundary[static_cast<int64>(i) * Boundary.Num() / NumPoints];
+		OutContour[i] = FVector2D(Point.X, Point.Y);
+	}
+}
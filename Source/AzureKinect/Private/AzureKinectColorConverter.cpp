@@ -0,0 +1,282 @@
+#include "AzureKinectColorConverter.h"
+#include "Async/ParallelFor.h"
+#include "HAL/IConsoleManager.h"
+#include "Modules/ModuleManager.h"
+#include "IImageWrapper.h"
+#include "IImageWrapperModule.h"
+
+#if PLATFORM_CPU_X86_FAMILY
+#include <emmintrin.h>
+#endif
+
+DEFINE_LOG_CATEGORY(AzureKinectColorConverterLog);
+
+namespace
+{
+	constexpr int32 RowsPerTask = 16;
+
+	// BT.601 limited range in 6bit fixed point, small enough for 16bit lanes.
+	// Only sums which end up above 255 can saturate, so scalar and vector results are identical.
+	constexpr int32 YScale = 75;
+	constexpr int32 VToR = 102;
+	constexpr int32 UToG = -25;
+	constexpr int32 VToG = -52;
+	constexpr int32 UToB = 129;
+
+	FORCEINLINE FColor YuvToColor(int32 Y, int32 U, int32 V)
+	{
+		const int32 C = (Y - 16) * YScale, D = U - 128, E = V - 128;
+		return FColor(
+			static_cast<uint8>(FMath::Clamp((C + VToR * E + 32) >> 6, 0, 255)),
+			static_cast<uint8>(FMath::Clamp((C + UToG * D + VToG * E + 32) >> 6, 0, 255)),
+			static_cast<uint8>(FMath::Clamp((C + UToB * D + 32) >> 6, 0, 255)),
+			0xFF);
+	}
+
+#if PLATFORM_CPU_X86_FAMILY
+	/**
+	 * Convert 8 pixels and store them as BGRA.
+	 * @param UV 16bit lanes of U0 V0 U1 V1 U2 V2 U3 V3, each pair shared by 2 pixels.
+	 */
+	FORCEINLINE void StoreBGRA(FColor* Dst, __m128i Y, __m128i UV)
+	{
+		const __m128i U = _mm_shufflehi_epi16(_mm_shufflelo_epi16(UV, _MM_SHUFFLE(2, 2, 0, 0)), _MM_SHUFFLE(2, 2, 0, 0));
+		const __m128i V = _mm_shufflehi_epi16(_mm_shufflelo_epi16(UV, _MM_SHUFFLE(3, 3, 1, 1)), _MM_SHUFFLE(3, 3, 1, 1));
+
+		const __m128i C = _mm_mullo_epi16(_mm_sub_epi16(Y, _mm_set1_epi16(16)), _mm_set1_epi16(YScale));
+		const __m128i D = _mm_sub_epi16(U, _mm_set1_epi16(128));
+		const __m128i E = _mm_sub_epi16(V, _mm_set1_epi16(128));
+		const __m128i Round = _mm_set1_epi16(32);
+
+		const __m128i R = _mm_srai_epi16(_mm_adds_epi16(_mm_adds_epi16(C, _mm_mullo_epi16(E, _mm_set1_epi16(VToR))), Round), 6);
+		const __m128i G = _mm_srai_epi16(_mm_adds_epi16(_mm_adds_epi16(_mm_adds_epi16(C,
+			_mm_mullo_epi16(D, _mm_set1_epi16(UToG))), _mm_mullo_epi16(E, _mm_set1_epi16(VToG))), Round), 6);
+		const __m128i B = _mm_srai_epi16(_mm_adds_epi16(_mm_adds_epi16(C, _mm_mullo_epi16(D, _mm_set1_epi16(UToB))), Round), 6);
+
+		const __m128i BG = _mm_unpacklo_epi8(_mm_packus_epi16(B, B), _mm_packus_epi16(G, G));
+		const __m128i RA = _mm_unpacklo_epi8(_mm_packus_epi16(R, R), _mm_set1_epi8(-1));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(Dst), _mm_unpacklo_epi16(BG, RA));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(Dst + 4), _mm_unpackhi_epi16(BG, RA));
+	}
+#endif
+
+	void ConvertNV12Row(const uint8* YRow, const uint8* UVRow, int32 Width, FColor* Dst)
+	{
+		int32 x = 0;
+#if PLATFORM_CPU_X86_FAMILY
+		const __m128i Zero = _mm_setzero_si128();
+		for (; x + 8 <= Width; x += 8)
+		{
+			const __m128i Y = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(YRow + x)), Zero);
+			const __m128i UV = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(UVRow + x)), Zero);
+			StoreBGRA(Dst + x, Y, UV);
+		}
+#endif
+		for (; x < Width; x++)
+		{
+			const int32 Pair = (x / 2) * 2;
+			Dst[x] = YuvToColor(YRow[x], UVRow[Pair], UVRow[Pair + 1]);
+		}
+	}
+
+	void ConvertYUY2Row(const uint8* Row, int32 Width, FColor* Dst)
+	{
+		int32 x = 0;
+#if PLATFORM_CPU_X86_FAMILY
+		const __m128i LowByte = _mm_set1_epi16(0x00FF);
+		for (; x + 8 <= Width; x += 8)
+		{
+			// Y0 U0 Y1 V0 ...
+			const __m128i Packed = _mm_loadu_si128(reinterpret_cast<const __m128i*>(Row + x * 2));
+			StoreBGRA(Dst + x, _mm_and_si128(Packed, LowByte), _mm_srli_epi16(Packed, 8));
+		}
+#endif
+		for (; x < Width; x++)
+		{
+			const int32 Pair = (x / 2) * 4;
+			Dst[x] = YuvToColor(Row[Pair + (x & 1) * 2], Row[Pair + 1], Row[Pair + 3]);
+		}
+	}
+
+	template<typename RowFunctionType>
+	void ForEachRowBand(int32 Height, RowFunctionType RowFunction)
+	{
+		ParallelFor(FMath::DivideAndRoundUp(Height, RowsPerTask), [&](int32 Band)
+		{
+			const int32 End = FMath::Min((Band + 1) * RowsPerTask, Height);
+			for (int32 y = Band * RowsPerTask; y < End; y++)
+			{
+				RowFunction(y);
+			}
+		});
+	}
+
+	void BenchmarkColorConversion(const TArray<FString>& Args)
+	{
+		const int32 NumFrames = Args.Num() > 0 ? FMath::Max(FCString::Atoi(*Args[0]), 1) : 30;
+
+		const TPair<EKinectColorResolution, FIntPoint> Resolutions[] = {
+			{ EKinectColorResolution::RESOLUTION_720P, FIntPoint(1280, 720) },
+			{ EKinectColorResolution::RESOLUTION_1440P, FIntPoint(2560, 1440) },
+			{ EKinectColorResolution::RESOLUTION_1536P, FIntPoint(2048, 1536) },
+			{ EKinectColorResolution::RESOLUTION_2160P, FIntPoint(3840, 2160) },
+			{ EKinectColorResolution::RESOLUTION_3072P, FIntPoint(4096, 3072) },
+		};
+		const EKinectColorFormat Formats[] = { EKinectColorFormat::MJPG, EKinectColorFormat::NV12, EKinectColorFormat::YUY2 };
+
+		// Can't be loaded from worker threads
+		FModuleManager::LoadModuleChecked<IImageWrapperModule>(TEXT("ImageWrapper"));
+
+		for (const TPair<EKinectColorResolution, FIntPoint>& Resolution : Resolutions)
+		{
+			for (EKinectColorFormat Format : Formats)
+			{
+				const float Ms = FAzureKinectColorConverter::Benchmark(Format, Resolution.Value.X, Resolution.Value.Y, NumFrames);
+				UE_LOG(AzureKinectColorConverterLog, Display, TEXT("%s %s: %.3f ms"),
+					*StaticEnum<EKinectColorResolution>()->GetNameStringByValue(static_cast<int64>(Resolution.Key)),
+					*StaticEnum<EKinectColorFormat>()->GetNameStringByValue(static_cast<int64>(Format)),
+					Ms);
+			}
+		}
+	}
+
+	FAutoConsoleCommand BenchmarkColorConversionCommand(
+		TEXT("AzureKinect.BenchmarkColorConversion"),
+		TEXT("Log the cost of converting each color format to BGRA at every color resolution. Takes the number of frames, 30 by default."),
+		FConsoleCommandWithArgsDelegate::CreateStatic(&BenchmarkColorConversion));
+}
+
+bool FAzureKinectColorConverter::Convert(EKinectColorFormat Format, const uint8* Src, int64 SrcSize, int32 Width, int32 Height, int32 Stride, FColor* Dst)
+{
+	switch (Format)
+	{
+	case EKinectColorFormat::NV12:
+		if (SrcSize < static_cast<int64>(Stride) * Height * 3 / 2) return false;
+		ConvertNV12(Src, Width, Height, Stride, Dst);
+		return true;
+	case EKinectColorFormat::YUY2:
+		if (SrcSize < static_cast<int64>(Stride) * Height) return false;
+		ConvertYUY2(Src, Width, Height, Stride, Dst);
+		return true;
+	case EKinectColorFormat::MJPG:
+		return DecodeMJPG(Src, SrcSize, Width, Height, Dst);
+	case EKinectColorFormat::BGRA32:
+		if (SrcSize < static_cast<int64>(Stride) * Height) return false;
+		for (int32 y = 0; y < Height; y++)
+		{
+			FMemory::Memcpy(Dst + y * Width, Src + y * Stride, Width * sizeof(FColor));
+		}
+		return true;
+	default:
+		return false;
+	}
+}
+
+void FAzureKinectColorConverter::ConvertNV12(const uint8* Src, int32 Width, int32 Height, int32 Stride, FColor* Dst)
+{
+	const uint8* UVPlane = Src + Stride * Height;
+	ForEachRowBand(Height, [&](int32 y)
+	{
+		ConvertNV12Row(Src + y * Stride, UVPlane + (y / 2) * Stride, Width, Dst + y * Width);
+	});
+}
+
+void FAzureKinectColorConverter::ConvertYUY2(const uint8* Src, int32 Width, int32 Height, int32 Stride, FColor* Dst)
+{
+	ForEachRowBand(Height, [&](int32 y)
+	{
+		ConvertYUY2Row(Src + y * Stride, Width, Dst + y * Width);
+	});
+}
+
+bool FAzureKinectColorConverter::DecodeMJPG(const uint8* Src, int64 SrcSize, int32 Width, int32 Height, FColor* Dst)
+{
+	if (!JpegWrapper)
+	{
+		IImageWrapperModule* ImageWrapperModule = FModuleManager::GetModulePtr<IImageWrapperModule>(TEXT("ImageWrapper"));
+		if (!ImageWrapperModule)
+		{
+			UE_LOG(AzureKinectColorConverterLog, Error, TEXT("ImageWrapper module is not loaded."));
+			return false;
+		}
+		JpegWrapper = ImageWrapperModule->CreateImageWrapper(EImageFormat::JPEG);
+	}
+
+	if (!JpegWrapper || !JpegWrapper->SetCompressed(Src, SrcSize))
+	{
+		UE_LOG(AzureKinectColorConverterLog, Verbose, TEXT("Can't read MJPG frame."));
+		return false;
+	}
+
+	if (JpegWrapper->GetWidth() != Width || JpegWrapper->GetHeight() != Height)
+	{
+		UE_LOG(AzureKinectColorConverterLog, Warning, TEXT("MJPG frame is %dx%d, expected %dx%d."), JpegWrapper->GetWidth(), JpegWrapper->GetHeight(), Width, Height);
+		return false;
+	}
+
+	if (!JpegWrapper->GetRaw(ERGBFormat::BGRA, 8, DecodedScratch))
+	{
+		UE_LOG(AzureKinectColorConverterLog, Verbose, TEXT("Can't decode MJPG frame."));
+		return false;
+	}
+
+	FMemory::Memcpy(Dst, DecodedScratch.GetData(), static_cast<int64>(Width) * Height * sizeof(FColor));
+	return true;
+}
+
+float FAzureKinectColorConverter::Benchmark(EKinectColorFormat Format, int32 Width, int32 Height, int32 NumFrames)
+{
+	// Gradients with some texture, so JPEG doesn't compress to nothing
+	TArray<FColor> Image;
+	Image.SetNumUninitialized(Width * Height);
+	for (int32 y = 0; y < Height; y++)
+	{
+		for (int32 x = 0; x < Width; x++)
+		{
+			Image[y * Width + x] = FColor(x & 0xFF, y & 0xFF, (x * y) >> 4 & 0xFF, 0xFF);
+		}
+	}
+
+	TArray64<uint8> Source;
+	int32 Stride = 0;
+	switch (Format)
+	{
+	case EKinectColorFormat::NV12:
+		Stride = Width;
+		Source.SetNumUninitialized(static_cast<int64>(Width) * Height * 3 / 2);
+		for (int64 i = 0; i < Source.Num(); i++)
+		{
+			Source[i] = static_cast<uint8>(i * 7);
+		}
+		break;
+	case EKinectColorFormat::YUY2:
+		Stride = Width * 2;
+		Source.SetNumUninitialized(static_cast<int64>(Stride) * Height);
+		for (int64 i = 0; i < Source.Num(); i++)
+		{
+			Source[i] = static_cast<uint8>(i * 7);
+		}
+		break;
+	case EKinectColorFormat::MJPG:
+	{
+		IImageWrapperModule* ImageWrapperModule = FModuleManager::GetModulePtr<IImageWrapperModule>(TEXT("ImageWrapper"));
+		TSharedPtr<IImageWrapper> Encoder = ImageWrapperModule ? ImageWrapperModule->CreateImageWrapper(EImageFormat::JPEG) : nullptr;
+		if (!Encoder || !Encoder->SetRaw(Image.GetData(), Image.Num() * sizeof(FColor), Width, Height, ERGBFormat::BGRA, 8))
+		{
+			return 0.f;
+		}
+		Source = Encoder->GetCompressed(90);
+		break;
+	}
+	default:
+		return 0.f;
+	}
+
+	FAzureKinectColorConverter Converter;
+	const double StartTime = FPlatformTime::Seconds();
+	for (int32 i = 0; i < NumFrames; i++)
+	{
+		Converter.Convert(Format, Source.GetData(), Source.Num(), Width, Height, Stride, Image.GetData());
+	}
+	return static_cast<float>((FPlatformTime::Seconds() - StartTime) * 1000.0 / FMath::Max(NumFrames, 1));
+}
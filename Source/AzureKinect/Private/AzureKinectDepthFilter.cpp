@@ -0,0 +1,531 @@
+#include "AzureKinectDepthFilter.h"
+#include "Async/ParallelFor.h"
+#include "HAL/IConsoleManager.h"
+#include "Math/RandomStream.h"
+
+#if PLATFORM_CPU_X86_FAMILY
+#include <emmintrin.h>
+#endif
+
+DEFINE_LOG_CATEGORY(AzureKinectDepthFilterLog);
+
+namespace
+{
+	/** Rows per task for neighbourhood kernels, pixels per task for per-pixel kernels. */
+	constexpr int32 RowsPerTask = 16;
+	constexpr int32 PixelsPerTask = 64 * 1024;
+
+	/** 3x3 spatial weights of the bilateral filter, sigma of 1 pixel. */
+	constexpr float SpatialWeights[9] = {
+		0.3679f, 0.6065f, 0.3679f,
+		0.6065f, 1.0000f, 0.6065f,
+		0.3679f, 0.6065f, 0.3679f,
+	};
+
+	FORCEINLINE uint16 AbsDiff(uint16 A, uint16 B)
+	{
+		return A > B ? A - B : B - A;
+	}
+
+	/** Compare-exchange network for the median of 9 (Paeth), shared by scalar and vector kernels. */
+	template<typename T, typename MinType, typename MaxType>
+	FORCEINLINE T Median9(T P[9], MinType Min, MaxType Max)
+	{
+		auto Sort2 = [&](int32 A, int32 B)
+		{
+			const T Lo = Min(P[A], P[B]);
+			P[B] = Max(P[A], P[B]);
+			P[A] = Lo;
+		};
+		Sort2(1, 2); Sort2(4, 5); Sort2(7, 8);
+		Sort2(0, 1); Sort2(3, 4); Sort2(6, 7);
+		Sort2(1, 2); Sort2(4, 5); Sort2(7, 8);
+		Sort2(0, 3); Sort2(5, 8); Sort2(4, 7);
+		Sort2(3, 6); Sort2(1, 4); Sort2(2, 5);
+		Sort2(4, 7); Sort2(4, 2); Sort2(6, 4);
+		Sort2(4, 2);
+		return P[4];
+	}
+
+#if PLATFORM_CPU_X86_FAMILY
+	// SSE2 has no unsigned 16bit min/max
+	FORCEINLINE __m128i MinU16(__m128i A, __m128i B) { return _mm_sub_epi16(A, _mm_subs_epu16(A, B)); }
+	FORCEINLINE __m128i MaxU16(__m128i A, __m128i B) { return _mm_add_epi16(_mm_subs_epu16(A, B), B); }
+	FORCEINLINE __m128i AbsDiffU16(__m128i A, __m128i B) { return _mm_or_si128(_mm_subs_epu16(A, B), _mm_subs_epu16(B, A)); }
+
+	FORCEINLINE __m128 ToFloatLo(__m128i V) { return _mm_cvtepi32_ps(_mm_unpacklo_epi16(V, _mm_setzero_si128())); }
+	FORCEINLINE __m128 ToFloatHi(__m128i V) { return _mm_cvtepi32_ps(_mm_unpackhi_epi16(V, _mm_setzero_si128())); }
+
+	FORCEINLINE __m128i ToU16(__m128 Lo, __m128 Hi)
+	{
+		// Bias into the signed range, packus_epi32 needs SSE4.1
+		const __m128i Bias = _mm_set1_epi32(32768);
+		const __m128i L = _mm_sub_epi32(_mm_cvtps_epi32(Lo), Bias);
+		const __m128i H = _mm_sub_epi32(_mm_cvtps_epi32(Hi), Bias);
+		return _mm_xor_si128(_mm_packs_epi32(L, H), _mm_set1_epi16(-32768));
+	}
+#endif
+
+	struct FFlyingPixelKernel
+	{
+		uint16 Threshold;
+
+		uint16 Scalar(const uint16 N[9]) const
+		{
+			const uint16 C = N[4];
+			for (int32 i = 0; i < 9; i++)
+			{
+				if (N[i] != 0 && AbsDiff(N[i], C) > Threshold)
+				{
+					return 0;
+				}
+			}
+			return C;
+		}
+
+#if PLATFORM_CPU_X86_FAMILY
+		__m128i Vector(const __m128i N[9]) const
+		{
+			const __m128i Zero = _mm_setzero_si128();
+			const __m128i ThresholdV = _mm_set1_epi16(static_cast<short>(Threshold));
+			const __m128i C = N[4];
+
+			// Lanes where a valid neighbour is within the threshold, accumulated as "not flying"
+			__m128i Flying = Zero;
+			for (int32 i = 0; i < 9; i++)
+			{
+				const __m128i Within = _mm_cmpeq_epi16(_mm_subs_epu16(AbsDiffU16(N[i], C), ThresholdV), Zero);
+				const __m128i Invalid = _mm_cmpeq_epi16(N[i], Zero);
+				Flying = _mm_or_si128(Flying, _mm_andnot_si128(_mm_or_si128(Within, Invalid), _mm_set1_epi16(-1)));
+			}
+			return _mm_andnot_si128(Flying, C);
+		}
+#endif
+	};
+
+	struct FHoleFillKernel
+	{
+		uint16 Scalar(const uint16 N[9]) const
+		{
+			if (N[4] != 0)
+			{
+				return N[4];
+			}
+			uint16 Farthest = 0;
+			for (int32 i = 0; i < 9; i++)
+			{
+				Farthest = FMath::Max(Farthest, N[i]);
+			}
+			return Farthest;
+		}
+
+#if PLATFORM_CPU_X86_FAMILY
+		__m128i Vector(const __m128i N[9]) const
+		{
+			__m128i Farthest = N[0];
+			for (int32 i = 1; i < 9; i++)
+			{
+				Farthest = MaxU16(Farthest, N[i]);
+			}
+			const __m128i Hole = _mm_cmpeq_epi16(N[4], _mm_setzero_si128());
+			return _mm_or_si128(N[4], _mm_and_si128(Hole, Farthest));
+		}
+#endif
+	};
+
+	struct FMedianKernel
+	{
+		uint16 Scalar(const uint16 N[9]) const
+		{
+			if (N[4] == 0)
+			{
+				return 0;
+			}
+			uint16 P[9];
+			FMemory::Memcpy(P, N, sizeof(P));
+			return Median9(P, [](uint16 A, uint16 B) { return FMath::Min(A, B); }, [](uint16 A, uint16 B) { return FMath::Max(A, B); });
+		}
+
+#if PLATFORM_CPU_X86_FAMILY
+		__m128i Vector(const __m128i N[9]) const
+		{
+			__m128i P[9];
+			for (int32 i = 0; i < 9; i++)
+			{
+				P[i] = N[i];
+			}
+			const __m128i Median = Median9(P, &MinU16, &MaxU16);
+			return _mm_andnot_si128(_mm_cmpeq_epi16(N[4], _mm_setzero_si128()), Median);
+		}
+#endif
+	};
+
+	/** Gaussian spatial weights with a linear range falloff, which keeps the kernel branch free. */
+	struct FBilateralKernel
+	{
+		float InvRange;
+
+		uint16 Scalar(const uint16 N[9]) const
+		{
+			if (N[4] == 0)
+			{
+				return 0;
+			}
+			float Sum = 0.f, WeightSum = 0.f;
+			for (int32 i = 0; i < 9; i++)
+			{
+				if (N[i] == 0)
+				{
+					continue;
+				}
+				const float Weight = FMath::Max(0.f, 1.f - AbsDiff(N[i], N[4]) * InvRange) * SpatialWeights[i];
+				Sum += Weight * N[i];
+				WeightSum += Weight;
+			}
+			// Same rounding as cvtps in the vector path
+			return static_cast<uint16>(FMath::Clamp(static_cast<int32>(FMath::RoundHalfToEven(Sum / WeightSum)), 0, 0xFFFF));
+		}
+
+#if PLATFORM_CPU_X86_FAMILY
+		__m128 Half(const __m128 N[9]) const
+		{
+			const __m128 Zero = _mm_setzero_ps();
+			const __m128 One = _mm_set1_ps(1.f);
+			const __m128 InvRangeV = _mm_set1_ps(InvRange);
+			const __m128 AbsMask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+
+			__m128 Sum = Zero, WeightSum = Zero;
+			for (int32 i = 0; i < 9; i++)
+			{
+				const __m128 Diff = _mm_and_ps(_mm_sub_ps(N[i], N[4]), AbsMask);
+				__m128 Weight = _mm_max_ps(Zero, _mm_sub_ps(One, _mm_mul_ps(Diff, InvRangeV)));
+				Weight = _mm_mul_ps(Weight, _mm_set1_ps(SpatialWeights[i]));
+				Weight = _mm_and_ps(Weight, _mm_cmpneq_ps(N[i], Zero));
+				Sum = _mm_add_ps(Sum, _mm_mul_ps(Weight, N[i]));
+				WeightSum = _mm_add_ps(WeightSum, Weight);
+			}
+			// Invalid centers may have no weight at all, they are masked out after
+			return _mm_div_ps(Sum, _mm_max_ps(WeightSum, _mm_set1_ps(1e-6f)));
+		}
+
+		__m128i Vector(const __m128i N[9]) const
+		{
+			__m128 Lo[9], Hi[9];
+			for (int32 i = 0; i < 9; i++)
+			{
+				Lo[i] = ToFloatLo(N[i]);
+				Hi[i] = ToFloatHi(N[i]);
+			}
+			const __m128i Filtered = ToU16(Half(Lo), Half(Hi));
+			return _mm_andnot_si128(_mm_cmpeq_epi16(N[4], _mm_setzero_si128()), Filtered);
+		}
+#endif
+	};
+
+	/** Run a 3x3 kernel over a row, borders are clamped. */
+	template<typename KernelType>
+	void FilterRow(const uint16* Up, const uint16* Mid, const uint16* Down, uint16* Out, int32 Width, const KernelType& Kernel)
+	{
+		auto ScalarAt = [&](int32 x)
+		{
+			const int32 L = FMath::Max(x - 1, 0), R = FMath::Min(x + 1, Width - 1);
+			const uint16 N[9] = {
+				Up[L], Up[x], Up[R],
+				Mid[L], Mid[x], Mid[R],
+				Down[L], Down[x], Down[R],
+			};
+			Out[x] = Kernel.Scalar(N);
+		};
+
+		ScalarAt(0);
+		int32 x = 1;
+#if PLATFORM_CPU_X86_FAMILY
+		for (; x + 8 < Width; x += 8)
+		{
+			const __m128i N[9] = {
+				_mm_loadu_si128(reinterpret_cast<const __m128i*>(Up + x - 1)),
+				_mm_loadu_si128(reinterpret_cast<const __m128i*>(Up + x)),
+				_mm_loadu_si128(reinterpret_cast<const __m128i*>(Up + x + 1)),
+				_mm_loadu_si128(reinterpret_cast<const __m128i*>(Mid + x - 1)),
+				_mm_loadu_si128(reinterpret_cast<const __m128i*>(Mid + x)),
+				_mm_loadu_si128(reinterpret_cast<const __m128i*>(Mid + x + 1)),
+				_mm_loadu_si128(reinterpret_cast<const __m128i*>(Down + x - 1)),
+				_mm_loadu_si128(reinterpret_cast<const __m128i*>(Down + x)),
+				_mm_loadu_si128(reinterpret_cast<const __m128i*>(Down + x + 1)),
+			};
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(Out + x), Kernel.Vector(N));
+		}
+#endif
+		for (; x < Width; x++)
+		{
+			ScalarAt(x);
+		}
+	}
+
+	template<typename KernelType>
+	void FilterImage(const uint16* Src, uint16* Dst, int32 Width, int32 Height, const KernelType& Kernel)
+	{
+		const int32 NumBands = FMath::DivideAndRoundUp(Height, RowsPerTask);
+		ParallelFor(NumBands, [&](int32 Band)
+		{
+			const int32 End = FMath::Min((Band + 1) * RowsPerTask, Height);
+			for (int32 y = Band * RowsPerTask; y < End; y++)
+			{
+				FilterRow(
+					Src + FMath::Max(y - 1, 0) * Width,
+					Src + y * Width,
+					Src + FMath::Min(y + 1, Height - 1) * Width,
+					Dst + y * Width, Width, Kernel);
+			}
+		});
+	}
+
+	void TemporalScalar(uint16* Depth, float* History, int32 Num, float Alpha, float Threshold)
+	{
+		for (int32 i = 0; i < Num; i++)
+		{
+			const float C = Depth[i];
+			float P = History[i];
+			if (C != 0.f && P != 0.f && FMath::Abs(C - P) < Threshold)
+			{
+				P += (C - P) * Alpha;
+				// Same rounding as cvtps in the vector path
+				Depth[i] = static_cast<uint16>(FMath::RoundHalfToEven(P));
+			}
+			else
+			{
+				P = C;
+			}
+			History[i] = P;
+		}
+	}
+
+#if PLATFORM_CPU_X86_FAMILY
+	void TemporalSSE2(uint16* Depth, float* History, int32 Num, float Alpha, float Threshold)
+	{
+		const __m128 Zero = _mm_setzero_ps();
+		const __m128 AlphaV = _mm_set1_ps(Alpha);
+		const __m128 ThresholdV = _mm_set1_ps(Threshold);
+		const __m128 AbsMask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+
+		auto Blend = [&](__m128 C, __m128 P)
+		{
+			const __m128 Diff = _mm_sub_ps(C, P);
+			const __m128 Near = _mm_cmplt_ps(_mm_and_ps(Diff, AbsMask), ThresholdV);
+			const __m128 Valid = _mm_and_ps(_mm_cmpneq_ps(C, Zero), _mm_cmpneq_ps(P, Zero));
+			const __m128 Mask = _mm_and_ps(Near, Valid);
+			const __m128 Smoothed = _mm_add_ps(P, _mm_mul_ps(Diff, AlphaV));
+			return _mm_or_ps(_mm_and_ps(Mask, Smoothed), _mm_andnot_ps(Mask, C));
+		};
+
+		int32 i = 0;
+		for (; i + 8 <= Num; i += 8)
+		{
+			const __m128i C = _mm_loadu_si128(reinterpret_cast<const __m128i*>(Depth + i));
+			const __m128 Lo = Blend(ToFloatLo(C), _mm_loadu_ps(History + i));
+			const __m128 Hi = Blend(ToFloatHi(C), _mm_loadu_ps(History + i + 4));
+
+			_mm_storeu_ps(History + i, Lo);
+			_mm_storeu_ps(History + i + 4, Hi);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(Depth + i), ToU16(Lo, Hi));
+		}
+
+		TemporalScalar(Depth + i, History + i, Num - i, Alpha, Threshold);
+	}
+#endif
+
+	void BenchmarkDepthFilter(const TArray<FString>& Args)
+	{
+		const int32 NumFrames = Args.Num() > 0 ? FMath::Max(FCString::Atoi(*Args[0]), 1) : 100;
+
+		const TPair<EKinectDepthMode, FIntPoint> Modes[] = {
+			{ EKinectDepthMode::NFOV_2X2BINNED, FIntPoint(320, 288) },
+			{ EKinectDepthMode::NFOV_UNBINNED, FIntPoint(640, 576) },
+			{ EKinectDepthMode::WFOV_2X2BINNED, FIntPoint(512, 512) },
+			{ EKinectDepthMode::WFOV_UNBINNED, FIntPoint(1024, 1024) },
+		};
+		const EKinectDepthSpatialFilter SpatialFilters[] = { EKinectDepthSpatialFilter::MEDIAN_3X3, EKinectDepthSpatialFilter::BILATERAL_3X3 };
+
+		FAzureKinectDepthFilterSettings Settings;
+		Settings.bEnabled = true;
+		Settings.bTemporal = true;
+
+		for (const TPair<EKinectDepthMode, FIntPoint>& Mode : Modes)
+		{
+			for (EKinectDepthSpatialFilter SpatialFilter : SpatialFilters)
+			{
+				Settings.SpatialFilter = SpatialFilter;
+				const FAzureKinectDepthFilterTiming Timing = FAzureKinectDepthFilter::Benchmark(Mode.Value.X, Mode.Value.Y, Settings, NumFrames);
+				UE_LOG(AzureKinectDepthFilterLog, Display, TEXT("%s %s: flying pixel %.3f, hole fill %.3f, spatial %.3f, temporal %.3f, total %.3f ms"),
+					*StaticEnum<EKinectDepthMode>()->GetNameStringByValue(static_cast<int64>(Mode.Key)),
+					*StaticEnum<EKinectDepthSpatialFilter>()->GetNameStringByValue(static_cast<int64>(SpatialFilter)),
+					Timing.FlyingPixelMs, Timing.HoleFillMs, Timing.SpatialMs, Timing.TemporalMs, Timing.TotalMs);
+			}
+		}
+	}
+
+	FAutoConsoleCommand BenchmarkDepthFilterCommand(
+		TEXT("AzureKinect.BenchmarkDepthFilter"),
+		TEXT("Log the cost of each depth filter at every depth mode. Takes the number of frames, 100 by default."),
+		FConsoleCommandWithArgsDelegate::CreateStatic(&BenchmarkDepthFilter));
+}
+
+void FAzureKinectDepthFilter::Reset()
+{
+	History.Reset();
+}
+
+void FAzureKinectDepthFilter::Process(uint16* Depth, int32 Width, int32 Height, const FAzureKinectDepthFilterSettings& Settings, FAzureKinectDepthFilterTiming* OutTiming)
+{
+	const int32 Num = Width * Height;
+	if (Num == 0)
+	{
+		return;
+	}
+
+	FAzureKinectDepthFilterTiming Timing;
+	const double StartTime = FPlatformTime::Seconds();
+	double LapTime = StartTime;
+	auto Lap = [&LapTime]()
+	{
+		const double Now = FPlatformTime::Seconds();
+		const float Ms = static_cast<float>((Now - LapTime) * 1000.0);
+		LapTime = Now;
+		return Ms;
+	};
+
+	// Ping-pong between the frame and the scratch buffer
+	Scratch.SetNumUninitialized(Num, false);
+	uint16* Src = Depth;
+	uint16* Dst = Scratch.GetData();
+
+	if (Settings.bRemoveFlyingPixels)
+	{
+		FFlyingPixelKernel Kernel;
+		Kernel.Threshold = static_cast<uint16>(FMath::Clamp(Settings.FlyingPixelThreshold, 1, 0xFFFF));
+		FilterImage(Src, Dst, Width, Height, Kernel);
+		Swap(Src, Dst);
+		Timing.FlyingPixelMs = Lap();
+	}
+
+	for (int32 Pass = 0; Pass < Settings.HoleFillPasses; Pass++)
+	{
+		FilterImage(Src, Dst, Width, Height, FHoleFillKernel());
+		Swap(Src, Dst);
+	}
+	Timing.HoleFillMs = Lap();
+
+	if (Settings.SpatialFilter == EKinectDepthSpatialFilter::MEDIAN_3X3)
+	{
+		FilterImage(Src, Dst, Width, Height, FMedianKernel());
+		Swap(Src, Dst);
+	}
+	else if (Settings.SpatialFilter == EKinectDepthSpatialFilter::BILATERAL_3X3)
+	{
+		FBilateralKernel Kernel;
+		Kernel.InvRange = 1.f / FMath::Max(Settings.BilateralRange, 1);
+		FilterImage(Src, Dst, Width, Height, Kernel);
+		Swap(Src, Dst);
+	}
+
+	if (Src != Depth)
+	{
+		FMemory::Memcpy(Depth, Src, Num * sizeof(uint16));
+	}
+	Timing.SpatialMs = Lap();
+
+	// The new frame alone at alpha 1
+	const bool bTemporal = Settings.bTemporal && Settings.TemporalAlpha < 1.f;
+	if (bTemporal && History.Num() == Num)
+	{
+		const float Alpha = FMath::Max(Settings.TemporalAlpha, 0.f);
+		const float Threshold = static_cast<float>(FMath::Clamp(Settings.TemporalThreshold, 1, 0xFFFF));
+		float* HistoryData = History.GetData();
+
+		ParallelFor(FMath::DivideAndRoundUp(Num, PixelsPerTask), [&](int32 Chunk)
+		{
+			const int32 Start = Chunk * PixelsPerTask;
+			const int32 ChunkNum = FMath::Min(PixelsPerTask, Num - Start);
+#if PLATFORM_CPU_X86_FAMILY
+			TemporalSSE2(Depth + Start, HistoryData + Start, ChunkNum, Alpha, Threshold);
+#else
+			TemporalScalar(Depth + Start, HistoryData + Start, ChunkNum, Alpha, Threshold);
+#endif
+		});
+	}
+	else if (bTemporal)
+	{
+		// First frame or resolution changed
+		History.SetNumUninitialized(Num);
+		for (int32 i = 0; i < Num; i++)
+		{
+			History[i] = Depth[i];
+		}
+	}
+	else
+	{
+		History.Reset();
+	}
+	Timing.TemporalMs = Lap();
+
+	Timing.TotalMs = static_cast<float>((FPlatformTime::Seconds() - StartTime) * 1000.0);
+	if (OutTiming)
+	{
+		*OutTiming = Timing;
+	}
+}
+
+FAzureKinectDepthFilterTiming FAzureKinectDepthFilter::Benchmark(int32 Width, int32 Height, const FAzureKinectDepthFilterSettings& Settings, int32 NumFrames)
+{
+	const int32 Num = Width * Height;
+
+	// A sloped wall with a box in front, sensor noise, holes and flying pixels around the box
+	constexpr int32 NumSourceFrames = 4;
+	FRandomStream Random(0x4B494E);
+	TArray<uint16> Source;
+	Source.SetNumUninitialized(Num * NumSourceFrames);
+	for (int32 f = 0; f < NumSourceFrames; f++)
+	{
+		for (int32 y = 0; y < Height; y++)
+		{
+			for (int32 x = 0; x < Width; x++)
+			{
+				const bool bBox = FMath::Abs(x - Width / 2) < Width / 6 && FMath::Abs(y - Height / 2) < Height / 4;
+				const bool bBoxEdge = bBox && (FMath::Abs(x - Width / 2) >= Width / 6 - 2 || FMath::Abs(y - Height / 2) >= Height / 4 - 2);
+				int32 Value = bBox ? 1200 : 3000 + x;
+				if (bBoxEdge)
+				{
+					Value = Random.RandRange(1200, 3000);
+				}
+				Value += Random.RandRange(-10, 10);
+				Source[f * Num + y * Width + x] = Random.FRand() < 0.03f ? 0 : static_cast<uint16>(Value);
+			}
+		}
+	}
+
+	FAzureKinectDepthFilter Filter;
+	TArray<uint16> Frame;
+	Frame.SetNumUninitialized(Num);
+
+	FAzureKinectDepthFilterTiming Total;
+	for (int32 i = 0; i < NumFrames; i++)
+	{
+		FMemory::Memcpy(Frame.GetData(), Source.GetData() + (i % NumSourceFrames) * Num, Num * sizeof(uint16));
+
+		FAzureKinectDepthFilterTiming Timing;
+		Filter.Process(Frame.GetData(), Width, Height, Settings, &Timing);
+		Total.FlyingPixelMs += Timing.FlyingPixelMs;
+		Total.HoleFillMs += Timing.HoleFillMs;
+		Total.SpatialMs += Timing.SpatialMs;
+		Total.TemporalMs += Timing.TemporalMs;
+		Total.TotalMs += Timing.TotalMs;
+	}
+
+	const float Scale = 1.f / FMath::Max(NumFrames, 1);
+	Total.FlyingPixelMs *= Scale;
+	Total.HoleFillMs *= Scale;
+	Total.SpatialMs *= Scale;
+	Total.TemporalMs *= Scale;
+	Total.TotalMs *= Scale;
+	return Total;
+}
@@ -0,0 +1,44 @@
+#include "AzureKinectDepthMeshComponent.h"
+#include "AzureKinectJointConverter.h"
+
+UAzureKinectDepthMeshComponent::UAzureKinectDepthMeshComponent(const FObjectInitializer& ObjectInitializer) :
+	Super(ObjectInitializer),
+	Device(nullptr),
+	bWorldSpace(true),
+	LastTimestampUsec(0),
+	bHasSection(false),
+	LastBuildMs(0.f)
+{
+	PrimaryComponentTick.bCanEverTick = true;
+	bUseAsyncCooking = true;
+}
+
+void UAzureKinectDepthMeshComponent::TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction)
+{
+	Super::TickComponent(DeltaTime, TickType, ThisTickFunction);
+
+	FAzureKinectPointCloudPtr PointCloud = Device ? Device->GetLatestPointCloud() : nullptr;
+	if (!PointCloud || (PointCloud == LastPointCloud && PointCloud->TimestampUsec == LastTimestampUsec)) return;
+
+	LastPointCloud = PointCloud;
+	LastTimestampUsec = PointCloud->TimestampUsec;
+
+	const double StartTime = FPlatformTime::Seconds();
+	const FMatrix PointToWorld = FAzureKinectJointConverter::MakePointToWorld(bWorldSpace ? Device->GetDepthCameraToWorld() : FTransform::Identity);
+	const bool bTopologyChanged = Mesher.Build(*PointCloud, MeshSettings, PointToWorld);
+	LastBuildMs = static_cast<float>((FPlatformTime::Seconds() - StartTime) * 1000.0);
+
+	static const TArray<FVector> NoNormals;
+	static const TArray<FVector2D> NoUVs;
+	static const TArray<FProcMeshTangent> NoTangents;
+
+	if (bTopologyChanged || !bHasSection)
+	{
+		CreateMeshSection(0, Mesher.GetVertices(), Mesher.GetTriangles(), NoNormals, NoUVs, Mesher.GetColors(), NoTangents, false);
+		bHasSection = true;
+	}
+	else
+	{
+		UpdateMeshSection(0, Mesher.GetVertices(), NoNormals, NoUVs, Mesher.GetColors(), NoTangents);
+	}
+}
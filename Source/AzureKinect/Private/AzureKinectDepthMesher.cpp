@@ -0,0 +1,197 @@
+#include "AzureKinectDepthMesher.h"
+#include "AzureKinectJointConverter.h"
+#include "Async/ParallelFor.h"
+#include "HAL/IConsoleManager.h"
+
+DEFINE_LOG_CATEGORY(AzureKinectDepthMeshLog);
+
+namespace
+{
+	constexpr int32 RowsPerTask = 8;
+
+	/** Vertex copies of grid point Index: shared one, owned by its cell's first triangle, owned by the second triangle of the cell above left. */
+	FORCEINLINE int32 SharedVertex(int32 Index, int32 NumPoints) { return Index; }
+	FORCEINLINE int32 FirstTriangleVertex(int32 Index, int32 NumPoints) { return NumPoints + Index; }
+	FORCEINLINE int32 SecondTriangleVertex(int32 Index, int32 NumPoints) { return 2 * NumPoints + Index; }
+}
+
+TSharedRef<const TArray<int32>, ESPMode::ThreadSafe> FAzureKinectDepthMesher::GetGridPattern(int32 Width, int32 Height)
+{
+	// A handful of resolutions per depth mode and stride, built once each
+	static TMap<FIntPoint, TSharedRef<const TArray<int32>, ESPMode::ThreadSafe>> Patterns;
+	static FCriticalSection PatternCriticalSection;
+
+	FScopeLock Lock(&PatternCriticalSection);
+	if (const TSharedRef<const TArray<int32>, ESPMode::ThreadSafe>* Found = Patterns.Find(FIntPoint(Width, Height)))
+	{
+		return *Found;
+	}
+
+	const int32 NumPoints = Width * Height;
+	TSharedRef<TArray<int32>, ESPMode::ThreadSafe> Pattern = MakeShared<TArray<int32>, ESPMode::ThreadSafe>();
+	Pattern->SetNumUninitialized((Width - 1) * (Height - 1) * 6);
+	int32* Out = Pattern->GetData();
+	for (int32 y = 0; y < Height - 1; y++)
+	{
+		for (int32 x = 0; x < Width - 1; x++)
+		{
+			const int32 I00 = y * Width + x, I01 = I00 + 1, I10 = I00 + Width, I11 = I10 + 1;
+			// Clockwise seen from the camera, Unreal front faces
+			*Out++ = FirstTriangleVertex(I00, NumPoints); *Out++ = SharedVertex(I01, NumPoints); *Out++ = SharedVertex(I10, NumPoints);
+			*Out++ = SharedVertex(I01, NumPoints); *Out++ = SecondTriangleVertex(I11, NumPoints); *Out++ = SharedVertex(I10, NumPoints);
+		}
+	}
+
+	UE_LOG(AzureKinectDepthMeshLog, Verbose, TEXT("Built %dx%d grid pattern."), Width, Height);
+	return Patterns.Add(FIntPoint(Width, Height), Pattern);
+}
+
+const TArray<int32>& FAzureKinectDepthMesher::GetTriangles() const
+{
+	static const TArray<int32> NoTriangles;
+	return Pattern ? *Pattern : NoTriangles;
+}
+
+bool FAzureKinectDepthMesher::Build(const FAzureKinectPointCloud& PointCloud, const FAzureKinectDepthMeshSettings& Settings, const FMatrix& PointToWorld)
+{
+	const int32 Stride = FMath::Max(Settings.Stride, 1);
+	const int32 Width = FMath::DivideAndRoundUp(PointCloud.Width, Stride);
+	const int32 Height = FMath::DivideAndRoundUp(PointCloud.Height, Stride);
+	if (Width < 2 || Height < 2)
+	{
+		const bool bHadPattern = Pattern.IsValid();
+		Pattern.Reset();
+		GridWidth = GridHeight = 0;
+		Vertices.Reset();
+		Colors.Reset();
+		return bHadPattern;
+	}
+
+	const bool bPatternChanged = !Pattern || Width != GridWidth || Height != GridHeight;
+	if (bPatternChanged)
+	{
+		Pattern = GetGridPattern(Width, Height);
+		GridWidth = Width;
+		GridHeight = Height;
+	}
+
+	const int32 NumPoints = Width * Height;
+	Vertices.SetNumUninitialized(NumPoints * 3, false);
+	Colors.SetNumUninitialized(NumPoints * 3, false);
+	Depths.SetNumUninitialized(NumPoints, false);
+
+	const bool bHasColor = PointCloud.Colors.Num() == PointCloud.GetNumPoints();
+	const int32 Threshold = Settings.DiscontinuityThreshold;
+
+	// Shared vertices, and owned ones in place as if every triangle was kept
+	ParallelFor(FMath::DivideAndRoundUp(Height, RowsPerTask), [&](int32 Task)
+	{
+		const int32 EndRow = FMath::Min((Task + 1) * RowsPerTask, Height);
+		for (int32 y = Task * RowsPerTask; y < EndRow; y++)
+		{
+			for (int32 x = 0; x < Width; x++)
+			{
+				const int32 Source = y * Stride * PointCloud.Width + x * Stride;
+				const int16* P = &PointCloud.Positions[Source * 3];
+				const int32 Index = y * Width + x;
+
+				const FVector Position = PointToWorld.TransformPosition(FVector(P[0], P[1], P[2]));
+				const FColor Color = bHasColor ? PointCloud.Colors[Source] : FColor::White;
+				for (int32 Copy = 0; Copy < 3; Copy++)
+				{
+					Vertices[Copy * NumPoints + Index] = Position;
+					Colors[Copy * NumPoints + Index] = Color;
+				}
+				Depths[Index] = static_cast<uint16>(FMath::Max<int16>(P[2], 0));
+			}
+		}
+	});
+
+	// Collapse the triangles with invalid or discontinuous depth onto their shared top right vertex.
+	// Owned vertices are written by their triangle only, so cells don't race.
+	const int32 NumCellRows = Height - 1;
+	ParallelFor(FMath::DivideAndRoundUp(NumCellRows, RowsPerTask), [&](int32 Task)
+	{
+		auto IsKept = [Threshold](int32 D0, int32 D1, int32 D2)
+		{
+			return D0 != 0 && D1 != 0 && D2 != 0 && FMath::Max3(D0, D1, D2) - FMath::Min3(D0, D1, D2) <= Threshold;
+		};
+
+		const int32 EndRow = FMath::Min((Task + 1) * RowsPerTask, NumCellRows);
+		for (int32 y = Task * RowsPerTask; y < EndRow; y++)
+		{
+			for (int32 x = 0; x < Width - 1; x++)
+			{
+				const int32 I00 = y * Width + x, I01 = I00 + 1, I10 = I00 + Width, I11 = I10 + 1;
+				const int32 D00 = Depths[I00], D01 = Depths[I01], D10 = Depths[I10], D11 = Depths[I11];
+				if (!IsKept(D00, D01, D10))
+				{
+					Vertices[FirstTriangleVertex(I00, NumPoints)] = Vertices[SharedVertex(I01, NumPoints)];
+				}
+				if (!IsKept(D01, D11, D10))
+				{
+					Vertices[SecondTriangleVertex(I11, NumPoints)] = Vertices[SharedVertex(I01, NumPoints)];
+				}
+			}
+		}
+	});
+
+	return bPatternChanged;
+}
+
+namespace
+{
+	void BenchmarkDepthMesh(const TArray<FString>& Args)
+	{
+		const int32 NumFrames = Args.Num() > 0 ? FMath::Max(FCString::Atoi(*Args[0]), 1) : 100;
+
+		FAzureKinectDepthMeshSettings Settings;
+		for (int32 Stride : { 1, 2, 4 })
+		{
+			Settings.Stride = Stride;
+			const float Ms = FAzureKinectDepthMesher::Benchmark(1024, 1024, Settings, NumFrames);
+			UE_LOG(AzureKinectDepthMeshLog, Display, TEXT("1024x1024, stride %d: %.3f ms"), Stride, Ms);
+		}
+	}
+
+	FAutoConsoleCommand BenchmarkDepthMeshCommand(
+		TEXT("AzureKinect.BenchmarkDepthMesh"),
+		TEXT("Log the cost of meshing a 1024x1024 (WFOV unbinned) point cloud at stride 1, 2 and 4. Takes the number of frames, 100 by default."),
+		FConsoleCommandWithArgsDelegate::CreateStatic(&BenchmarkDepthMesh));
+}
+
+float FAzureKinectDepthMesher::Benchmark(int32 Width, int32 Height, const FAzureKinectDepthMeshSettings& Settings, int32 NumFrames)
+{
+	// A wavy wall 2 m away with a box in front of it and a hole, so every test of the filter is hit
+	FAzureKinectPointCloud PointCloud;
+	PointCloud.Width = Width;
+	PointCloud.Height = Height;
+	PointCloud.Positions.SetNumUninitialized(Width * Height * 3);
+
+	FAzureKinectDepthMesher Mesher;
+	const FMatrix PointToWorld = FAzureKinectJointConverter::MakePointToWorld(FTransform::Identity);
+	double Seconds = 0.0;
+
+	for (int32 Frame = 0; Frame < NumFrames; Frame++)
+	{
+		for (int32 y = 0; y < Height; y++)
+		{
+			for (int32 x = 0; x < Width; x++)
+			{
+				int16* P = &PointCloud.Positions[(y * Width + x) * 3];
+				const bool bBox = FMath::Abs(x - Width / 2) < Width / 8 && FMath::Abs(y - Height / 2) < Height / 8;
+				const bool bHole = (x / 64 + y / 64 + Frame) % 11 == 0;
+				const int16 Z = bHole ? 0 : bBox ? 1200 : static_cast<int16>(2000 + 100 * FMath::Sin((x + Frame * 4) * 0.02f));
+				P[0] = static_cast<int16>((x - Width / 2) * Z / 500);
+				P[1] = static_cast<int16>((y - Height / 2) * Z / 500);
+				P[2] = Z;
+			}
+		}
+
+		const double StartTime = FPlatformTime::Seconds();
+		Mesher.Build(PointCloud, Settings, PointToWorld);
+		Seconds += FPlatformTime::Seconds() - StartTime;
+	}
+
+	return static_cast<float>(Seconds * 1000.0 / NumFrames);
+}
@@ -1,11 +1,122 @@
 // Fill out your copyright notice in the Description page of Project Settings.
 #include "AzureKinectDevice.h"
 #include "Runtime/RHI/Public/RHI.h"
+#include "AzureKinectDeviceRegistry.h"
+#include "Async/Async.h"
+#include "AzureKinectPointCloudWriter.h"
+#include "AzureKinectSkeletonStream.h"
+#include "AzureKinectJointConverter.h"
+#include "AzureKinectTextureConverter.h"
+#include "HAL/IConsoleManager.h"
+
+#if WITH_AZUREKINECT_SDK
+#include "k4arecord/playback.hpp"
+#endif
 
 DEFINE_LOG_CATEGORY(AzureKinectDeviceLog);
 
+#if WITH_AZUREKINECT_SDK
+namespace
+{
+	/** Longest wait for a body frame from a CPU tracker. */
+	const std::chrono::milliseconds CpuTrackerTimeout(5000);
+
+	/** Mean inference time per frame of one tracker configuration over a recording, negative if the tracker can't be created. */
+	float BenchmarkTracker(const FString& FilePath, int32 NumFrames, k4abt_tracker_processing_mode_t Mode, bool bLite)
+	{
+		k4abt_tracker_configuration_t TrackerConfig = K4ABT_TRACKER_CONFIG_DEFAULT;
+		TrackerConfig.processing_mode = Mode;
+		TrackerConfig.model_path = bLite ? "dnn_model_2_0_lite_op11.onnx" : nullptr;
+
+		k4a::playback Playback = k4a::playback::open(TCHAR_TO_ANSI(*FilePath));
+		k4abt::tracker Tracker;
+		try
+		{
+			Tracker = k4abt::tracker::create(Playback.get_calibration(), TrackerConfig);
+		}
+		catch (const k4a::error& Err)
+		{
+			FString Msg(ANSI_TO_TCHAR(Err.what()));
+			UE_LOG(AzureKinectDeviceLog, Display, TEXT("Can't create tracker: %s"), *Msg);
+			return -1.f;
+		}
+
+		// The first frames include lazy initialization of the inference runtime
+		constexpr int32 NumWarmupFrames = 3;
+		double TotalSeconds = 0.0;
+		int32 NumMeasured = 0;
+		k4a::capture Capture;
+		for (int32 Frame = 0; Frame < NumFrames + NumWarmupFrames && Playback.get_next_capture(&Capture); )
+		{
+			if (!Capture.get_depth_image()) continue;
+
+			const double StartTime = FPlatformTime::Seconds();
+			k4abt::frame BodyFrame;
+			if (!Tracker.enqueue_capture(Capture, CpuTrackerTimeout) || !Tracker.pop_result(&BodyFrame, CpuTrackerTimeout))
+			{
+				break;
+			}
+			if (Frame++ >= NumWarmupFrames)
+			{
+				TotalSeconds += FPlatformTime::Seconds() - StartTime;
+				NumMeasured++;
+			}
+		}
+
+		Tracker.shutdown();
+		Tracker.destroy();
+		return NumMeasured > 0 ? static_cast<float>(TotalSeconds / NumMeasured * 1000.0) : -1.f;
+	}
+
+	void BenchmarkBodyTracker(const TArray<FString>& Args)
+	{
+		if (Args.Num() < 1)
+		{
+			UE_LOG(AzureKinectDeviceLog, Warning, TEXT("Usage: AzureKinect.BenchmarkBodyTracker <recording.mkv> [frames] [cpu]"));
+			return;
+		}
+		const int32 NumFrames = Args.Num() > 1 ? FMath::Max(FCString::Atoi(*Args[1]), 1) : 30;
+		const bool bCpuOnly = Args.Num() > 2 && Args[2] == TEXT("cpu");
+
+		const UEnum* ModeEnum = StaticEnum<EKinectTrackerProcessingMode>();
+		for (int32 Mode = 0; Mode < ModeEnum->NumEnums() - 1; Mode++)
+		{
+			const int64 Value = ModeEnum->GetValueByIndex(Mode);
+			if (bCpuOnly && Value != static_cast<int64>(EKinectTrackerProcessingMode::CPU)) continue;
+
+			for (const bool bLite : { false, true })
+			{
+				try
+				{
+					const float InferenceMs = BenchmarkTracker(Args[0], NumFrames, static_cast<k4abt_tracker_processing_mode_t>(Value), bLite);
+					if (InferenceMs >= 0.f)
+					{
+						UE_LOG(AzureKinectDeviceLog, Display, TEXT("%s, %s model: %.2f ms per frame"),
+							*ModeEnum->GetNameStringByIndex(Mode), bLite ? TEXT("lite") : TEXT("full"), InferenceMs);
+					}
+				}
+				catch (const k4a::error& Err)
+				{
+					FString Msg(ANSI_TO_TCHAR(Err.what()));
+					UE_LOG(AzureKinectDeviceLog, Error, TEXT("Can't read %s: %s"), *Args[0], *Msg);
+					return;
+				}
+			}
+		}
+	}
+
+	FAutoConsoleCommand BenchmarkBodyTrackerCommand(
+		TEXT("AzureKinect.BenchmarkBodyTracker"),
+		TEXT("Log body tracker inference time per frame for each processing mode, with full and lite models. Takes a recording (*.mkv), the number of frames and \"cpu\" to only run the CPU mode."),
+		FConsoleCommandWithArgsDelegate::CreateStatic(&BenchmarkBodyTracker));
+}
+
+#endif
+
 UAzureKinectDevice::UAzureKinectDevice() :
+#if WITH_AZUREKINECT_SDK
 	NativeDevice(nullptr),
+#endif
 	Thread(nullptr),
 	DeviceIndex(-1),
 	bOpen(false),
@@ -14,46 +125,49 @@ UAzureKinectDevice::UAzureKinectDevice() :
 	ColorMode(EKinectColorResolution::RESOLUTION_720P),
 	Fps(EKinectFps::PER_SECOND_30),
 	SensorOrientation(EKinectSensorOrientation::DEFAULT),
-	bSkeletonTracking(false)
+	bSkeletonTracking(false),
+	bKeepTrackerAlive(false),
+	TrackerProcessingMode(EKinectTrackerProcessingMode::GPU),
+	TrackerGpuDeviceId(0),
+	bLiteTrackerModel(false),
+	bTrackerCpuFallback(true),
+	TrackerSmoothing(K4ABT_DEFAULT_TRACKER_SMOOTHING_FACTOR),
+	MaxTrackedBodies(0),
+	BodySelection(EKinectBodySelection::NEAREST),
+	bGeneratePointCloud(false),
+	bImu(false),
+	OpenedIndex(-1),
+	BodyIndexTimestampUsec(0),
+	PointCloudPool(24),
+	LastDroppedPointCloudFrames(0),
+	LastFloorUpdateTime(0.0),
+	PublishedCameraLocation(FVector::ZeroVector),
+	bLoopPlayback(false),
+	PlaybackFrame(INDEX_NONE)
 {
-	LoadDevices();
 }
 
 UAzureKinectDevice::UAzureKinectDevice(const FObjectInitializer& ObjectInitializer) :
-	Super(ObjectInitializer)
+	Super(ObjectInitializer),
+	bTrackerCpuFallback(true),
+	TrackerSmoothing(K4ABT_DEFAULT_TRACKER_SMOOTHING_FACTOR),
+	OpenedIndex(-1),
+	BodyIndexTimestampUsec(0),
+	PointCloudPool(24),
+	LastDroppedPointCloudFrames(0),
+	LastFloorUpdateTime(0.0),
+	PublishedCameraLocation(FVector::ZeroVector),
+	bLoopPlayback(false),
+	PlaybackFrame(INDEX_NONE)
 {
-	LoadDevices();
 }
 
 void UAzureKinectDevice::LoadDevices()
 {
-	
-	int32 NumKinect = GetNumConnectedDevices();
-	
-	DeviceList.Empty(NumKinect + 1);
-	DeviceList.Add(MakeShared<FString>("No Device"));
-
-	if (NumKinect > 0)
-	{
-		for (int32 i = 0; i < NumKinect; i++)
-		{
-			try
-			{
-				// Open connection to the device.
-				k4a::device Device = k4a::device::open(i);
-				// Get and store the device serial number
-				DeviceList.Add(MakeShared<FString>(Device.get_serialnum().c_str()));
-				Device.close();
-			}
-			catch (const k4a::error& Err)
-			{
-				UE_LOG(AzureKinectDeviceLog, Error, TEXT("Can't load: %s"), TCHAR_TO_UTF8(ANSI_TO_TCHAR(Err.what())));
-			}
-		}
-	}
-	
+	FAzureKinectDeviceRegistry::Get().Refresh();
 }
 
+#if WITH_AZUREKINECT_SDK
 bool UAzureKinectDevice::StartDevice()
 {
 	if (bOpen)
@@ -62,10 +176,13 @@ bool UAzureKinectDevice::StartDevice()
 		return false;
 	}
 
-	
-	if (DeviceIndex == -1)
+
+	StartDeviceTime = FPlatformTime::Seconds();
+	StartupTiming = FAzureKinectStartupTiming();
+
+	const int32 IndexToOpen = ResolveDeviceIndex();
+	if (IndexToOpen == -1)
 	{
-		UE_LOG(AzureKinectDeviceLog, Warning, TEXT("No Device is selected."));
 		return false;
 	}
 
@@ -74,29 +191,26 @@ bool UAzureKinectDevice::StartDevice()
 	try
 	{
 		// Open connection to the device.
-		NativeDevice = k4a::device::open(DeviceIndex);
+		NativeDevice = k4a::device::open(IndexToOpen);
 
-		// Start the Camera and make sure the Depth Camera is Enabled
-		k4a_device_configuration_t DeviceConfig = K4A_DEVICE_CONFIG_INIT_DISABLE_ALL;
-		DeviceConfig.depth_mode = static_cast<k4a_depth_mode_t>(DepthMode);
-		DeviceConfig.color_resolution = static_cast<k4a_color_resolution_t>(ColorMode);
-		DeviceConfig.camera_fps = static_cast<k4a_fps_t>(Fps);
-		DeviceConfig.color_format = k4a_image_format_t::K4A_IMAGE_FORMAT_COLOR_BGRA32;
-		DeviceConfig.synchronized_images_only = true;
-		DeviceConfig.wired_sync_mode = K4A_WIRED_SYNC_MODE_STANDALONE;
+		OpenedSerial = ANSI_TO_TCHAR(NativeDevice.get_serialnum().c_str());
 
-		NativeDevice.start_cameras(&DeviceConfig);
+		StartCameras();
+		LoadCalibration();
 
-		KinectCalibration = NativeDevice.get_calibration(DeviceConfig.depth_mode, DeviceConfig.color_resolution);
-		KinectTransformation = k4a::transformation(KinectCalibration);
+		if (bImu)
+		{
+			StartImu();
+		}
 
 		if (bSkeletonTracking)
 		{
-			k4abt_tracker_configuration_t TrackerConfig = K4ABT_TRACKER_CONFIG_DEFAULT;
-			TrackerConfig.sensor_orientation = static_cast<k4abt_sensor_orientation_t>(SensorOrientation);
-
-			// Retain body tracker
-			BodyTracker = k4abt::tracker::create(KinectCalibration, TrackerConfig);
+			// Streaming starts right away, skeletons follow once the model is loaded.
+			EnsureBodyTracker(KinectCalibration, OpenedSerial);
+		}
+		else if (!bKeepTrackerAlive)
+		{
+			DestroyBodyTracker();
 		}
 		
 	}
@@ -104,6 +218,7 @@ bool UAzureKinectDevice::StartDevice()
 	{
 		if (NativeDevice)
 		{
+			StopImu();
 			NativeDevice.close();
 		}
 
@@ -112,13 +227,30 @@ bool UAzureKinectDevice::StartDevice()
 		return false;
 	}
 	
+	StoreAppliedConfig();
+	PreallocateTextures();
+
+	OpenedIndex = IndexToOpen;
+	FAzureKinectDeviceRegistry::Get().NotifyDeviceOpened(OpenedIndex);
+
 	Thread = new FAzureKinectDeviceThread(this);
 
 	bOpen = true;
 
+	StartupTiming.StartDeviceMs = static_cast<float>((FPlatformTime::Seconds() - StartDeviceTime) * 1000.0);
+	UE_LOG(AzureKinectDeviceLog, Log, TEXT("Device started in %.2f ms."), StartupTiming.StartDeviceMs);
+
 	return true;
 }
 
+#else
+bool UAzureKinectDevice::StartDevice()
+{
+	UE_LOG(AzureKinectDeviceLog, Error, TEXT("Built without the Azure Kinect SDK, only skeleton playback is available."));
+	return false;
+}
+#endif
+
 bool UAzureKinectDevice::StopDevice()
 {
 
@@ -134,13 +266,27 @@ bool UAzureKinectDevice::StopDevice()
 		Thread = nullptr;
 	}
 
-	if (BodyTracker)
+	StopPointCloudRecording();
+	StopSkeletonRecording();
+	SkeletonReader.Reset();
+	if (FloorTask.IsValid())
+	{
+		FloorTask.Wait();
+		FloorTask.Reset();
+	}
+	FloorDetector.Reset();
+	LatestPointCloud.Reset();
+	PointCloudPool.Reset();
+	DepthFilterChain.Reset();
+	MjpegDecoder.Reset();
+	DecodedColorFrame.Reset();
+
+	if (!bKeepTrackerAlive)
 	{
-		BodyTracker.shutdown();
-		BodyTracker.destroy();
-		BodyTracker = nullptr;
+		DestroyBodyTracker();
 	}
 
+#if WITH_AZUREKINECT_SDK
 	if (RemapImage)
 	{
 		RemapImage.reset();
@@ -148,413 +294,1348 @@ bool UAzureKinectDevice::StopDevice()
 
 	if (NativeDevice)
 	{
+		// IMU needs the cameras running
+		StopImu();
 		NativeDevice.stop_cameras();
 		NativeDevice.close();
 		NativeDevice = nullptr;
 		UE_LOG(AzureKinectDeviceLog, Verbose, TEXT("KinectDevice Camera is Stopped and Closed."));
 	}
+#endif
+
+	FAzureKinectDeviceRegistry::Get().NotifyDeviceClosed(OpenedIndex);
+	OpenedIndex = -1;
 
 	bOpen = false;
 	return true;
 }
 
-int32 UAzureKinectDevice::GetNumConnectedDevices()
-{
-	return k4a_device_get_installed_count();
-}
-
-int32 UAzureKinectDevice::GetNumTrackedSkeletons() const
+#if WITH_AZUREKINECT_SDK
+bool UAzureKinectDevice::ReconfigureDevice()
 {
 	if (!bOpen)
 	{
-		return 0;
+		UE_LOG(AzureKinectDeviceLog, Warning, TEXT("KinectDevice is not running."));
+		return false;
 	}
-	if (!bSkeletonTracking)
+
+	// Playback has no native device to reconfigure
+	if (SkeletonReader)
 	{
-		UE_LOG(AzureKinectDeviceLog, Error, TEXT("GetNumTrackedBodies: Skeleton Tracking is disabled!"));
-		return 0;
+		UE_LOG(AzureKinectDeviceLog, Warning, TEXT("KinectDevice is playing back skeletons, it can't be reconfigured."));
+		return false;
 	}
 
-	FScopeLock Lock(Thread->GetCriticalSection());
-	return NumTrackedSkeletons;
-}
+	const bool bDepthChanged = DepthMode != AppliedDepthMode;
+	const bool bDecodeThreadsChanged = AppliedColorFormat == EKinectColorFormat::MJPG &&
+		(MjpegDecoder ? MjpegDecoder->GetMaxInFlight() : 0) != MjpegDecodeThreads;
+	const bool bColorChanged = ColorMode != AppliedColorMode || ResolveColorFormat() != AppliedColorFormat || bDecodeThreadsChanged;
+	const bool bFpsChanged = Fps != AppliedFps;
+	const bool bRemapChanged = RemapMode != AppliedRemapMode;
+	const bool bOrientationChanged = SensorOrientation != AppliedSensorOrientation;
+	const bool bTrackingChanged = bSkeletonTracking != bAppliedSkeletonTracking;
+	const bool bImuChanged = bImu != bAppliedImu;
+
+	const bool bRestartCameras = bDepthChanged || bColorChanged || bFpsChanged;
+	// The tracker only depends on depth calibration, sensor orientation and its own config,
+	// so a color or fps change keeps the (expensive to load) model alive.
+	const bool bTrackerConfigChanged = TrackerTask.IsValid() && !IsTrackerConfigApplied();
+	const bool bRebuildTracker = bTrackingChanged || (bSkeletonTracking && (bDepthChanged || bOrientationChanged || bTrackerConfigChanged));
+
+	FAzureKinectReconfigureTiming Timing;
+	const double StartTime = FPlatformTime::Seconds();
+
+	// Block the capture thread at frame boundary, it keeps running once we release the lock.
+	FScopeLock DeviceLock(&DeviceCriticalSection);
+	double LapTime = FPlatformTime::Seconds();
+	Timing.ThreadPauseMs = static_cast<float>((LapTime - StartTime) * 1000.0);
+
+	auto Lap = [&LapTime]()
+	{
+		const double Now = FPlatformTime::Seconds();
+		const float Elapsed = static_cast<float>((Now - LapTime) * 1000.0);
+		LapTime = Now;
+		return Elapsed;
+	};
 
-FAzureKinectSkeleton UAzureKinectDevice::GetSkeleton(int32 Index) const
-{
-	if (bOpen)
+	try
 	{
-		if (!bSkeletonTracking)
+		if (bRebuildTracker && !bKeepTrackerAlive)
 		{
-			UE_LOG(AzureKinectDeviceLog, Error, TEXT("GetSkeleton: Skeleton Tracking is disabled!"));
-			return FAzureKinectSkeleton();
+			DestroyBodyTracker();
+			Timing.TrackerMs += Lap();
 		}
 
-		FScopeLock Lock(Thread->GetCriticalSection());
-		if (Skeletons.IsValidIndex(Index))
+		if (bRestartCameras || bImuChanged)
 		{
-			return Skeletons[Index];
+			StopImu();
 		}
-		else
+
+		if (bRestartCameras)
 		{
-			UE_LOG(AzureKinectDeviceLog, Error, TEXT("GetSkeleton: Index is out of range!"));
-			return FAzureKinectSkeleton();
+			NativeDevice.stop_cameras();
+			CalcFrameCount();
+			StartCameras();
+			Timing.CamerasMs = Lap();
+
+			LoadCalibration();
+			Timing.TransformationMs = Lap();
+		}
+
+		if (bRestartCameras || bRemapChanged)
+		{
+			// Remap buffer dimension and format depend on both modes.
+			if (RemapImage)
+			{
+				RemapImage.reset();
+			}
+			Timing.BuffersMs = Lap();
+		}
+
+		if ((bRestartCameras || bImuChanged) && bImu)
+		{
+			StartImu();
+			Timing.CamerasMs += Lap();
+		}
+
+		if (bRebuildTracker && bSkeletonTracking)
+		{
+			// Model is loaded in background, so this only measures the dispatch.
+			EnsureBodyTracker(KinectCalibration, OpenedSerial);
+			Timing.TrackerMs += Lap();
 		}
 	}
-	else
+	catch (const k4a::error& Err)
 	{
-		return FAzureKinectSkeleton();
+		FString Msg(ANSI_TO_TCHAR(Err.what()));
+		UE_LOG(AzureKinectDeviceLog, Error, TEXT("Can't reconfigure: %s"), *Msg);
+
+		// The device is in an unknown state, let a full restart recover it.
+		DeviceLock.Unlock();
+		StopDevice();
+		return false;
 	}
-	
-}
 
-const TArray<FAzureKinectSkeleton>& UAzureKinectDevice::GetSkeletons() const {
-	if (bOpen)
+	if (bTrackingChanged && !bSkeletonTracking)
 	{
 		FScopeLock Lock(Thread->GetCriticalSection());
-		return Skeletons;
+		NumTrackedSkeletons = 0;
+		Skeletons.Reset();
 	}
-	else
+
+	StoreAppliedConfig();
+	// Still paused, so the capture thread sees the new sizes with the first frame of the new modes
+	PreallocateTextures();
+	Timing.BuffersMs += Lap();
+
+	Timing.TotalMs = static_cast<float>((FPlatformTime::Seconds() - StartTime) * 1000.0);
+	LastReconfigureTiming = Timing;
+
+	UE_LOG(AzureKinectDeviceLog, Log, TEXT("Reconfigured in %.2f ms (pause %.2f, cameras %.2f, transformation %.2f, tracker %.2f, buffers %.2f)"),
+		Timing.TotalMs, Timing.ThreadPauseMs, Timing.CamerasMs, Timing.TransformationMs, Timing.TrackerMs, Timing.BuffersMs);
+
+	return true;
+}
+
+void UAzureKinectDevice::StartCameras()
+{
+	// Start the Camera and make sure the Depth Camera is Enabled
+	k4a_device_configuration_t DeviceConfig = K4A_DEVICE_CONFIG_INIT_DISABLE_ALL;
+	DeviceConfig.depth_mode = static_cast<k4a_depth_mode_t>(DepthMode);
+	DeviceConfig.color_resolution = static_cast<k4a_color_resolution_t>(ColorMode);
+	DeviceConfig.camera_fps = static_cast<k4a_fps_t>(Fps);
+	AppliedColorFormat = ResolveColorFormat();
+	// Cameras also restart on fps or depth changes, only warn when the request itself changed
+	if (AppliedColorFormat != ColorFormat && (ColorFormat != LastRequestedColorFormat || ColorMode != LastRequestedColorMode))
 	{
-		return Skeletons;
+		UE_LOG(AzureKinectDeviceLog, Warning, TEXT("NV12 and YUY2 are available at 720p only, capturing MJPG instead."));
+	}
+	LastRequestedColorFormat = ColorFormat;
+	LastRequestedColorMode = ColorMode;
+	DeviceConfig.color_format = static_cast<k4a_image_format_t>(AppliedColorFormat);
+
+	// Frames in flight belong to the previous configuration
+	MjpegDecoder.Reset();
+	DecodedColorFrame.Reset();
+	if (AppliedColorFormat == EKinectColorFormat::MJPG && MjpegDecodeThreads > 0)
+	{
+		MjpegDecoder = MakeUnique<FAzureKinectMjpegDecoder>(MjpegDecodeThreads);
 	}
+	// Synchronization can only be requested when both of cameras are running.
+	DeviceConfig.synchronized_images_only = DepthMode != EKinectDepthMode::OFF && ColorMode != EKinectColorResolution::RESOLUTION_OFF;
+	DeviceConfig.wired_sync_mode = K4A_WIRED_SYNC_MODE_STANDALONE;
+
+	NativeDevice.start_cameras(&DeviceConfig);
 }
 
-void UAzureKinectDevice::UpdateAsync()
+EKinectColorFormat UAzureKinectDevice::ResolveColorFormat() const
 {
-	// Threaded function
-	try
+	if ((ColorFormat == EKinectColorFormat::NV12 || ColorFormat == EKinectColorFormat::YUY2) &&
+		ColorMode != EKinectColorResolution::RESOLUTION_720P && ColorMode != EKinectColorResolution::RESOLUTION_OFF)
 	{
-		if (!NativeDevice.get_capture(&Capture, FrameTime))
+		return EKinectColorFormat::MJPG;
+	}
+	return ColorFormat;
+}
+
+void UAzureKinectDevice::LoadCalibration()
+{
+	KinectCalibration = NativeDevice.get_calibration(static_cast<k4a_depth_mode_t>(DepthMode), static_cast<k4a_color_resolution_t>(ColorMode));
+	KinectTransformation = k4a::transformation(KinectCalibration);
+	BodyGeometryExtractor.ResetXYTable();
+}
+
+int32 UAzureKinectDevice::ResolveDeviceIndex() const
+{
+	int32 IndexToOpen = DeviceIndex;
+	if (!DeviceSerial.IsEmpty())
+	{
+		IndexToOpen = FAzureKinectDeviceRegistry::Get().FindIndexBySerial(DeviceSerial);
+		if (IndexToOpen == INDEX_NONE)
 		{
-			UE_LOG(AzureKinectDeviceLog, Verbose, TEXT("Timed out waiting for capture."));
+			UE_LOG(AzureKinectDeviceLog, Warning, TEXT("Device %s is not connected."), *DeviceSerial);
+			return -1;
 		}
 	}
-	catch (const k4a::error& Err)
+
+	if (IndexToOpen == -1)
 	{
-		FString Msg(ANSI_TO_TCHAR(Err.what()));
-		UE_LOG(AzureKinectDeviceLog, Error, TEXT("Can't capture frame: %s"), *Msg);
-		return;
+		UE_LOG(AzureKinectDeviceLog, Warning, TEXT("No Device is selected."));
+	}
+	return IndexToOpen;
+}
+
+bool UAzureKinectDevice::PreloadBodyTracker()
+{
+	if (bOpen)
+	{
+		// Tracker is swapped only between frames.
+		FScopeLock DeviceLock(&DeviceCriticalSection);
+		EnsureBodyTracker(KinectCalibration, OpenedSerial);
+		return true;
 	}
 
-	if (ColorMode != EKinectColorResolution::RESOLUTION_OFF && ColorTexture)
+	const int32 IndexToOpen = ResolveDeviceIndex();
+	if (IndexToOpen == -1)
 	{
-		CaptureColorImage();
+		return false;
 	}
 
-	if (DepthMode != EKinectDepthMode::OFF && DepthTexture)
+	try
 	{
-		CaptureDepthImage();
+		// Calibration can be read without starting the cameras.
+		k4a::device Device = k4a::device::open(IndexToOpen);
+		const FString Serial = ANSI_TO_TCHAR(Device.get_serialnum().c_str());
+		const k4a::calibration Calibration = Device.get_calibration(static_cast<k4a_depth_mode_t>(DepthMode), static_cast<k4a_color_resolution_t>(ColorMode));
+		Device.close();
+
+		EnsureBodyTracker(Calibration, Serial);
 	}
-	
-	if (DepthMode != EKinectDepthMode::OFF && InflaredTexture)
+	catch (const k4a::error& Err)
 	{
-		CaptureInflaredImage();
+		FString Msg(ANSI_TO_TCHAR(Err.what()));
+		UE_LOG(AzureKinectDeviceLog, Error, TEXT("Can't preload body tracker: %s"), *Msg);
+		return false;
 	}
 
-	if (bSkeletonTracking && BodyTracker)
+	return true;
+}
+
+bool UAzureKinectDevice::HasBodyTrackerFor(const FString& Serial) const
+{
+	if (!TrackerTask.IsValid())
 	{
-		UpdateSkeletons();
+		return false;
 	}
 
-	Capture.reset();
+	// Loading has finished but failed
+	if (TrackerTask.IsReady() && !bBodyTrackerReady)
+	{
+		return false;
+	}
 
+	return TrackerSerial == Serial && TrackerDepthMode == DepthMode && TrackerOrientation == SensorOrientation && IsTrackerConfigApplied();
 }
 
-void UAzureKinectDevice::CaptureColorImage()
+bool UAzureKinectDevice::IsTrackerConfigApplied() const
 {
-	int32 Width = 0, Height = 0;
-	uint8* SourceBuffer;
+	return TrackerMode == TrackerProcessingMode && TrackerGpuId == TrackerGpuDeviceId && bTrackerLite == bLiteTrackerModel;
+}
 
-	if (RemapMode == EKinectRemap::COLOR_TO_DEPTH)
+void UAzureKinectDevice::EnsureBodyTracker(const k4a::calibration& Calibration, const FString& Serial)
+{
+	if (HasBodyTrackerFor(Serial))
 	{
-		k4a::image DepthCapture = Capture.get_depth_image();
-		k4a::image ColorCapture = Capture.get_color_image();
+		UE_LOG(AzureKinectDeviceLog, Verbose, TEXT("Reusing body tracker."));
+		return;
+	}
 
-		if (!DepthCapture.is_valid() || !ColorCapture.is_valid()) return;
+	DestroyBodyTracker();
+	CreateBodyTrackerAsync(Calibration, Serial);
+}
 
-		Width = DepthCapture.get_width_pixels();
-		Height = DepthCapture.get_height_pixels();
+void UAzureKinectDevice::CreateBodyTrackerAsync(const k4a::calibration& Calibration, const FString& Serial)
+{
+	k4abt_tracker_configuration_t TrackerConfig = K4ABT_TRACKER_CONFIG_DEFAULT;
+	TrackerConfig.sensor_orientation = static_cast<k4abt_sensor_orientation_t>(SensorOrientation);
+	TrackerConfig.processing_mode = static_cast<k4abt_tracker_processing_mode_t>(TrackerProcessingMode);
+	TrackerConfig.gpu_device_id = TrackerGpuDeviceId;
+
+	TrackerSerial = Serial;
+	TrackerDepthMode = DepthMode;
+	TrackerOrientation = SensorOrientation;
+	TrackerMode = TrackerProcessingMode;
+	TrackerGpuId = TrackerGpuDeviceId;
+	bTrackerLite = bLiteTrackerModel;
+	AppliedTrackerSmoothing = -1.f;
 
-		if (Width == 0 || Height == 0) return;
+	{
+		FScopeLock Lock(&TrackerTimingCriticalSection);
+		TrackerTiming = FAzureKinectTrackerTiming();
+		TrackerTiming.ProcessingMode = TrackerProcessingMode;
+		TrackerTiming.bLiteModel = bLiteTrackerModel;
+	}
 
-		//
-		if (!RemapImage || !RemapImage.is_valid())
-		{
-			RemapImage = k4a::image::create(K4A_IMAGE_FORMAT_COLOR_BGRA32, Width, Height, Width * static_cast<int>(sizeof(uint8) * 4));
-		}
+	// The SDK looks model files up next to k4abt
+	const FString ModelPath = bLiteTrackerModel ? TEXT("dnn_model_2_0_lite_op11.onnx") : FString();
+	const bool bCpuFallback = bTrackerCpuFallback && TrackerProcessingMode != EKinectTrackerProcessingMode::CPU;
+
+	uint32 Generation;
+	{
+		FScopeLock Lock(&TrackerCriticalSection);
+		Generation = ++TrackerGeneration;
+	}
+
+	// Loading the model takes seconds, keep it away from the calling thread.
+	// The task is always waited for before this object is destroyed, but not when the tracker is destroyed or replaced.
+	TrackerTask = Async(EAsyncExecution::Thread, [this, Generation, Calibration, TrackerConfig, ModelPath, bCpuFallback]() mutable
+	{
+		const double LoadStartTime = FPlatformTime::Seconds();
+		FTCHARToUTF8 ModelPathUtf8(*ModelPath);
+		TrackerConfig.model_path = ModelPath.IsEmpty() ? nullptr : ModelPathUtf8.Get();
 
+		k4abt::tracker Tracker;
 		try
 		{
-			KinectTransformation.color_image_to_depth_camera(DepthCapture, ColorCapture, &RemapImage);
+			Tracker = k4abt::tracker::create(Calibration, TrackerConfig);
 		}
 		catch (const k4a::error& Err)
 		{
 			FString Msg(ANSI_TO_TCHAR(Err.what()));
-			UE_LOG(AzureKinectDeviceLog, Error, TEXT("Cant't transform Color to Depth: %s"), *Msg);
-			return;
+			if (!bCpuFallback)
+			{
+				UE_LOG(AzureKinectDeviceLog, Error, TEXT("Can't create body tracker: %s"), *Msg);
+				return;
+			}
+
+			UE_LOG(AzureKinectDeviceLog, Warning, TEXT("Can't create body tracker: %s Falling back to CPU."), *Msg);
+			TrackerConfig.processing_mode = K4ABT_TRACKER_PROCESSING_MODE_CPU;
+			try
+			{
+				Tracker = k4abt::tracker::create(Calibration, TrackerConfig);
+			}
+			catch (const k4a::error& CpuErr)
+			{
+				FString CpuMsg(ANSI_TO_TCHAR(CpuErr.what()));
+				UE_LOG(AzureKinectDeviceLog, Error, TEXT("Can't create body tracker on CPU: %s"), *CpuMsg);
+				return;
+			}
 		}
+		const float LoadMs = static_cast<float>((FPlatformTime::Seconds() - LoadStartTime) * 1000.0);
 
-		SourceBuffer = RemapImage.get_buffer();
+		{
+			FScopeLock Lock(&TrackerCriticalSection);
+			if (Generation == TrackerGeneration)
+			{
+				// Retain body tracker
+				BodyTracker = MoveTemp(Tracker);
+				if (TrackerConfig.processing_mode == K4ABT_TRACKER_PROCESSING_MODE_CPU)
+				{
+					FScopeLock TimingLock(&TrackerTimingCriticalSection);
+					TrackerTiming.ProcessingMode = EKinectTrackerProcessingMode::CPU;
+				}
+				StartupTiming.TrackerLoadMs = LoadMs;
+				bBodyTrackerReady = true;
+			}
+		}
 
-		DepthCapture.reset();
-		ColorCapture.reset();
-	}
-	else
-	{
-		k4a::image ColorCapture = Capture.get_color_image();
+		if (Tracker)
+		{
+			UE_LOG(AzureKinectDeviceLog, Verbose, TEXT("Body tracker has been destroyed or replaced while loading, discarding it."));
+			Tracker.destroy();
+			return;
+		}
 
-		if (!ColorCapture.is_valid()) return;
+		UE_LOG(AzureKinectDeviceLog, Log, TEXT("Body tracker (%s%s) loaded in %.2f ms."),
+			*StaticEnum<EKinectTrackerProcessingMode>()->GetNameStringByValue(static_cast<int64>(TrackerConfig.processing_mode)),
+			ModelPath.IsEmpty() ? TEXT("") : TEXT(", lite model"), LoadMs);
+	});
+}
 
-		Width = ColorCapture.get_width_pixels();
-		Height = ColorCapture.get_height_pixels();
-		if (Width == 0 || Height == 0) return;
-		
-		SourceBuffer = ColorCapture.get_buffer();
+void UAzureKinectDevice::DestroyBodyTracker()
+{
+	k4abt::tracker Tracker;
+	{
+		FScopeLock Lock(&TrackerCriticalSection);
+		// A model load in flight discards its tracker once done, so nobody waits for it here
+		TrackerGeneration++;
+		bBodyTrackerReady = false;
+		Tracker = MoveTemp(BodyTracker);
+	}
 
-		ColorCapture.reset();
+	if (TrackerTask.IsValid())
+	{
+		PendingTrackerTasks.Add(MoveTemp(TrackerTask));
 	}
+	PendingTrackerTasks.RemoveAll([](const TFuture<void>& Task) { return Task.IsReady(); });
 
-	if (ColorTexture->GetSurfaceWidth() != Width || ColorTexture->GetSurfaceHeight() != Height)
+	if (Tracker)
 	{
-		ColorTexture->InitCustomFormat(Width, Height, EPixelFormat::PF_B8G8R8A8, false);
-		ColorTexture->RenderTargetFormat = ETextureRenderTargetFormat::RTF_RGBA8;
-		ColorTexture->UpdateResource();
-	}	
-	else
+		Tracker.shutdown();
+		Tracker.destroy();
+	}
+}
+
+void UAzureKinectDevice::StartImu()
+{
+	TUniquePtr<FAzureKinectImuReader> Reader = MakeUnique<FAzureKinectImuReader>(NativeDevice);
+	if (!Reader->Start())
 	{
+		return;
+	}
 
-		FTextureResource* TextureResource = ColorTexture->Resource;
-		auto Region = FUpdateTextureRegion2D(0, 0, 0, 0, Width, Height);
+	FScopeLock Lock(&ImuCriticalSection);
+	ImuReader = MoveTemp(Reader);
+}
+
+void UAzureKinectDevice::StopImu()
+{
+	// Stops the IMU as well. Held for the whole reset so that no reader is used while its thread is joined.
+	FScopeLock Lock(&ImuCriticalSection);
+	ImuReader.Reset();
+}
+
+int32 UAzureKinectDevice::ReadImuSamples(TArray<FAzureKinectImuSample>& OutSamples, int32 MaxSamples)
+{
+	FScopeLock Lock(&ImuCriticalSection);
+	return ImuReader ? ImuReader->Read(OutSamples, MaxSamples) : 0;
+}
+
+int32 UAzureKinectDevice::ReadImuSamplesUntilDepthFrame(TArray<FAzureKinectImuSample>& OutSamples)
+{
+	FScopeLock Lock(&ImuCriticalSection);
+	return ImuReader ? ImuReader->ReadUntil(LatestDepthTimestampUsec.GetValue(), OutSamples) : 0;
+}
+
+int32 UAzureKinectDevice::GetNumImuOverruns() const
+{
+	FScopeLock Lock(&ImuCriticalSection);
+	return ImuReader ? ImuReader->GetNumOverruns() : 0;
+}
+#else
+bool UAzureKinectDevice::ReconfigureDevice()
+{
+	UE_LOG(AzureKinectDeviceLog, Warning, TEXT("KinectDevice is not running."));
+	return false;
+}
+
+bool UAzureKinectDevice::PreloadBodyTracker()
+{
+	return false;
+}
+
+void UAzureKinectDevice::DestroyBodyTracker()
+{
+	bBodyTrackerReady = false;
+}
+
+int32 UAzureKinectDevice::ReadImuSamples(TArray<FAzureKinectImuSample>& OutSamples, int32 MaxSamples)
+{
+	return 0;
+}
+
+int32 UAzureKinectDevice::ReadImuSamplesUntilDepthFrame(TArray<FAzureKinectImuSample>& OutSamples)
+{
+	return 0;
+}
+
+int32 UAzureKinectDevice::GetNumImuOverruns() const
+{
+	return 0;
+}
+#endif
+
+void UAzureKinectDevice::StoreAppliedConfig()
+{
+	AppliedDepthMode = DepthMode;
+	AppliedColorMode = ColorMode;
+	AppliedFps = Fps;
+	AppliedRemapMode = RemapMode;
+	AppliedSensorOrientation = SensorOrientation;
+	bAppliedSkeletonTracking = bSkeletonTracking;
+	bAppliedImu = bImu;
+}
+
+bool UAzureKinectDevice::StartPointCloudRecording(const FString& FilePath, bool bQuantize)
+{
+	if (!bOpen)
+	{
+		UE_LOG(AzureKinectDeviceLog, Warning, TEXT("KinectDevice is not running."));
+		return false;
+	}
+
+	StopPointCloudRecording();
+
+	TSharedPtr<FAzureKinectPointCloudWriter> Writer = MakeShared<FAzureKinectPointCloudWriter>(FilePath, bQuantize);
+	if (!Writer->Start())
+	{
+		return false;
+	}
+
+	FScopeLock DeviceLock(&DeviceCriticalSection);
+	PointCloudWriter = Writer;
+	return true;
+}
+
+void UAzureKinectDevice::StopPointCloudRecording()
+{
+	TSharedPtr<FAzureKinectPointCloudWriter> Writer;
+	{
+		// Detach from the capture thread first, then flush without blocking it.
+		FScopeLock DeviceLock(&DeviceCriticalSection);
+		Writer = MoveTemp(PointCloudWriter);
+	}
+
+	if (Writer)
+	{
+		Writer->EnsureCompletion();
+		LastDroppedPointCloudFrames = Writer->GetNumDroppedFrames();
+	}
+}
+
+int32 UAzureKinectDevice::GetNumDroppedPointCloudFrames() const
+{
+	return PointCloudWriter ? PointCloudWriter->GetNumDroppedFrames() : LastDroppedPointCloudFrames;
+}
+
+FAzureKinectPointCloudPtr UAzureKinectDevice::GetLatestPointCloud() const
+{
+	if (bOpen)
+	{
+		FScopeLock Lock(Thread->GetCriticalSection());
+		return LatestPointCloud;
+	}
+	return nullptr;
+}
+
+bool UAzureKinectDevice::StartSkeletonRecording(const FString& FilePath)
+{
+	if (!bOpen)
+	{
+		UE_LOG(AzureKinectDeviceLog, Warning, TEXT("KinectDevice is not running."));
+		return false;
+	}
+
+	if (SkeletonReader)
+	{
+		UE_LOG(AzureKinectDeviceLog, Warning, TEXT("KinectDevice is playing back skeletons, they are already recorded."));
+		return false;
+	}
+
+	TSharedPtr<FAzureKinectSkeletonWriter> Writer = MakeShared<FAzureKinectSkeletonWriter>();
+	if (!Writer->Open(FilePath))
+	{
+		return false;
+	}
+
+	FScopeLock DeviceLock(&DeviceCriticalSection);
+	SkeletonWriter = Writer;
+	return true;
+}
+
+void UAzureKinectDevice::StopSkeletonRecording()
+{
+	TSharedPtr<FAzureKinectSkeletonWriter> Writer;
+	{
+		FScopeLock DeviceLock(&DeviceCriticalSection);
+		Writer = MoveTemp(SkeletonWriter);
+	}
+
+	if (Writer)
+	{
+		UE_LOG(AzureKinectDeviceLog, Log, TEXT("Recorded %d skeleton frames."), Writer->GetNumFrames());
+		Writer->Close();
+	}
+}
+
+bool UAzureKinectDevice::StartSkeletonPlayback(const FString& FilePath, bool bLoop)
+{
+	if (bOpen)
+	{
+		UE_LOG(AzureKinectDeviceLog, Warning, TEXT("This Device has been open."));
+		return false;
+	}
+
+	TSharedPtr<FAzureKinectSkeletonReader> Reader = MakeShared<FAzureKinectSkeletonReader>();
+	if (!Reader->Open(FilePath))
+	{
+		return false;
+	}
+
+	StartDeviceTime = FPlatformTime::Seconds();
+	StartupTiming = FAzureKinectStartupTiming();
+
+	SkeletonReader = Reader;
+	bLoopPlayback = bLoop;
+	PlaybackFrame = INDEX_NONE;
+	PlaybackStartTimestamp = SkeletonReader->GetFrameTimestamp(0);
+	PlaybackStartTime = FPlatformTime::Seconds();
+	FrameTime = std::chrono::milliseconds(33);
+
+	// Playback drives the same thread and publication path as the native device.
+	Thread = new FAzureKinectDeviceThread(this);
+	bOpen = true;
+
+	return true;
+}
+
+void UAzureKinectDevice::SeekSkeletonPlayback(float Seconds)
+{
+	if (!SkeletonReader)
+	{
+		return;
+	}
+
+	FScopeLock DeviceLock(&DeviceCriticalSection);
+	PlaybackStartTimestamp = SkeletonReader->GetFrameTimestamp(0) + static_cast<int64>(FMath::Max(Seconds, 0.f) * 1e6);
+	PlaybackStartTime = FPlatformTime::Seconds();
+	PlaybackFrame = INDEX_NONE;
+}
+
+float UAzureKinectDevice::GetSkeletonPlaybackDuration() const
+{
+	if (!SkeletonReader)
+	{
+		return 0.f;
+	}
+
+	const int64 Duration = SkeletonReader->GetFrameTimestamp(SkeletonReader->GetNumFrames() - 1) - SkeletonReader->GetFrameTimestamp(0);
+	return Duration / 1e6f;
+}
+
+FDelegateHandle UAzureKinectDevice::AddSkeletonsPublishedListener(FOnAzureKinectSkeletonsPublished::FDelegate&& Delegate)
+{
+	// Broadcast happens while the capture thread holds the device lock.
+	FScopeLock DeviceLock(&DeviceCriticalSection);
+	return SkeletonsPublishedEvent.Add(MoveTemp(Delegate));
+}
+
+void UAzureKinectDevice::RemoveSkeletonsPublishedListener(FDelegateHandle Handle)
+{
+	FScopeLock DeviceLock(&DeviceCriticalSection);
+	SkeletonsPublishedEvent.Remove(Handle);
+}
+
+void UAzureKinectDevice::BeginDestroy()
+{
+	if (bOpen)
+	{
+		StopDevice();
+	}
+	DestroyBodyTracker();
+
+	// Model loads still in flight refer to this object
+	for (TFuture<void>& Task : PendingTrackerTasks)
+	{
+		Task.Wait();
+	}
+	PendingTrackerTasks.Reset();
+
+	Super::BeginDestroy();
+}
+
+int32 UAzureKinectDevice::GetNumConnectedDevices()
+{
+#if WITH_AZUREKINECT_SDK
+	return k4a_device_get_installed_count();
+#else
+	return 0;
+#endif
+}
+
+int32 UAzureKinectDevice::GetNumTrackedSkeletons() const
+{
+	if (!bOpen)
+	{
+		return 0;
+	}
+	if (!bSkeletonTracking && !SkeletonReader)
+	{
+		UE_LOG(AzureKinectDeviceLog, Error, TEXT("GetNumTrackedBodies: Skeleton Tracking is disabled!"));
+		return 0;
+	}
+
+	FScopeLock Lock(Thread->GetCriticalSection());
+	return NumTrackedSkeletons;
+}
+
+FAzureKinectSkeleton UAzureKinectDevice::GetSkeleton(int32 Index) const
+{
+	if (bOpen)
+	{
+		if (!bSkeletonTracking && !SkeletonReader)
+		{
+			UE_LOG(AzureKinectDeviceLog, Error, TEXT("GetSkeleton: Skeleton Tracking is disabled!"));
+			return FAzureKinectSkeleton();
+		}
+
+		FScopeLock Lock(Thread->GetCriticalSection());
+		if (Skeletons.IsValidIndex(Index))
+		{
+			return Skeletons[Index];
+		}
+		else
+		{
+			UE_LOG(AzureKinectDeviceLog, Error, TEXT("GetSkeleton: Index is out of range!"));
+			return FAzureKinectSkeleton();
+		}
+	}
+	else
+	{
+		return FAzureKinectSkeleton();
+	}
+	
+}
+
+const TArray<FAzureKinectSkeleton>& UAzureKinectDevice::GetSkeletons() const {
+	if (bOpen)
+	{
+		FScopeLock Lock(Thread->GetCriticalSection());
+		return Skeletons;
+	}
+	else
+	{
+		return Skeletons;
+	}
+}
+
+void UAzureKinectDevice::UpdateAsync()
+{
+	// Threaded function
+	if (SkeletonReader)
+	{
+		UpdatePlayback();
+		return;
+	}
+
+#if WITH_AZUREKINECT_SDK
+	FScopeLock DeviceLock(&DeviceCriticalSection);
+
+	try
+	{
+		if (!NativeDevice.get_capture(&Capture, FrameTime))
+		{
+			UE_LOG(AzureKinectDeviceLog, Verbose, TEXT("Timed out waiting for capture."));
+		}
+	}
+	catch (const k4a::error& Err)
+	{
+		FString Msg(ANSI_TO_TCHAR(Err.what()));
+		UE_LOG(AzureKinectDeviceLog, Error, TEXT("Can't capture frame: %s"), *Msg);
+		return;
+	}
+
+	if (AppliedDepthMode != EKinectDepthMode::OFF)
+	{
+		k4a::image DepthCapture = Capture.get_depth_image();
+		if (DepthCapture.is_valid())
+		{
+			LatestDepthTimestampUsec.Set(DepthCapture.get_device_timestamp().count());
+		}
+	}
+
+	if (AppliedDepthMode != EKinectDepthMode::OFF && AppliedDepthMode != EKinectDepthMode::PASSIVE_IR && DepthFilter.bEnabled)
+	{
+		FilterDepthImage();
+	}
+
+	// The depth remap transforms into the converted color image
+	if (AppliedColorMode != EKinectColorResolution::RESOLUTION_OFF && AppliedColorFormat != EKinectColorFormat::BGRA32 &&
+		(ColorTexture || bGeneratePointCloud || PointCloudWriter || AppliedRemapMode == EKinectRemap::DEPTH_TO_COLOR))
+	{
+		ConvertColorImage();
+	}
+
+	if (AppliedColorMode != EKinectColorResolution::RESOLUTION_OFF && ColorTexture)
+	{
+		CaptureColorImage();
+	}
+
+	if (AppliedDepthMode != EKinectDepthMode::OFF && DepthTexture)
+	{
+		CaptureDepthImage();
+	}
+	
+	if (AppliedDepthMode != EKinectDepthMode::OFF && InflaredTexture)
+	{
+		CaptureInflaredImage();
+	}
+
+	if (AppliedDepthMode != EKinectDepthMode::OFF && AppliedDepthMode != EKinectDepthMode::PASSIVE_IR && BackgroundSubtraction.bEnabled)
+	{
+		CaptureForegroundMask();
+	}
+
+	// Before point clouds, which pick up the body index map
+	if (bAppliedSkeletonTracking && bBodyTrackerReady)
+	{
+		UpdateSkeletons();
+	}
+
+	if (AppliedDepthMode != EKinectDepthMode::OFF && AppliedDepthMode != EKinectDepthMode::PASSIVE_IR && (bGeneratePointCloud || PointCloudWriter || FloorDetection.bEnabled))
+	{
+		CapturePointCloud();
+	}
+
+	if (FloorDetection.bEnabled && LatestPointCloud)
+	{
+		UpdateFloor();
+	}
+
+	if (StartupTiming.FirstTextureMs == 0.f)
+	{
+		// Uploads finish on the render thread, so this is picked up a frame later with the time it happened
+		const double LastUploadTime = FMath::Max(
+			FMath::Max3(DepthTarget.GetLastUploadTime(), ColorTarget.GetLastUploadTime(), InflaredTarget.GetLastUploadTime()),
+			FMath::Max(BodyIndexTarget.GetLastUploadTime(), ForegroundMaskTarget.GetLastUploadTime()));
+		if (LastUploadTime > StartDeviceTime)
+		{
+			StartupTiming.FirstTextureMs = static_cast<float>((LastUploadTime - StartDeviceTime) * 1000.0);
+			UE_LOG(AzureKinectDeviceLog, Log, TEXT("First texture uploaded after %.2f ms."), StartupTiming.FirstTextureMs);
+		}
+	}
+
+	FilteredDepthImage.reset();
+	BodyIndexMap.reset();
+	ConvertedColorImage.reset();
+	Capture.reset();
+#endif
+}
+
+#if WITH_AZUREKINECT_SDK
+void UAzureKinectDevice::CaptureColorImage()
+{
+	int32 Width = 0, Height = 0;
+	uint8* SourceBuffer;
+
+	if (AppliedRemapMode == EKinectRemap::COLOR_TO_DEPTH)
+	{
+		k4a::image DepthCapture = GetDepthImage();
+		k4a::image ColorCapture = GetColorImage();
+
+		if (!DepthCapture.is_valid() || !ColorCapture.is_valid()) return;
+
+		Width = DepthCapture.get_width_pixels();
+		Height = DepthCapture.get_height_pixels();
+
+		if (Width == 0 || Height == 0) return;
+
+		//
+		if (!RemapImage || !RemapImage.is_valid())
+		{
+			RemapImage = k4a::image::create(K4A_IMAGE_FORMAT_COLOR_BGRA32, Width, Height, Width * static_cast<int>(sizeof(uint8) * 4));
+		}
+
+		try
+		{
+			KinectTransformation.color_image_to_depth_camera(DepthCapture, ColorCapture, &RemapImage);
+		}
+		catch (const k4a::error& Err)
+		{
+			FString Msg(ANSI_TO_TCHAR(Err.what()));
+			UE_LOG(AzureKinectDeviceLog, Error, TEXT("Cant't transform Color to Depth: %s"), *Msg);
+			return;
+		}
+
+		SourceBuffer = RemapImage.get_buffer();
+
+		DepthCapture.reset();
+		ColorCapture.reset();
+	}
+	else
+	{
+		k4a::image ColorCapture = GetColorImage();
+
+		if (!ColorCapture.is_valid()) return;
+
+		Width = ColorCapture.get_width_pixels();
+		Height = ColorCapture.get_height_pixels();
+		if (Width == 0 || Height == 0) return;
+		
+		SourceBuffer = ColorCapture.get_buffer();
+
+		ColorCapture.reset();
+	}
+
+	// The source is released or reused by the next frame, so it's copied before returning
+	uint8* Texels = ColorTarget.BeginUpload(ColorTexture, Width, Height);
+	if (!Texels) return;
+
+	FMemory::Memcpy(Texels, SourceBuffer, Width * Height * 4);
+	ColorTarget.EndUpload();
+}
+
+void UAzureKinectDevice::CaptureDepthImage()
+{
+	int32 Width = 0, Height = 0;
+	uint8* SourceBuffer;
+	if (AppliedRemapMode == EKinectRemap::DEPTH_TO_COLOR)
+	{
+		k4a::image DepthCapture = GetDepthImage();
+		k4a::image ColorCapture = GetColorImage();
+
+		if (!DepthCapture.is_valid() || !ColorCapture.is_valid()) return;
+
+		Width = ColorCapture.get_width_pixels();
+		Height = ColorCapture.get_height_pixels();
+		
+		if (Width == 0 || Height == 0) return;
+
+		//
+		if (!RemapImage || !RemapImage.is_valid())
+		{
+			RemapImage = k4a::image::create(K4A_IMAGE_FORMAT_DEPTH16, Width, Height, Width * static_cast<int>(sizeof(uint16)));
+		}
+
+		try
+		{
+			KinectTransformation.depth_image_to_color_camera(DepthCapture, &RemapImage);
+		}
+		catch (const k4a::error& Err)
+		{
+			FString Msg(ANSI_TO_TCHAR(Err.what()));
+			UE_LOG(AzureKinectDeviceLog, Error, TEXT("Cant't transform Depth to Color: %s"), *Msg);
+			return;
+		}
+
+		SourceBuffer = RemapImage.get_buffer();
+
+		DepthCapture.reset();
+		ColorCapture.reset();
+	}
+	else
+	{
+		k4a::image DepthCapture = GetDepthImage();
+		if (!DepthCapture.is_valid()) return;
+
+		Width = DepthCapture.get_width_pixels();
+		Height = DepthCapture.get_height_pixels();
+
+		if (Width == 0 || Height == 0) return;
+
+		SourceBuffer = DepthCapture.get_buffer();
+
+		DepthCapture.reset();
+	}
+
+	// Skipped while the texture is resized or the render thread is behind
+	uint8* Texels = DepthTarget.BeginUpload(DepthTexture, Width, Height);
+	if (!Texels) return;
+
+	FAzureKinectTextureConverter::DepthToRGBA(reinterpret_cast<const uint16*>(SourceBuffer), Width * Height, Texels);
+	DepthTarget.EndUpload();
+}
+
+void UAzureKinectDevice::CaptureInflaredImage()
+{
+	const k4a::image& InflaredCapture = Capture.get_ir_image();
+	if (!InflaredCapture.is_valid()) return;
+
+	int32 Width = InflaredCapture.get_width_pixels(), Height = InflaredCapture.get_height_pixels();
+	if (Width == 0 || Height == 0) return;
+
+	uint8* Texels = InflaredTarget.BeginUpload(InflaredTexture, Width, Height);
+	if (!Texels) return;
+
+	FAzureKinectTextureConverter::InfraredToRGBA(reinterpret_cast<const uint16*>(InflaredCapture.get_buffer()), Width * Height, Texels);
+	InflaredTarget.EndUpload();
+}
+
+void UAzureKinectDevice::CaptureBodyIndexImage(const k4abt::frame& BodyFrame)
+{
+	k4a::image BodyIndexMap = BodyFrame.get_body_index_map();
+
+	int32 Width = BodyIndexMap.get_width_pixels(), Height = BodyIndexMap.get_height_pixels();
+	if (Width == 0 || Height == 0) return;
 
-		ENQUEUE_RENDER_COMMAND(UpdateTextureData)(
-			[TextureResource, Region, SourceBuffer](FRHICommandListImmediate& RHICmdList) {
-				FTexture2DRHIRef Texture2D = TextureResource->TextureRHI ? TextureResource->TextureRHI->GetTexture2D() : nullptr;
-				if (!Texture2D)
-				{
-					return;
-				}
-				RHIUpdateTexture2D(Texture2D, 0, Region, 4 * Region.Width, SourceBuffer);
-			});
-	}
+	uint8* Texels = BodyIndexTarget.BeginUpload(BodyIndexTexture, Width, Height);
+	if (!Texels) return;
 
+	FAzureKinectTextureConverter::BodyIndexToRGBA(BodyIndexMap.get_buffer(), Width * Height, Texels);
+	BodyIndexTarget.EndUpload();
 }
 
-void UAzureKinectDevice::CaptureDepthImage()
+void UAzureKinectDevice::FilterDepthImage()
 {
-	int32 Width = 0, Height = 0;
-	uint8* SourceBuffer;
-	if (RemapMode == EKinectRemap::DEPTH_TO_COLOR)
+	k4a::image DepthCapture = Capture.get_depth_image();
+	if (!DepthCapture.is_valid()) return;
+
+	int32 Width = DepthCapture.get_width_pixels(), Height = DepthCapture.get_height_pixels();
+	if (Width == 0 || Height == 0) return;
+
+	// Keep the captured image intact for the body tracker
+	FilteredDepth.SetNumUninitialized(Width * Height, false);
+	FMemory::Memcpy(FilteredDepth.GetData(), DepthCapture.get_buffer(), FilteredDepth.Num() * sizeof(uint16));
+
+	FAzureKinectDepthFilterTiming Timing;
+	DepthFilterChain.Process(FilteredDepth.GetData(), Width, Height, DepthFilter, &Timing);
+
 	{
-		k4a::image DepthCapture = Capture.get_depth_image();
-		k4a::image ColorCapture = Capture.get_color_image();
+		FScopeLock Lock(Thread->GetCriticalSection());
+		LastDepthFilterTiming = Timing;
+	}
 
-		if (!DepthCapture.is_valid() || !ColorCapture.is_valid()) return;
+	try
+	{
+		FilteredDepthImage = k4a::image::create_from_buffer(
+			K4A_IMAGE_FORMAT_DEPTH16, Width, Height, Width * static_cast<int>(sizeof(uint16)),
+			reinterpret_cast<uint8*>(FilteredDepth.GetData()), FilteredDepth.Num() * sizeof(uint16), nullptr, nullptr);
+		FilteredDepthImage.set_device_timestamp(DepthCapture.get_device_timestamp());
+	}
+	catch (const k4a::error& Err)
+	{
+		FString Msg(ANSI_TO_TCHAR(Err.what()));
+		UE_LOG(AzureKinectDeviceLog, Error, TEXT("Cant't wrap filtered depth: %s"), *Msg);
+		FilteredDepthImage.reset();
+	}
+}
 
-		Width = ColorCapture.get_width_pixels();
-		Height = ColorCapture.get_height_pixels();
-		
-		if (Width == 0 || Height == 0) return;
+k4a::image UAzureKinectDevice::GetDepthImage() const
+{
+	return FilteredDepthImage.is_valid() ? FilteredDepthImage : Capture.get_depth_image();
+}
 
-		//
-		if (!RemapImage || !RemapImage.is_valid())
+void UAzureKinectDevice::ConvertColorImage()
+{
+	k4a::image ColorCapture = Capture.get_color_image();
+	if (!ColorCapture.is_valid()) return;
+
+	int32 Width = ColorCapture.get_width_pixels(), Height = ColorCapture.get_height_pixels();
+	if (Width == 0 || Height == 0) return;
+
+	if (MjpegDecoder)
+	{
+		MjpegDecoder->Submit(ColorCapture.get_device_timestamp().count(), ColorCapture.get_buffer(), ColorCapture.get_size(), Width, Height);
+		if (FAzureKinectColorFramePtr Frame = MjpegDecoder->PopLatest())
 		{
-			RemapImage = k4a::image::create(K4A_IMAGE_FORMAT_DEPTH16, Width, Height, Width * static_cast<int>(sizeof(uint16)));
+			DecodedColorFrame = Frame;
 		}
 
+		if (!DecodedColorFrame) return;
+
 		try
 		{
-			KinectTransformation.depth_image_to_color_camera(DepthCapture, &RemapImage);
+			ConvertedColorImage = k4a::image::create_from_buffer(
+				K4A_IMAGE_FORMAT_COLOR_BGRA32, DecodedColorFrame->Width, DecodedColorFrame->Height, DecodedColorFrame->Width * static_cast<int>(sizeof(FColor)),
+				reinterpret_cast<uint8*>(DecodedColorFrame->Pixels.GetData()), DecodedColorFrame->Pixels.Num() * sizeof(FColor), nullptr, nullptr);
+			ConvertedColorImage.set_device_timestamp(std::chrono::microseconds(DecodedColorFrame->TimestampUsec));
 		}
 		catch (const k4a::error& Err)
 		{
 			FString Msg(ANSI_TO_TCHAR(Err.what()));
-			UE_LOG(AzureKinectDeviceLog, Error, TEXT("Cant't transform Depth to Color: %s"), *Msg);
-			return;
+			UE_LOG(AzureKinectDeviceLog, Error, TEXT("Cant't wrap decoded color: %s"), *Msg);
+			ConvertedColorImage.reset();
 		}
+		return;
+	}
 
-		SourceBuffer = RemapImage.get_buffer();
+	ConvertedColor.SetNumUninitialized(Width * Height, false);
+	if (!ColorConverter.Convert(AppliedColorFormat, ColorCapture.get_buffer(), ColorCapture.get_size(), Width, Height, ColorCapture.get_stride_bytes(), ConvertedColor.GetData()))
+	{
+		UE_LOG(AzureKinectDeviceLog, Verbose, TEXT("Can't convert color frame, skipping."));
+		return;
+	}
 
-		DepthCapture.reset();
-		ColorCapture.reset();
+	try
+	{
+		ConvertedColorImage = k4a::image::create_from_buffer(
+			K4A_IMAGE_FORMAT_COLOR_BGRA32, Width, Height, Width * static_cast<int>(sizeof(FColor)),
+			reinterpret_cast<uint8*>(ConvertedColor.GetData()), ConvertedColor.Num() * sizeof(FColor), nullptr, nullptr);
+		ConvertedColorImage.set_device_timestamp(ColorCapture.get_device_timestamp());
 	}
-	else
+	catch (const k4a::error& Err)
 	{
-		k4a::image DepthCapture = Capture.get_depth_image();
-		if (!DepthCapture.is_valid()) return;
-
-		Width = DepthCapture.get_width_pixels();
-		Height = DepthCapture.get_height_pixels();
+		FString Msg(ANSI_TO_TCHAR(Err.what()));
+		UE_LOG(AzureKinectDeviceLog, Error, TEXT("Cant't wrap converted color: %s"), *Msg);
+		ConvertedColorImage.reset();
+	}
+}
 
-		if (Width == 0 || Height == 0) return;
+k4a::image UAzureKinectDevice::GetColorImage() const
+{
+	if (AppliedColorFormat == EKinectColorFormat::BGRA32)
+	{
+		return Capture.get_color_image();
+	}
+	// Unconverted frames can't be used as BGRA
+	return ConvertedColorImage.is_valid() ? ConvertedColorImage : k4a::image();
+}
 
-		SourceBuffer = DepthCapture.get_buffer();
+#endif
 
-		DepthCapture.reset();
+void UAzureKinectDevice::SetCameraToWorld(const FTransform& InCameraToWorld)
+{
+	if (bOpen && Thread)
+	{
+		FScopeLock Lock(Thread->GetCriticalSection());
+		CameraToWorld = InCameraToWorld;
+		return;
 	}
+	CameraToWorld = InCameraToWorld;
+}
 
-	if (DepthTexture->GetSurfaceWidth() != Width || DepthTexture->GetSurfaceHeight() != Height)
+FTransform UAzureKinectDevice::GetCameraToWorld() const
+{
+	if (bOpen && Thread)
 	{
-		DepthTexture->InitCustomFormat(Width, Height, EPixelFormat::PF_R8G8B8A8, true);
-		DepthTexture->RenderTargetFormat = ETextureRenderTargetFormat::RTF_RGBA8;
-		DepthTexture->UpdateResource();
+		FScopeLock Lock(Thread->GetCriticalSection());
+		return CameraToWorld;
 	}
-	else
+	return CameraToWorld;
+}
+
+FTransform UAzureKinectDevice::GetDepthCameraToWorld() const
+{
+	const FTransform Extrinsic = GetCameraToWorld();
+	if (FloorDetection.bApplyToSkeletons && FloorDetector.IsDetected())
 	{
-		
-		TArray<uint8> SrcData;
-		SrcData.Reset(Width * Height * 4);
-		for (int hi = 0; hi < Height; hi++)
-		{
-			for (int wi = 0; wi < Width; wi++)
-			{
-				int index = hi * Width + wi;
-				uint16 R = SourceBuffer[index * 2];
-				uint16 G = SourceBuffer[index * 2 + 1];
-				
-				uint16 Sample = G << 8 | R;
-
-				SrcData.Push(SourceBuffer[index * 2]);
-				SrcData.Push(SourceBuffer[index * 2 + 1]);
-				SrcData.Push(Sample > 0 ? 0x00 : 0xFF);
-				SrcData.Push(0xFF);
-				
-			}
-		}
-		
-		FTextureResource* TextureResource = DepthTexture->Resource;
-		auto Region = FUpdateTextureRegion2D(0, 0, 0, 0, Width, Height);
+		return FloorDetector.GetCameraToFloor() * Extrinsic;
+	}
+	return Extrinsic;
+}
 
-		ENQUEUE_RENDER_COMMAND(UpdateTextureData)(
-			[TextureResource, Region, SrcData](FRHICommandListImmediate& RHICmdList) {
-				FTexture2DRHIRef Texture2D = TextureResource->TextureRHI ? TextureResource->TextureRHI->GetTexture2D() : nullptr;
-				if (!Texture2D)
-				{
-					return;
-				}
-				RHIUpdateTexture2D(Texture2D, 0, Region, 4 * Region.Width, SrcData.GetData());
+FAzureKinectTrackerTiming UAzureKinectDevice::GetTrackerTiming() const
+{
+	FScopeLock Lock(&TrackerTimingCriticalSection);
+	return TrackerTiming;
+}
 
-			});
+FAzureKinectDepthFilterTiming UAzureKinectDevice::GetDepthFilterTiming() const
+{
+	if (bOpen)
+	{
+		FScopeLock Lock(Thread->GetCriticalSection());
+		return LastDepthFilterTiming;
 	}
+	return LastDepthFilterTiming;
+}
 
+int32 UAzureKinectDevice::GetNumTextureReallocations() const
+{
+	return DepthTarget.GetNumReallocations() + ColorTarget.GetNumReallocations() + InflaredTarget.GetNumReallocations() +
+		BodyIndexTarget.GetNumReallocations() + ForegroundMaskTarget.GetNumReallocations();
 }
 
-void UAzureKinectDevice::CaptureInflaredImage()
+FAzureKinectUploadTiming UAzureKinectDevice::GetUploadTiming() const
 {
-	const k4a::image& InflaredCapture = Capture.get_ir_image();
-	if (!InflaredCapture.is_valid()) return;
+	FAzureKinectUploadTiming UploadTiming;
+	UploadTiming.DepthMs = DepthTarget.GetAverageUploadMs();
+	UploadTiming.ColorMs = ColorTarget.GetAverageUploadMs();
+	UploadTiming.InflaredMs = InflaredTarget.GetAverageUploadMs();
+	UploadTiming.BodyIndexMs = BodyIndexTarget.GetAverageUploadMs();
+	UploadTiming.ForegroundMaskMs = ForegroundMaskTarget.GetAverageUploadMs();
+	UploadTiming.NumDroppedFrames = DepthTarget.GetNumDroppedFrames() + ColorTarget.GetNumDroppedFrames() + InflaredTarget.GetNumDroppedFrames() +
+		BodyIndexTarget.GetNumDroppedFrames() + ForegroundMaskTarget.GetNumDroppedFrames();
+	return UploadTiming;
+}
 
-	int32 Width = InflaredCapture.get_width_pixels(), Height = InflaredCapture.get_height_pixels();
+#if WITH_AZUREKINECT_SDK
+void UAzureKinectDevice::PreallocateTextures()
+{
+	// Otherwise the capture thread requests the sizes it sees
+	if (!IsInGameThread()) return;
+
+	// Sizes the cameras were actually started at, which the enums don't tell, e.g. EKinectColorResolution has no 1080p
+	const k4a_calibration_camera_t& DepthCamera = KinectCalibration.depth_camera_calibration;
+	const k4a_calibration_camera_t& ColorCamera = KinectCalibration.color_camera_calibration;
+	const FIntPoint IRSize = AppliedDepthMode != EKinectDepthMode::OFF ? FIntPoint(DepthCamera.resolution_width, DepthCamera.resolution_height) : FIntPoint::ZeroValue;
+	const FIntPoint DepthSize = AppliedDepthMode != EKinectDepthMode::PASSIVE_IR ? IRSize : FIntPoint::ZeroValue;
+	const FIntPoint ColorSize = AppliedColorMode != EKinectColorResolution::RESOLUTION_OFF ? FIntPoint(ColorCamera.resolution_width, ColorCamera.resolution_height) : FIntPoint::ZeroValue;
+
+	// Remapped images come at the size of the other camera
+	DepthTarget.Preallocate(DepthTexture, AppliedRemapMode == EKinectRemap::DEPTH_TO_COLOR ? ColorSize : DepthSize);
+	ColorTarget.Preallocate(ColorTexture, AppliedRemapMode == EKinectRemap::COLOR_TO_DEPTH ? DepthSize : ColorSize);
+	InflaredTarget.Preallocate(InflaredTexture, IRSize);
+	ForegroundMaskTarget.Preallocate(ForegroundMaskTexture, DepthSize);
+	if (bAppliedSkeletonTracking)
+	{
+		BodyIndexTarget.Preallocate(BodyIndexTexture, DepthSize);
+	}
+}
+
+void UAzureKinectDevice::CaptureForegroundMask()
+{
+	k4a::image DepthCapture = GetDepthImage();
+	if (!DepthCapture.is_valid()) return;
+
+	int32 Width = DepthCapture.get_width_pixels(), Height = DepthCapture.get_height_pixels();
 	if (Width == 0 || Height == 0) return;
 
-	if (InflaredTexture->GetSurfaceWidth() != Width || InflaredTexture->GetSurfaceWidth() != Height)
+	if (bResetBackgroundRequested)
 	{
-		InflaredTexture->InitCustomFormat(Width, Height, EPixelFormat::PF_R8G8B8A8, true);
-		InflaredTexture->RenderTargetFormat = ETextureRenderTargetFormat::RTF_RGBA8;
-		InflaredTexture->UpdateResource();
+		BackgroundModel.Reset();
+		bResetBackgroundRequested = false;
 	}
-	else
-	{
-		const uint8* S = InflaredCapture.get_buffer();
-		TArray<uint8> SrcData;
-		SrcData.Reset(Width * Height * 4);
-		for (int hi = 0; hi < Height; hi++)
-		{
-			for (int wi = 0; wi < Width; wi++)
-			{
-				int index = hi * Width + wi;
 
-				if (S[index * 2] + S[index * 2 + 1] > 0)
-				{
-					SrcData.Push(S[index * 2]);
-					SrcData.Push(S[index * 2 + 1]);
-					SrcData.Push(0x00);
-					SrcData.Push(0xff);
-				}
-				else
-				{
-					SrcData.Push(0x00);
-					SrcData.Push(0x00);
-					SrcData.Push(0xff);
-					SrcData.Push(0xff);
-				}
-			}
-		}
-		
-		FTextureResource* TextureResource = InflaredTexture->Resource;
-		auto Region = FUpdateTextureRegion2D(0, 0, 0, 0, Width, Height);
+	ForegroundMask.SetNumUninitialized(Width * Height, false);
+	const uint16* DepthBuffer = reinterpret_cast<const uint16*>(DepthCapture.get_buffer());
+	ForegroundPixelCount.Set(BackgroundModel.Process(DepthBuffer, Width, Height, BackgroundSubtraction, ForegroundMask.GetData()));
 
-		ENQUEUE_RENDER_COMMAND(UpdateTextureData)(
-			[TextureResource, Region, SrcData](FRHICommandListImmediate& RHICmdList) {
-				FTexture2DRHIRef Texture2D = TextureResource->TextureRHI ? TextureResource->TextureRHI->GetTexture2D() : nullptr;
-				if (!Texture2D)
-				{
-					return;
-				}
+	if (!ForegroundMaskTexture) return;
 
-				RHIUpdateTexture2D(Texture2D, 0, Region, 4 * Region.Width, SrcData.GetData());
-			});
-	}
-	
+	uint8* Texels = ForegroundMaskTarget.BeginUpload(ForegroundMaskTexture, Width, Height);
+	if (!Texels) return;
+
+	FMemory::Memcpy(Texels, ForegroundMask.GetData(), Width * Height);
+	ForegroundMaskTarget.EndUpload();
 }
 
-void UAzureKinectDevice::CaptureBodyIndexImage(const k4abt::frame& BodyFrame)
+void UAzureKinectDevice::CapturePointCloud()
 {
-	k4a::image BodyIndexMap = BodyFrame.get_body_index_map();
+	k4a::image DepthCapture = GetDepthImage();
+	if (!DepthCapture.is_valid()) return;
 
-	int32 Width = BodyIndexMap.get_width_pixels(), Height = BodyIndexMap.get_height_pixels();
+	int32 Width = DepthCapture.get_width_pixels(), Height = DepthCapture.get_height_pixels();
 	if (Width == 0 || Height == 0) return;
 
-	if (BodyIndexTexture->GetSurfaceWidth() != Width || BodyIndexTexture->GetSurfaceHeight() != Height)
+	FAzureKinectPointCloudPtr Frame = PointCloudPool.Acquire();
+	if (!Frame)
 	{
-		BodyIndexTexture->InitCustomFormat(Width, Height, EPixelFormat::PF_R8G8B8A8, true);
-		BodyIndexTexture->RenderTargetFormat = ETextureRenderTargetFormat::RTF_RGBA8;
-		BodyIndexTexture->UpdateResource();
+		UE_LOG(AzureKinectDeviceLog, Verbose, TEXT("All point cloud frames are in use, skipping."));
+		return;
 	}
-	else
+
+	Frame->Width = Width;
+	Frame->Height = Height;
+	Frame->TimestampUsec = DepthCapture.get_device_timestamp().count();
+	Frame->Positions.SetNumUninitialized(Width * Height * 3, false);
+
+	k4a::image ColorCapture = GetColorImage();
+
+	try
 	{
-		uint8* S = BodyIndexMap.get_buffer();
-		TArray<uint8> SrcData;
-		SrcData.Reset(Width * Height * 4);
-		for (int i = 0; i < Width * Height; i++)
+		// Let the SDK write straight into the pooled frame.
+		k4a::image PointCloudImage = k4a::image::create_from_buffer(
+			K4A_IMAGE_FORMAT_CUSTOM, Width, Height, Width * static_cast<int>(sizeof(int16) * 3),
+			reinterpret_cast<uint8*>(Frame->Positions.GetData()), Frame->Positions.Num() * sizeof(int16), nullptr, nullptr);
+		KinectTransformation.depth_image_to_point_cloud(DepthCapture, K4A_CALIBRATION_TYPE_DEPTH, &PointCloudImage);
+
+		if (ColorCapture.is_valid())
+		{
+			Frame->Colors.SetNumUninitialized(Width * Height, false);
+			k4a::image ColorImage = k4a::image::create_from_buffer(
+				K4A_IMAGE_FORMAT_COLOR_BGRA32, Width, Height, Width * static_cast<int>(sizeof(FColor)),
+				reinterpret_cast<uint8*>(Frame->Colors.GetData()), Frame->Colors.Num() * sizeof(FColor), nullptr, nullptr);
+			KinectTransformation.color_image_to_depth_camera(DepthCapture, ColorCapture, &ColorImage);
+		}
+		else
+		{
+			Frame->Colors.Reset();
+		}
+
+		// Tracking can lag behind depth, only a map of the same capture lines up
+		if (BodyIndexMap.is_valid() && BodyIndexTimestampUsec == Frame->TimestampUsec &&
+			BodyIndexMap.get_width_pixels() == Width && BodyIndexMap.get_height_pixels() == Height)
+		{
+			Frame->BodyIndices.SetNumUninitialized(Width * Height, false);
+			FMemory::Memcpy(Frame->BodyIndices.GetData(), BodyIndexMap.get_buffer(), Width * Height);
+		}
+		else
 		{
-			SrcData.Push(S[i]);
-			SrcData.Push(S[i]);
-			SrcData.Push(S[i]);
-			SrcData.Push(0xff);
+			Frame->BodyIndices.Reset();
 		}
+	}
+	catch (const k4a::error& Err)
+	{
+		FString Msg(ANSI_TO_TCHAR(Err.what()));
+		UE_LOG(AzureKinectDeviceLog, Error, TEXT("Cant't generate point cloud: %s"), *Msg);
+		return;
+	}
 
-		FTextureResource* TextureResource = BodyIndexTexture->Resource;
-		auto Region = FUpdateTextureRegion2D(0, 0, 0, 0, Width, Height);
+	{
+		FScopeLock Lock(Thread->GetCriticalSection());
+		LatestPointCloud = Frame;
+	}
 
-		ENQUEUE_RENDER_COMMAND(UpdateTextureData)(
-			[TextureResource, Region, SrcData](FRHICommandListImmediate& RHICmdList) {
-				FTexture2DRHIRef Texture2D = TextureResource->TextureRHI ? TextureResource->TextureRHI->GetTexture2D() : nullptr;
-				if (!Texture2D)
-				{
-					return;
-				}
-				RHIUpdateTexture2D(Texture2D, 0, Region, 4 * Region.Width, SrcData.GetData());
+	if (PointCloudWriter)
+	{
+		PointCloudWriter->Enqueue(Frame);
+	}
+}
+
+void UAzureKinectDevice::UpdateFloor()
+{
+	const double Now = FPlatformTime::Seconds();
+	if (Now - LastFloorUpdateTime < FloorDetection.UpdateInterval) return;
+	if (FloorTask.IsValid() && !FloorTask.IsReady()) return;
+
+	LastFloorUpdateTime = Now;
+
+	// The task keeps the frame out of the pool until it's done
+	FAzureKinectPointCloudPtr Frame = LatestPointCloud;
+	const FVector Up = GetGravityUp();
+	const FAzureKinectFloorSettings Settings = FloorDetection;
+	FloorTask = Async(EAsyncExecution::ThreadPool, [this, Frame, Up, Settings]()
+	{
+		FloorDetector.Update(*Frame, Up, Settings);
+	});
+}
 
-			});
+FVector UAzureKinectDevice::GetGravityUp() const
+{
+	FVector Acceleration;
+	{
+		FScopeLock Lock(&ImuCriticalSection);
+		if (!ImuReader) return FVector::ZeroVector;
+		Acceleration = ImuReader->GetGravity();
 	}
+	if (Acceleration.IsNearlyZero()) return FVector::ZeroVector;
+
+	// Accelerometer to depth camera, row major rotation
+	const float* R = KinectCalibration.extrinsics[K4A_CALIBRATION_TYPE_ACCEL][K4A_CALIBRATION_TYPE_DEPTH].rotation;
+	const FVector Depth(
+		R[0] * Acceleration.X + R[1] * Acceleration.Y + R[2] * Acceleration.Z,
+		R[3] * Acceleration.X + R[4] * Acceleration.Y + R[5] * Acceleration.Z,
+		R[6] * Acceleration.X + R[7] * Acceleration.Y + R[8] * Acceleration.Z);
 
+	// Same axes as skeleton joints, see FAzureKinectJointConverter
+	return FVector(Depth.Z, Depth.X, -Depth.Y).GetSafeNormal();
 }
 
 void UAzureKinectDevice::UpdateSkeletons()
 {
 	
 	k4abt::frame BodyFrame = nullptr;
-	TArray<int32> BodyIDs;
+
+	// A CPU tracker takes several frame times per frame, wait for it rather than piling captures up
+	const std::chrono::milliseconds PopTimeout = GetTrackerTiming().ProcessingMode == EKinectTrackerProcessingMode::CPU ? CpuTrackerTimeout : FrameTime;
+	const double InferenceStartTime = FPlatformTime::Seconds();
 		
 	try
 	{
+		if (AppliedTrackerSmoothing != TrackerSmoothing)
+		{
+			BodyTracker.set_temporal_smoothing(FMath::Clamp(TrackerSmoothing, 0.f, 1.f));
+			AppliedTrackerSmoothing = TrackerSmoothing;
+		}
+
 		if (!BodyTracker.enqueue_capture(Capture, FrameTime))
 		{
 			UE_LOG(AzureKinectDeviceLog, Warning, TEXT("Failed adding capture to tracker process queue"));
 			return;
 		}
 			
-		if (!BodyTracker.pop_result(&BodyFrame, FrameTime))
+		if (!BodyTracker.pop_result(&BodyFrame, PopTimeout))
 		{
 			UE_LOG(AzureKinectDeviceLog, Warning, TEXT("Failed Tracker pop body frame"));
 			return;
@@ -564,6 +1645,15 @@ void UAzureKinectDevice::UpdateSkeletons()
 	{
 		FString Msg(ANSI_TO_TCHAR(Err.what()));
 		UE_LOG(AzureKinectDeviceLog, Error, TEXT("Couldn't get Body Frame: %s"), *Msg);
+		return;
+	}
+
+	{
+		const float InferenceMs = static_cast<float>((FPlatformTime::Seconds() - InferenceStartTime) * 1000.0);
+		FScopeLock Lock(&TrackerTimingCriticalSection);
+		TrackerTiming.LastInferenceMs = InferenceMs;
+		TrackerTiming.AverageInferenceMs = TrackerTiming.NumFrames > 0 ? FMath::Lerp(TrackerTiming.AverageInferenceMs, InferenceMs, 0.05f) : InferenceMs;
+		TrackerTiming.NumFrames++;
 	}
 
 	if (BodyIndexTexture)
@@ -571,70 +1661,186 @@ void UAzureKinectDevice::UpdateSkeletons()
 		CaptureBodyIndexImage(BodyFrame);
 	}
 
+	if (bGeneratePointCloud || PointCloudWriter)
 	{
-		FScopeLock Lock(Thread->GetCriticalSection());
+		BodyIndexMap = BodyFrame.get_body_index_map();
+		BodyIndexTimestampUsec = BodyFrame.get_device_timestamp().count();
+	}
+
+	// Convert outside of the lock, readers only wait for the swap in PublishSkeletons.
+	const int32 NumBodies = BodyFrame.get_num_bodies();
+	NativeSkeletons.SetNumUninitialized(NumBodies, false);
+	NativeBodyIds.SetNumUninitialized(NumBodies, false);
+	for (int32 i = 0; i < NumBodies; i++)
+	{
+		BodyFrame.get_body_skeleton(i, NativeSkeletons[i]);
+		NativeBodyIds[i] = BodyFrame.get_body_id(i);
+	}
 
-		NumTrackedSkeletons = BodyFrame.get_num_bodies();
-		Skeletons.Reset(NumTrackedSkeletons);
+	// Bodies left out are not converted at all
+	FAzureKinectJointConverter::SelectBodies(NativeSkeletons.GetData(), NativeBodyIds.GetData(), NumBodies, MaxTrackedBodies, BodySelection, SelectedBodies);
+	PendingSkeletons.SetNum(SelectedBodies.Num(), false);
 
-		for (int32 i = 0; i < NumTrackedSkeletons; i++)
-		{
-			k4abt_body_t Body;
-			FAzureKinectSkeleton Skeleton;
+	const FTransform Extrinsic = GetDepthCameraToWorld();
+	const FAzureKinectJointConverter JointConverter(Extrinsic);
+	PublishedCameraLocation = Extrinsic.GetLocation();
+
+	if (BodyGeometry.bEnabled)
+	{
+		ExtractBodyGeometry(BodyFrame, Extrinsic);
+	}
 
-			BodyFrame.get_body_skeleton(i, Body.skeleton);
-			Skeleton.ID = BodyFrame.get_body_id(i);
+	for (int32 i = 0; i < SelectedBodies.Num(); i++)
+	{
+		const int32 BodyIndex = SelectedBodies[i];
+		const k4abt_skeleton_t& NativeSkeleton = NativeSkeletons[BodyIndex];
 
-			Skeleton.Joints.Reset(K4ABT_JOINT_COUNT);
+		FAzureKinectSkeleton& Skeleton = PendingSkeletons[i];
+		Skeleton.ID = NativeBodyIds[BodyIndex];
+		Skeleton.Joints.SetNumUninitialized(K4ABT_JOINT_COUNT, false);
+		Skeleton.JointConfidences.SetNumUninitialized(K4ABT_JOINT_COUNT, false);
 
-			for (int32 j = 0; j < K4ABT_JOINT_COUNT; j++)
-			{
-				Skeleton.Joints.Push(JointToTransform(Body.skeleton.joints[j], j));
-			}
+		JointConverter.Convert(NativeSkeleton.joints, K4ABT_JOINT_COUNT, Skeleton.Joints.GetData());
+		for (int32 j = 0; j < K4ABT_JOINT_COUNT; j++)
+		{
+			Skeleton.JointConfidences[j] = static_cast<EKinectJointConfidence>(NativeSkeleton.joints[j].confidence_level);
+		}
 
-			Skeletons.Push(Skeleton);
+		// Swap so both arrays keep their contour allocations
+		if (BodyGeometry.bEnabled)
+		{
+			Swap(Skeleton.Geometry, BodyGeometries[BodyIndex]);
+		}
+		else
+		{
+			Skeleton.Geometry = FAzureKinectBodyGeometry();
 		}
 	}
-	
+
+	PublishSkeletons(BodyFrame.get_device_timestamp().count());
 		
 	BodyFrame.reset();
 	
 }
 
-FTransform UAzureKinectDevice::JointToTransform(const k4abt_joint_t& Joint, int32 Index)
-{
-
-	// This transform algorithm is introdeced from 
-	// https://github.com/secretlocation/azure-kinect-unreal/
-	// Still there is room to refactor...
-
-	/**
-	 * Convert Azure Kinect Depth and Color camera co-ordinate system
-	 * to Unreal co-ordinate system
-	 * @see https://docs.microsoft.com/en-us/azure/kinect-dk/coordinate-systems
-	 *
-	 * Kinect [mm]				Unreal [cm]
-	 * --------------------------------------
-	 * +ve X-axis		Right		+ve Y-axis
-	 * +ve Y-axis		Down		-ve Z-axis
-	 * +ve Z-axis		Forward		+ve X-axis
-	*/
-	FVector Position(Joint.position.xyz.z, Joint.position.xyz.x, - Joint.position.xyz.y);
-	Position *= 0.1f;
-
-	/**
-	 * Convert the Orientation from Kinect co-ordinate system to Unreal co-ordinate system.
-	 * We negate the x, y components of the JointQuaternion since we are converting from
-	 * Kinect's Right Hand orientation to Unreal's Left Hand orientation.
-	 */
-	FQuat Quat(
-		-Joint.orientation.wxyz.x,
-		-Joint.orientation.wxyz.y,
-		Joint.orientation.wxyz.z,
-		Joint.orientation.wxyz.w
-	);
-	
-	return FTransform(Quat, Position);
+void UAzureKinectDevice::ExtractBodyGeometry(const k4abt::frame& BodyFrame, const FTransform& Extrinsic)
+{
+	const int32 NumBodies = BodyFrame.get_num_bodies();
+	try
+	{
+		// Raw depth, the one body tracking has segmented
+		k4a::image BodyIndex = BodyFrame.get_body_index_map();
+		k4a::image Depth = Capture.get_depth_image();
+		const int32 Width = BodyIndex ? BodyIndex.get_width_pixels() : 0;
+		const int32 Height = BodyIndex ? BodyIndex.get_height_pixels() : 0;
+
+		if (Depth && Depth.get_width_pixels() == Width && Depth.get_height_pixels() == Height)
+		{
+			if (!BodyGeometryExtractor.HasXYTable(Width, Height))
+			{
+				// Unit rays of every depth pixel, only rebuilt after a calibration change
+				TArray<float> XYTable;
+				XYTable.SetNumUninitialized(Width * Height * 2);
+				for (int32 y = 0, i = 0; y < Height; y++)
+				{
+					for (int32 x = 0; x < Width; x++, i++)
+					{
+						k4a_float3_t Ray;
+						const bool bValid = KinectCalibration.convert_2d_to_3d(k4a_float2_t{ { static_cast<float>(x), static_cast<float>(y) } }, 1.f,
+							K4A_CALIBRATION_TYPE_DEPTH, K4A_CALIBRATION_TYPE_DEPTH, &Ray);
+						XYTable[i * 2] = bValid ? Ray.xyz.x : NAN;
+						XYTable[i * 2 + 1] = bValid ? Ray.xyz.y : 0.f;
+					}
+				}
+				BodyGeometryExtractor.SetXYTable(MoveTemp(XYTable), Width, Height);
+			}
+
+			BodyGeometryExtractor.Extract(BodyIndex.get_buffer(), reinterpret_cast<const uint16*>(Depth.get_buffer()), Width, Height,
+				FAzureKinectJointConverter::MakePointToWorld(Extrinsic), NumBodies, BodyGeometry, BodyGeometries);
+			return;
+		}
+	}
+	catch (const k4a::error& Err)
+	{
+		FString Msg(ANSI_TO_TCHAR(Err.what()));
+		UE_LOG(AzureKinectDeviceLog, Error, TEXT("Couldn't extract body geometry: %s"), *Msg);
+	}
+
+	// Publish empty geometry rather than the previous frame's
+	BodyGeometries.SetNum(NumBodies, false);
+	for (FAzureKinectBodyGeometry& Geometry : BodyGeometries)
+	{
+		Geometry = FAzureKinectBodyGeometry();
+	}
+}
+
+#endif
+
+void UAzureKinectDevice::PublishSkeletons(int64 TimestampUsec)
+{
+	if (SkeletonWriter)
+	{
+		SkeletonWriter->WriteFrame(TimestampUsec, PendingSkeletons);
+	}
+
+	{
+		FScopeLock Lock(Thread->GetCriticalSection());
+		// Previous skeletons come back as the next pending ones, keeping their allocations.
+		Swap(Skeletons, PendingSkeletons);
+		NumTrackedSkeletons = Skeletons.Num();
+	}
+
+	// Only this thread writes Skeletons, so it can be read here without the lock.
+	SkeletonsPublishedEvent.Broadcast(TimestampUsec, Skeletons);
+
+	if (StartupTiming.FirstSkeletonMs == 0.f)
+	{
+		StartupTiming.FirstSkeletonMs = static_cast<float>((FPlatformTime::Seconds() - StartDeviceTime) * 1000.0);
+		UE_LOG(AzureKinectDeviceLog, Log, TEXT("First skeletons after %.2f ms."), StartupTiming.FirstSkeletonMs);
+	}
+}
+
+void UAzureKinectDevice::UpdatePlayback()
+{
+	float WaitTime = 0.f;
+	{
+		FScopeLock DeviceLock(&DeviceCriticalSection);
+
+		const int32 NumFrames = SkeletonReader->GetNumFrames();
+		const int64 LastTimestamp = SkeletonReader->GetFrameTimestamp(NumFrames - 1);
+		int64 PlaybackTimestamp = PlaybackStartTimestamp + static_cast<int64>((FPlatformTime::Seconds() - PlaybackStartTime) * 1e6);
+
+		if (PlaybackTimestamp > LastTimestamp && bLoopPlayback)
+		{
+			PlaybackStartTimestamp = SkeletonReader->GetFrameTimestamp(0);
+			PlaybackStartTime = FPlatformTime::Seconds();
+			PlaybackTimestamp = PlaybackStartTimestamp;
+		}
+
+		const int32 Frame = SkeletonReader->FindFrame(PlaybackTimestamp);
+		if (Frame != PlaybackFrame)
+		{
+			int64 FrameTimestamp = 0;
+			if (SkeletonReader->ReadFrame(Frame, FrameTimestamp, PendingSkeletons))
+			{
+				PublishedCameraLocation = GetCameraToWorld().GetLocation();
+				PublishSkeletons(FrameTimestamp);
+			}
+			PlaybackFrame = Frame;
+		}
+
+		// Sleep until the next frame is due
+		if (Frame + 1 < NumFrames)
+		{
+			WaitTime = (SkeletonReader->GetFrameTimestamp(Frame + 1) - PlaybackTimestamp) / 1e6f;
+		}
+		else
+		{
+			WaitTime = FrameTime.count() / 1000.f;
+		}
+	}
+
+	FPlatformProcess::Sleep(FMath::Clamp(WaitTime, 0.f, 0.1f));
 }
 
 void UAzureKinectDevice::CalcFrameCount()
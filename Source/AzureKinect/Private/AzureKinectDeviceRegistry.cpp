@@ -0,0 +1,181 @@
+#include "AzureKinectDeviceRegistry.h"
+#include "AzureKinectSdk.h"
+
+DEFINE_LOG_CATEGORY(AzureKinectRegistryLog);
+
+namespace
+{
+	/** Interval to poll the number of installed devices for hotplug [sec]. */
+	constexpr float HotplugPollInterval = 2.f;
+
+#if WITH_AZUREKINECT_SDK
+	FString VersionToString(const k4a_version_t& Version)
+	{
+		return FString::Printf(TEXT("%u.%u.%u"), Version.major, Version.minor, Version.iteration);
+	}
+#endif
+
+	/** Built without the SDK, no device can be found. */
+	uint32 GetInstalledCount()
+	{
+#if WITH_AZUREKINECT_SDK
+		return k4a_device_get_installed_count();
+#else
+		return 0;
+#endif
+	}
+}
+
+FAzureKinectDeviceRegistry& FAzureKinectDeviceRegistry::Get()
+{
+	static FAzureKinectDeviceRegistry Registry;
+	return Registry;
+}
+
+void FAzureKinectDeviceRegistry::Startup()
+{
+	TickerHandle = FTicker::GetCoreTicker().AddTicker(
+		FTickerDelegate::CreateRaw(this, &FAzureKinectDeviceRegistry::Tick), HotplugPollInterval);
+}
+
+void FAzureKinectDeviceRegistry::Shutdown()
+{
+	if (TickerHandle.IsValid())
+	{
+		FTicker::GetCoreTicker().RemoveTicker(TickerHandle);
+		TickerHandle.Reset();
+	}
+	DevicesChangedEvent.Clear();
+}
+
+void FAzureKinectDeviceRegistry::Refresh()
+{
+	Enumerate();
+	DevicesChangedEvent.Broadcast();
+}
+
+TArray<FAzureKinectDeviceInfo> FAzureKinectDeviceRegistry::GetDevices()
+{
+	{
+		FScopeLock Lock(&CriticalSection);
+		if (bEnumerated)
+		{
+			return Devices;
+		}
+	}
+
+	Enumerate();
+
+	FScopeLock Lock(&CriticalSection);
+	return Devices;
+}
+
+int32 FAzureKinectDeviceRegistry::FindIndexBySerial(const FString& SerialNumber)
+{
+	auto Find = [this, &SerialNumber]()
+	{
+		FScopeLock Lock(&CriticalSection);
+		const FAzureKinectDeviceInfo* Info = Devices.FindByPredicate([&SerialNumber](const FAzureKinectDeviceInfo& Device) {
+			return Device.SerialNumber == SerialNumber;
+		});
+		return Info ? Info->Index : INDEX_NONE;
+	};
+
+	GetDevices();
+	int32 Index = Find();
+	if (Index == INDEX_NONE)
+	{
+		// Device may have been plugged after the last enumeration.
+		Refresh();
+		Index = Find();
+	}
+	return Index;
+}
+
+void FAzureKinectDeviceRegistry::NotifyDeviceOpened(int32 Index)
+{
+	FScopeLock Lock(&CriticalSection);
+	OpenIndices.Add(Index);
+}
+
+void FAzureKinectDeviceRegistry::NotifyDeviceClosed(int32 Index)
+{
+	FScopeLock Lock(&CriticalSection);
+	OpenIndices.Remove(Index);
+}
+
+bool FAzureKinectDeviceRegistry::Tick(float DeltaTime)
+{
+	bool bChanged = false;
+	{
+		FScopeLock Lock(&CriticalSection);
+		// Nothing to compare with until someone asks for the devices.
+		bChanged = bEnumerated && GetInstalledCount() != LastInstalledCount;
+	}
+
+	if (bChanged)
+	{
+		UE_LOG(AzureKinectRegistryLog, Log, TEXT("Number of connected devices changed, enumerating again."));
+		Refresh();
+	}
+
+	// Keep ticking
+	return true;
+}
+
+void FAzureKinectDeviceRegistry::Enumerate()
+{
+	FScopeLock Lock(&CriticalSection);
+
+	const uint32 NumKinect = GetInstalledCount();
+
+	TArray<FAzureKinectDeviceInfo> NewDevices;
+	NewDevices.Reserve(NumKinect);
+
+	for (uint32 i = 0; i < NumKinect; i++)
+	{
+		const int32 Index = static_cast<int32>(i);
+
+		if (OpenIndices.Contains(Index))
+		{
+			// Opening a streaming device fails, keep what we know about it.
+			const FAzureKinectDeviceInfo* Cached = Devices.FindByPredicate([Index](const FAzureKinectDeviceInfo& Device) {
+				return Device.Index == Index;
+			});
+			if (Cached)
+			{
+				FAzureKinectDeviceInfo& Info = NewDevices.Add_GetRef(*Cached);
+				Info.bInUse = true;
+			}
+			continue;
+		}
+
+#if WITH_AZUREKINECT_SDK
+		try
+		{
+			// Open connection to the device.
+			k4a::device Device = k4a::device::open(i);
+
+			FAzureKinectDeviceInfo& Info = NewDevices.AddDefaulted_GetRef();
+			Info.Index = Index;
+			// Get and store the device serial number and capabilities
+			Info.SerialNumber = ANSI_TO_TCHAR(Device.get_serialnum().c_str());
+
+			const k4a_hardware_version_t Version = Device.get_version();
+			Info.ColorFirmware = VersionToString(Version.rgb);
+			Info.DepthFirmware = VersionToString(Version.depth);
+			Info.AudioFirmware = VersionToString(Version.audio);
+
+			Device.close();
+		}
+		catch (const k4a::error& Err)
+		{
+			UE_LOG(AzureKinectRegistryLog, Error, TEXT("Can't load: %s"), ANSI_TO_TCHAR(Err.what()));
+		}
+#endif
+	}
+
+	Devices = MoveTemp(NewDevices);
+	LastInstalledCount = NumKinect;
+	bEnumerated = true;
+}
@@ -0,0 +1,245 @@
+#include "AzureKinectFloorDetector.h"
+#include "Async/ParallelFor.h"
+
+namespace
+{
+	constexpr int32 PointsPerTask = 4096;
+
+	/** A floor should cover at least this ratio of the sampled points. */
+	constexpr float MinInlierRatio = 0.1f;
+
+	/** Keep refining the previous plane while it keeps this ratio of its inliers. */
+	constexpr float KeepInlierRatio = 0.8f;
+}
+
+bool FAzureKinectFloorDetector::Update(const FAzureKinectPointCloud& PointCloud, const FVector& Up, const FAzureKinectFloorSettings& Settings)
+{
+	// Downsample and convert to Unreal co-ordinate system, same as skeleton joints
+	const int32 Stride = FMath::Max(Settings.SampleStride, 1);
+	Points.Reset();
+	for (int32 y = 0; y < PointCloud.Height; y += Stride)
+	{
+		for (int32 x = 0; x < PointCloud.Width; x += Stride)
+		{
+			const int16* P = &PointCloud.Positions[(y * PointCloud.Width + x) * 3];
+			if (P[2] == 0) continue;
+			Points.Emplace(P[2] * 0.1f, P[0] * 0.1f, -P[1] * 0.1f);
+		}
+	}
+
+	if (Points.Num() < 3)
+	{
+		return IsDetected();
+	}
+
+	FPlane Candidate;
+	float InlierRatio = 0.f;
+	{
+		FScopeLock Lock(&CriticalSection);
+		Candidate = Plane;
+	}
+
+	// Cheap path after convergence
+	if (IsDetected())
+	{
+		InlierRatio = static_cast<float>(CountInliers(Candidate, Settings.InlierThreshold)) / Points.Num();
+	}
+
+	if (!IsDetected() || InlierRatio < MinInlierRatio || InlierRatio < LastInlierRatio * KeepInlierRatio)
+	{
+		if (!Ransac(Up, Settings, Candidate))
+		{
+			return IsDetected();
+		}
+	}
+
+	Candidate = Refine(Candidate, Settings.InlierThreshold);
+	LastInlierRatio = static_cast<float>(CountInliers(Candidate, Settings.InlierThreshold)) / Points.Num();
+
+	// Floor space: Z along the normal, X along camera forward, origin right under the camera
+	const FVector Normal(Candidate.X, Candidate.Y, Candidate.Z);
+	FVector Forward = FVector::ForwardVector - (FVector::ForwardVector | Normal) * Normal;
+	if (!Forward.Normalize())
+	{
+		Forward = FVector::RightVector - (FVector::RightVector | Normal) * Normal;
+		Forward.Normalize();
+	}
+	const FTransform FloorToCamera(FRotationMatrix::MakeFromXZ(Forward, Normal).ToQuat(), Normal * Candidate.W);
+
+	FScopeLock Lock(&CriticalSection);
+	Plane = Candidate;
+	CameraToFloor = FloorToCamera.Inverse();
+	bDetected = true;
+	return true;
+}
+
+void FAzureKinectFloorDetector::Reset()
+{
+	FScopeLock Lock(&CriticalSection);
+	bDetected = false;
+	Plane = FPlane(0.f, 0.f, 1.f, 0.f);
+	CameraToFloor = FTransform::Identity;
+	LastInlierRatio = 0.f;
+}
+
+bool FAzureKinectFloorDetector::IsDetected() const
+{
+	FScopeLock Lock(&CriticalSection);
+	return bDetected;
+}
+
+FPlane FAzureKinectFloorDetector::GetPlane() const
+{
+	FScopeLock Lock(&CriticalSection);
+	return Plane;
+}
+
+FTransform FAzureKinectFloorDetector::GetCameraToFloor() const
+{
+	FScopeLock Lock(&CriticalSection);
+	return CameraToFloor;
+}
+
+int32 FAzureKinectFloorDetector::CountInliers(const FPlane& Candidate, float Threshold) const
+{
+	const int32 NumChunks = FMath::DivideAndRoundUp(Points.Num(), PointsPerTask);
+	TArray<int32, TInlineAllocator<64>> Counts;
+	Counts.SetNumZeroed(NumChunks);
+
+	ParallelFor(NumChunks, [&](int32 Chunk)
+	{
+		const int32 End = FMath::Min((Chunk + 1) * PointsPerTask, Points.Num());
+		int32 Count = 0;
+		for (int32 i = Chunk * PointsPerTask; i < End; i++)
+		{
+			Count += FMath::Abs(Candidate.PlaneDot(Points[i])) < Threshold ? 1 : 0;
+		}
+		Counts[Chunk] = Count;
+	});
+
+	int32 Total = 0;
+	for (int32 Count : Counts)
+	{
+		Total += Count;
+	}
+	return Total;
+}
+
+bool FAzureKinectFloorDetector::Ransac(const FVector& Up, const FAzureKinectFloorSettings& Settings, FPlane& OutPlane)
+{
+	// Without IMU, assume the camera is roughly level
+	const FVector Prior = Up.IsNearlyZero() ? FVector::UpVector : Up.GetSafeNormal();
+	const float MinCosTilt = FMath::Cos(FMath::DegreesToRadians(Settings.MaxTilt));
+
+	struct FHypothesis
+	{
+		FPlane Plane;
+		int32 NumInliers = -1;
+	};
+	TArray<FHypothesis> Hypotheses;
+	Hypotheses.SetNum(Settings.Iterations);
+
+	// Sample on this thread so the random sequence doesn't depend on scheduling
+	for (FHypothesis& Hypothesis : Hypotheses)
+	{
+		const FVector& A = Points[Random.RandHelper(Points.Num())];
+		const FVector& B = Points[Random.RandHelper(Points.Num())];
+		const FVector& C = Points[Random.RandHelper(Points.Num())];
+
+		FVector Normal = (B - A) ^ (C - A);
+		if (!Normal.Normalize())
+		{
+			continue;
+		}
+		if ((Normal | Prior) < 0.f)
+		{
+			Normal = -Normal;
+		}
+
+		const float W = Normal | A;
+		// Reject walls, and planes above the camera
+		if ((Normal | Prior) < MinCosTilt || W >= 0.f)
+		{
+			continue;
+		}
+		Hypothesis.Plane = FPlane(Normal, W);
+		Hypothesis.NumInliers = 0;
+	}
+
+	const float Threshold = Settings.InlierThreshold;
+	ParallelFor(Hypotheses.Num(), [&](int32 Index)
+	{
+		FHypothesis& Hypothesis = Hypotheses[Index];
+		if (Hypothesis.NumInliers < 0) return;
+
+		int32 Count = 0;
+		for (const FVector& Point : Points)
+		{
+			Count += FMath::Abs(Hypothesis.Plane.PlaneDot(Point)) < Threshold ? 1 : 0;
+		}
+		Hypothesis.NumInliers = Count;
+	});
+
+	const FHypothesis* Best = nullptr;
+	for (const FHypothesis& Hypothesis : Hypotheses)
+	{
+		if (!Best || Hypothesis.NumInliers > Best->NumInliers)
+		{
+			Best = &Hypothesis;
+		}
+	}
+
+	if (!Best || Best->NumInliers < Points.Num() * MinInlierRatio)
+	{
+		return false;
+	}
+
+	OutPlane = Best->Plane;
+	return true;
+}
+
+FPlane FAzureKinectFloorDetector::Refine(const FPlane& Candidate, float Threshold) const
+{
+	// Least squares height field in the frame of the candidate plane, w = a * u + b * v
+	const FVector Normal(Candidate.X, Candidate.Y, Candidate.Z);
+	FVector T1, T2;
+	Normal.FindBestAxisVectors(T1, T2);
+
+	FVector Centroid = FVector::ZeroVector;
+	int32 NumInliers = 0;
+	for (const FVector& Point : Points)
+	{
+		if (FMath::Abs(Candidate.PlaneDot(Point)) < Threshold)
+		{
+			Centroid += Point;
+			NumInliers++;
+		}
+	}
+	if (NumInliers < 3)
+	{
+		return Candidate;
+	}
+	Centroid /= NumInliers;
+
+	double Suu = 0, Svv = 0, Suv = 0, Suw = 0, Svw = 0;
+	for (const FVector& Point : Points)
+	{
+		if (FMath::Abs(Candidate.PlaneDot(Point)) >= Threshold) continue;
+
+		const FVector D = Point - Centroid;
+		const double U = D | T1, V = D | T2, W = D | Normal;
+		Suu += U * U; Svv += V * V; Suv += U * V;
+		Suw += U * W; Svw += V * W;
+	}
+
+	const double Det = Suu * Svv - Suv * Suv;
+	if (FMath::Abs(Det) < SMALL_NUMBER)
+	{
+		return Candidate;
+	}
+	const double A = (Suw * Svv - Svw * Suv) / Det;
+	const double B = (Svw * Suu - Suw * Suv) / Det;
+
+	const FVector Refined = (Normal - static_cast<float>(A) * T1 - static_cast<float>(B) * T2).GetSafeNormal();
+	return FPlane(Refined, Refined | Centroid);
+}
@@ -0,0 +1,264 @@
+#include "AzureKinectFusionSubsystem.h"
+#include "Async/Async.h"
+
+void UAzureKinectFusionSubsystem::Deinitialize()
+{
+	if (PointCloudTask.IsValid())
+	{
+		PointCloudTask.Wait();
+	}
+	RemoveAllDevices();
+	Super::Deinitialize();
+}
+
+bool UAzureKinectFusionSubsystem::AddDevice(UAzureKinectDevice* Device)
+{
+	if (!Device)
+	{
+		UE_LOG(AzureKinectFusionLog, Warning, TEXT("No device is given."));
+		return false;
+	}
+
+	const TWeakObjectPtr<UAzureKinectDevice> WeakDevice(Device);
+	{
+		FScopeLock Lock(&FusionCriticalSection);
+		if (Sources.ContainsByPredicate([&WeakDevice](const FSource& Source) { return Source.Device == WeakDevice; }))
+		{
+			UE_LOG(AzureKinectFusionLog, Warning, TEXT("%s is already fused."), *Device->GetName());
+			return false;
+		}
+
+		FSource& Source = Sources.AddDefaulted_GetRef();
+		Source.Device = WeakDevice;
+		Views.AddDefaulted();
+	}
+
+	// Registering waits for the device lock, which is held while the device publishes into this subsystem.
+	const FDelegateHandle Handle = Device->AddSkeletonsPublishedListener(
+		FOnAzureKinectSkeletonsPublished::FDelegate::CreateUObject(this, &UAzureKinectFusionSubsystem::OnSkeletonsPublished, WeakDevice));
+
+	FScopeLock Lock(&FusionCriticalSection);
+	for (FSource& Source : Sources)
+	{
+		if (Source.Device == WeakDevice)
+		{
+			Source.PublishedHandle = Handle;
+		}
+	}
+	return true;
+}
+
+void UAzureKinectFusionSubsystem::RemoveDevice(UAzureKinectDevice* Device)
+{
+	RemoveSource(TWeakObjectPtr<UAzureKinectDevice>(Device));
+}
+
+void UAzureKinectFusionSubsystem::RemoveSource(const TWeakObjectPtr<UAzureKinectDevice>& Device)
+{
+	FDelegateHandle Handle;
+	{
+		FScopeLock Lock(&FusionCriticalSection);
+		const int32 Index = Sources.IndexOfByPredicate([&Device](const FSource& Source) { return Source.Device == Device; });
+		if (Index == INDEX_NONE) return;
+		Handle = Sources[Index].PublishedHandle;
+	}
+
+	// Not under the fusion lock, see AddDevice. Waits for a publication in progress.
+	if (UAzureKinectDevice* AliveDevice = Device.Get())
+	{
+		AliveDevice->RemoveSkeletonsPublishedListener(Handle);
+	}
+
+	FScopeLock Lock(&FusionCriticalSection);
+	const int32 Index = Sources.IndexOfByPredicate([&Device](const FSource& Source) { return Source.Device == Device; });
+	if (Index != INDEX_NONE)
+	{
+		Sources.RemoveAt(Index);
+		Views.RemoveAt(Index);
+	}
+	if (Sources.Num() == 0)
+	{
+		Fusion.Reset();
+	}
+}
+
+void UAzureKinectFusionSubsystem::RemoveAllDevices()
+{
+	TArray<TWeakObjectPtr<UAzureKinectDevice>> Devices;
+	{
+		FScopeLock Lock(&FusionCriticalSection);
+		for (const FSource& Source : Sources)
+		{
+			Devices.Add(Source.Device);
+		}
+	}
+
+	// Destroyed devices too, they can't be passed to RemoveDevice anymore
+	for (const TWeakObjectPtr<UAzureKinectDevice>& Device : Devices)
+	{
+		RemoveSource(Device);
+	}
+}
+
+int32 UAzureKinectFusionSubsystem::GetNumDevices() const
+{
+	FScopeLock Lock(&FusionCriticalSection);
+	return Sources.Num();
+}
+
+TArray<FAzureKinectSkeleton> UAzureKinectFusionSubsystem::GetFusedSkeletons() const
+{
+	FScopeLock Lock(&FusedCriticalSection);
+	return FusedSkeletons;
+}
+
+int32 UAzureKinectFusionSubsystem::GetNumFusedSkeletons() const
+{
+	FScopeLock Lock(&FusedCriticalSection);
+	return FusedSkeletons.Num();
+}
+
+FDelegateHandle UAzureKinectFusionSubsystem::AddFusedSkeletonsListener(FOnAzureKinectSkeletonsPublished::FDelegate&& Delegate)
+{
+	FScopeLock Lock(&FusionCriticalSection);
+	return FusedEvent.Add(MoveTemp(Delegate));
+}
+
+void UAzureKinectFusionSubsystem::RemoveFusedSkeletonsListener(FDelegateHandle Handle)
+{
+	FScopeLock Lock(&FusionCriticalSection);
+	FusedEvent.Remove(Handle);
+}
+
+void UAzureKinectFusionSubsystem::OnSkeletonsPublished(int64 TimestampUsec, const TArray<FAzureKinectSkeleton>& Skeletons, TWeakObjectPtr<UAzureKinectDevice> WeakDevice)
+{
+	FScopeLock Lock(&FusionCriticalSection);
+
+	const int32 Index = Sources.IndexOfByPredicate([&WeakDevice](const FSource& Source) { return Source.Device == WeakDevice; });
+	if (Index == INDEX_NONE) return;
+
+	// Publishing, so alive
+	UAzureKinectDevice* Device = WeakDevice.Get();
+	if (!Device) return;
+
+	// This device is a frame ahead of a device which hasn't delivered, don't wait for it anymore
+	if (Sources[Index].bFresh)
+	{
+		FuseSources(TimestampUsec);
+	}
+
+	FSource& Source = Sources[Index];
+	Source.ReceivedTime = FPlatformTime::Seconds();
+	Source.bFresh = true;
+	FAzureKinectSkeletonView& View = Views[Index];
+	View.CameraLocation = Device->GetPublishedCameraLocation();
+	// Per element, so joint arrays of the previous frame are reused
+	View.Skeletons.SetNum(Skeletons.Num(), false);
+	for (int32 i = 0; i < Skeletons.Num(); i++)
+	{
+		View.Skeletons[i] = Skeletons[i];
+	}
+
+	if (!Sources.ContainsByPredicate([](const FSource& Other) { return !Other.bFresh; }))
+	{
+		FuseSources(TimestampUsec);
+	}
+}
+
+void UAzureKinectFusionSubsystem::FuseSources(int64 TimestampUsec)
+{
+	const double Now = FPlatformTime::Seconds();
+	for (int32 i = 0; i < Sources.Num(); i++)
+	{
+		if (Now - Sources[i].ReceivedTime > Settings.MaxFrameAge)
+		{
+			Views[i].Skeletons.Reset();
+		}
+		Sources[i].bFresh = false;
+	}
+
+	Fusion.Fuse(Views, Settings, PendingSkeletons);
+
+	{
+		FScopeLock Lock(&FusedCriticalSection);
+		Swap(FusedSkeletons, PendingSkeletons);
+	}
+
+	// Only fusion writes FusedSkeletons, and it's serialized by the fusion lock.
+	FusedEvent.Broadcast(TimestampUsec, FusedSkeletons);
+}
+
+FAzureKinectFusedPointCloudPtr UAzureKinectFusionSubsystem::GetFusedPointCloud() const
+{
+	FScopeLock Lock(&PointCloudCriticalSection);
+	return FrontPointCloud;
+}
+
+FAzureKinectVoxelGridStats UAzureKinectFusionSubsystem::GetPointCloudFusionStats() const
+{
+	FScopeLock Lock(&PointCloudCriticalSection);
+	return PointCloudStats;
+}
+
+void UAzureKinectFusionSubsystem::Tick(float DeltaTime)
+{
+	UpdatePointCloudFusion();
+}
+
+bool UAzureKinectFusionSubsystem::IsTickable() const
+{
+	return PointCloudFusion.bEnabled && !HasAnyFlags(RF_ClassDefaultObject);
+}
+
+TStatId UAzureKinectFusionSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UAzureKinectFusionSubsystem, STATGROUP_Tickables);
+}
+
+void UAzureKinectFusionSubsystem::UpdatePointCloudFusion()
+{
+	if (PointCloudTask.IsValid() && !PointCloudTask.IsReady()) return;
+
+	TArray<TWeakObjectPtr<UAzureKinectDevice>, TInlineAllocator<8>> Devices;
+	{
+		FScopeLock Lock(&FusionCriticalSection);
+		for (const FSource& Source : Sources)
+		{
+			Devices.Add(Source.Device);
+		}
+	}
+
+	TArray<FAzureKinectVoxelGridSource> GridSources;
+	TArray<FAzureKinectPointCloudPtr> PointClouds;
+	bool bNewFrame = false;
+	for (const TWeakObjectPtr<UAzureKinectDevice>& WeakDevice : Devices)
+	{
+		UAzureKinectDevice* Device = WeakDevice.Get();
+		FAzureKinectPointCloudPtr PointCloud = Device ? Device->GetLatestPointCloud() : nullptr;
+		if (!PointCloud) continue;
+
+		bNewFrame |= !LastPointClouds.Contains(PointCloud);
+		PointClouds.Add(PointCloud);
+		GridSources.Add({ PointCloud, Device->GetDepthCameraToWorld() });
+	}
+
+	if (!bNewFrame) return;
+	LastPointClouds = MoveTemp(PointClouds);
+
+	// Reuse the back buffer unless a reader still holds it from when it was in front
+	if (!BackPointCloud || !BackPointCloud.IsUnique())
+	{
+		BackPointCloud = MakeShared<FAzureKinectFusedPointCloud, ESPMode::ThreadSafe>();
+	}
+
+	const FAzureKinectVoxelGridSettings GridSettings = PointCloudFusion;
+	PointCloudTask = Async(EAsyncExecution::ThreadPool, [this, GridSources = MoveTemp(GridSources), GridSettings]()
+	{
+		FAzureKinectVoxelGridStats Stats;
+		VoxelGrid.Build(GridSources, GridSettings, *BackPointCloud, Stats);
+
+		FScopeLock Lock(&PointCloudCriticalSection);
+		Swap(FrontPointCloud, BackPointCloud);
+		PointCloudStats = Stats;
+	});
+}
@@ -0,0 +1,169 @@
+#include "AzureKinectImuReader.h"
+#include "HAL/PlatformProcess.h"
+
+DEFINE_LOG_CATEGORY(AzureKinectImuLog);
+
+#if WITH_AZUREKINECT_SDK
+
+namespace
+{
+	/** Per sample weight of the gravity low-pass, a time constant of about 0.1 sec at 1.6 kHz. */
+	constexpr float GravityAlpha = 0.005f;
+}
+
+FAzureKinectImuReader::FAzureKinectImuReader(k4a::device& InDevice, uint32 Capacity) :
+	Device(InDevice),
+	// One slot of TCircularQueue is always kept empty.
+	Ring(Capacity + 1),
+	Thread(nullptr),
+	StopTaskCounter(0),
+	bImuStarted(false),
+	FilteredAcceleration(FVector::ZeroVector),
+	Gravity(FVector::ZeroVector)
+{
+}
+
+FAzureKinectImuReader::~FAzureKinectImuReader()
+{
+	EnsureCompletion();
+}
+
+bool FAzureKinectImuReader::Start()
+{
+	try
+	{
+		Device.start_imu();
+		bImuStarted = true;
+	}
+	catch (const k4a::error& Err)
+	{
+		FString Msg(ANSI_TO_TCHAR(Err.what()));
+		UE_LOG(AzureKinectImuLog, Error, TEXT("Can't start IMU: %s"), *Msg);
+		return false;
+	}
+
+	Thread = FRunnableThread::Create(this, TEXT("FAzureKinectImuReader"), 0, TPri_AboveNormal);
+	if (!Thread)
+	{
+		UE_LOG(AzureKinectImuLog, Error, TEXT("Failed to create IMU thread."));
+		EnsureCompletion();
+		return false;
+	}
+
+	return true;
+}
+
+void FAzureKinectImuReader::EnsureCompletion()
+{
+	Stop();
+	if (Thread)
+	{
+		Thread->WaitForCompletion();
+		delete Thread;
+		Thread = nullptr;
+	}
+
+	if (bImuStarted)
+	{
+		Device.stop_imu();
+		bImuStarted = false;
+	}
+
+	if (Overruns.GetValue() > 0)
+	{
+		UE_LOG(AzureKinectImuLog, Warning, TEXT("%d IMU samples were dropped, read them more often."), Overruns.GetValue());
+	}
+}
+
+void FAzureKinectImuReader::Stop()
+{
+	StopTaskCounter.Increment();
+}
+
+uint32 FAzureKinectImuReader::Run()
+{
+	// Short timeout so a stop request is picked up quickly
+	const std::chrono::milliseconds Timeout(10);
+
+	while (StopTaskCounter.GetValue() == 0)
+	{
+		k4a_imu_sample_t NativeSample;
+		try
+		{
+			if (!Device.get_imu_sample(&NativeSample, Timeout))
+			{
+				continue;
+			}
+		}
+		catch (const k4a::error& Err)
+		{
+			FString Msg(ANSI_TO_TCHAR(Err.what()));
+			UE_LOG(AzureKinectImuLog, Error, TEXT("Can't read IMU sample: %s"), *Msg);
+			FPlatformProcess::Sleep(0.01f);
+			continue;
+		}
+
+		FAzureKinectImuSample Sample;
+		Sample.TimestampUsec = static_cast<int64>(NativeSample.acc_timestamp_usec);
+		Sample.GyroTimestampUsec = static_cast<int64>(NativeSample.gyro_timestamp_usec);
+		Sample.Acceleration = FVector(NativeSample.acc_sample.xyz.x, NativeSample.acc_sample.xyz.y, NativeSample.acc_sample.xyz.z);
+		Sample.AngularVelocity = FVector(NativeSample.gyro_sample.xyz.x, NativeSample.gyro_sample.xyz.y, NativeSample.gyro_sample.xyz.z);
+		Sample.Temperature = NativeSample.temperature;
+
+		if (!Ring.Enqueue(Sample))
+		{
+			Overruns.Increment();
+		}
+
+		FilteredAcceleration = FilteredAcceleration.IsZero()
+			? Sample.Acceleration
+			: FMath::Lerp(FilteredAcceleration, Sample.Acceleration, GravityAlpha);
+
+		// A busy reader only delays the update to the next sample
+		if (GravityCriticalSection.TryLock())
+		{
+			Gravity = FilteredAcceleration;
+			GravityCriticalSection.Unlock();
+		}
+	}
+
+	return 0;
+}
+
+FVector FAzureKinectImuReader::GetGravity() const
+{
+	FScopeLock Lock(&GravityCriticalSection);
+	return Gravity;
+}
+
+int32 FAzureKinectImuReader::Read(TArray<FAzureKinectImuSample>& OutSamples, int32 MaxSamples)
+{
+	FScopeLock Lock(&ReadCriticalSection);
+
+	int32 NumRead = 0;
+	FAzureKinectImuSample Sample;
+	while ((MaxSamples <= 0 || NumRead < MaxSamples) && Ring.Dequeue(Sample))
+	{
+		OutSamples.Add(Sample);
+		NumRead++;
+	}
+	return NumRead;
+}
+
+int32 FAzureKinectImuReader::ReadUntil(int64 TimestampUsec, TArray<FAzureKinectImuSample>& OutSamples)
+{
+	FScopeLock Lock(&ReadCriticalSection);
+
+	int32 NumRead = 0;
+	const FAzureKinectImuSample* Next = Ring.Peek();
+	while (Next && Next->TimestampUsec <= TimestampUsec)
+	{
+		OutSamples.Add(*Next);
+		Ring.Dequeue();
+		NumRead++;
+		Next = Ring.Peek();
+	}
+	return NumRead;
+}
+
+#endif
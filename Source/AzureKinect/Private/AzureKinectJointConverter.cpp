@@ -0,0 +1,161 @@
+#include "AzureKinectJointConverter.h"
+#include "HAL/IConsoleManager.h"
+
+DEFINE_LOG_CATEGORY(AzureKinectJointConverterLog);
+
+namespace
+{
+	/**
+	 * Kinect [mm]				Unreal [cm]
+	 * --------------------------------------
+	 * +ve X-axis		Right		+ve Y-axis
+	 * +ve Y-axis		Down		-ve Z-axis
+	 * +ve Z-axis		Forward		+ve X-axis
+	 */
+	const FMatrix KinectToUnreal(
+		FPlane(0.f, 0.1f, 0.f, 0.f),
+		FPlane(0.f, 0.f, -0.1f, 0.f),
+		FPlane(0.1f, 0.f, 0.f, 0.f),
+		FPlane(0.f, 0.f, 0.f, 1.f));
+
+	/** Right handed wxyz to left handed xyzw, x and y negated. */
+	FORCEINLINE VectorRegister LoadOrientation(const k4abt_joint_t& Joint)
+	{
+		static const VectorRegister Handedness = MakeVectorRegister(-1.f, -1.f, 1.f, 1.f);
+		const VectorRegister Wxyz = VectorLoad(Joint.orientation.v);
+		return VectorMultiply(VectorSwizzle(Wxyz, 1, 2, 3, 0), Handedness);
+	}
+
+	void BenchmarkJointConversion(const TArray<FString>& Args)
+	{
+		const int32 NumFrames = Args.Num() > 0 ? FMath::Max(FCString::Atoi(*Args[0]), 1) : 10000;
+		const int32 MaxBodies = Args.Num() > 1 ? FCString::Atoi(*Args[1]) : 2;
+
+		for (const int32 NumBodies : { 1, 6 })
+		{
+			const float AllUs = FAzureKinectJointConverter::Benchmark(NumBodies, 0, NumFrames);
+			const float LimitedUs = FAzureKinectJointConverter::Benchmark(NumBodies, MaxBodies, NumFrames);
+			UE_LOG(AzureKinectJointConverterLog, Display, TEXT("%d bodies: %.2f us per frame, %.2f us with MaxTrackedBodies %d"),
+				NumBodies, AllUs, LimitedUs, MaxBodies);
+		}
+	}
+
+	FAutoConsoleCommand BenchmarkJointConversionCommand(
+		TEXT("AzureKinect.BenchmarkJointConversion"),
+		TEXT("Log the cost of body selection and joint conversion with 1 and 6 bodies in view. Takes the number of frames and MaxTrackedBodies."),
+		FConsoleCommandWithArgsDelegate::CreateStatic(&BenchmarkJointConversion));
+}
+
+FAzureKinectJointConverter::FAzureKinectJointConverter(const FTransform& CameraToWorld) :
+	Scale(CameraToWorld.GetScale3D())
+{
+	const FQuat WorldRotation = CameraToWorld.GetRotation();
+	Rotation = VectorLoadAligned(&WorldRotation);
+
+	const FMatrix Combined = MakePointToWorld(CameraToWorld);
+	for (int32 i = 0; i < 4; i++)
+	{
+		Rows[i] = VectorLoad(Combined.M[i]);
+	}
+}
+
+void FAzureKinectJointConverter::Convert(const k4abt_joint_t* Joints, int32 NumJoints, FTransform* OutJoints) const
+{
+	for (int32 i = 0; i < NumJoints; i++)
+	{
+		const float* P = Joints[i].position.v;
+
+		VectorRegister Position = VectorMultiplyAdd(VectorLoadFloat1(&P[0]), Rows[0], Rows[3]);
+		Position = VectorMultiplyAdd(VectorLoadFloat1(&P[1]), Rows[1], Position);
+		Position = VectorMultiplyAdd(VectorLoadFloat1(&P[2]), Rows[2], Position);
+
+		const VectorRegister Quat = VectorQuaternionMultiply2(Rotation, LoadOrientation(Joints[i]));
+
+		FVector OutPosition;
+		FQuat OutRotation;
+		VectorStoreFloat3(Position, &OutPosition);
+		VectorStoreAligned(Quat, &OutRotation);
+		OutJoints[i] = FTransform(OutRotation, OutPosition, Scale);
+	}
+}
+
+FMatrix FAzureKinectJointConverter::MakePointToWorld(const FTransform& CameraToWorld)
+{
+	return KinectToUnreal * CameraToWorld.ToMatrixWithScale();
+}
+
+void FAzureKinectJointConverter::SelectBodies(const k4abt_skeleton_t* Skeletons, const uint32* IDs, int32 NumBodies, int32 MaxBodies, EKinectBodySelection Selection, TArray<int32>& OutIndices)
+{
+	OutIndices.SetNumUninitialized(NumBodies, false);
+	for (int32 i = 0; i < NumBodies; i++)
+	{
+		OutIndices[i] = i;
+	}
+	if (MaxBodies <= 0 || NumBodies <= MaxBodies)
+	{
+		return;
+	}
+
+	// Lower is better
+	TArray<float, TInlineAllocator<8>> Keys;
+	Keys.SetNumUninitialized(NumBodies);
+	for (int32 i = 0; i < NumBodies; i++)
+	{
+		const k4a_float3_t& Pelvis = Skeletons[i].joints[K4ABT_JOINT_PELVIS].position;
+		switch (Selection)
+		{
+		case EKinectBodySelection::MOST_CENTRAL:
+			Keys[i] = (Pelvis.xyz.x * Pelvis.xyz.x + Pelvis.xyz.y * Pelvis.xyz.y) / FMath::Max(Pelvis.xyz.z * Pelvis.xyz.z, 1.f);
+			break;
+		case EKinectBodySelection::OLDEST_ID:
+			// IDs are handed out in increasing order
+			Keys[i] = static_cast<float>(IDs[i]);
+			break;
+		default:
+			Keys[i] = Pelvis.xyz.x * Pelvis.xyz.x + Pelvis.xyz.y * Pelvis.xyz.y + Pelvis.xyz.z * Pelvis.xyz.z;
+			break;
+		}
+	}
+
+	OutIndices.Sort([&Keys](int32 A, int32 B) { return Keys[A] < Keys[B]; });
+	OutIndices.SetNum(MaxBodies, false);
+	OutIndices.Sort();
+}
+
+float FAzureKinectJointConverter::Benchmark(int32 NumBodies, int32 MaxBodies, int32 NumFrames)
+{
+	FRandomStream Random(NumBodies);
+	TArray<k4abt_skeleton_t> Skeletons;
+	TArray<uint32> IDs;
+	Skeletons.SetNumUninitialized(NumBodies);
+	IDs.SetNumUninitialized(NumBodies);
+	for (int32 b = 0; b < NumBodies; b++)
+	{
+		IDs[b] = b + 1;
+		for (k4abt_joint_t& Joint : Skeletons[b].joints)
+		{
+			const FQuat Orientation(Random.GetUnitVector(), Random.FRand() * PI);
+			Joint.position = { { Random.FRandRange(-1000.f, 1000.f), Random.FRandRange(-1000.f, 1000.f), Random.FRandRange(1000.f, 5000.f) } };
+			Joint.orientation = { { Orientation.W, Orientation.X, Orientation.Y, Orientation.Z } };
+			Joint.confidence_level = K4ABT_JOINT_CONFIDENCE_MEDIUM;
+		}
+	}
+
+	const FAzureKinectJointConverter Converter(FTransform(FRotator(10.f, 20.f, 0.f), FVector(100.f, 0.f, 150.f)));
+	TArray<int32> Selected;
+	TArray<FTransform> Joints;
+	Joints.SetNumUninitialized(NumBodies * K4ABT_JOINT_COUNT);
+
+	const double StartTime = FPlatformTime::Seconds();
+	for (int32 Frame = 0; Frame < NumFrames; Frame++)
+	{
+		SelectBodies(Skeletons.GetData(), IDs.GetData(), NumBodies, MaxBodies, EKinectBodySelection::NEAREST, Selected);
+		for (int32 i = 0; i < Selected.Num(); i++)
+		{
+			Converter.Convert(Skeletons[Selected[i]].joints, K4ABT_JOINT_COUNT, &Joints[i * K4ABT_JOINT_COUNT]);
+		}
+	}
+	const double Elapsed = FPlatformTime::Seconds() - StartTime;
+
+	return static_cast<float>(Elapsed / NumFrames * 1e6);
+}
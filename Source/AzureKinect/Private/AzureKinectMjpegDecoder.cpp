@@ -0,0 +1,240 @@
+#include "AzureKinectMjpegDecoder.h"
+#include "AzureKinectColorConverter.h"
+#include "Async/Async.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/QueuedThreadPool.h"
+#include "IImageWrapper.h"
+#include "IImageWrapperModule.h"
+
+#if WITH_AZUREKINECT_SDK
+#include "k4arecord/playback.hpp"
+#endif
+
+DEFINE_LOG_CATEGORY(AzureKinectMjpegDecoderLog);
+
+namespace
+{
+	bool LoadRecordedFrames(const FString& FilePath, int32 MaxFrames, TArray<TArray64<uint8>>& OutFrames, int32& OutWidth, int32& OutHeight)
+	{
+#if WITH_AZUREKINECT_SDK
+		try
+		{
+			k4a::playback Playback = k4a::playback::open(TCHAR_TO_ANSI(*FilePath));
+			if (Playback.get_record_configuration().color_format != K4A_IMAGE_FORMAT_COLOR_MJPG)
+			{
+				UE_LOG(AzureKinectMjpegDecoderLog, Warning, TEXT("%s has no MJPG color track."), *FilePath);
+				return false;
+			}
+
+			k4a::capture Capture;
+			while (OutFrames.Num() < MaxFrames && Playback.get_next_capture(&Capture))
+			{
+				k4a::image ColorImage = Capture.get_color_image();
+				if (!ColorImage.is_valid()) continue;
+
+				OutWidth = ColorImage.get_width_pixels();
+				OutHeight = ColorImage.get_height_pixels();
+				OutFrames.Emplace(ColorImage.get_buffer(), static_cast<int64>(ColorImage.get_size()));
+			}
+		}
+		catch (const k4a::error& Err)
+		{
+			FString Msg(ANSI_TO_TCHAR(Err.what()));
+			UE_LOG(AzureKinectMjpegDecoderLog, Error, TEXT("Can't read %s: %s"), *FilePath, *Msg);
+			return false;
+		}
+
+		return OutFrames.Num() > 0;
+#else
+		UE_LOG(AzureKinectMjpegDecoderLog, Warning, TEXT("Built without the Azure Kinect SDK, can't read %s."), *FilePath);
+		return false;
+#endif
+	}
+
+	bool MakeSyntheticFrames(int32 NumFrames, TArray<TArray64<uint8>>& OutFrames, int32& OutWidth, int32& OutHeight)
+	{
+		OutWidth = 4096;
+		OutHeight = 3072;
+
+		TArray<FColor> Image;
+		Image.SetNumUninitialized(OutWidth * OutHeight);
+		for (int32 y = 0; y < OutHeight; y++)
+		{
+			for (int32 x = 0; x < OutWidth; x++)
+			{
+				Image[y * OutWidth + x] = FColor(x & 0xFF, y & 0xFF, (x * y) >> 4 & 0xFF, 0xFF);
+			}
+		}
+
+		IImageWrapperModule& ImageWrapperModule = FModuleManager::LoadModuleChecked<IImageWrapperModule>(TEXT("ImageWrapper"));
+		TSharedPtr<IImageWrapper> Encoder = ImageWrapperModule.CreateImageWrapper(EImageFormat::JPEG);
+		if (!Encoder || !Encoder->SetRaw(Image.GetData(), Image.Num() * sizeof(FColor), OutWidth, OutHeight, ERGBFormat::BGRA, 8))
+		{
+			return false;
+		}
+
+		const TArray64<uint8> Compressed = Encoder->GetCompressed(90);
+		OutFrames.Init(Compressed, NumFrames);
+		return true;
+	}
+
+	void BenchmarkMjpegDecode(const TArray<FString>& Args)
+	{
+		const int32 NumFrames = Args.Num() > 1 ? FMath::Max(FCString::Atoi(*Args[1]), 1) : 90;
+
+		TArray<TArray64<uint8>> Frames;
+		int32 Width = 0, Height = 0;
+		const bool bLoaded = Args.Num() > 0
+			? LoadRecordedFrames(Args[0], NumFrames, Frames, Width, Height)
+			: MakeSyntheticFrames(NumFrames, Frames, Width, Height);
+		if (!bLoaded)
+		{
+			return;
+		}
+
+		UE_LOG(AzureKinectMjpegDecoderLog, Display, TEXT("Decoding %d MJPG frames of %dx%d from %s."),
+			Frames.Num(), Width, Height, Args.Num() > 0 ? *Args[0] : TEXT("synthetic source"));
+
+		const int32 MaxThreads = GThreadPool ? GThreadPool->GetNumThreads() : 1;
+		for (int32 NumThreads = 1; ; NumThreads = FMath::Min(NumThreads * 2, MaxThreads))
+		{
+			const float Fps = FAzureKinectMjpegDecoder::Benchmark(Frames, Width, Height, NumThreads);
+			UE_LOG(AzureKinectMjpegDecoderLog, Display, TEXT("%d thread(s): %.1f fps"), NumThreads, Fps);
+			if (NumThreads == MaxThreads) break;
+		}
+	}
+
+	FAutoConsoleCommand BenchmarkMjpegDecodeCommand(
+		TEXT("AzureKinect.BenchmarkMjpegDecode"),
+		TEXT("Log MJPG decode throughput per number of threads. Takes a recording (*.mkv) and the number of frames, 4096x3072 synthetic frames without a recording."),
+		FConsoleCommandWithArgsDelegate::CreateStatic(&BenchmarkMjpegDecode));
+}
+
+FAzureKinectMjpegDecoder::FAzureKinectMjpegDecoder(int32 InMaxInFlight) :
+	MaxInFlight(FMath::Max(InMaxInFlight, 1))
+{
+}
+
+FAzureKinectMjpegDecoder::~FAzureKinectMjpegDecoder()
+{
+	// Tasks reference this decoder
+	Flush();
+}
+
+bool FAzureKinectMjpegDecoder::Submit(int64 TimestampUsec, const uint8* Data, int64 Size, int32 Width, int32 Height)
+{
+	FAzureKinectColorFramePtr Frame = Pending.Num() < MaxInFlight ? AcquireFrame() : nullptr;
+	if (!Frame)
+	{
+		NumDropped++;
+		UE_LOG(AzureKinectMjpegDecoderLog, Verbose, TEXT("All decoders are busy, dropping a frame."));
+		return false;
+	}
+
+	Frame->TimestampUsec = TimestampUsec;
+	Frame->Width = Width;
+	Frame->Height = Height;
+	Frame->Compressed.SetNumUninitialized(Size, false);
+	FMemory::Memcpy(Frame->Compressed.GetData(), Data, Size);
+	Frame->Pixels.SetNumUninitialized(Width * Height, false);
+
+	FPendingFrame& Entry = Pending.AddDefaulted_GetRef();
+	Entry.Frame = Frame;
+	Entry.Result = Async(EAsyncExecution::ThreadPool, [this, Frame]()
+	{
+		TUniquePtr<FAzureKinectColorConverter> Converter = AcquireConverter();
+		const bool bDecoded = Converter->DecodeMJPG(Frame->Compressed.GetData(), Frame->Compressed.Num(), Frame->Width, Frame->Height, Frame->Pixels.GetData());
+		ReleaseConverter(MoveTemp(Converter));
+		return bDecoded;
+	});
+
+	return true;
+}
+
+FAzureKinectColorFramePtr FAzureKinectMjpegDecoder::PopLatest()
+{
+	FAzureKinectColorFramePtr Latest;
+	while (Pending.Num() > 0 && Pending[0].Result.IsReady())
+	{
+		if (Pending[0].Result.Get())
+		{
+			Latest = Pending[0].Frame;
+		}
+		Pending.RemoveAt(0, 1, false);
+	}
+	return Latest;
+}
+
+void FAzureKinectMjpegDecoder::Flush()
+{
+	for (FPendingFrame& Entry : Pending)
+	{
+		Entry.Result.Wait();
+	}
+}
+
+FAzureKinectColorFramePtr FAzureKinectMjpegDecoder::AcquireFrame()
+{
+	for (const FAzureKinectColorFramePtr& Frame : Frames)
+	{
+		if (Frame.GetSharedReferenceCount() == 1)
+		{
+			return Frame;
+		}
+	}
+
+	// Frames in flight, one held by the consumer and one spare
+	if (Frames.Num() < MaxInFlight + 2)
+	{
+		return Frames.Add_GetRef(MakeShared<FAzureKinectColorFrame, ESPMode::ThreadSafe>());
+	}
+
+	return nullptr;
+}
+
+TUniquePtr<FAzureKinectColorConverter> FAzureKinectMjpegDecoder::AcquireConverter()
+{
+	FScopeLock Lock(&ConverterCriticalSection);
+	return Converters.Num() > 0 ? Converters.Pop(false) : MakeUnique<FAzureKinectColorConverter>();
+}
+
+void FAzureKinectMjpegDecoder::ReleaseConverter(TUniquePtr<FAzureKinectColorConverter>&& Converter)
+{
+	FScopeLock Lock(&ConverterCriticalSection);
+	Converters.Add(MoveTemp(Converter));
+}
+
+float FAzureKinectMjpegDecoder::Benchmark(const TArray<TArray64<uint8>>& CompressedFrames, int32 Width, int32 Height, int32 NumThreads)
+{
+	const double StartTime = FPlatformTime::Seconds();
+
+	if (NumThreads <= 1)
+	{
+		FAzureKinectColorConverter Converter;
+		TArray<FColor> Pixels;
+		Pixels.SetNumUninitialized(Width * Height);
+		for (const TArray64<uint8>& Compressed : CompressedFrames)
+		{
+			Converter.DecodeMJPG(Compressed.GetData(), Compressed.Num(), Width, Height, Pixels.GetData());
+		}
+	}
+	else
+	{
+		FAzureKinectMjpegDecoder Decoder(NumThreads);
+		int64 TimestampUsec = 0;
+		for (const TArray64<uint8>& Compressed : CompressedFrames)
+		{
+			// Wait for the oldest frame instead of dropping, as a capture thread would at full load
+			while (Decoder.Pending.Num() >= Decoder.MaxInFlight)
+			{
+				Decoder.Pending[0].Result.Wait();
+				Decoder.PopLatest();
+			}
+			Decoder.Submit(TimestampUsec++, Compressed.GetData(), Compressed.Num(), Width, Height);
+		}
+		Decoder.Flush();
+	}
+
+	const double Elapsed = FPlatformTime::Seconds() - StartTime;
+	return Elapsed > 0.0 ? static_cast<float>(CompressedFrames.Num() / Elapsed) : 0.f;
+}
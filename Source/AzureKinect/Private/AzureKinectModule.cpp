@@ -4,6 +4,8 @@
 
 #include "CoreMinimal.h"
 #include "Modules/ModuleManager.h"
+#include "AzureKinectDeviceRegistry.h"
+#include "IImageWrapperModule.h"
 
 #define LOCTEXT_NAMESPACE "FAzureKinectModule"
 
@@ -12,8 +14,18 @@ class FAzureKinectModule : public IModuleInterface
 public:
 
 	/** IModuleInterface implementation */
-	virtual void StartupModule() override {};
-	virtual void ShutdownModule() override {};
+	virtual void StartupModule() override
+	{
+		FAzureKinectDeviceRegistry::Get().Startup();
+
+		// MJPG color is decoded on the capture thread, where modules can't be loaded
+		FModuleManager::LoadModuleChecked<IImageWrapperModule>(TEXT("ImageWrapper"));
+	}
+
+	virtual void ShutdownModule() override
+	{
+		FAzureKinectDeviceRegistry::Get().Shutdown();
+	}
 };
 
 #undef LOCTEXT_NAMESPACE
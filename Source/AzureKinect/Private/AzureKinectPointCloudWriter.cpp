@@ -0,0 +1,230 @@
+#include "AzureKinectPointCloudWriter.h"
+#include "HAL/FileManager.h"
+#include "HAL/Event.h"
+
+DEFINE_LOG_CATEGORY(AzureKinectPointCloudLog);
+
+using namespace AzureKinectPointCloudFormat;
+
+FAzureKinectPointCloudWriter::FAzureKinectPointCloudWriter(const FString& InFilePath, bool bInQuantize, uint32 QueueCapacity) :
+	FilePath(InFilePath),
+	bQuantize(bInQuantize),
+	bHeaderWritten(false),
+	bHeaderHasColor(false),
+	HeaderSize(FIntPoint::ZeroValue),
+	// One slot of TCircularQueue is always kept empty.
+	Queue(QueueCapacity + 1),
+	WorkEvent(nullptr),
+	Thread(nullptr),
+	StopTaskCounter(0)
+{
+}
+
+FAzureKinectPointCloudWriter::~FAzureKinectPointCloudWriter()
+{
+	EnsureCompletion();
+
+	if (Thread)
+	{
+		delete Thread;
+		Thread = nullptr;
+	}
+
+	if (WorkEvent)
+	{
+		FPlatformProcess::ReturnSynchEventToPool(WorkEvent);
+		WorkEvent = nullptr;
+	}
+}
+
+bool FAzureKinectPointCloudWriter::Start()
+{
+	Writer.Reset(IFileManager::Get().CreateFileWriter(*FilePath));
+	if (!Writer)
+	{
+		UE_LOG(AzureKinectPointCloudLog, Error, TEXT("Can't open %s for writing."), *FilePath);
+		return false;
+	}
+
+	WorkEvent = FPlatformProcess::GetSynchEventFromPool();
+	Thread = FRunnableThread::Create(this, TEXT("FAzureKinectPointCloudWriter"), 0, TPri_BelowNormal);
+	if (!Thread)
+	{
+		UE_LOG(AzureKinectPointCloudLog, Error, TEXT("Failed to create point cloud writer thread."));
+		Writer.Reset();
+		return false;
+	}
+
+	return true;
+}
+
+void FAzureKinectPointCloudWriter::EnsureCompletion()
+{
+	Stop();
+	if (Thread)
+	{
+		Thread->WaitForCompletion();
+	}
+}
+
+bool FAzureKinectPointCloudWriter::Enqueue(const FAzureKinectPointCloudPtr& Frame)
+{
+	if (!Frame.IsValid() || !Queue.Enqueue(Frame))
+	{
+		DroppedFrames.Increment();
+		return false;
+	}
+
+	WorkEvent->Trigger();
+	return true;
+}
+
+uint32 FAzureKinectPointCloudWriter::Run()
+{
+	FAzureKinectPointCloudPtr Frame;
+
+	while (true)
+	{
+		while (Queue.Dequeue(Frame))
+		{
+			WriteFrame(*Frame);
+			// Give the frame back to the pool as soon as possible
+			Frame.Reset();
+		}
+
+		if (StopTaskCounter.GetValue() != 0)
+		{
+			// Producer has stopped, drain what is left
+			if (Queue.IsEmpty())
+			{
+				break;
+			}
+			continue;
+		}
+
+		WorkEvent->Wait(100);
+	}
+
+	if (Writer)
+	{
+		Writer->Close();
+		Writer.Reset();
+	}
+
+	UE_LOG(AzureKinectPointCloudLog, Log, TEXT("Wrote %d point cloud frames to %s (%d dropped, %d skipped for a different layout)."),
+		WrittenFrames.GetValue(), *FilePath, DroppedFrames.GetValue(), MismatchedFrames.GetValue());
+
+	return 0;
+}
+
+void FAzureKinectPointCloudWriter::Stop()
+{
+	StopTaskCounter.Increment();
+	if (WorkEvent)
+	{
+		WorkEvent->Trigger();
+	}
+}
+
+void FAzureKinectPointCloudWriter::WriteFrame(const FAzureKinectPointCloud& Frame)
+{
+	const bool bHasColor = Frame.Colors.Num() == Frame.GetNumPoints();
+
+	if (!bHeaderWritten)
+	{
+		FFileHeader Header;
+		Header.Flags = (bQuantize ? Quantized : 0) | (bHasColor ? HasColor : 0);
+		Header.Width = Frame.Width;
+		Header.Height = Frame.Height;
+		Writer->Serialize(&Header, sizeof(Header));
+		bHeaderWritten = true;
+		bHeaderHasColor = bHasColor;
+		HeaderSize = FIntPoint(Frame.Width, Frame.Height);
+	}
+	else if (bHasColor != bHeaderHasColor || HeaderSize != FIntPoint(Frame.Width, Frame.Height))
+	{
+		// The file header describes every frame, e.g. the color camera stopped or the depth mode changed
+		if (MismatchedFrames.Increment() == 1)
+		{
+			UE_LOG(AzureKinectPointCloudLog, Warning, TEXT("Point cloud layout changed while recording %s, skipping frames that don't match the first one."), *FilePath);
+		}
+		return;
+	}
+
+	// Compact valid points
+	const int32 NumPoints = Frame.GetNumPoints();
+	const int32 PositionSize = bQuantize ? sizeof(int16) * 3 : sizeof(float) * 3;
+
+	PositionScratch.SetNumUninitialized(NumPoints * PositionSize, false);
+	if (bHasColor)
+	{
+		ColorScratch.SetNumUninitialized(NumPoints, false);
+	}
+
+	const int16* Src = Frame.Positions.GetData();
+	uint8* Dst = PositionScratch.GetData();
+	int32 NumValid = 0;
+
+	for (int32 i = 0; i < NumPoints; i++)
+	{
+		const int16 X = Src[i * 3], Y = Src[i * 3 + 1], Z = Src[i * 3 + 2];
+		if (Z == 0)
+		{
+			continue;
+		}
+
+		if (bQuantize)
+		{
+			int16* P = reinterpret_cast<int16*>(Dst) + NumValid * 3;
+			P[0] = X;
+			P[1] = Y;
+			P[2] = Z;
+		}
+		else
+		{
+			// Same axis conversion as skeleton joints (FAzureKinectJointConverter), mm to cm
+			float* P = reinterpret_cast<float*>(Dst) + NumValid * 3;
+			P[0] = Z * 0.1f;
+			P[1] = X * 0.1f;
+			P[2] = -Y * 0.1f;
+		}
+
+		if (bHasColor)
+		{
+			ColorScratch[NumValid] = Frame.Colors[i];
+		}
+
+		NumValid++;
+	}
+
+	const int64 PositionBytes = static_cast<int64>(NumValid) * PositionSize;
+	const int64 PositionPadded = Align(PositionBytes, Alignment);
+	const int64 ColorBytes = bHasColor ? static_cast<int64>(NumValid) * sizeof(FColor) : 0;
+	const int64 ColorPadded = Align(ColorBytes, Alignment);
+
+	FFrameHeader FrameHeader;
+	FrameHeader.NumPoints = NumValid;
+	FrameHeader.TimestampUsec = Frame.TimestampUsec;
+	FrameHeader.PayloadSize = PositionPadded + ColorPadded;
+
+	Writer->Serialize(&FrameHeader, sizeof(FrameHeader));
+	Writer->Serialize(PositionScratch.GetData(), PositionBytes);
+	WritePadding(PositionPadded - PositionBytes);
+
+	if (bHasColor)
+	{
+		Writer->Serialize(ColorScratch.GetData(), ColorBytes);
+		WritePadding(ColorPadded - ColorBytes);
+	}
+
+	WrittenFrames.Increment();
+}
+
+void FAzureKinectPointCloudWriter::WritePadding(int64 Size)
+{
+	static const uint8 Zeros[Alignment] = {};
+	if (Size > 0)
+	{
+		Writer->Serialize(const_cast<uint8*>(Zeros), Size);
+	}
+}
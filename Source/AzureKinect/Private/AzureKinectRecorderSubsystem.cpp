@@ -0,0 +1,318 @@
+#include "AzureKinectRecorderSubsystem.h"
+#include "Animation/AnimSequence.h"
+#include "Animation/Skeleton.h"
+#include "Async/Async.h"
+#include "Async/ParallelFor.h"
+
+#if WITH_EDITOR
+#include "AssetRegistryModule.h"
+#include "Misc/PackageName.h"
+#endif
+
+DEFINE_LOG_CATEGORY(AzureKinectRecorderLog);
+
+void FAzureKinectSkeletonRing::Reset(int32 InCapacity)
+{
+	Frames.SetNumUninitialized(FMath::Max(InCapacity, 1));
+	Head = 0;
+	NumFrames = 0;
+}
+
+void FAzureKinectSkeletonRing::Push(int64 TimestampUsec, const FAzureKinectSkeleton& Skeleton)
+{
+	const int32 Capacity = Frames.Num();
+	int32 Index;
+	if (NumFrames < Capacity)
+	{
+		Index = (Head + NumFrames) % Capacity;
+		NumFrames++;
+	}
+	else
+	{
+		// Overwrite the oldest
+		Index = Head;
+		Head = (Head + 1) % Capacity;
+	}
+
+	FFrame& Frame = Frames[Index];
+	Frame.TimestampUsec = TimestampUsec;
+
+	const int32 NumJoints = FMath::Min(Skeleton.Joints.Num(), static_cast<int32>(EKinectBodyJoint::COUNT));
+	for (int32 j = 0; j < NumJoints; j++)
+	{
+		Frame.Rotations[j] = Skeleton.Joints[j].GetRotation();
+	}
+}
+
+void UAzureKinectRecorderSubsystem::Deinitialize()
+{
+	DetachDevice();
+	Super::Deinitialize();
+}
+
+bool UAzureKinectRecorderSubsystem::StartRecording(UAzureKinectDevice* Device, float MaxDuration, int32 BodyID)
+{
+	if (!Device || IsRecording() || bBaking)
+	{
+		UE_LOG(AzureKinectRecorderLog, Warning, TEXT("Recorder is busy or no device is given."));
+		return false;
+	}
+
+	{
+		FScopeLock Lock(&RingCriticalSection);
+		// Allocate the whole duration up front, assuming 30 fps at most.
+		Ring.Reset(FMath::CeilToInt(FMath::Max(MaxDuration, 1.f) * 30.f));
+		RecordingBodyID = BodyID;
+	}
+
+	RecordingDevice = Device;
+	PublishedHandle = Device->AddSkeletonsPublishedListener(
+		FOnAzureKinectSkeletonsPublished::FDelegate::CreateUObject(this, &UAzureKinectRecorderSubsystem::OnSkeletonsPublished));
+
+	return true;
+}
+
+bool UAzureKinectRecorderSubsystem::StopRecordingWithBoneReferences(USkeleton* Skeleton, const TMap<EKinectBodyJoint, FBoneReference>& BonesToModify, const FString& AssetPath, float SampleRate)
+{
+	TMap<EKinectBodyJoint, FName> BoneNames;
+	for (const TPair<EKinectBodyJoint, FBoneReference>& Pair : BonesToModify)
+	{
+		BoneNames.Add(Pair.Key, Pair.Value.BoneName);
+	}
+	return StopRecording(Skeleton, BoneNames, AssetPath, SampleRate);
+}
+
+bool UAzureKinectRecorderSubsystem::StopRecording(USkeleton* Skeleton, const TMap<EKinectBodyJoint, FName>& BoneNames, const FString& AssetPath, float SampleRate)
+{
+	DetachDevice();
+
+#if WITH_EDITOR
+	if (!Skeleton || SampleRate <= 0.f || Ring.Num() < 2)
+	{
+		UE_LOG(AzureKinectRecorderLog, Warning, TEXT("Nothing to bake."));
+		return false;
+	}
+
+	// Copy everything the worker needs, it should not touch UObjects.
+	const FReferenceSkeleton& RefSkeleton = Skeleton->GetReferenceSkeleton();
+	const int32 NumBones = RefSkeleton.GetNum();
+
+	TArray<FTransform> RefPose = RefSkeleton.GetRefBonePose();
+	TArray<int32> Parents;
+	TArray<FName> TrackNames;
+	TArray<int32> JointOfBone;
+	Parents.SetNumUninitialized(NumBones);
+	TrackNames.SetNumUninitialized(NumBones);
+	JointOfBone.Init(INDEX_NONE, NumBones);
+
+	for (int32 b = 0; b < NumBones; b++)
+	{
+		Parents[b] = RefSkeleton.GetParentIndex(b);
+		TrackNames[b] = RefSkeleton.GetBoneName(b);
+	}
+
+	for (const TPair<EKinectBodyJoint, FName>& Pair : BoneNames)
+	{
+		const int32 BoneIndex = RefSkeleton.FindBoneIndex(Pair.Value);
+		if (BoneIndex != INDEX_NONE && Pair.Key != EKinectBodyJoint::COUNT)
+		{
+			JointOfBone[BoneIndex] = static_cast<int32>(Pair.Key);
+		}
+	}
+
+	// The worker owns the frames, so it doesn't depend on the subsystem staying alive
+	FAzureKinectSkeletonRing Recorded;
+	{
+		FScopeLock Lock(&RingCriticalSection);
+		Recorded = MoveTemp(Ring);
+		Ring = FAzureKinectSkeletonRing();
+	}
+
+	bBaking = true;
+
+	TWeakObjectPtr<UAzureKinectRecorderSubsystem> WeakThis(this);
+	TWeakObjectPtr<USkeleton> WeakSkeleton(Skeleton);
+	const float InPositionTolerance = PositionTolerance;
+	const float InRotationTolerance = RotationTolerance;
+
+	Async(EAsyncExecution::ThreadPool, [WeakThis, WeakSkeleton, AssetPath, SampleRate, NumBones, Recorded = MoveTemp(Recorded),
+		RefPose = MoveTemp(RefPose), Parents = MoveTemp(Parents), TrackNames = MoveTemp(TrackNames), JointOfBone = MoveTemp(JointOfBone),
+		InPositionTolerance, InRotationTolerance]() mutable
+	{
+		const double BakeStartTime = FPlatformTime::Seconds();
+
+		const int32 NumSource = Recorded.Num();
+		const int64 StartUsec = Recorded[0].TimestampUsec;
+		const int64 EndUsec = Recorded[NumSource - 1].TimestampUsec;
+		const int32 NumFrames = FMath::FloorToInt((EndUsec - StartUsec) / 1e6 * SampleRate) + 1;
+
+		TArray<FRawAnimSequenceTrack> Tracks;
+		Tracks.SetNum(NumBones);
+		for (FRawAnimSequenceTrack& Track : Tracks)
+		{
+			Track.PosKeys.SetNumUninitialized(NumFrames);
+			Track.RotKeys.SetNumUninitialized(NumFrames);
+			Track.ScaleKeys.SetNumUninitialized(NumFrames);
+		}
+
+		// Resample at uniform rate and solve local transforms, every output frame is independent.
+		ParallelFor(NumFrames, [&](int32 Frame)
+		{
+			const int64 TimeUsec = StartUsec + static_cast<int64>(Frame / SampleRate * 1e6);
+
+			// Last source frame at or before the time
+			int32 Lo = 0, Hi = NumSource - 1;
+			while (Lo < Hi)
+			{
+				const int32 Mid = (Lo + Hi + 1) / 2;
+				if (Recorded[Mid].TimestampUsec <= TimeUsec) Lo = Mid; else Hi = Mid - 1;
+			}
+			const FAzureKinectSkeletonRing::FFrame& A = Recorded[Lo];
+			const FAzureKinectSkeletonRing::FFrame& B = Recorded[FMath::Min(Lo + 1, NumSource - 1)];
+			const int64 Span = B.TimestampUsec - A.TimestampUsec;
+			const float Alpha = Span > 0 ? FMath::Clamp(static_cast<float>(TimeUsec - A.TimestampUsec) / Span, 0.f, 1.f) : 0.f;
+
+			TArray<FTransform> ComponentSpace;
+			ComponentSpace.SetNumUninitialized(NumBones);
+
+			// Same as FAnimNode_AzureKinectPose: keep reference translation, override component space rotation.
+			// Reference skeleton guarantees parents come before children.
+			for (int32 b = 0; b < NumBones; b++)
+			{
+				const int32 Parent = Parents[b];
+				FTransform CS = Parent == INDEX_NONE ? RefPose[b] : RefPose[b] * ComponentSpace[Parent];
+
+				const int32 Joint = JointOfBone[b];
+				if (Joint != INDEX_NONE)
+				{
+					CS.SetRotation(FQuat::Slerp(A.Rotations[Joint], B.Rotations[Joint], Alpha).GetNormalized());
+				}
+				ComponentSpace[b] = CS;
+
+				const FTransform Local = Parent == INDEX_NONE ? CS : CS.GetRelativeTransform(ComponentSpace[Parent]);
+				Tracks[b].PosKeys[Frame] = Local.GetTranslation();
+				Tracks[b].RotKeys[Frame] = Local.GetRotation();
+				Tracks[b].ScaleKeys[Frame] = Local.GetScale3D();
+			}
+		});
+
+		// Collapse constant channels to a single key, tracks are independent.
+		ParallelFor(NumBones, [&](int32 b)
+		{
+			FRawAnimSequenceTrack& Track = Tracks[b];
+
+			auto IsConstantVector = [](const TArray<FVector>& Keys, float Tolerance)
+			{
+				for (const FVector& Key : Keys)
+				{
+					if (!Key.Equals(Keys[0], Tolerance)) return false;
+				}
+				return true;
+			};
+
+			if (IsConstantVector(Track.PosKeys, InPositionTolerance))
+			{
+				Track.PosKeys.SetNum(1);
+			}
+			if (IsConstantVector(Track.ScaleKeys, InPositionTolerance))
+			{
+				Track.ScaleKeys.SetNum(1);
+			}
+
+			bool bConstantRotation = true;
+			for (const FQuat& Key : Track.RotKeys)
+			{
+				if (!Key.Equals(Track.RotKeys[0], InRotationTolerance))
+				{
+					bConstantRotation = false;
+					break;
+				}
+			}
+			if (bConstantRotation)
+			{
+				Track.RotKeys.SetNum(1);
+			}
+		});
+
+		UE_LOG(AzureKinectRecorderLog, Log, TEXT("Resampled %d frames into %d keys per track in %.2f ms."),
+			NumSource, NumFrames, (FPlatformTime::Seconds() - BakeStartTime) * 1000.0);
+
+		AsyncTask(ENamedThreads::GameThread, [WeakThis, WeakSkeleton, AssetPath, SampleRate, NumFrames,
+			Tracks = MoveTemp(Tracks), TrackNames = MoveTemp(TrackNames)]() mutable
+		{
+			UAzureKinectRecorderSubsystem* Subsystem = WeakThis.Get();
+			USkeleton* Skeleton = WeakSkeleton.Get();
+			if (!Subsystem)
+			{
+				return;
+			}
+			Subsystem->bBaking = false;
+
+			if (!Skeleton)
+			{
+				Subsystem->OnAnimationBaked.Broadcast(nullptr);
+				return;
+			}
+
+			const FString AssetName = FPackageName::GetLongPackageAssetName(AssetPath);
+			UPackage* Package = CreatePackage(*AssetPath);
+			UAnimSequence* Sequence = NewObject<UAnimSequence>(Package, *AssetName, RF_Public | RF_Standalone);
+			Sequence->SetSkeleton(Skeleton);
+			Sequence->SetRawNumberOfFrame(NumFrames);
+			Sequence->SequenceLength = FMath::Max(NumFrames - 1, 1) / SampleRate;
+
+			for (int32 b = 0; b < Tracks.Num(); b++)
+			{
+				Sequence->AddNewRawTrack(TrackNames[b], &Tracks[b]);
+			}
+
+			Sequence->MarkRawDataAsModified();
+			Sequence->PostProcessSequence();
+
+			FAssetRegistryModule::AssetCreated(Sequence);
+			Package->MarkPackageDirty();
+
+			Subsystem->OnAnimationBaked.Broadcast(Sequence);
+		});
+	});
+
+	return true;
+#else
+	UE_LOG(AzureKinectRecorderLog, Error, TEXT("Baking an animation is only available in editor."));
+	return false;
+#endif
+}
+
+int32 UAzureKinectRecorderSubsystem::GetNumRecordedFrames() const
+{
+	FScopeLock Lock(&RingCriticalSection);
+	return Ring.Num();
+}
+
+void UAzureKinectRecorderSubsystem::OnSkeletonsPublished(int64 TimestampUsec, const TArray<FAzureKinectSkeleton>& Skeletons)
+{
+	// Called on the capture thread
+	FScopeLock Lock(&RingCriticalSection);
+
+	if (RecordingBodyID == -1 && Skeletons.Num() > 0)
+	{
+		// Follow the first body appeared
+		RecordingBodyID = Skeletons[0].ID;
+	}
+
+	const FAzureKinectSkeleton* Skeleton = Skeletons.FindByPredicate([this](const FAzureKinectSkeleton& S) { return S.ID == RecordingBodyID; });
+	if (Skeleton)
+	{
+		Ring.Push(TimestampUsec, *Skeleton);
+	}
+}
+
+void UAzureKinectRecorderSubsystem::DetachDevice()
+{
+	if (UAzureKinectDevice* Device = RecordingDevice.Get())
+	{
+		Device->RemoveSkeletonsPublishedListener(PublishedHandle);
+	}
+	RecordingDevice.Reset();
+	PublishedHandle.Reset();
+}
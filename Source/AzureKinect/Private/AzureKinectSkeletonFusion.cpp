@@ -0,0 +1,428 @@
+#include "AzureKinectSkeletonFusion.h"
+#include "HAL/IConsoleManager.h"
+
+DEFINE_LOG_CATEGORY(AzureKinectFusionLog);
+
+namespace
+{
+	constexpr int32 NumJoints = static_cast<int32>(EKinectBodyJoint::COUNT);
+	constexpr int32 PelvisIndex = static_cast<int32>(EKinectBodyJoint::PELVIS);
+	constexpr int32 ShoulderLeftIndex = static_cast<int32>(EKinectBodyJoint::SHOULDER_LEFT);
+	constexpr int32 ShoulderRightIndex = static_cast<int32>(EKinectBodyJoint::SHOULDER_RIGHT);
+
+	/** Keep the ID of a body lost by all devices for this many frames. */
+	constexpr int32 MaxMissedFrames = 15;
+
+	/** Per EKinectJointConfidence, occluded (predicted) joints count little. */
+	constexpr float ConfidenceWeights[] = { 0.f, 0.2f, 1.f, 1.f };
+
+	bool IsValidSkeleton(const FAzureKinectSkeleton& Skeleton)
+	{
+		return Skeleton.Joints.Num() >= NumJoints && Skeleton.JointConfidences.Num() >= NumJoints;
+	}
+
+	/** Horizontal direction the body faces, zero if shoulders are on top of each other. */
+	FVector GetFacing(const FAzureKinectSkeleton& Skeleton)
+	{
+		const FVector Right = Skeleton.Joints[ShoulderRightIndex].GetLocation() - Skeleton.Joints[ShoulderLeftIndex].GetLocation();
+		return (Right ^ FVector::UpVector).GetSafeNormal2D();
+	}
+
+	struct FPair
+	{
+		float DistSquared;
+		int32 A;
+		int32 B;
+
+		bool operator<(const FPair& Other) const { return DistSquared < Other.DistSquared; }
+	};
+
+	/** Sort pairs nearest first and take each side at most once. */
+	template <typename AssignFunc>
+	void AssignGreedy(TArray<FPair>& Pairs, int32 NumA, int32 NumB, AssignFunc Assign)
+	{
+		Pairs.Sort();
+		TBitArray<> TakenA(false, NumA), TakenB(false, NumB);
+		for (const FPair& Pair : Pairs)
+		{
+			if (TakenA[Pair.A] || TakenB[Pair.B]) continue;
+			TakenA[Pair.A] = true;
+			TakenB[Pair.B] = true;
+			Assign(Pair.A, Pair.B);
+		}
+	}
+}
+
+void FAzureKinectSkeletonFusion::Fuse(const TArray<FAzureKinectSkeletonView>& Views, const FAzureKinectFusionSettings& Settings, TArray<FAzureKinectSkeleton>& OutSkeletons)
+{
+	Associate(Views, Settings.AssociationDistance);
+	MatchTracks(Settings.AssociationDistance);
+
+	TArray<FTrack> NewTracks;
+	NewTracks.Reserve(Clusters.Num() + Tracks.Num());
+	OutSkeletons.SetNum(Clusters.Num(), false);
+	TBitArray<> Matched(false, Tracks.Num());
+
+	for (int32 c = 0; c < Clusters.Num(); c++)
+	{
+		const FCluster& Cluster = Clusters[c];
+		const FTrack* Track = Cluster.TrackIndex != INDEX_NONE ? &Tracks[Cluster.TrackIndex] : nullptr;
+		if (Track)
+		{
+			Matched[Cluster.TrackIndex] = true;
+		}
+
+		FAzureKinectSkeleton& Skeleton = OutSkeletons[c];
+		MergeJoints(Views, Cluster, Track ? Track->Forward : FVector::ZeroVector, Settings.MinViewWeight, Skeleton);
+		Skeleton.ID = Track ? Track->ID : NextID++;
+
+		const FVector Facing = GetFacing(Skeleton);
+		NewTracks.Add({ Skeleton.ID, Skeleton.Joints[PelvisIndex].GetLocation(), Facing.IsZero() && Track ? Track->Forward : Facing, 0 });
+	}
+
+	// Bridge short occlusions of every device
+	for (int32 t = 0; t < Tracks.Num(); t++)
+	{
+		if (!Matched[t] && Tracks[t].MissedFrames < MaxMissedFrames)
+		{
+			NewTracks.Add(Tracks[t]);
+			NewTracks.Last().MissedFrames++;
+		}
+	}
+
+	Tracks = MoveTemp(NewTracks);
+}
+
+void FAzureKinectSkeletonFusion::Reset()
+{
+	Tracks.Reset();
+	Clusters.Reset();
+	NextID = 1;
+}
+
+void FAzureKinectSkeletonFusion::Associate(const TArray<FAzureKinectSkeletonView>& Views, float Distance)
+{
+	Clusters.Reset();
+
+	TArray<FPair> Pairs;
+	TArray<int32, TInlineAllocator<8>> NumMembers;
+	const float DistSquared = Distance * Distance;
+
+	for (int32 v = 0; v < Views.Num(); v++)
+	{
+		const TArray<FAzureKinectSkeleton>& Skeletons = Views[v].Skeletons;
+		const int32 NumClusters = Clusters.Num();
+
+		// Join the nearest cluster not seen by this view yet
+		Pairs.Reset();
+		for (int32 b = 0; b < Skeletons.Num(); b++)
+		{
+			if (!IsValidSkeleton(Skeletons[b])) continue;
+
+			const FVector Pelvis = Skeletons[b].Joints[PelvisIndex].GetLocation();
+			for (int32 c = 0; c < NumClusters; c++)
+			{
+				const float D = FVector::DistSquared(Pelvis, Clusters[c].Pelvis);
+				if (D < DistSquared)
+				{
+					Pairs.Add({ D, b, c });
+				}
+			}
+		}
+
+		TBitArray<> Assigned(false, Skeletons.Num());
+		AssignGreedy(Pairs, Skeletons.Num(), NumClusters, [&](int32 b, int32 c)
+		{
+			FCluster& Cluster = Clusters[c];
+			Cluster.Bodies[v] = b;
+			NumMembers[c]++;
+			Cluster.Pelvis += (Skeletons[b].Joints[PelvisIndex].GetLocation() - Cluster.Pelvis) / NumMembers[c];
+			Assigned[b] = true;
+		});
+
+		// Everyone else is a new person
+		for (int32 b = 0; b < Skeletons.Num(); b++)
+		{
+			if (Assigned[b] || !IsValidSkeleton(Skeletons[b])) continue;
+
+			FCluster& Cluster = Clusters.AddDefaulted_GetRef();
+			Cluster.Pelvis = Skeletons[b].Joints[PelvisIndex].GetLocation();
+			Cluster.Bodies.Init(INDEX_NONE, Views.Num());
+			Cluster.Bodies[v] = b;
+			Cluster.TrackIndex = INDEX_NONE;
+			NumMembers.Add(1);
+		}
+	}
+}
+
+void FAzureKinectSkeletonFusion::MatchTracks(float Distance)
+{
+	TArray<FPair> Pairs;
+	const float DistSquared = Distance * Distance;
+	for (int32 c = 0; c < Clusters.Num(); c++)
+	{
+		for (int32 t = 0; t < Tracks.Num(); t++)
+		{
+			const float D = FVector::DistSquared(Clusters[c].Pelvis, Tracks[t].Pelvis);
+			if (D < DistSquared)
+			{
+				Pairs.Add({ D, c, t });
+			}
+		}
+	}
+
+	AssignGreedy(Pairs, Clusters.Num(), Tracks.Num(), [&](int32 c, int32 t)
+	{
+		Clusters[c].TrackIndex = t;
+	});
+}
+
+void FAzureKinectSkeletonFusion::MergeJoints(const TArray<FAzureKinectSkeletonView>& Views, const FCluster& Cluster, const FVector& Forward, float MinViewWeight, FAzureKinectSkeleton& OutSkeleton) const
+{
+	// Weight each view by how much it sees the front of the body
+	TArray<float, TInlineAllocator<8>> ViewWeights;
+	ViewWeights.SetNumUninitialized(Views.Num());
+	int32 FirstView = INDEX_NONE;
+	for (int32 v = 0; v < Views.Num(); v++)
+	{
+		const int32 b = Cluster.Bodies[v];
+		if (b == INDEX_NONE)
+		{
+			ViewWeights[v] = 0.f;
+			continue;
+		}
+
+		const FAzureKinectSkeleton& Skeleton = Views[v].Skeletons[b];
+		// Without history a view can only trust its own facing
+		const FVector Facing = Forward.IsZero() ? GetFacing(Skeleton) : Forward;
+		const FVector ToCamera = (Views[v].CameraLocation - Skeleton.Joints[PelvisIndex].GetLocation()).GetSafeNormal2D();
+		ViewWeights[v] = FMath::Max(Facing | ToCamera, MinViewWeight);
+
+		if (FirstView == INDEX_NONE)
+		{
+			FirstView = v;
+		}
+	}
+
+	OutSkeleton.Joints.SetNumUninitialized(NumJoints, false);
+	OutSkeleton.JointConfidences.SetNumUninitialized(NumJoints, false);
+
+	for (int32 j = 0; j < NumJoints; j++)
+	{
+		const FQuat Reference = Views[FirstView].Skeletons[Cluster.Bodies[FirstView]].Joints[j].GetRotation();
+		FVector Position = FVector::ZeroVector;
+		FQuat Rotation(0.f, 0.f, 0.f, 0.f);
+		float TotalWeight = 0.f;
+		EKinectJointConfidence Confidence = EKinectJointConfidence::NONE;
+
+		// Second pass only when no view has any confidence in the joint,
+		// third (unweighted mean) when every view faces away with a MinViewWeight of 0
+		for (int32 Pass = 0; Pass < 3 && TotalWeight <= 0.f; Pass++)
+		{
+			for (int32 v = 0; v < Views.Num(); v++)
+			{
+				const int32 b = Cluster.Bodies[v];
+				if (b == INDEX_NONE) continue;
+
+				const FAzureKinectSkeleton& Skeleton = Views[v].Skeletons[b];
+				const EKinectJointConfidence JointConfidence = Skeleton.JointConfidences[j];
+				const float Weight = Pass == 2 ? 1.f : ViewWeights[v] * (Pass == 0 ? ConfidenceWeights[static_cast<int32>(JointConfidence) & 3] : 1.f);
+				if (Weight <= 0.f) continue;
+
+				// q and -q are the same rotation, keep them on one side before averaging
+				FQuat Quat = Skeleton.Joints[j].GetRotation();
+				if ((Quat | Reference) < 0.f)
+				{
+					Quat *= -1.f;
+				}
+
+				Position += Skeleton.Joints[j].GetLocation() * Weight;
+				Rotation = Rotation + Quat * Weight;
+				TotalWeight += Weight;
+				Confidence = FMath::Max(Confidence, JointConfidence);
+			}
+		}
+
+		OutSkeleton.Joints[j] = FTransform(Rotation.GetNormalized(), Position / TotalWeight);
+		OutSkeleton.JointConfidences[j] = Confidence;
+	}
+
+	// Bounds of all views, contours are in the pixels of each device and don't merge
+	FAzureKinectBodyGeometry& Geometry = OutSkeleton.Geometry;
+	Geometry.Bounds.Init();
+	Geometry.Contour.Reset();
+	FVector CentroidSum = FVector::ZeroVector;
+	int32 NumPixels = 0;
+	for (int32 v = 0; v < Views.Num(); v++)
+	{
+		const int32 b = Cluster.Bodies[v];
+		if (b == INDEX_NONE) continue;
+
+		const FAzureKinectBodyGeometry& ViewGeometry = Views[v].Skeletons[b].Geometry;
+		if (ViewGeometry.NumPixels == 0) continue;
+
+		Geometry.Bounds += ViewGeometry.Bounds;
+		CentroidSum += ViewGeometry.Centroid * ViewGeometry.NumPixels;
+		NumPixels += ViewGeometry.NumPixels;
+	}
+	Geometry.NumPixels = NumPixels;
+	Geometry.Centroid = NumPixels > 0 ? CentroidSum / NumPixels : FVector::ZeroVector;
+}
+
+namespace
+{
+	/** A synthetic body: fixed joint offsets from the pelvis in body space, walking on a circle. */
+	struct FSyntheticBody
+	{
+		FVector Offsets[NumJoints];
+		FVector Center;
+		float Radius;
+		float Speed;
+		float Phase;
+
+		void Init(FRandomStream& Random, int32 Index)
+		{
+			for (int32 j = 0; j < NumJoints; j++)
+			{
+				Offsets[j] = FVector(Random.FRandRange(-10.f, 10.f), Random.FRandRange(-25.f, 25.f), Random.FRandRange(-90.f, 70.f));
+			}
+			Offsets[ShoulderLeftIndex] = FVector(0.f, -20.f, 45.f);
+			Offsets[ShoulderRightIndex] = FVector(0.f, 20.f, 45.f);
+			Offsets[PelvisIndex] = FVector::ZeroVector;
+
+			Center = FVector(Random.FRandRange(-100.f, 100.f), Random.FRandRange(-100.f, 100.f), 0.f);
+			Radius = 50.f + 40.f * Index;
+			Speed = Random.FRandRange(0.5f, 1.5f);
+			Phase = Random.FRandRange(0.f, 2.f * PI);
+		}
+
+		void Pose(float Time, FTransform* OutJoints) const
+		{
+			const float Angle = Phase + Speed * Time;
+			const FVector Pelvis = Center + FVector(FMath::Cos(Angle), FMath::Sin(Angle), 0.f) * Radius + FVector(0.f, 0.f, 95.f);
+			// Facing along the walk
+			const FQuat Facing(FVector::UpVector, Angle + HALF_PI);
+			for (int32 j = 0; j < NumJoints; j++)
+			{
+				OutJoints[j] = FTransform(Facing, Pelvis + Facing.RotateVector(Offsets[j]));
+			}
+		}
+	};
+
+	void BenchmarkSkeletonFusion(const TArray<FString>& Args)
+	{
+		const int32 NumViews = Args.Num() > 0 ? FMath::Clamp(FCString::Atoi(*Args[0]), 1, 16) : 4;
+		const int32 NumBodies = Args.Num() > 1 ? FMath::Clamp(FCString::Atoi(*Args[1]), 1, 6) : 6;
+		const int32 NumFrames = Args.Num() > 2 ? FMath::Max(FCString::Atoi(*Args[2]), 1) : 300;
+
+		float MeanError = 0.f;
+		const float Ms = FAzureKinectSkeletonFusion::Benchmark(NumViews, NumBodies, NumFrames, MeanError);
+		UE_LOG(AzureKinectFusionLog, Display, TEXT("%d device(s), %d bodies: %.3f ms per fusion, mean joint error %.2f cm"), NumViews, NumBodies, Ms, MeanError);
+	}
+
+	FAutoConsoleCommand BenchmarkSkeletonFusionCommand(
+		TEXT("AzureKinect.BenchmarkSkeletonFusion"),
+		TEXT("Fuse synthetic skeleton streams and log the cost and joint error. Takes the number of devices, bodies and frames."),
+		FConsoleCommandWithArgsDelegate::CreateStatic(&BenchmarkSkeletonFusion));
+}
+
+float FAzureKinectSkeletonFusion::Benchmark(int32 NumViews, int32 NumBodies, int32 NumFrames, float& OutMeanError)
+{
+	FRandomStream Random(1234);
+
+	TArray<FSyntheticBody> Bodies;
+	Bodies.SetNum(NumBodies);
+	for (int32 i = 0; i < NumBodies; i++)
+	{
+		Bodies[i].Init(Random, i);
+	}
+
+	// Devices on a circle around the stage, looking at its center
+	TArray<FAzureKinectSkeletonView> Views;
+	Views.SetNum(NumViews);
+	for (int32 v = 0; v < NumViews; v++)
+	{
+		const float Angle = 2.f * PI * v / NumViews;
+		Views[v].CameraLocation = FVector(FMath::Cos(Angle) * 400.f, FMath::Sin(Angle) * 400.f, 100.f);
+	}
+
+	FAzureKinectSkeletonFusion Fusion;
+	FAzureKinectFusionSettings Settings;
+	TArray<FAzureKinectSkeleton> Fused;
+	TArray<FTransform> Truth;
+	Truth.SetNumUninitialized(NumBodies * NumJoints);
+
+	double FuseSeconds = 0.0;
+	double ErrorSum = 0.0;
+	int64 NumErrors = 0;
+
+	for (int32 Frame = 0; Frame < NumFrames; Frame++)
+	{
+		const float Time = Frame / 30.f;
+		for (int32 i = 0; i < NumBodies; i++)
+		{
+			Bodies[i].Pose(Time, &Truth[i * NumJoints]);
+		}
+
+		for (int32 v = 0; v < NumViews; v++)
+		{
+			TArray<FAzureKinectSkeleton>& Skeletons = Views[v].Skeletons;
+			Skeletons.Reset();
+			for (int32 i = 0; i < NumBodies; i++)
+			{
+				// Occluded from time to time
+				if (Random.FRand() < 0.1f) continue;
+
+				const FVector Pelvis = Truth[i * NumJoints + PelvisIndex].GetLocation();
+				const FVector Facing = Truth[i * NumJoints + PelvisIndex].GetRotation().GetForwardVector();
+				const bool bFront = (Facing | (Views[v].CameraLocation - Pelvis).GetSafeNormal2D()) > 0.f;
+				const float Noise = bFront ? 1.5f : 6.f;
+
+				FAzureKinectSkeleton& Skeleton = Skeletons.AddDefaulted_GetRef();
+				Skeleton.ID = Random.RandHelper(1000);
+				Skeleton.Joints.SetNumUninitialized(NumJoints);
+				Skeleton.JointConfidences.SetNumUninitialized(NumJoints);
+				for (int32 j = 0; j < NumJoints; j++)
+				{
+					const FTransform& Joint = Truth[i * NumJoints + j];
+					Skeleton.Joints[j] = FTransform(Joint.GetRotation(), Joint.GetLocation() + Random.GetUnitVector() * Random.FRandRange(0.f, Noise));
+					Skeleton.JointConfidences[j] = bFront ? EKinectJointConfidence::MEDIUM : EKinectJointConfidence::LOW;
+				}
+			}
+
+			// Device order of bodies is arbitrary
+			for (int32 i = Skeletons.Num() - 1; i > 0; i--)
+			{
+				Skeletons.Swap(i, Random.RandHelper(i + 1));
+			}
+		}
+
+		const double StartTime = FPlatformTime::Seconds();
+		Fusion.Fuse(Views, Settings, Fused);
+		FuseSeconds += FPlatformTime::Seconds() - StartTime;
+
+		// Compare against the nearest true body
+		for (const FAzureKinectSkeleton& Skeleton : Fused)
+		{
+			int32 Nearest = 0;
+			float NearestDist = MAX_flt;
+			for (int32 i = 0; i < NumBodies; i++)
+			{
+				const float D = FVector::DistSquared(Skeleton.Joints[PelvisIndex].GetLocation(), Truth[i * NumJoints + PelvisIndex].GetLocation());
+				if (D < NearestDist)
+				{
+					NearestDist = D;
+					Nearest = i;
+				}
+			}
+			for (int32 j = 0; j < NumJoints; j++)
+			{
+				ErrorSum += FVector::Dist(Skeleton.Joints[j].GetLocation(), Truth[Nearest * NumJoints + j].GetLocation());
+				NumErrors++;
+			}
+		}
+	}
+
+	OutMeanError = NumErrors > 0 ? static_cast<float>(ErrorSum / NumErrors) : 0.f;
+	return static_cast<float>(FuseSeconds * 1000.0 / NumFrames);
+}
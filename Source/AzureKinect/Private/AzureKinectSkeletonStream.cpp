@@ -0,0 +1,319 @@
+#include "AzureKinectSkeletonStream.h"
+#include "HAL/FileManager.h"
+#include "HAL/PlatformFilemanager.h"
+#include "Async/MappedFileHandle.h"
+#include "Algo/BinarySearch.h"
+
+DEFINE_LOG_CATEGORY(AzureKinectSkeletonStreamLog);
+
+using namespace AzureKinectSkeletonFormat;
+
+namespace
+{
+	int16 QuantizePosition(float Value)
+	{
+		return static_cast<int16>(FMath::Clamp(FMath::RoundToInt(Value * PositionScale), -32767, 32767));
+	}
+
+	int16 QuantizeRotation(float Value)
+	{
+		return static_cast<int16>(FMath::RoundToInt(FMath::Clamp(Value, -1.f, 1.f) * RotationScale));
+	}
+
+	template<typename T>
+	T ReadAt(const uint8* Data, int64 Offset)
+	{
+		// Records are not necessarily aligned in the file
+		T Value;
+		FMemory::Memcpy(&Value, Data + Offset, sizeof(T));
+		return Value;
+	}
+}
+
+FAzureKinectSkeletonWriter::~FAzureKinectSkeletonWriter()
+{
+	Close();
+}
+
+bool FAzureKinectSkeletonWriter::Open(const FString& FilePath)
+{
+	Close();
+
+	Writer.Reset(IFileManager::Get().CreateFileWriter(*FilePath));
+	if (!Writer)
+	{
+		UE_LOG(AzureKinectSkeletonStreamLog, Error, TEXT("Can't open %s for writing."), *FilePath);
+		return false;
+	}
+
+	FFileHeader Header;
+	Writer->Serialize(&Header, sizeof(Header));
+	FrameIndex.Reset();
+	return true;
+}
+
+void FAzureKinectSkeletonWriter::Close()
+{
+	if (!Writer)
+	{
+		return;
+	}
+
+	FTrailer Trailer;
+	Trailer.IndexOffset = Writer->Tell();
+	Trailer.NumFrames = FrameIndex.Num();
+
+	Writer->Serialize(FrameIndex.GetData(), FrameIndex.Num() * sizeof(FFrameIndexEntry));
+	Writer->Serialize(&Trailer, sizeof(Trailer));
+	Writer->Close();
+	Writer.Reset();
+}
+
+void FAzureKinectSkeletonWriter::WriteFrame(int64 TimestampUsec, const TArray<FAzureKinectSkeleton>& Skeletons)
+{
+	if (!Writer)
+	{
+		return;
+	}
+
+	FFrameIndexEntry& Entry = FrameIndex.AddDefaulted_GetRef();
+	Entry.Offset = Writer->Tell();
+	Entry.TimestampUsec = TimestampUsec;
+
+	BodyScratch.SetNumUninitialized(Skeletons.Num(), false);
+	FMemory::Memzero(BodyScratch.GetData(), BodyScratch.Num() * sizeof(FBodyRecord));
+	for (int32 i = 0; i < Skeletons.Num(); i++)
+	{
+		const FAzureKinectSkeleton& Skeleton = Skeletons[i];
+		FBodyRecord& Body = BodyScratch[i];
+		Body.ID = Skeleton.ID;
+
+		const int32 NumJoints = FMath::Min<int32>(Skeleton.Joints.Num(), JointCount);
+		for (int32 j = 0; j < NumJoints; j++)
+		{
+			const FTransform& Joint = Skeleton.Joints[j];
+			const FVector Position = Joint.GetLocation();
+			const FQuat Rotation = Joint.GetRotation().GetNormalized();
+
+			FJointRecord& Record = Body.Joints[j];
+			Record.Position[0] = QuantizePosition(Position.X);
+			Record.Position[1] = QuantizePosition(Position.Y);
+			Record.Position[2] = QuantizePosition(Position.Z);
+			Record.Rotation[0] = QuantizeRotation(Rotation.X);
+			Record.Rotation[1] = QuantizeRotation(Rotation.Y);
+			Record.Rotation[2] = QuantizeRotation(Rotation.Z);
+			Record.Rotation[3] = QuantizeRotation(Rotation.W);
+			Record.Confidence = Skeleton.JointConfidences.IsValidIndex(j) ? static_cast<uint8>(Skeleton.JointConfidences[j]) : 0;
+		}
+	}
+
+	FFrameHeader Header;
+	Header.TimestampUsec = TimestampUsec;
+	Header.NumBodies = Skeletons.Num();
+
+	Writer->Serialize(&Header, sizeof(Header));
+	Writer->Serialize(BodyScratch.GetData(), BodyScratch.Num() * sizeof(FBodyRecord));
+}
+
+FAzureKinectSkeletonReader::~FAzureKinectSkeletonReader()
+{
+	Close();
+}
+
+bool FAzureKinectSkeletonReader::Open(const FString& FilePath)
+{
+	Close();
+
+	MappedHandle.Reset(FPlatformFileManager::Get().GetPlatformFile().OpenMapped(*FilePath));
+	if (!MappedHandle)
+	{
+		UE_LOG(AzureKinectSkeletonStreamLog, Error, TEXT("Can't map %s."), *FilePath);
+		return false;
+	}
+
+	MappedRegion.Reset(MappedHandle->MapRegion());
+	if (!MappedRegion)
+	{
+		UE_LOG(AzureKinectSkeletonStreamLog, Error, TEXT("Can't map %s."), *FilePath);
+		Close();
+		return false;
+	}
+
+	Data = MappedRegion->GetMappedPtr();
+	DataSize = MappedRegion->GetMappedSize();
+
+	if (DataSize < static_cast<int64>(sizeof(FFileHeader)))
+	{
+		UE_LOG(AzureKinectSkeletonStreamLog, Error, TEXT("%s is too small."), *FilePath);
+		Close();
+		return false;
+	}
+
+	const FFileHeader Header = ReadAt<FFileHeader>(Data, 0);
+	if (Header.Magic != FileMagic || Header.Version != Version || Header.JointCount != JointCount)
+	{
+		UE_LOG(AzureKinectSkeletonStreamLog, Error, TEXT("%s is not a skeleton stream."), *FilePath);
+		Close();
+		return false;
+	}
+
+	bool bHasTrailer = false;
+	if (!ReadIndex(bHasTrailer))
+	{
+		if (bHasTrailer)
+		{
+			UE_LOG(AzureKinectSkeletonStreamLog, Error, TEXT("%s has a corrupt frame index."), *FilePath);
+			Close();
+			return false;
+		}
+		if (!ScanIndex())
+		{
+			UE_LOG(AzureKinectSkeletonStreamLog, Error, TEXT("%s has no readable frames."), *FilePath);
+			Close();
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void FAzureKinectSkeletonReader::Close()
+{
+	Data = nullptr;
+	DataSize = 0;
+	FrameIndex.Reset();
+	MappedRegion.Reset();
+	MappedHandle.Reset();
+}
+
+int64 FAzureKinectSkeletonReader::GetFrameTimestamp(int32 Frame) const
+{
+	return FrameIndex.IsValidIndex(Frame) ? FrameIndex[Frame].TimestampUsec : 0;
+}
+
+int32 FAzureKinectSkeletonReader::FindFrame(int64 TimestampUsec) const
+{
+	// First frame after the timestamp, then step back
+	const int32 Upper = Algo::UpperBoundBy(FrameIndex, TimestampUsec, [](const FFrameIndexEntry& Entry) { return Entry.TimestampUsec; });
+	return FMath::Max(Upper - 1, 0);
+}
+
+bool FAzureKinectSkeletonReader::ReadFrame(int32 Frame, int64& OutTimestampUsec, TArray<FAzureKinectSkeleton>& OutSkeletons) const
+{
+	if (!FrameIndex.IsValidIndex(Frame) || !IsFrameInRange(FrameIndex[Frame].Offset, DataSize))
+	{
+		return false;
+	}
+
+	const int64 Offset = FrameIndex[Frame].Offset;
+	const FFrameHeader Header = ReadAt<FFrameHeader>(Data, Offset);
+	OutTimestampUsec = Header.TimestampUsec;
+
+	// Keep joint arrays allocated across frames
+	OutSkeletons.SetNum(Header.NumBodies, false);
+
+	int64 BodyOffset = Offset + sizeof(FFrameHeader);
+	for (uint32 i = 0; i < Header.NumBodies; i++, BodyOffset += sizeof(FBodyRecord))
+	{
+		FAzureKinectSkeleton& Skeleton = OutSkeletons[i];
+		Skeleton.ID = ReadAt<uint32>(Data, BodyOffset);
+		Skeleton.Joints.SetNumUninitialized(JointCount, false);
+		Skeleton.JointConfidences.SetNumUninitialized(JointCount, false);
+		// Body geometry isn't recorded
+		Skeleton.Geometry = FAzureKinectBodyGeometry();
+
+		for (uint32 j = 0; j < JointCount; j++)
+		{
+			const FJointRecord Record = ReadAt<FJointRecord>(Data, BodyOffset + STRUCT_OFFSET(FBodyRecord, Joints) + j * sizeof(FJointRecord));
+
+			const FVector Position(
+				Record.Position[0] / PositionScale,
+				Record.Position[1] / PositionScale,
+				Record.Position[2] / PositionScale);
+			const FQuat Rotation = FQuat(
+				Record.Rotation[0] / RotationScale,
+				Record.Rotation[1] / RotationScale,
+				Record.Rotation[2] / RotationScale,
+				Record.Rotation[3] / RotationScale).GetNormalized();
+
+			Skeleton.Joints[j] = FTransform(Rotation, Position);
+			Skeleton.JointConfidences[j] = static_cast<EKinectJointConfidence>(Record.Confidence);
+		}
+	}
+
+	return true;
+}
+
+bool FAzureKinectSkeletonReader::ReadIndex(bool& bOutHasTrailer)
+{
+	bOutHasTrailer = false;
+	if (DataSize < static_cast<int64>(sizeof(FFileHeader) + sizeof(FTrailer)))
+	{
+		return false;
+	}
+
+	const FTrailer Trailer = ReadAt<FTrailer>(Data, DataSize - sizeof(FTrailer));
+	if (Trailer.Magic != TrailerMagic)
+	{
+		return false;
+	}
+	bOutHasTrailer = true;
+
+	// The index ends right before the trailer, and starts after the file header
+	const int64 IndexEnd = DataSize - sizeof(FTrailer);
+	if (Trailer.IndexOffset < sizeof(FFileHeader) || Trailer.IndexOffset > static_cast<uint64>(IndexEnd) ||
+		(IndexEnd - static_cast<int64>(Trailer.IndexOffset)) != static_cast<int64>(Trailer.NumFrames) * static_cast<int64>(sizeof(FFrameIndexEntry)))
+	{
+		return false;
+	}
+
+	FrameIndex.SetNumUninitialized(Trailer.NumFrames);
+	FMemory::Memcpy(FrameIndex.GetData(), Data + Trailer.IndexOffset, FrameIndex.Num() * sizeof(FFrameIndexEntry));
+
+	// Frames are written before the index
+	for (const FFrameIndexEntry& Entry : FrameIndex)
+	{
+		if (!IsFrameInRange(Entry.Offset, Trailer.IndexOffset))
+		{
+			FrameIndex.Reset();
+			return false;
+		}
+	}
+	return FrameIndex.Num() > 0;
+}
+
+bool FAzureKinectSkeletonReader::IsFrameInRange(uint64 Offset, int64 End) const
+{
+	if (Offset < sizeof(FFileHeader) || Offset > static_cast<uint64>(End) || End - static_cast<int64>(Offset) < static_cast<int64>(sizeof(FFrameHeader)))
+	{
+		return false;
+	}
+	const FFrameHeader Header = ReadAt<FFrameHeader>(Data, Offset);
+	const int64 FrameSize = sizeof(FFrameHeader) + static_cast<int64>(Header.NumBodies) * sizeof(FBodyRecord);
+	return Header.NumBodies <= MaxBodies && static_cast<int64>(Offset) + FrameSize <= End;
+}
+
+bool FAzureKinectSkeletonReader::ScanIndex()
+{
+	UE_LOG(AzureKinectSkeletonStreamLog, Warning, TEXT("Frame index is missing, scanning frames."));
+
+	FrameIndex.Reset();
+	int64 Offset = sizeof(FFileHeader);
+	while (Offset + static_cast<int64>(sizeof(FFrameHeader)) <= DataSize)
+	{
+		if (!IsFrameInRange(Offset, DataSize))
+		{
+			// Truncated tail
+			break;
+		}
+		const FFrameHeader Header = ReadAt<FFrameHeader>(Data, Offset);
+		const int64 FrameSize = sizeof(FFrameHeader) + static_cast<int64>(Header.NumBodies) * sizeof(FBodyRecord);
+
+		FFrameIndexEntry& Entry = FrameIndex.AddDefaulted_GetRef();
+		Entry.Offset = Offset;
+		Entry.TimestampUsec = Header.TimestampUsec;
+		Offset += FrameSize;
+	}
+
+	return FrameIndex.Num() > 0;
+}
@@ -0,0 +1,52 @@
+#include "AzureKinectTextureConverter.h"
+#include "Async/ParallelFor.h"
+
+namespace
+{
+	/** Small enough to stay in cache, large enough to amortize the task. */
+	constexpr int32 PixelsPerTask = 64 * 1024;
+
+	constexpr uint32 OpaqueAlpha = 0xFF000000;
+	constexpr uint32 Blue = 0x00FF0000;
+
+	template<typename SourceType, typename TexelFunctionType>
+	void ForEachPixelBlock(const SourceType* Src, int32 NumPixels, uint8* Dst, TexelFunctionType TexelFunction)
+	{
+		static_assert(PLATFORM_LITTLE_ENDIAN, "Texels are packed as little endian words.");
+		check(IsAligned(Dst, alignof(uint32)));
+
+		uint32* Texels = reinterpret_cast<uint32*>(Dst);
+		ParallelFor(FMath::DivideAndRoundUp(NumPixels, PixelsPerTask), [&](int32 Block)
+		{
+			const int32 End = FMath::Min((Block + 1) * PixelsPerTask, NumPixels);
+			for (int32 i = Block * PixelsPerTask; i < End; i++)
+			{
+				Texels[i] = TexelFunction(static_cast<uint32>(Src[i]));
+			}
+		});
+	}
+}
+
+void FAzureKinectTextureConverter::DepthToRGBA(const uint16* Src, int32 NumPixels, uint8* Dst)
+{
+	ForEachPixelBlock(Src, NumPixels, Dst, [](uint32 Depth)
+	{
+		return Depth | (Depth == 0 ? Blue : 0) | OpaqueAlpha;
+	});
+}
+
+void FAzureKinectTextureConverter::InfraredToRGBA(const uint16* Src, int32 NumPixels, uint8* Dst)
+{
+	ForEachPixelBlock(Src, NumPixels, Dst, [](uint32 Infrared)
+	{
+		return Infrared != 0 ? Infrared | OpaqueAlpha : Blue | OpaqueAlpha;
+	});
+}
+
+void FAzureKinectTextureConverter::BodyIndexToRGBA(const uint8* Src, int32 NumPixels, uint8* Dst)
+{
+	ForEachPixelBlock(Src, NumPixels, Dst, [](uint32 BodyIndex)
+	{
+		return BodyIndex * 0x00010101 | OpaqueAlpha;
+	});
+}
@@ -0,0 +1,290 @@
+#include "AzureKinectTextureTarget.h"
+#include "Async/Async.h"
+#include "RenderingThread.h"
+#include "RHI.h"
+#include "RHICommandList.h"
+#include "TextureResource.h"
+
+DEFINE_STAT(STAT_AzureKinectTextureAllocations);
+DEFINE_STAT(STAT_AzureKinectTextureReallocations);
+DEFINE_STAT(STAT_AzureKinectDroppedUploads);
+DEFINE_STAT(STAT_AzureKinectTextureUpload);
+
+FAzureKinectTextureTarget::FAzureKinectTextureTarget(EPixelFormat InFormat, ETextureRenderTargetFormat InRenderTargetFormat, bool bInForceLinearGamma) :
+	State(MakeShared<FState, ESPMode::ThreadSafe>())
+{
+	State->Format = InFormat;
+	State->RenderTargetFormat = InRenderTargetFormat;
+	State->bForceLinearGamma = bInForceLinearGamma;
+}
+
+FAzureKinectTextureTarget::~FAzureKinectTextureTarget()
+{
+	// After every upload already enqueued
+	ENQUEUE_RENDER_COMMAND(AzureKinectReleaseStaging)(
+		[SharedState = State](FRHICommandListImmediate& RHICmdList) {
+			for (FSlot& Slot : SharedState->Slots)
+			{
+				ReleaseStaging(Slot);
+			}
+		});
+}
+
+void FAzureKinectTextureTarget::Preallocate(UTextureRenderTarget2D* Texture, const FIntPoint& Size)
+{
+	if (Texture && Size.X > 0 && Size.Y > 0)
+	{
+		Allocate(*State, Texture, Size.X, Size.Y);
+	}
+}
+
+uint8* FAzureKinectTextureTarget::BeginUpload(UTextureRenderTarget2D* Texture, int32 Width, int32 Height)
+{
+	check(WritingSlot == INDEX_NONE);
+
+	// Skipped while the texture is resized on the game thread
+	FTextureResource* Resource = GetResourceFor(Texture, Width, Height);
+	if (!Resource)
+	{
+		return nullptr;
+	}
+
+	FSlot& Slot = State->Slots[NextSlot];
+	if (Slot.bInFlight)
+	{
+		State->NumDroppedFrames++;
+		INC_DWORD_STAT(STAT_AzureKinectDroppedUploads);
+		return nullptr;
+	}
+
+	WritingSlot = NextSlot;
+	WritingResource = Resource;
+	WritingSize = FIntPoint(Width, Height);
+
+	// The render thread leaves a claimed staging texture alone until the upload command unmaps it
+	EStaging Expected = EStaging::Mapped;
+	bWritingStaging = Slot.StagingState.CompareExchange(Expected, EStaging::Claimed);
+	if (bWritingStaging && Slot.StagingSize == WritingSize)
+	{
+		return Slot.MappedData;
+	}
+
+	// Keeps the allocation when the frame shrinks
+	Slot.Data.SetNumUninitialized(Width * Height * GPixelFormats[State->Format].BlockBytes, false);
+	return Slot.Data.GetData();
+}
+
+void FAzureKinectTextureTarget::EndUpload()
+{
+	check(WritingSlot != INDEX_NONE);
+
+	State->Slots[WritingSlot].bInFlight = true;
+
+	const int32 SlotIndex = WritingSlot;
+	const FIntPoint Size = WritingSize;
+	const bool bClaimed = bWritingStaging;
+	const bool bStaged = bClaimed && State->Slots[SlotIndex].StagingSize == Size;
+	ENQUEUE_RENDER_COMMAND(AzureKinectTextureUpload)(
+		[SharedState = State, SlotIndex, Resource = WritingResource, Size, bClaimed, bStaged](FRHICommandListImmediate& RHICmdList) {
+			FState& TargetState = *SharedState;
+			FSlot& Slot = TargetState.Slots[SlotIndex];
+			FTexture2DRHIRef Texture2D = Resource->TextureRHI ? Resource->TextureRHI->GetTexture2D() : nullptr;
+			const uint64 StartCycles = FPlatformTime::Cycles64();
+			{
+				SCOPE_CYCLE_COUNTER(STAT_AzureKinectTextureUpload);
+
+				if (bStaged)
+				{
+					// The capture thread is done writing, the GPU copies the texels later
+					RHIUnlockTexture2D(Slot.Staging, 0, false);
+					Slot.MappedData = nullptr;
+					Slot.StagingState = EStaging::Unmapped;
+
+					if (Texture2D)
+					{
+						FRHICopyTextureInfo CopyInfo;
+						CopyInfo.Size = FIntVector(Size.X, Size.Y, 1);
+						RHICmdList.Transition({
+							FRHITransitionInfo(Slot.Staging, ERHIAccess::Unknown, ERHIAccess::CopySrc),
+							FRHITransitionInfo(Texture2D, ERHIAccess::Unknown, ERHIAccess::CopyDest) });
+						RHICmdList.CopyTexture(Slot.Staging, Texture2D, CopyInfo);
+						RHICmdList.Transition(FRHITransitionInfo(Texture2D, ERHIAccess::CopyDest, ERHIAccess::SRVMask));
+					}
+				}
+				else
+				{
+					if (bClaimed)
+					{
+						// Mapped at a previous frame size, recreated below
+						ReleaseStaging(Slot);
+					}
+
+					if (Texture2D)
+					{
+						// The data is consumed before returning, copied into the command list when the RHI runs on its own thread
+						const int32 BytesPerPixel = GPixelFormats[TargetState.Format].BlockBytes;
+						RHIUpdateTexture2D(Texture2D, 0, FUpdateTextureRegion2D(0, 0, 0, 0, Size.X, Size.Y), Size.X * BytesPerPixel, Slot.Data.GetData());
+					}
+				}
+
+				// Copies from the other slots were enqueued a frame ago at least, so mapping them doesn't wait for the GPU in steady state
+				for (int32 i = 0; i < NumSlots; i++)
+				{
+					if (!(bStaged && i == SlotIndex))
+					{
+						MapStaging(TargetState, TargetState.Slots[i], Size);
+					}
+				}
+			}
+
+			if (Texture2D)
+			{
+				const float UploadMs = FPlatformTime::ToMilliseconds64(FPlatformTime::Cycles64() - StartCycles);
+				FScopeLock Lock(&TargetState.TimingCriticalSection);
+				TargetState.AverageUploadMs = TargetState.NumUploads == 0 ? UploadMs : FMath::Lerp(TargetState.AverageUploadMs, UploadMs, 0.05f);
+				TargetState.NumUploads++;
+				TargetState.LastUploadTime = FPlatformTime::Seconds();
+			}
+			Slot.bInFlight = false;
+		});
+
+	NextSlot = (NextSlot + 1) % NumSlots;
+	WritingSlot = INDEX_NONE;
+	bWritingStaging = false;
+	WritingResource = nullptr;
+}
+
+void FAzureKinectTextureTarget::MapStaging(FState& InState, FSlot& Slot, const FIntPoint& Size)
+{
+	check(IsInRenderingThread());
+
+	if (!InState.bStaging || Slot.StagingState != EStaging::Unmapped)
+	{
+		return;
+	}
+	if (!InState.bStagingChecked)
+	{
+		// Elsewhere CPU writable textures are locked through an upload buffer of their own, no better than the fallback
+		InState.bStagingChecked = true;
+		InState.bStaging = GDynamicRHI && FCString::Strcmp(GDynamicRHI->GetName(), TEXT("D3D11")) == 0;
+		if (!InState.bStaging)
+		{
+			return;
+		}
+	}
+
+	if (!Slot.Staging || Slot.StagingSize != Size)
+	{
+		Slot.Staging.SafeRelease();
+		FRHIResourceCreateInfo CreateInfo(TEXT("AzureKinectStaging"));
+		Slot.Staging = RHICreateTexture2D(Size.X, Size.Y, InState.Format, 1, 1, TexCreate_CPUWritable, CreateInfo);
+		Slot.StagingSize = Size;
+	}
+
+	uint32 Stride = 0;
+	uint8* Data = Slot.Staging ? static_cast<uint8*>(RHILockTexture2D(Slot.Staging, 0, RLM_WriteOnly, Stride, false)) : nullptr;
+	if (!Data || Stride != static_cast<uint32>(Size.X * GPixelFormats[InState.Format].BlockBytes))
+	{
+		// Padded rows would need strided writes on the capture thread, the fallback is used from now on
+		if (Data)
+		{
+			RHIUnlockTexture2D(Slot.Staging, 0, false);
+		}
+		Slot.Staging.SafeRelease();
+		Slot.StagingSize = FIntPoint::ZeroValue;
+		InState.bStaging = false;
+		return;
+	}
+
+	Slot.MappedData = Data;
+	// Publishes the mapped memory and its size to the capture thread
+	Slot.StagingState = EStaging::Mapped;
+}
+
+void FAzureKinectTextureTarget::ReleaseStaging(FSlot& Slot)
+{
+	check(IsInRenderingThread());
+
+	if (Slot.StagingState != EStaging::Unmapped)
+	{
+		RHIUnlockTexture2D(Slot.Staging, 0, false);
+		Slot.StagingState = EStaging::Unmapped;
+	}
+	Slot.MappedData = nullptr;
+	Slot.Staging.SafeRelease();
+	Slot.StagingSize = FIntPoint::ZeroValue;
+}
+
+float FAzureKinectTextureTarget::GetAverageUploadMs() const
+{
+	FScopeLock Lock(&State->TimingCriticalSection);
+	return State->AverageUploadMs;
+}
+
+double FAzureKinectTextureTarget::GetLastUploadTime() const
+{
+	FScopeLock Lock(&State->TimingCriticalSection);
+	return State->LastUploadTime;
+}
+
+FTextureResource* FAzureKinectTextureTarget::GetResourceFor(UTextureRenderTarget2D* Texture, int32 Width, int32 Height)
+{
+	{
+		FScopeLock Lock(&State->CriticalSection);
+		// Anything else recreating the resource (ResizeTarget, UpdateResource, an edit in editor) makes the cached one stale
+		if (State->Texture == Texture && State->Size == FIntPoint(Width, Height) &&
+			Texture->Resource == State->Resource && Texture->SizeX == Width && Texture->SizeY == Height)
+		{
+			return State->Resource;
+		}
+		if (State->bResizePending)
+		{
+			return nullptr;
+		}
+		State->bResizePending = true;
+	}
+
+	// Frames don't come at the preallocated size or the resource changed, e.g. the texture was replaced or resized behind our back
+	TWeakObjectPtr<UTextureRenderTarget2D> WeakTexture(Texture);
+	AsyncTask(ENamedThreads::GameThread, [SharedState = State, WeakTexture, Width, Height]()
+	{
+		if (UTextureRenderTarget2D* Target = WeakTexture.Get())
+		{
+			// A recreated resource that still fits is only picked up
+			if (Allocate(*SharedState, Target, Width, Height))
+			{
+				SharedState->NumReallocations++;
+				INC_DWORD_STAT(STAT_AzureKinectTextureReallocations);
+			}
+		}
+		else
+		{
+			FScopeLock Lock(&SharedState->CriticalSection);
+			SharedState->bResizePending = false;
+		}
+	});
+	return nullptr;
+}
+
+bool FAzureKinectTextureTarget::Allocate(FState& InState, UTextureRenderTarget2D* Texture, int32 Width, int32 Height)
+{
+	check(IsInGameThread());
+
+	// InitCustomFormat recreates the resource, so everything else is set before
+	bool bAllocated = false;
+	if (!Texture->Resource || Texture->SizeX != Width || Texture->SizeY != Height || Texture->OverrideFormat != InState.Format ||
+		Texture->RenderTargetFormat != InState.RenderTargetFormat || Texture->bForceLinearGamma != InState.bForceLinearGamma)
+	{
+		Texture->RenderTargetFormat = InState.RenderTargetFormat;
+		Texture->InitCustomFormat(Width, Height, InState.Format, InState.bForceLinearGamma);
+		INC_DWORD_STAT(STAT_AzureKinectTextureAllocations);
+		bAllocated = true;
+	}
+
+	FScopeLock Lock(&InState.CriticalSection);
+	InState.Texture = Texture;
+	InState.Resource = Texture->Resource;
+	InState.Size = FIntPoint(Width, Height);
+	InState.bResizePending = false;
+	return bAllocated;
+}
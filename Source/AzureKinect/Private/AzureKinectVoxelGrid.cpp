@@ -0,0 +1,183 @@
+#include "AzureKinectVoxelGrid.h"
+#include "AzureKinectJointConverter.h"
+#include "Async/ParallelFor.h"
+
+namespace
+{
+	constexpr int32 PointsPerTask = 16384;
+
+	constexpr int32 ShardBits = 6;
+	constexpr int32 NumShards = 1 << ShardBits;
+
+	constexpr uint64 InvalidKey = ~0ull;
+
+	/** 21 bits per axis, about 10 km across at 1 cm voxels. */
+	FORCEINLINE uint64 MakeKey(int32 X, int32 Y, int32 Z)
+	{
+		constexpr int32 Bias = 1 << 20;
+		constexpr uint64 Mask = (1ull << 21) - 1;
+		return (static_cast<uint64>(X + Bias) & Mask) | (static_cast<uint64>(Y + Bias) & Mask) << 21 | (static_cast<uint64>(Z + Bias) & Mask) << 42;
+	}
+
+	/** Fibonacci hashing, neighbor voxels end up in different shards. */
+	FORCEINLINE int32 GetShard(uint64 Key)
+	{
+		return static_cast<int32>((Key * 0x9E3779B97F4A7C15ull) >> (64 - ShardBits));
+	}
+}
+
+void FAzureKinectVoxelGrid::Build(const TArray<FAzureKinectVoxelGridSource>& Sources, const FAzureKinectVoxelGridSettings& Settings, FAzureKinectFusedPointCloud& OutCloud, FAzureKinectVoxelGridStats& OutStats)
+{
+	const double StartTime = FPlatformTime::Seconds();
+
+	OutStats = FAzureKinectVoxelGridStats();
+	OutCloud.TimestampUsec = 0;
+
+	TArray<FMatrix, TInlineAllocator<8>> PointToWorld;
+	Chunks.Reset();
+	int32 NumEntries = 0;
+	for (int32 s = 0; s < Sources.Num(); s++)
+	{
+		const FAzureKinectPointCloud& Cloud = *Sources[s].PointCloud;
+		PointToWorld.Add(FAzureKinectJointConverter::MakePointToWorld(Sources[s].CameraToWorld));
+		OutCloud.TimestampUsec = FMath::Max(OutCloud.TimestampUsec, Cloud.TimestampUsec);
+
+		for (int32 Start = 0; Start < Cloud.GetNumPoints(); Start += PointsPerTask)
+		{
+			const int32 End = FMath::Min(Start + PointsPerTask, Cloud.GetNumPoints());
+			Chunks.Add({ s, Start, End, NumEntries });
+			NumEntries += End - Start;
+		}
+	}
+	OutStats.NumDevices = Sources.Num();
+
+	Entries.SetNumUninitialized(NumEntries, false);
+	ChunkShardCounts.SetNumUninitialized(Chunks.Num() * NumShards, false);
+	FMemory::Memzero(ChunkShardCounts.GetData(), ChunkShardCounts.Num() * sizeof(int32));
+	const float InvVoxelSize = 1.f / FMath::Max(Settings.VoxelSize, 0.1f);
+
+	// Transform to world and bin
+	ParallelFor(Chunks.Num(), [&](int32 c)
+	{
+		const FChunk& Chunk = Chunks[c];
+		const FAzureKinectPointCloud& Cloud = *Sources[Chunk.Source].PointCloud;
+		const FMatrix& Matrix = PointToWorld[Chunk.Source];
+		const bool bHasColor = Cloud.Colors.Num() == Cloud.GetNumPoints();
+		int32* Counts = &ChunkShardCounts[c * NumShards];
+
+		for (int32 i = Chunk.Start; i < Chunk.End; i++)
+		{
+			FEntry& Entry = Entries[Chunk.EntryOffset + i - Chunk.Start];
+			const int16* P = &Cloud.Positions[i * 3];
+			if (P[2] == 0)
+			{
+				Entry.Key = InvalidKey;
+				continue;
+			}
+
+			Entry.Position = Matrix.TransformPosition(FVector(P[0], P[1], P[2]));
+			Entry.Key = MakeKey(
+				FMath::FloorToInt(Entry.Position.X * InvVoxelSize),
+				FMath::FloorToInt(Entry.Position.Y * InvVoxelSize),
+				FMath::FloorToInt(Entry.Position.Z * InvVoxelSize));
+			Entry.Color = bHasColor ? Cloud.Colors[i] : FColor::White;
+			Counts[GetShard(Entry.Key)]++;
+		}
+	});
+
+	// Offsets, shard major so each shard is contiguous
+	ShardStarts.SetNumUninitialized(NumShards + 1, false);
+	int32 Offset = 0;
+	for (int32 s = 0; s < NumShards; s++)
+	{
+		ShardStarts[s] = Offset;
+		for (int32 c = 0; c < Chunks.Num(); c++)
+		{
+			const int32 Count = ChunkShardCounts[c * NumShards + s];
+			ChunkShardCounts[c * NumShards + s] = Offset;
+			Offset += Count;
+		}
+	}
+	ShardStarts[NumShards] = Offset;
+	OutStats.PointsIn = Offset;
+
+	Partitioned.SetNumUninitialized(Offset, false);
+	ParallelFor(Chunks.Num(), [&](int32 c)
+	{
+		const FChunk& Chunk = Chunks[c];
+		int32* Offsets = &ChunkShardCounts[c * NumShards];
+		for (int32 i = 0; i < Chunk.End - Chunk.Start; i++)
+		{
+			const FEntry& Entry = Entries[Chunk.EntryOffset + i];
+			if (Entry.Key == InvalidKey) continue;
+			Partitioned[Offsets[GetShard(Entry.Key)]++] = Entry;
+		}
+	});
+
+	// Reduce each shard independently
+	Shards.SetNum(NumShards, false);
+	const int32 MinPoints = FMath::Max(Settings.MinPointsPerVoxel, 1);
+	ParallelFor(NumShards, [&](int32 s)
+	{
+		FShard& Shard = Shards[s];
+		Shard.Index.Reset();
+		Shard.Voxels.Reset();
+
+		for (int32 i = ShardStarts[s]; i < ShardStarts[s + 1]; i++)
+		{
+			const FEntry& Entry = Partitioned[i];
+			int32& VoxelIndex = Shard.Index.FindOrAdd(Entry.Key, INDEX_NONE);
+			if (VoxelIndex == INDEX_NONE)
+			{
+				VoxelIndex = Shard.Voxels.Add({ FVector::ZeroVector, { 0, 0, 0 }, 0, 0 });
+			}
+
+			FVoxel& Voxel = Shard.Voxels[VoxelIndex];
+			Voxel.PositionSum += Entry.Position;
+			Voxel.Count++;
+			// Black with alpha 0 from color_image_to_depth_camera, it would darken the voxel
+			if (Entry.Color.A != 0)
+			{
+				Voxel.ColorSum[0] += Entry.Color.R;
+				Voxel.ColorSum[1] += Entry.Color.G;
+				Voxel.ColorSum[2] += Entry.Color.B;
+				Voxel.ColorCount++;
+			}
+		}
+
+		Shard.NumOut = 0;
+		for (const FVoxel& Voxel : Shard.Voxels)
+		{
+			Shard.NumOut += Voxel.Count >= MinPoints ? 1 : 0;
+		}
+	});
+
+	int32 NumOut = 0;
+	for (FShard& Shard : Shards)
+	{
+		Shard.OutOffset = NumOut;
+		NumOut += Shard.NumOut;
+	}
+	OutStats.PointsOut = NumOut;
+
+	OutCloud.Positions.SetNumUninitialized(NumOut, false);
+	OutCloud.Colors.SetNumUninitialized(NumOut, false);
+	ParallelFor(NumShards, [&](int32 s)
+	{
+		const FShard& Shard = Shards[s];
+		int32 Out = Shard.OutOffset;
+		for (const FVoxel& Voxel : Shard.Voxels)
+		{
+			if (Voxel.Count < MinPoints) continue;
+
+			const float InvCount = 1.f / Voxel.Count;
+			OutCloud.Positions[Out] = Voxel.PositionSum * InvCount;
+			OutCloud.Colors[Out] = Voxel.ColorCount > 0
+				? FColor(Voxel.ColorSum[0] / Voxel.ColorCount, Voxel.ColorSum[1] / Voxel.ColorCount, Voxel.ColorSum[2] / Voxel.ColorCount, 0xFF)
+				: FColor(0xFF, 0xFF, 0xFF, 0);
+			Out++;
+		}
+	});
+
+	OutStats.BuildMs = static_cast<float>((FPlatformTime::Seconds() - StartTime) * 1000.0);
+}
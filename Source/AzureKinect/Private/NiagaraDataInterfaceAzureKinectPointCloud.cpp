@@ -0,0 +1,197 @@
+#include "NiagaraDataInterfaceAzureKinectPointCloud.h"
+#include "NiagaraTypes.h"
+#include "AzureKinectJointConverter.h"
+
+namespace
+{
+	const FName GetNumPointsName(TEXT("GetNumPoints"));
+	const FName GetPointPositionName(TEXT("GetPointPosition"));
+	const FName GetPointColorName(TEXT("GetPointColor"));
+	const FName GetPointBodyIndexName(TEXT("GetPointBodyIndex"));
+
+	/** Source index of a strided point, or INDEX_NONE if out of range. */
+	FORCEINLINE int32 ToSourceIndex(const FNDIAzureKinectPointCloudInstanceData& Data, int32 Index)
+	{
+		if (!Data.PointCloud || Index < 0 || Index >= Data.Width * Data.Height) return INDEX_NONE;
+
+		const int32 x = (Index % Data.Width) * Data.Stride;
+		const int32 y = (Index / Data.Width) * Data.Stride;
+		return y * Data.PointCloud->Width + x;
+	}
+}
+
+DEFINE_NDI_DIRECT_FUNC_BINDER(UNiagaraDataInterfaceAzureKinectPointCloud, GetNumPoints);
+DEFINE_NDI_DIRECT_FUNC_BINDER(UNiagaraDataInterfaceAzureKinectPointCloud, GetPointPosition);
+DEFINE_NDI_DIRECT_FUNC_BINDER(UNiagaraDataInterfaceAzureKinectPointCloud, GetPointColor);
+DEFINE_NDI_DIRECT_FUNC_BINDER(UNiagaraDataInterfaceAzureKinectPointCloud, GetPointBodyIndex);
+
+UNiagaraDataInterfaceAzureKinectPointCloud::UNiagaraDataInterfaceAzureKinectPointCloud(const FObjectInitializer& ObjectInitializer) :
+	Super(ObjectInitializer),
+	Device(nullptr),
+	Stride(2),
+	bWorldSpace(true)
+{
+}
+
+void UNiagaraDataInterfaceAzureKinectPointCloud::PostInitProperties()
+{
+	Super::PostInitProperties();
+
+	if (HasAnyFlags(RF_ClassDefaultObject))
+	{
+		FNiagaraTypeRegistry::Register(FNiagaraTypeDefinition(GetClass()), true, false, false);
+	}
+}
+
+void UNiagaraDataInterfaceAzureKinectPointCloud::GetFunctions(TArray<FNiagaraFunctionSignature>& OutFunctions)
+{
+	const FNiagaraVariable Self(FNiagaraTypeDefinition(GetClass()), TEXT("PointCloud"));
+	const FNiagaraVariable Index(FNiagaraTypeDefinition::GetIntDef(), TEXT("Index"));
+
+	auto AddFunction = [&](FName Name, bool bIndexed, const FNiagaraVariable& Output)
+	{
+		FNiagaraFunctionSignature& Sig = OutFunctions.AddDefaulted_GetRef();
+		Sig.Name = Name;
+		Sig.bMemberFunction = true;
+		Sig.bRequiresContext = false;
+		Sig.Inputs.Add(Self);
+		if (bIndexed)
+		{
+			Sig.Inputs.Add(Index);
+		}
+		Sig.Outputs.Add(Output);
+		return &Sig;
+	};
+
+	AddFunction(GetNumPointsName, false, FNiagaraVariable(FNiagaraTypeDefinition::GetIntDef(), TEXT("Num")));
+	AddFunction(GetPointPositionName, true, FNiagaraVariable(FNiagaraTypeDefinition::GetVec3Def(), TEXT("Position")))
+		->Outputs.Add(FNiagaraVariable(FNiagaraTypeDefinition::GetBoolDef(), TEXT("Valid")));
+	AddFunction(GetPointColorName, true, FNiagaraVariable(FNiagaraTypeDefinition::GetColorDef(), TEXT("Color")));
+	AddFunction(GetPointBodyIndexName, true, FNiagaraVariable(FNiagaraTypeDefinition::GetIntDef(), TEXT("BodyIndex")));
+}
+
+void UNiagaraDataInterfaceAzureKinectPointCloud::GetVMExternalFunction(const FVMExternalFunctionBindingInfo& BindingInfo, void* InstanceData, FVMExternalFunction& OutFunc)
+{
+	if (BindingInfo.Name == GetNumPointsName)
+	{
+		NDI_FUNC_BINDER(UNiagaraDataInterfaceAzureKinectPointCloud, GetNumPoints)::Bind(this, OutFunc);
+	}
+	else if (BindingInfo.Name == GetPointPositionName)
+	{
+		NDI_FUNC_BINDER(UNiagaraDataInterfaceAzureKinectPointCloud, GetPointPosition)::Bind(this, OutFunc);
+	}
+	else if (BindingInfo.Name == GetPointColorName)
+	{
+		NDI_FUNC_BINDER(UNiagaraDataInterfaceAzureKinectPointCloud, GetPointColor)::Bind(this, OutFunc);
+	}
+	else if (BindingInfo.Name == GetPointBodyIndexName)
+	{
+		NDI_FUNC_BINDER(UNiagaraDataInterfaceAzureKinectPointCloud, GetPointBodyIndex)::Bind(this, OutFunc);
+	}
+}
+
+bool UNiagaraDataInterfaceAzureKinectPointCloud::InitPerInstanceData(void* PerInstanceData, FNiagaraSystemInstance* SystemInstance)
+{
+	FNDIAzureKinectPointCloudInstanceData* Data = new (PerInstanceData) FNDIAzureKinectPointCloudInstanceData();
+	Data->PointToWorld = FMatrix::Identity;
+	Data->Stride = Stride;
+	Data->Width = 0;
+	Data->Height = 0;
+	return true;
+}
+
+void UNiagaraDataInterfaceAzureKinectPointCloud::DestroyPerInstanceData(void* PerInstanceData, FNiagaraSystemInstance* SystemInstance)
+{
+	static_cast<FNDIAzureKinectPointCloudInstanceData*>(PerInstanceData)->~FNDIAzureKinectPointCloudInstanceData();
+}
+
+bool UNiagaraDataInterfaceAzureKinectPointCloud::PerInstanceTick(void* PerInstanceData, FNiagaraSystemInstance* SystemInstance, float DeltaSeconds)
+{
+	FNDIAzureKinectPointCloudInstanceData* Data = static_cast<FNDIAzureKinectPointCloudInstanceData*>(PerInstanceData);
+
+	// Holding the frame keeps it out of the device pool until the next tick
+	Data->PointCloud = Device ? Device->GetLatestPointCloud() : nullptr;
+	Data->Stride = FMath::Max(Stride, 1);
+	Data->Width = Data->PointCloud ? FMath::DivideAndRoundUp(Data->PointCloud->Width, Data->Stride) : 0;
+	Data->Height = Data->PointCloud ? FMath::DivideAndRoundUp(Data->PointCloud->Height, Data->Stride) : 0;
+	Data->PointToWorld = FAzureKinectJointConverter::MakePointToWorld(bWorldSpace && Device ? Device->GetDepthCameraToWorld() : FTransform::Identity);
+
+	return false;
+}
+
+bool UNiagaraDataInterfaceAzureKinectPointCloud::Equals(const UNiagaraDataInterface* Other) const
+{
+	if (!Super::Equals(Other)) return false;
+
+	const UNiagaraDataInterfaceAzureKinectPointCloud* Typed = CastChecked<const UNiagaraDataInterfaceAzureKinectPointCloud>(Other);
+	return Typed->Device == Device && Typed->Stride == Stride && Typed->bWorldSpace == bWorldSpace;
+}
+
+bool UNiagaraDataInterfaceAzureKinectPointCloud::CopyToInternal(UNiagaraDataInterface* Destination) const
+{
+	if (!Super::CopyToInternal(Destination)) return false;
+
+	UNiagaraDataInterfaceAzureKinectPointCloud* Typed = CastChecked<UNiagaraDataInterfaceAzureKinectPointCloud>(Destination);
+	Typed->Device = Device;
+	Typed->Stride = Stride;
+	Typed->bWorldSpace = bWorldSpace;
+	return true;
+}
+
+void UNiagaraDataInterfaceAzureKinectPointCloud::GetNumPoints(FVectorVMContext& Context)
+{
+	VectorVM::FUserPtrHandler<FNDIAzureKinectPointCloudInstanceData> Data(Context);
+	FNDIOutputParam<int32> OutNum(Context);
+
+	for (int32 i = 0; i < Context.NumInstances; i++)
+	{
+		OutNum.SetAndAdvance(Data->Width * Data->Height);
+	}
+}
+
+void UNiagaraDataInterfaceAzureKinectPointCloud::GetPointPosition(FVectorVMContext& Context)
+{
+	VectorVM::FUserPtrHandler<FNDIAzureKinectPointCloudInstanceData> Data(Context);
+	FNDIInputParam<int32> InIndex(Context);
+	FNDIOutputParam<FVector> OutPosition(Context);
+	FNDIOutputParam<bool> OutValid(Context);
+
+	for (int32 i = 0; i < Context.NumInstances; i++)
+	{
+		const int32 Source = ToSourceIndex(*Data, InIndex.GetAndAdvance());
+		const int16* P = Source != INDEX_NONE ? &Data->PointCloud->Positions[Source * 3] : nullptr;
+		const bool bValid = P && P[2] != 0;
+
+		OutPosition.SetAndAdvance(bValid ? Data->PointToWorld.TransformPosition(FVector(P[0], P[1], P[2])) : FVector::ZeroVector);
+		OutValid.SetAndAdvance(bValid);
+	}
+}
+
+void UNiagaraDataInterfaceAzureKinectPointCloud::GetPointColor(FVectorVMContext& Context)
+{
+	VectorVM::FUserPtrHandler<FNDIAzureKinectPointCloudInstanceData> Data(Context);
+	FNDIInputParam<int32> InIndex(Context);
+	FNDIOutputParam<FLinearColor> OutColor(Context);
+
+	const bool bHasColor = Data->PointCloud && Data->PointCloud->Colors.Num() == Data->PointCloud->GetNumPoints();
+	for (int32 i = 0; i < Context.NumInstances; i++)
+	{
+		const int32 Source = ToSourceIndex(*Data, InIndex.GetAndAdvance());
+		OutColor.SetAndAdvance(bHasColor && Source != INDEX_NONE ? FLinearColor(Data->PointCloud->Colors[Source]) : FLinearColor::White);
+	}
+}
+
+void UNiagaraDataInterfaceAzureKinectPointCloud::GetPointBodyIndex(FVectorVMContext& Context)
+{
+	VectorVM::FUserPtrHandler<FNDIAzureKinectPointCloudInstanceData> Data(Context);
+	FNDIInputParam<int32> InIndex(Context);
+	FNDIOutputParam<int32> OutBodyIndex(Context);
+
+	const bool bHasBodies = Data->PointCloud && Data->PointCloud->BodyIndices.Num() == Data->PointCloud->GetNumPoints();
+	for (int32 i = 0; i < Context.NumInstances; i++)
+	{
+		const int32 Source = ToSourceIndex(*Data, InIndex.GetAndAdvance());
+		const uint8 BodyIndex = bHasBodies && Source != INDEX_NONE ? Data->PointCloud->BodyIndices[Source] : K4ABT_BODY_INDEX_MAP_BACKGROUND;
+		OutBodyIndex.SetAndAdvance(BodyIndex == K4ABT_BODY_INDEX_MAP_BACKGROUND ? INDEX_NONE : BodyIndex);
+	}
+}
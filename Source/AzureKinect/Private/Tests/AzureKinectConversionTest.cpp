@@ -0,0 +1,331 @@
+#include "Misc/AutomationTest.h"
+#include "AzureKinectColorConverter.h"
+#include "AzureKinectJointConverter.h"
+#include "AzureKinectTextureConverter.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+namespace
+{
+	/** Depth, IR and body index sizes of every depth mode. */
+	const FIntPoint DepthResolutions[] = { { 320, 288 }, { 640, 576 }, { 512, 512 }, { 1024, 1024 } };
+
+	/** Depth remapped to color comes at every color resolution. */
+	const FIntPoint ColorResolutions[] = { { 1280, 720 }, { 1920, 1080 }, { 2560, 1440 }, { 2048, 1536 }, { 3840, 2160 }, { 4096, 3072 } };
+
+	/** Random 16 bit samples with invalid pixels and values that only set one of the bytes. */
+	TArray<uint16> MakeSamples(int32 NumPixels, int32 Seed)
+	{
+		static const uint16 EdgeValues[] = { 0, 1, 0x00FF, 0x0100, 0xFF00, 0xFFFF };
+
+		FRandomStream Random(Seed);
+		TArray<uint16> Samples;
+		Samples.SetNumUninitialized(NumPixels);
+		for (int32 i = 0; i < NumPixels; i++)
+		{
+			Samples[i] = i < static_cast<int32>(UE_ARRAY_COUNT(EdgeValues)) ? EdgeValues[i]
+				: Random.FRand() < 0.1f ? 0
+				: static_cast<uint16>(Random.RandHelper(0x10000));
+		}
+		return Samples;
+	}
+
+	/** Depth texels as UAzureKinectDevice::CaptureDepthImage built them byte by byte. */
+	TArray<uint8> ReferenceDepthToRGBA(const uint8* SourceBuffer, int32 NumPixels)
+	{
+		TArray<uint8> SrcData;
+		SrcData.Reserve(NumPixels * 4);
+		for (int32 index = 0; index < NumPixels; index++)
+		{
+			const uint16 Sample = SourceBuffer[index * 2 + 1] << 8 | SourceBuffer[index * 2];
+			SrcData.Add(SourceBuffer[index * 2]);
+			SrcData.Add(SourceBuffer[index * 2 + 1]);
+			SrcData.Add(Sample > 0 ? 0x00 : 0xFF);
+			SrcData.Add(0xFF);
+		}
+		return SrcData;
+	}
+
+	/** IR texels as UAzureKinectDevice::CaptureInflaredImage built them. */
+	TArray<uint8> ReferenceInfraredToRGBA(const uint8* S, int32 NumPixels)
+	{
+		TArray<uint8> SrcData;
+		SrcData.Reserve(NumPixels * 4);
+		for (int32 index = 0; index < NumPixels; index++)
+		{
+			if (S[index * 2] + S[index * 2 + 1] > 0)
+			{
+				SrcData.Add(S[index * 2]);
+				SrcData.Add(S[index * 2 + 1]);
+				SrcData.Add(0x00);
+				SrcData.Add(0xff);
+			}
+			else
+			{
+				SrcData.Add(0x00);
+				SrcData.Add(0x00);
+				SrcData.Add(0xff);
+				SrcData.Add(0xff);
+			}
+		}
+		return SrcData;
+	}
+
+	/** Body index texels as UAzureKinectDevice::CaptureBodyIndexImage built them. */
+	TArray<uint8> ReferenceBodyIndexToRGBA(const uint8* S, int32 NumPixels)
+	{
+		TArray<uint8> SrcData;
+		SrcData.Reserve(NumPixels * 4);
+		for (int32 i = 0; i < NumPixels; i++)
+		{
+			SrcData.Add(S[i]);
+			SrcData.Add(S[i]);
+			SrcData.Add(S[i]);
+			SrcData.Add(0xff);
+		}
+		return SrcData;
+	}
+
+	/** Joints as UAzureKinectDevice::JointToTransform converted them before FAzureKinectJointConverter, without extrinsic. */
+	FTransform ReferenceJointToTransform(const k4abt_joint_t& Joint)
+	{
+		FVector Position(Joint.position.xyz.z, Joint.position.xyz.x, -Joint.position.xyz.y);
+		Position *= 0.1f;
+		const FQuat Quat(-Joint.orientation.wxyz.x, -Joint.orientation.wxyz.y, Joint.orientation.wxyz.z, Joint.orientation.wxyz.w);
+		return FTransform(Quat, Position);
+	}
+
+	/** BT.601 limited range in 6bit fixed point, the scalar path of FAzureKinectColorConverter. */
+	FColor ReferenceYuvToColor(int32 Y, int32 U, int32 V)
+	{
+		const int32 C = (Y - 16) * 75, D = U - 128, E = V - 128;
+		return FColor(
+			static_cast<uint8>(FMath::Clamp((C + 102 * E + 32) >> 6, 0, 255)),
+			static_cast<uint8>(FMath::Clamp((C - 25 * D - 52 * E + 32) >> 6, 0, 255)),
+			static_cast<uint8>(FMath::Clamp((C + 129 * D + 32) >> 6, 0, 255)),
+			0xFF);
+	}
+
+	/** Report the first texel that differs, if any. */
+	bool TestSameTexels(FAutomationTestBase& Test, const FString& What, const TArray<uint8>& Actual, const TArray<uint8>& Expected)
+	{
+		if (Actual.Num() != Expected.Num())
+		{
+			Test.AddError(FString::Printf(TEXT("%s: %d bytes, expected %d"), *What, Actual.Num(), Expected.Num()));
+			return false;
+		}
+		for (int32 i = 0; i < Expected.Num(); i += 4)
+		{
+			if (FMemory::Memcmp(&Actual[i], &Expected[i], 4) != 0)
+			{
+				Test.AddError(FString::Printf(TEXT("%s: texel %d is %02X %02X %02X %02X, expected %02X %02X %02X %02X"), *What, i / 4,
+					Actual[i], Actual[i + 1], Actual[i + 2], Actual[i + 3], Expected[i], Expected[i + 1], Expected[i + 2], Expected[i + 3]));
+				return false;
+			}
+		}
+		return true;
+	}
+
+	bool TestSameColors(FAutomationTestBase& Test, const FString& What, const TArray<FColor>& Actual, const TArray<FColor>& Expected)
+	{
+		for (int32 i = 0; i < Expected.Num(); i++)
+		{
+			if (Actual[i] != Expected[i])
+			{
+				Test.AddError(FString::Printf(TEXT("%s: pixel %d is %s, expected %s"), *What, i, *Actual[i].ToString(), *Expected[i].ToString()));
+				return false;
+			}
+		}
+		return true;
+	}
+
+	void MakeJoints(FRandomStream& Random, k4abt_joint_t* OutJoints, int32 NumJoints)
+	{
+		for (int32 j = 0; j < NumJoints; j++)
+		{
+			const FQuat Orientation(Random.GetUnitVector(), Random.FRandRange(-PI, PI));
+			OutJoints[j].position = { { Random.FRandRange(-2000.f, 2000.f), Random.FRandRange(-2000.f, 2000.f), Random.FRandRange(500.f, 5000.f) } };
+			OutJoints[j].orientation = { { Orientation.W, Orientation.X, Orientation.Y, Orientation.Z } };
+			OutJoints[j].confidence_level = K4ABT_JOINT_CONFIDENCE_MEDIUM;
+		}
+	}
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FAzureKinectDepthTexelTest, "Plugins.AzureKinect.Conversion.Depth",
+	EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::EngineFilter)
+
+bool FAzureKinectDepthTexelTest::RunTest(const FString& Parameters)
+{
+	TArray<FIntPoint> Resolutions(DepthResolutions, UE_ARRAY_COUNT(DepthResolutions));
+	Resolutions.Append(ColorResolutions, UE_ARRAY_COUNT(ColorResolutions));
+
+	for (const FIntPoint& Resolution : Resolutions)
+	{
+		const int32 NumPixels = Resolution.X * Resolution.Y;
+		const TArray<uint16> Depth = MakeSamples(NumPixels, Resolution.X);
+
+		TArray<uint8> Texels;
+		Texels.SetNumUninitialized(NumPixels * 4);
+		FAzureKinectTextureConverter::DepthToRGBA(Depth.GetData(), NumPixels, Texels.GetData());
+		TestSameTexels(*this, FString::Printf(TEXT("Depth %dx%d"), Resolution.X, Resolution.Y),
+			Texels, ReferenceDepthToRGBA(reinterpret_cast<const uint8*>(Depth.GetData()), NumPixels));
+	}
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FAzureKinectInfraredTexelTest, "Plugins.AzureKinect.Conversion.Infrared",
+	EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::EngineFilter)
+
+bool FAzureKinectInfraredTexelTest::RunTest(const FString& Parameters)
+{
+	for (const FIntPoint& Resolution : DepthResolutions)
+	{
+		const int32 NumPixels = Resolution.X * Resolution.Y;
+		const TArray<uint16> Infrared = MakeSamples(NumPixels, Resolution.Y);
+
+		TArray<uint8> Texels;
+		Texels.SetNumUninitialized(NumPixels * 4);
+		FAzureKinectTextureConverter::InfraredToRGBA(Infrared.GetData(), NumPixels, Texels.GetData());
+		TestSameTexels(*this, FString::Printf(TEXT("IR %dx%d"), Resolution.X, Resolution.Y),
+			Texels, ReferenceInfraredToRGBA(reinterpret_cast<const uint8*>(Infrared.GetData()), NumPixels));
+	}
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FAzureKinectBodyIndexTexelTest, "Plugins.AzureKinect.Conversion.BodyIndex",
+	EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::EngineFilter)
+
+bool FAzureKinectBodyIndexTexelTest::RunTest(const FString& Parameters)
+{
+	for (const FIntPoint& Resolution : DepthResolutions)
+	{
+		const int32 NumPixels = Resolution.X * Resolution.Y;
+
+		// Mostly background with every body index somewhere
+		FRandomStream Random(NumPixels);
+		TArray<uint8> BodyIndices;
+		BodyIndices.SetNumUninitialized(NumPixels);
+		for (int32 i = 0; i < NumPixels; i++)
+		{
+			BodyIndices[i] = i < 256 ? static_cast<uint8>(i) : Random.FRand() < 0.7f ? 255 : static_cast<uint8>(Random.RandHelper(6));
+		}
+
+		TArray<uint8> Texels;
+		Texels.SetNumUninitialized(NumPixels * 4);
+		FAzureKinectTextureConverter::BodyIndexToRGBA(BodyIndices.GetData(), NumPixels, Texels.GetData());
+		TestSameTexels(*this, FString::Printf(TEXT("Body index %dx%d"), Resolution.X, Resolution.Y),
+			Texels, ReferenceBodyIndexToRGBA(BodyIndices.GetData(), NumPixels));
+	}
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FAzureKinectColorConversionTest, "Plugins.AzureKinect.Conversion.Color",
+	EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::EngineFilter)
+
+bool FAzureKinectColorConversionTest::RunTest(const FString& Parameters)
+{
+	// 720p is the only YUV mode, the odd sizes end rows with the scalar tail and have padded strides
+	const FIntPoint Resolutions[] = { { 1280, 720 }, { 22, 6 }, { 2, 2 } };
+
+	for (const FIntPoint& Resolution : Resolutions)
+	{
+		const int32 Width = Resolution.X, Height = Resolution.Y;
+		const int32 Padding = Width < 64 ? 6 : 0;
+		FRandomStream Random(Width);
+
+		TArray<FColor> Expected, Actual;
+		Expected.SetNumUninitialized(Width * Height);
+		Actual.SetNumUninitialized(Width * Height);
+
+		// NV12: Y plane, then interleaved UV at half the resolution
+		const int32 NV12Stride = Width + Padding;
+		TArray<uint8> NV12;
+		NV12.SetNumUninitialized(NV12Stride * Height * 3 / 2);
+		for (uint8& Byte : NV12)
+		{
+			Byte = static_cast<uint8>(Random.RandHelper(256));
+		}
+		const uint8* UVPlane = NV12.GetData() + NV12Stride * Height;
+		for (int32 y = 0; y < Height; y++)
+		{
+			for (int32 x = 0; x < Width; x++)
+			{
+				const uint8* UV = UVPlane + (y / 2) * NV12Stride + (x / 2) * 2;
+				Expected[y * Width + x] = ReferenceYuvToColor(NV12[y * NV12Stride + x], UV[0], UV[1]);
+			}
+		}
+		FAzureKinectColorConverter::ConvertNV12(NV12.GetData(), Width, Height, NV12Stride, Actual.GetData());
+		TestSameColors(*this, FString::Printf(TEXT("NV12 %dx%d"), Width, Height), Actual, Expected);
+
+		// YUY2: Y0 U Y1 V per pixel pair
+		const int32 YUY2Stride = Width * 2 + Padding;
+		TArray<uint8> YUY2;
+		YUY2.SetNumUninitialized(YUY2Stride * Height);
+		for (uint8& Byte : YUY2)
+		{
+			Byte = static_cast<uint8>(Random.RandHelper(256));
+		}
+		for (int32 y = 0; y < Height; y++)
+		{
+			for (int32 x = 0; x < Width; x++)
+			{
+				const uint8* Pair = &YUY2[y * YUY2Stride + (x / 2) * 4];
+				Expected[y * Width + x] = ReferenceYuvToColor(Pair[(x & 1) * 2], Pair[1], Pair[3]);
+			}
+		}
+		FAzureKinectColorConverter::ConvertYUY2(YUY2.GetData(), Width, Height, YUY2Stride, Actual.GetData());
+		TestSameColors(*this, FString::Printf(TEXT("YUY2 %dx%d"), Width, Height), Actual, Expected);
+	}
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FAzureKinectJointConversionTest, "Plugins.AzureKinect.Conversion.Joints",
+	EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::EngineFilter)
+
+bool FAzureKinectJointConversionTest::RunTest(const FString& Parameters)
+{
+	FRandomStream Random(32);
+	k4abt_joint_t Joints[K4ABT_JOINT_COUNT];
+	FTransform Converted[K4ABT_JOINT_COUNT];
+
+	// Without extrinsic the folded matrix only scales and swaps axes, so the result is bit-exact
+	const FAzureKinectJointConverter IdentityConverter;
+	for (int32 Body = 0; Body < 16; Body++)
+	{
+		MakeJoints(Random, Joints, K4ABT_JOINT_COUNT);
+		IdentityConverter.Convert(Joints, K4ABT_JOINT_COUNT, Converted);
+		for (int32 j = 0; j < K4ABT_JOINT_COUNT; j++)
+		{
+			const FTransform Expected = ReferenceJointToTransform(Joints[j]);
+			const FQuat ExpectedRotation = Expected.GetRotation(), Rotation = Converted[j].GetRotation();
+			if (Converted[j].GetLocation() != Expected.GetLocation() || Rotation.X != ExpectedRotation.X || Rotation.Y != ExpectedRotation.Y ||
+				Rotation.Z != ExpectedRotation.Z || Rotation.W != ExpectedRotation.W)
+			{
+				AddError(FString::Printf(TEXT("Joint %d is %s, expected %s"), j, *Converted[j].ToString(), *Expected.ToString()));
+				return true;
+			}
+		}
+	}
+
+	// With an extrinsic it's the reference composed with the camera transform, up to rounding
+	for (int32 Body = 0; Body < 16; Body++)
+	{
+		const FTransform CameraToWorld(FQuat(Random.GetUnitVector(), Random.FRandRange(-PI, PI)), Random.GetUnitVector() * Random.FRandRange(0.f, 500.f));
+		const FAzureKinectJointConverter Converter(CameraToWorld);
+		MakeJoints(Random, Joints, K4ABT_JOINT_COUNT);
+		Converter.Convert(Joints, K4ABT_JOINT_COUNT, Converted);
+		for (int32 j = 0; j < K4ABT_JOINT_COUNT; j++)
+		{
+			const FTransform Expected = ReferenceJointToTransform(Joints[j]) * CameraToWorld;
+			if (!Converted[j].GetLocation().Equals(Expected.GetLocation(), 1e-2f) ||
+				Converted[j].GetRotation().AngularDistance(Expected.GetRotation()) > 1e-4f)
+			{
+				AddError(FString::Printf(TEXT("Joint %d with extrinsic %s is %s, expected %s"), j, *CameraToWorld.ToString(), *Converted[j].ToString(), *Expected.ToString()));
+				return true;
+			}
+		}
+	}
+	return true;
+}
+
+#endif
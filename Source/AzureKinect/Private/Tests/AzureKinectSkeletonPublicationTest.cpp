@@ -0,0 +1,162 @@
+#include "Misc/AutomationTest.h"
+#include "Async/Async.h"
+#include "AzureKinectDevice.h"
+#include "AzureKinectSkeletonStream.h"
+#include "HAL/FileManager.h"
+#include "Misc/Paths.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+namespace
+{
+	constexpr int32 NumFrames = 200;
+	constexpr int32 NumJoints = 32;
+	constexpr int32 NumReaders = 4;
+	constexpr int64 FrameIntervalUsec = 2000;
+
+	/**
+	 * Frame F has F % 4 + 1 bodies, body B has ID F * 10 + B and joint J at (F, B, J) [cm].
+	 * Whole centimeters survive the quantization of the stream, so every field of a published skeleton tells its frame.
+	 */
+	void MakeFrame(int32 Frame, TArray<FAzureKinectSkeleton>& OutSkeletons)
+	{
+		OutSkeletons.SetNum(Frame % 4 + 1);
+		for (int32 b = 0; b < OutSkeletons.Num(); b++)
+		{
+			FAzureKinectSkeleton& Skeleton = OutSkeletons[b];
+			Skeleton.ID = Frame * 10 + b;
+			Skeleton.Joints.SetNum(NumJoints);
+			Skeleton.JointConfidences.Init(EKinectJointConfidence::HIGH, NumJoints);
+			for (int32 j = 0; j < NumJoints; j++)
+			{
+				Skeleton.Joints[j] = FTransform(FVector(Frame, b, j));
+			}
+		}
+	}
+
+	/** @return The frame the skeleton comes from, INDEX_NONE if it mixes frames or bodies. */
+	int32 GetSkeletonFrame(const FAzureKinectSkeleton& Skeleton, int32 Body)
+	{
+		const int32 Frame = Skeleton.ID / 10;
+		if (Skeleton.ID % 10 != Body || Skeleton.Joints.Num() != NumJoints || Skeleton.JointConfidences.Num() != NumJoints)
+		{
+			return INDEX_NONE;
+		}
+		for (int32 j = 0; j < NumJoints; j++)
+		{
+			if (!Skeleton.Joints[j].GetLocation().Equals(FVector(Frame, Body, j), 1e-3f))
+			{
+				return INDEX_NONE;
+			}
+		}
+		return Frame;
+	}
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FAzureKinectSkeletonPublicationTest, "Plugins.AzureKinect.SkeletonPublication",
+	EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::EngineFilter)
+
+bool FAzureKinectSkeletonPublicationTest::RunTest(const FString& Parameters)
+{
+	const FString FilePath = FPaths::Combine(FPaths::AutomationTransientDir(), TEXT("AzureKinectSkeletonPublication.ksk"));
+	{
+		FAzureKinectSkeletonWriter Writer;
+		if (!TestTrue(TEXT("Open skeleton stream"), Writer.Open(FilePath)))
+		{
+			return false;
+		}
+		TArray<FAzureKinectSkeleton> Skeletons;
+		for (int32 Frame = 0; Frame < NumFrames; Frame++)
+		{
+			MakeFrame(Frame, Skeletons);
+			Writer.WriteFrame(Frame * FrameIntervalUsec, Skeletons);
+		}
+		Writer.Close();
+	}
+
+	// Playback publishes through the same path as body tracking, on the device thread
+	UAzureKinectDevice* Device = NewObject<UAzureKinectDevice>();
+	Device->AddToRoot();
+
+	TAtomic<int32> NumPublished { 0 };
+	TAtomic<int32> LastPublishedFrame { INDEX_NONE };
+	TAtomic<int32> NumListenerErrors { 0 };
+	const FDelegateHandle Listener = Device->AddSkeletonsPublishedListener(FOnAzureKinectSkeletonsPublished::FDelegate::CreateLambda(
+		[&](int64 TimestampUsec, const TArray<FAzureKinectSkeleton>& Skeletons)
+		{
+			const int32 Frame = static_cast<int32>(TimestampUsec / FrameIntervalUsec);
+			bool bValid = Frame > LastPublishedFrame && Skeletons.Num() == Frame % 4 + 1;
+			for (int32 b = 0; bValid && b < Skeletons.Num(); b++)
+			{
+				bValid = GetSkeletonFrame(Skeletons[b], b) == Frame;
+			}
+			if (!bValid)
+			{
+				NumListenerErrors++;
+			}
+			LastPublishedFrame = Frame;
+			NumPublished++;
+		}));
+
+	if (!TestTrue(TEXT("Start skeleton playback"), Device->StartSkeletonPlayback(FilePath, false)))
+	{
+		Device->RemoveSkeletonsPublishedListener(Listener);
+		Device->RemoveFromRoot();
+		return false;
+	}
+
+	// Readers start once there is a frame, so the first body always exists
+	const double Timeout = FPlatformTime::Seconds() + 10.0;
+	while (NumPublished == 0 && FPlatformTime::Seconds() < Timeout)
+	{
+		FPlatformProcess::Sleep(0.001f);
+	}
+
+	TAtomic<bool> bStop { false };
+	TAtomic<int32> NumReads { 0 };
+	TAtomic<int32> NumReaderErrors { 0 };
+	TArray<TFuture<void>> Readers;
+	for (int32 r = 0; r < NumReaders; r++)
+	{
+		Readers.Add(Async(EAsyncExecution::Thread, [&]()
+		{
+			int32 LastFrame = INDEX_NONE;
+			while (!bStop)
+			{
+				const int32 NumSkeletons = Device->GetNumTrackedSkeletons();
+				const int32 Frame = GetSkeletonFrame(Device->GetSkeleton(0), 0);
+				// Frames never go back for a single reader
+				if (NumSkeletons < 1 || NumSkeletons > 4 || Frame == INDEX_NONE || Frame < LastFrame)
+				{
+					NumReaderErrors++;
+				}
+				LastFrame = Frame;
+				NumReads++;
+			}
+		}));
+	}
+
+	while (LastPublishedFrame < NumFrames - 1 && FPlatformTime::Seconds() < Timeout)
+	{
+		FPlatformProcess::Sleep(0.01f);
+	}
+
+	bStop = true;
+	for (TFuture<void>& Reader : Readers)
+	{
+		Reader.Wait();
+	}
+
+	Device->RemoveSkeletonsPublishedListener(Listener);
+	Device->StopDevice();
+	Device->RemoveFromRoot();
+	IFileManager::Get().Delete(*FilePath);
+
+	TestEqual(TEXT("Last published frame"), LastPublishedFrame.Load(), NumFrames - 1);
+	TestEqual(TEXT("Torn or out of order frames seen by the listener"), NumListenerErrors.Load(), 0);
+	TestEqual(TEXT("Torn or out of order skeletons seen by readers"), NumReaderErrors.Load(), 0);
+	TestTrue(TEXT("Readers ran concurrently with publication"), NumReads > NumReaders);
+	return true;
+}
+
+#endif
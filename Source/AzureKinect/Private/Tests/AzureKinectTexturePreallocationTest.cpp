@@ -0,0 +1,66 @@
+#include "Misc/AutomationTest.h"
+#include "Async/TaskGraphInterfaces.h"
+#include "AzureKinectDevice.h"
+#include "AzureKinectDeviceRegistry.h"
+#include "Engine/TextureRenderTarget2D.h"
+#include "RenderingThread.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FAzureKinectTexturePreallocationTest, "Plugins.AzureKinect.TexturePreallocation",
+	EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::EngineFilter)
+
+bool FAzureKinectTexturePreallocationTest::RunTest(const FString& Parameters)
+{
+	if (FAzureKinectDeviceRegistry::Get().GetDevices().Num() == 0)
+	{
+		AddInfo(TEXT("No device connected, skipped."));
+		return true;
+	}
+
+	// Not 720p, and remapped depth comes at the color size
+	UAzureKinectDevice* Device = NewObject<UAzureKinectDevice>();
+	Device->AddToRoot();
+	Device->DeviceIndex = 0;
+	Device->DepthMode = EKinectDepthMode::NFOV_UNBINNED;
+	Device->ColorMode = EKinectColorResolution::RESOLUTION_1536P;
+	Device->RemapMode = EKinectRemap::DEPTH_TO_COLOR;
+	Device->DepthTexture = NewObject<UTextureRenderTarget2D>(Device);
+	Device->ColorTexture = NewObject<UTextureRenderTarget2D>(Device);
+
+	if (!TestTrue(TEXT("Start device"), Device->StartDevice()))
+	{
+		Device->RemoveFromRoot();
+		return false;
+	}
+
+	// Resize requests run on the game thread and uploads on the render thread, both are pumped while waiting
+	constexpr int32 NumFramesToWait = 30;
+	const double Timeout = FPlatformTime::Seconds() + 10.0;
+	int32 NumFrames = 0;
+	while (NumFrames < NumFramesToWait && FPlatformTime::Seconds() < Timeout)
+	{
+		FTaskGraphInterface::Get().ProcessThreadUntilIdle(ENamedThreads::GameThread);
+		FlushRenderingCommands();
+		const FAzureKinectUploadTiming Timing = Device->GetUploadTiming();
+		if (Timing.DepthMs > 0.f && Timing.ColorMs > 0.f)
+		{
+			NumFrames++;
+		}
+		FPlatformProcess::Sleep(0.033f);
+	}
+
+	const FIntPoint ColorSize(Device->ColorTexture->SizeX, Device->ColorTexture->SizeY);
+	const FIntPoint DepthSize(Device->DepthTexture->SizeX, Device->DepthTexture->SizeY);
+	const int32 NumReallocations = Device->GetNumTextureReallocations();
+
+	Device->StopDevice();
+	Device->RemoveFromRoot();
+
+	TestEqual(TEXT("Frames uploaded"), NumFrames, NumFramesToWait);
+	TestEqual(TEXT("Texture reallocations"), NumReallocations, 0);
+	TestTrue(TEXT("Remapped depth at the color size"), DepthSize == ColorSize && ColorSize.X > 0);
+	return true;
+}
+
+#endif
@@ -0,0 +1,55 @@
+#pragma once
+
+#include "CoreMinimal.h"
+
+#include "AzureKinectBackgroundModel.generated.h"
+
+USTRUCT(BlueprintType)
+struct FAzureKinectBackgroundSettings
+{
+	GENERATED_BODY()
+
+	/** Learn background from depth and write ForegroundMaskTexture every frame. */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere)
+	bool bEnabled = false;
+
+	/** Number of frames to learn the farthest surface per pixel before detecting foreground. */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, meta = (ClampMin = "1"))
+	int32 LearningFrames = 30;
+
+	/**
+	 * Maximum change of the background per frame after learning [mm].
+	 * Background pixels step toward the observed depth, which approximates a running median.
+	 * 0 freezes the background.
+	 */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, meta = (ClampMin = "0", ClampMax = "1000"))
+	int32 UpdateRate = 2;
+
+	/** A pixel nearer than the background by this distance is foreground [mm]. */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, meta = (ClampMin = "1", ClampMax = "10000"))
+	int32 Threshold = 80;
+};
+
+/**
+ * Per-pixel background model over DEPTH16 images.
+ * Processing is vectorized (SSE2 on x86, scalar otherwise) and split in chunks over worker threads.
+ */
+class AZUREKINECT_API FAzureKinectBackgroundModel
+{
+public:
+	/** Forget the learned background. */
+	void Reset();
+
+	/**
+	 * Update the background with a depth frame and classify its pixels.
+	 * @param OutMask Width * Height bytes, 0xFF for foreground and 0x00 otherwise.
+	 * @return Number of foreground pixels.
+	 */
+	int32 Process(const uint16* Depth, int32 Width, int32 Height, const FAzureKinectBackgroundSettings& Settings, uint8* OutMask);
+
+	bool IsLearning(const FAzureKinectBackgroundSettings& Settings) const { return NumLearnedFrames < Settings.LearningFrames; }
+
+private:
+	TArray<uint16> Background;
+	int32 NumLearnedFrames = 0;
+};
@@ -0,0 +1,94 @@
+#pragma once
+
+#include "CoreMinimal.h"
+
+#include "AzureKinectBodyGeometry.generated.h"
+
+USTRUCT(BlueprintType)
+struct FAzureKinectBodyGeometrySettings
+{
+	GENERATED_BODY()
+
+	/** Extract bounds and centroid of each body from the body index map, published with its skeleton. */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere)
+	bool bEnabled = false;
+
+	/** Also trace the outline of each body in the depth image. */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere)
+	bool bContour = true;
+
+	/** Longer contours are decimated to this many points. */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, meta = (ClampMin = "8", ClampMax = "4096"))
+	int32 MaxContourPoints = 256;
+};
+
+USTRUCT(BlueprintType)
+struct FAzureKinectBodyGeometry
+{
+	GENERATED_BODY()
+
+	/** Axis aligned bounds of the body pixels, in the same space as the joints [cm]. Invalid if the body has no depth. */
+	UPROPERTY(BlueprintReadOnly)
+	FBox Bounds = FBox(ForceInit);
+
+	/** Mean of the body pixels, in the same space as the joints [cm]. */
+	UPROPERTY(BlueprintReadOnly)
+	FVector Centroid = FVector::ZeroVector;
+
+	/** Number of body pixels with valid depth. */
+	UPROPERTY(BlueprintReadOnly)
+	int32 NumPixels = 0;
+
+	/** Outer contour in depth image pixels, in order around the body. Only the region of the topmost pixel if the body is split. */
+	UPROPERTY(BlueprintReadOnly)
+	TArray<FVector2D> Contour;
+};
+
+/**
+ * Extracts the geometry of each body from a body index map and the depth image it was tracked on.
+ * Bounds and centroids come from a single parallel pass over row chunks, each chunk with its own accumulators,
+ * and the contour is traced from the first pixel of each body.
+ */
+class AZUREKINECT_API FAzureKinectBodyGeometryExtractor
+{
+public:
+	/**
+	 * Set the unit depth ray of each pixel, as convert_2d_to_3d at 1 mm, X and Y interleaved.
+	 * Pixels without a ray are NaN.
+	 */
+	void SetXYTable(TArray<float>&& InXYTable, int32 Width, int32 Height);
+
+	/** Drop the table, after a calibration change. */
+	void ResetXYTable();
+
+	bool HasXYTable(int32 Width, int32 Height) const { return XYTable.Num() > 0 && TableWidth == Width && TableHeight == Height; }
+
+	/**
+	 * @param BodyIndexMap Body index per pixel, 255 for background.
+	 * @param Depth Raw depth [mm] of the same size.
+	 * @param PointToWorld Transform of depth camera points [mm] to output space, see FAzureKinectJointConverter::MakePointToWorld.
+	 * @param OutGeometries One per body index, sized to NumBodies.
+	 */
+	void Extract(const uint8* BodyIndexMap, const uint16* Depth, int32 Width, int32 Height, const FMatrix& PointToWorld,
+		int32 NumBodies, const FAzureKinectBodyGeometrySettings& Settings, TArray<FAzureKinectBodyGeometry>& OutGeometries);
+
+private:
+	struct FAccumulator
+	{
+		FVector Min;
+		FVector Max;
+		FVector Sum;
+		int32 Count;
+		/** First pixel of the body in scan order, start of the contour. */
+		int32 FirstPixel;
+	};
+
+	static void TraceContour(const uint8* BodyIndexMap, int32 Width, int32 Height, uint8 BodyIndex, int32 StartPixel, int32 MaxPoints, TArray<FVector2D>& OutContour);
+
+	TArray<float> XYTable;
+	int32 TableWidth = 0;
+	int32 TableHeight = 0;
+
+	/** NumChunks x NumBodies, reused between frames. */
+	TArray<FAccumulator> Accumulators;
+};
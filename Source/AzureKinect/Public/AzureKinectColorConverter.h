@@ -0,0 +1,34 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "AzureKinectEnum.h"
+
+DECLARE_LOG_CATEGORY_EXTERN(AzureKinectColorConverterLog, Log, All);
+
+class IImageWrapper;
+
+/**
+ * Converts color images captured as MJPG, NV12 or YUY2 into BGRA, the layout the SDK transformations expect.
+ * YUV kernels are vectorized (SSE2 on x86, scalar otherwise) and run over bands of rows on worker threads.
+ * YUV is taken as BT.601 limited range.
+ */
+class AZUREKINECT_API FAzureKinectColorConverter
+{
+public:
+	/**
+	 * @param Stride Bytes per row of the source, of the Y plane for NV12.
+	 * @return false if the source can't be converted, Dst is left undefined then.
+	 */
+	bool Convert(EKinectColorFormat Format, const uint8* Src, int64 SrcSize, int32 Width, int32 Height, int32 Stride, FColor* Dst);
+
+	static void ConvertNV12(const uint8* Src, int32 Width, int32 Height, int32 Stride, FColor* Dst);
+	static void ConvertYUY2(const uint8* Src, int32 Width, int32 Height, int32 Stride, FColor* Dst);
+	bool DecodeMJPG(const uint8* Src, int64 SrcSize, int32 Width, int32 Height, FColor* Dst);
+
+	/** Convert synthetic frames and return the average cost per frame [ms]. */
+	static float Benchmark(EKinectColorFormat Format, int32 Width, int32 Height, int32 NumFrames);
+
+private:
+	TSharedPtr<IImageWrapper> JpegWrapper;
+	TArray64<uint8> DecodedScratch;
+};
@@ -0,0 +1,94 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "AzureKinectEnum.h"
+
+#include "AzureKinectDepthFilter.generated.h"
+
+DECLARE_LOG_CATEGORY_EXTERN(AzureKinectDepthFilterLog, Log, All);
+
+USTRUCT(BlueprintType)
+struct FAzureKinectDepthFilterSettings
+{
+	GENERATED_BODY()
+
+	/** Filter depth before it's used for textures, point clouds and background subtraction. */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere)
+	bool bEnabled = false;
+
+	/** Invalidate pixels whose 3x3 neighbours jump by more than FlyingPixelThreshold. */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere)
+	bool bRemoveFlyingPixels = true;
+
+	/** [mm] */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, meta = (ClampMin = "1", ClampMax = "10000"))
+	int32 FlyingPixelThreshold = 100;
+
+	/** Each pass fills invalid pixels with the farthest valid 3x3 neighbour. 0 disables hole filling. */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, meta = (ClampMin = "0", ClampMax = "8"))
+	int32 HoleFillPasses = 2;
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere)
+	EKinectDepthSpatialFilter SpatialFilter = EKinectDepthSpatialFilter::MEDIAN_3X3;
+
+	/** Neighbours further than this from the center don't contribute to the bilateral filter [mm]. */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, meta = (ClampMin = "1", ClampMax = "10000"))
+	int32 BilateralRange = 50;
+
+	/** Exponential moving average over frames. */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere)
+	bool bTemporal = false;
+
+	/** Weight of the new frame, 1 bypasses the temporal filter. */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, meta = (ClampMin = "0.01", ClampMax = "1"))
+	float TemporalAlpha = 0.4f;
+
+	/** Changes larger than this are taken as is, so moving edges don't trail [mm]. */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, meta = (ClampMin = "1", ClampMax = "1000"))
+	int32 TemporalThreshold = 30;
+};
+
+USTRUCT(BlueprintType)
+struct FAzureKinectDepthFilterTiming
+{
+	GENERATED_BODY()
+
+	UPROPERTY(BlueprintReadOnly)
+	float FlyingPixelMs = 0.f;
+
+	UPROPERTY(BlueprintReadOnly)
+	float HoleFillMs = 0.f;
+
+	UPROPERTY(BlueprintReadOnly)
+	float SpatialMs = 0.f;
+
+	UPROPERTY(BlueprintReadOnly)
+	float TemporalMs = 0.f;
+
+	UPROPERTY(BlueprintReadOnly)
+	float TotalMs = 0.f;
+};
+
+/**
+ * Filter chain over DEPTH16 images: flying pixel removal, hole filling, 3x3 median or bilateral, temporal average.
+ * Kernels are vectorized (SSE2 on x86, scalar otherwise) and run over bands of rows on worker threads.
+ * Invalid pixels are 0, as in the SDK.
+ */
+class AZUREKINECT_API FAzureKinectDepthFilter
+{
+public:
+	/** Forget the temporal history. */
+	void Reset();
+
+	/** Filter a frame in place. */
+	void Process(uint16* Depth, int32 Width, int32 Height, const FAzureKinectDepthFilterSettings& Settings, FAzureKinectDepthFilterTiming* OutTiming = nullptr);
+
+	/** Run the filters over synthetic frames and return the average cost per frame. */
+	static FAzureKinectDepthFilterTiming Benchmark(int32 Width, int32 Height, const FAzureKinectDepthFilterSettings& Settings, int32 NumFrames);
+
+private:
+	TArray<uint16> Scratch;
+
+	/** Temporal average [mm], kept in float so that changes smaller than a millimeter per frame still accumulate. */
+	TArray<float> History;
+};
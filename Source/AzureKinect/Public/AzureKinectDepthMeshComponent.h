@@ -0,0 +1,48 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "ProceduralMeshComponent.h"
+#include "AzureKinectDevice.h"
+#include "AzureKinectDepthMesher.h"
+
+#include "AzureKinectDepthMeshComponent.generated.h"
+
+/**
+ * A live surface mesh of what the depth camera sees, relative to the component.
+ * Meshes the latest point cloud of the device when a new one is available. The section is only recreated
+ * when the resolution changes, otherwise only vertex positions and colors are uploaded.
+ * The device should generate point clouds.
+ */
+UCLASS(ClassGroup = (AzureKinect), meta = (BlueprintSpawnableComponent))
+class AZUREKINECT_API UAzureKinectDepthMeshComponent : public UProceduralMeshComponent
+{
+	GENERATED_BODY()
+
+public:
+	UAzureKinectDepthMeshComponent(const FObjectInitializer& ObjectInitializer);
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Azure Kinect")
+	UAzureKinectDevice* Device;
+
+	/** Vertices in the space of the device skeletons (see UAzureKinectDevice::GetDepthCameraToWorld), depth camera space otherwise. */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Azure Kinect")
+	bool bWorldSpace;
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Azure Kinect")
+	FAzureKinectDepthMeshSettings MeshSettings;
+
+	/** Return the cost of the latest mesh build on the game thread [ms]. */
+	UFUNCTION(BlueprintCallable, Category = "Azure Kinect")
+	float GetLastBuildMs() const { return LastBuildMs; }
+
+	// UActorComponent interface
+	virtual void TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction) override;
+
+private:
+	FAzureKinectDepthMesher Mesher;
+	/** Frame meshed last, to skip ticks without a new one. */
+	FAzureKinectPointCloudPtr LastPointCloud;
+	int64 LastTimestampUsec;
+	bool bHasSection;
+	float LastBuildMs;
+};
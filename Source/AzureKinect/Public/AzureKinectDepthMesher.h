@@ -0,0 +1,68 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "AzureKinectPointCloud.h"
+
+#include "AzureKinectDepthMesher.generated.h"
+
+DECLARE_LOG_CATEGORY_EXTERN(AzureKinectDepthMeshLog, Log, All);
+
+USTRUCT(BlueprintType)
+struct FAzureKinectDepthMeshSettings
+{
+	GENERATED_BODY()
+
+	/** Use every Nth point of the depth grid in both directions as a vertex. */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, meta = (ClampMin = "1", ClampMax = "16"))
+	int32 Stride = 2;
+
+	/** Triangles whose vertices differ more in depth are dropped, so silhouettes don't connect to the background [mm]. */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, meta = (ClampMin = "1"))
+	int32 DiscontinuityThreshold = 50;
+};
+
+/**
+ * Triangulates an organized point cloud on its depth grid.
+ * The full grid triangulation is built once per resolution and shared, and stays the same from frame to frame:
+ * triangles with invalid or discontinuous depth are collapsed instead of removed, so only vertices change.
+ * Each grid point has three vertices. The first is shared by the triangles around the point;
+ * the others each belong to a single triangle and are snapped onto a shared vertex to collapse it.
+ */
+class AZUREKINECT_API FAzureKinectDepthMesher
+{
+public:
+	/**
+	 * Update vertices from a point cloud.
+	 * @param PointToWorld Transform of the points, see FAzureKinectJointConverter::MakePointToWorld.
+	 * @return true if the triangle list differs from the previous build (the resolution changed), false if only vertices have changed.
+	 */
+	bool Build(const FAzureKinectPointCloud& PointCloud, const FAzureKinectDepthMeshSettings& Settings, const FMatrix& PointToWorld);
+
+	/** In the space of PointToWorld, collapsed triangles and invalid points where a neighbour is. */
+	const TArray<FVector>& GetVertices() const { return Vertices; }
+	/** White if the point cloud has no color. */
+	const TArray<FColor>& GetColors() const { return Colors; }
+	const TArray<int32>& GetTriangles() const;
+
+	/**
+	 * Mesh NumFrames synthetic Width x Height frames.
+	 * @return Average build cost [ms].
+	 */
+	static float Benchmark(int32 Width, int32 Height, const FAzureKinectDepthMeshSettings& Settings, int32 NumFrames);
+
+private:
+	/**
+	 * Full triangulation of a Width x Height grid, two triangles per cell, row by row.
+	 * The first triangle of a cell owns the second vertex of its top left point, the second one the third vertex of its bottom right point.
+	 */
+	static TSharedRef<const TArray<int32>, ESPMode::ThreadSafe> GetGridPattern(int32 Width, int32 Height);
+
+	TSharedPtr<const TArray<int32>, ESPMode::ThreadSafe> Pattern;
+	int32 GridWidth = 0;
+	int32 GridHeight = 0;
+
+	TArray<FVector> Vertices;
+	TArray<FColor> Colors;
+	/** Depth of each grid point [mm], 0 if invalid. */
+	TArray<uint16> Depths;
+};
@@ -1,30 +1,149 @@
 #pragma once
 
 #include "CoreMinimal.h"
+#include "Async/Future.h"
+#include "HAL/ThreadSafeBool.h"
 #include "Engine/TextureRenderTarget2D.h"
 #include "Animation/SkeletalMeshActor.h"
 
-#include "k4a/k4a.hpp"
-#include "k4abt.hpp"
+#include "AzureKinectSdk.h"
 #include "AzureKinectEnum.h"
+#include "AzureKinectSkeleton.h"
 #include "AzureKinectDeviceThread.h"
+#include "AzureKinectPointCloud.h"
+#include "AzureKinectBackgroundModel.h"
+#include "AzureKinectDepthFilter.h"
+#include "AzureKinectColorConverter.h"
+#include "AzureKinectMjpegDecoder.h"
+#include "AzureKinectImuReader.h"
+#include "AzureKinectFloorDetector.h"
+#include "AzureKinectBodyGeometry.h"
+#include "AzureKinectTextureTarget.h"
 
 #include "AzureKinectDevice.generated.h"
 
+/**
+ * Wall-clock cost of the last ReconfigureDevice call, broken down per component.
+ * A component which did not need to be rebuilt reports 0.
+ */
 USTRUCT(BlueprintType)
-struct FAzureKinectSkeleton
+struct FAzureKinectReconfigureTiming
 {
 	GENERATED_BODY()
 
-	UPROPERTY(BlueprintReadWrite)
-	int32 ID;
+	/** Time spent to wait for the capture thread to release the device [ms]. */
+	UPROPERTY(BlueprintReadOnly)
+	float ThreadPauseMs = 0.f;
 
-	UPROPERTY(BlueprintReadWrite)
-	TArray<FTransform> Joints;
+	/** Time spent to stop and restart the camera streams [ms]. */
+	UPROPERTY(BlueprintReadOnly)
+	float CamerasMs = 0.f;
+
+	/** Time spent to reload calibration and rebuild the transformation [ms]. */
+	UPROPERTY(BlueprintReadOnly)
+	float TransformationMs = 0.f;
+
+	/** Time spent to destroy and/or create the body tracker [ms]. */
+	UPROPERTY(BlueprintReadOnly)
+	float TrackerMs = 0.f;
+
+	/** Time spent to release remap buffers [ms]. */
+	UPROPERTY(BlueprintReadOnly)
+	float BuffersMs = 0.f;
+
+	UPROPERTY(BlueprintReadOnly)
+	float TotalMs = 0.f;
+};
+
+/**
+ * Startup latencies of the last StartDevice call.
+ * A value stays 0 until the corresponding event has happened.
+ */
+USTRUCT(BlueprintType)
+struct FAzureKinectStartupTiming
+{
+	GENERATED_BODY()
+
+	/** Time spent in StartDevice on the calling thread [ms]. */
+	UPROPERTY(BlueprintReadOnly)
+	float StartDeviceMs = 0.f;
+
+	/** From StartDevice call to the first texture upload done on the render thread [ms]. Stays 0 without textures. */
+	UPROPERTY(BlueprintReadOnly)
+	float FirstTextureMs = 0.f;
+
+	/** Time spent to load the body tracking model on a background task [ms]. Stays 0 when a kept tracker is reused. */
+	UPROPERTY(BlueprintReadOnly)
+	float TrackerLoadMs = 0.f;
+
+	/** From StartDevice call to the first skeletons published [ms]. */
+	UPROPERTY(BlueprintReadOnly)
+	float FirstSkeletonMs = 0.f;
+};
+
+/**
+ * Body tracker in use and its inference cost, measured from enqueuing a capture to popping its body frame.
+ */
+USTRUCT(BlueprintType)
+struct FAzureKinectTrackerTiming
+{
+	GENERATED_BODY()
+
+	/** Mode the tracker has been created with, CPU after a fallback. */
+	UPROPERTY(BlueprintReadOnly)
+	EKinectTrackerProcessingMode ProcessingMode = EKinectTrackerProcessingMode::GPU;
+
+	UPROPERTY(BlueprintReadOnly)
+	bool bLiteModel = false;
+
+	/** Inference time of the latest body frame [ms]. */
+	UPROPERTY(BlueprintReadOnly)
+	float LastInferenceMs = 0.f;
+
+	/** Exponential moving average of the inference time [ms]. */
+	UPROPERTY(BlueprintReadOnly)
+	float AverageInferenceMs = 0.f;
+
+	/** Body frames processed since the tracker has been created. */
+	UPROPERTY(BlueprintReadOnly)
+	int32 NumFrames = 0;
+};
+
+/**
+ * Render thread time spent submitting each texture per frame, as exponential moving averages [ms].
+ * Copies from staging textures run later on the GPU and aren't included, see FAzureKinectTextureTarget.
+ * 0 for textures that aren't updated.
+ */
+USTRUCT(BlueprintType)
+struct FAzureKinectUploadTiming
+{
+	GENERATED_BODY()
+
+	UPROPERTY(BlueprintReadOnly)
+	float DepthMs = 0.f;
+
+	UPROPERTY(BlueprintReadOnly)
+	float ColorMs = 0.f;
+
+	UPROPERTY(BlueprintReadOnly)
+	float InflaredMs = 0.f;
+
+	UPROPERTY(BlueprintReadOnly)
+	float BodyIndexMs = 0.f;
+
+	UPROPERTY(BlueprintReadOnly)
+	float ForegroundMaskMs = 0.f;
+
+	/** Frames not uploaded because the render thread was still busy with the previous ones, over all textures. */
+	UPROPERTY(BlueprintReadOnly)
+	int32 NumDroppedFrames = 0;
 };
 
 DECLARE_LOG_CATEGORY_EXTERN(AzureKinectDeviceLog, Log, All);
 
+/** Broadcast on the capture thread each time skeletons are published, with device timestamp [usec]. */
+DECLARE_MULTICAST_DELEGATE_TwoParams(FOnAzureKinectSkeletonsPublished, int64, const TArray<FAzureKinectSkeleton>&);
+
 UCLASS(BlueprintType, hidecategories=(Object))
 class AZUREKINECT_API UAzureKinectDevice : public UObject
 {
@@ -45,12 +164,30 @@ public:
 	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "IO")
 	UTextureRenderTarget2D* BodyIndexTexture;
 
+	/** Foreground pixels of depth against the learned background, 8bit single channel. */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "IO")
+	UTextureRenderTarget2D* ForegroundMaskTexture;
+
 	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Config")
 	EKinectDepthMode DepthMode;
 
 	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Config")
 	EKinectColorResolution ColorMode;
 
+	/**
+	 * Format the camera sends color in. Anything but BGRA32 is converted by the plugin instead of the SDK.
+	 * NV12 and YUY2 are available at 720p only, other resolutions fall back to MJPG.
+	 */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Config")
+	EKinectColorFormat ColorFormat = EKinectColorFormat::BGRA32;
+
+	/**
+	 * Number of MJPG frames decoded in parallel on the thread pool. 0 decodes on the capture thread, in sync with depth.
+	 * Opt-in for 2160p and 3072p: decoded color then lags behind depth by the decode time.
+	 */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Config", meta = (ClampMin = "0", ClampMax = "16"))
+	int32 MjpegDecodeThreads = 0;
+
 	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Config")
 	EKinectRemap RemapMode;
 
@@ -63,19 +200,115 @@ public:
 	UPROPERTY(BlueprintReadWrite, Category = "Config")
 	int32 DeviceIndex;
 
+	/**
+	 * Serial number of the device to open. If set, it takes precedence over DeviceIndex
+	 * so the asset keeps pointing to the same device even when enumeration order changes.
+	 */
+	UPROPERTY(BlueprintReadWrite, Category = "Config")
+	FString DeviceSerial;
+
 	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Config")
 	bool bSkeletonTracking;
 
+	/**
+	 * Keep the body tracker alive on StopDevice, so the next StartDevice
+	 * with the same device, depth mode and orientation skips the model load.
+	 */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Config")
+	bool bKeepTrackerAlive;
+
+	/** Where the body tracking model runs. CPU needs no GPU but is several times slower. */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Config")
+	EKinectTrackerProcessingMode TrackerProcessingMode;
+
+	/** GPU used by the GPU processing modes, 0 for the first one. */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Config", meta = (ClampMin = "0"))
+	int32 TrackerGpuDeviceId;
+
+	/** Use the lite model (dnn_model_2_0_lite_op11.onnx), lower latency for a bit less accuracy. */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Config")
+	bool bLiteTrackerModel;
+
+	/** Create the tracker in CPU mode if the GPU mode fails, e.g. on machines without GPU. */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Config")
+	bool bTrackerCpuFallback;
+
+	/**
+	 * Temporal smoothing of the body tracker, 0 for none up to 1 for full smoothing.
+	 * More smoothing trades responsiveness for less jitter. Applied to a running tracker from the next frame.
+	 */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Config", meta = (ClampMin = "0", ClampMax = "1"))
+	float TrackerSmoothing;
+
+	/** Convert and publish at most this many bodies, picked by BodySelection. 0 for all of them. */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Config", meta = (ClampMin = "0"))
+	int32 MaxTrackedBodies;
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Config")
+	EKinectBodySelection BodySelection;
+
+	/**
+	 * Filters applied to depth before it's used for textures, point clouds and background subtraction.
+	 * Body tracking keeps using raw depth.
+	 */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Processing")
+	FAzureKinectDepthFilterSettings DepthFilter;
+
+	/**
+	 * Depth based background subtraction, usable without skeleton tracking.
+	 */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Processing")
+	FAzureKinectBackgroundSettings BackgroundSubtraction;
+
+	/**
+	 * Floor plane fitted to depth in the background, seeded by IMU gravity when bImu is on.
+	 */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Processing")
+	FAzureKinectFloorSettings FloorDetection;
+
+	/**
+	 * Per body bounds, centroid and contour from the body index map, published in FAzureKinectSkeleton::Geometry.
+	 * Needs bSkeletonTracking.
+	 */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Processing")
+	FAzureKinectBodyGeometrySettings BodyGeometry;
+
+	/**
+	 * Extrinsic of the depth camera, baked into skeletons on the tracking thread so they are published in world space.
+	 * With FloorDetection.bApplyToSkeletons, it places floor space instead of camera space.
+	 * Change it with SetCameraToWorld while the device is open.
+	 */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Processing")
+	FTransform CameraToWorld;
+
+	/**
+	 * Generate a point cloud from depth (and color remapped to depth) every frame.
+	 * Always generated while a point cloud recording is running.
+	 */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Config")
+	bool bGeneratePointCloud;
+
+	/**
+	 * Read gyroscope and accelerometer (about 1.6 kHz) on their own thread.
+	 * Samples are kept in a ring of a couple of seconds, read them with ReadImuSamples.
+	 */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Config")
+	bool bImu;
+
 	UFUNCTION(BlueprintCallable, Category = "IO")
 	static int32 GetNumConnectedDevices();
 
+	/**
+	 * Enumerate connected devices again through the shared device registry.
+	 * Only needed when a hotplug has not been picked up yet.
+	 */
 	UFUNCTION(BlueprintCallable, Category = "IO")
 	void LoadDevices();
 
 	/**
 	 * Call "open" and "start_camara" to Native Kinect Device
 	 * and return result. Then start a thread for Kinect's data feed.
-	 * Device Index should be specified in advance;
+	 * Device Serial or Device Index should be specified in advance;
 	 */
 	UFUNCTION(BlueprintCallable, Category = "IO")
 	bool StartDevice();
@@ -86,6 +319,48 @@ public:
 	 */
 	UFUNCTION(BlueprintCallable, Category = "IO")
 	bool StopDevice();
+
+	/**
+	 * Apply current DepthMode, ColorMode, ColorFormat, Fps, RemapMode, SensorOrientation
+	 * and bSkeletonTracking to a running device without a full restart.
+	 * Only the components affected by the change are rebuilt:
+	 * the capture thread is always reused, and the body tracker is kept alive
+	 * unless DepthMode, SensorOrientation, bSkeletonTracking or a tracker setting has changed.
+	 */
+	UFUNCTION(BlueprintCallable, Category = "IO")
+	bool ReconfigureDevice();
+
+	/**
+	 * Return per component timing of the last ReconfigureDevice call.
+	 */
+	UFUNCTION(BlueprintCallable, Category = "IO")
+	FAzureKinectReconfigureTiming GetLastReconfigureTiming() const { return LastReconfigureTiming; }
+
+	/**
+	 * Start loading the body tracking model on a background task
+	 * for the selected device, DepthMode and SensorOrientation.
+	 * The following StartDevice picks up the tracker instead of loading it again.
+	 */
+	UFUNCTION(BlueprintCallable, Category = "IO")
+	bool PreloadBodyTracker();
+
+	/**
+	 * Check if the body tracker has been loaded and skeletons are being updated.
+	 */
+	UFUNCTION(BlueprintCallable, Category = "Skeletons")
+	bool IsBodyTrackerReady() const { return bBodyTrackerReady; }
+
+	/**
+	 * Return the processing mode of the body tracker and its inference time per frame.
+	 */
+	UFUNCTION(BlueprintCallable, Category = "Skeletons")
+	FAzureKinectTrackerTiming GetTrackerTiming() const;
+
+	/**
+	 * Return startup latencies of the last StartDevice call.
+	 */
+	UFUNCTION(BlueprintCallable, Category = "IO")
+	FAzureKinectStartupTiming GetStartupTiming() const { return StartupTiming; }
 	
 	/**
 	 * Check if Kinect Device is open.
@@ -112,37 +387,367 @@ public:
 	UFUNCTION(BlueprintCallable, Category = "Skeletons")
 	FAzureKinectSkeleton GetSkeleton(int32 Index) const;
 	
+	/**
+	 * Return per filter cost of the latest depth frame.
+	 */
+	UFUNCTION(BlueprintCallable, Category = "Processing")
+	FAzureKinectDepthFilterTiming GetDepthFilterTiming() const;
+
+	/**
+	 * Return the number of times a texture had to be resized because frames didn't come at the size it was allocated for on start.
+	 * 0 in steady state, also reported by "stat AzureKinect".
+	 */
+	UFUNCTION(BlueprintCallable, Category = "IO")
+	int32 GetNumTextureReallocations() const;
+
+	/**
+	 * Return the render thread time spent submitting each texture, also reported by "stat AzureKinect".
+	 */
+	UFUNCTION(BlueprintCallable, Category = "IO")
+	FAzureKinectUploadTiming GetUploadTiming() const;
+
+	/**
+	 * Return a number of foreground pixels in the latest depth frame.
+	 */
+	UFUNCTION(BlueprintCallable, Category = "Processing")
+	int32 GetForegroundPixelCount() const { return ForegroundPixelCount.GetValue(); }
+
+	/**
+	 * Forget the learned background and start learning again from the next frame.
+	 */
+	UFUNCTION(BlueprintCallable, Category = "Processing")
+	void ResetBackground() { bResetBackgroundRequested = true; }
+
+	/**
+	 * Set CameraToWorld, safe while the tracking thread is running. Applied from the next body frame.
+	 */
+	UFUNCTION(BlueprintCallable, Category = "Processing")
+	void SetCameraToWorld(const FTransform& InCameraToWorld);
+
+	UFUNCTION(BlueprintCallable, Category = "Processing")
+	FTransform GetCameraToWorld() const;
+
+	/**
+	 * Return the transform applied to published skeletons: CameraToWorld,
+	 * preceded by the floor transform when FloorDetection applies to skeletons.
+	 * Use it to bring point clouds into the same space.
+	 */
+	UFUNCTION(BlueprintCallable, Category = "Processing")
+	FTransform GetDepthCameraToWorld() const;
+
+	UFUNCTION(BlueprintCallable, Category = "Processing")
+	bool IsFloorDetected() const { return FloorDetector.IsDetected(); }
+
+	/**
+	 * Return the transform from depth camera space (as skeleton joints) to floor space,
+	 * Z up with the floor at Z = 0 right under the camera. Identity until a floor is detected.
+	 */
+	UFUNCTION(BlueprintCallable, Category = "Processing")
+	FTransform GetCameraToFloorTransform() const { return FloorDetector.GetCameraToFloor(); }
+
+	/**
+	 * Return the floor plane in depth camera space [cm], its normal points to the camera.
+	 */
+	UFUNCTION(BlueprintCallable, Category = "Processing")
+	FPlane GetFloorPlane() const { return FloorDetector.GetPlane(); }
+
+	/**
+	 * Start writing point clouds of every frame into a chunked binary file (*.kpc)
+	 * on a background thread. Device should be open.
+	 * @param bQuantize Store int16 millimeter positions instead of float centimeter.
+	 */
+	UFUNCTION(BlueprintCallable, Category = "PointCloud")
+	bool StartPointCloudRecording(const FString& FilePath, bool bQuantize = true);
+
+	/**
+	 * Flush queued frames and close the point cloud file.
+	 */
+	UFUNCTION(BlueprintCallable, Category = "PointCloud")
+	void StopPointCloudRecording();
+
+	UFUNCTION(BlueprintCallable, Category = "PointCloud")
+	bool IsRecordingPointCloud() const { return PointCloudWriter.IsValid(); }
+
+	/**
+	 * Return a number of frames which couldn't be recorded because the writer fell behind.
+	 */
+	UFUNCTION(BlueprintCallable, Category = "PointCloud")
+	int32 GetNumDroppedPointCloudFrames() const;
+
+	/**
+	 * Move IMU samples received so far out of the ring, oldest first.
+	 * Readers should be on a single thread at a time, usually the game thread.
+	 * @param MaxSamples 0 reads all of them.
+	 * @return Number of samples appended to OutSamples.
+	 */
+	UFUNCTION(BlueprintCallable, Category = "IMU")
+	int32 ReadImuSamples(TArray<FAzureKinectImuSample>& OutSamples, int32 MaxSamples = 0);
+
+	/**
+	 * Same as ReadImuSamples, stopping at the timestamp of the latest depth frame
+	 * so the samples line up with what depth and skeletons show.
+	 */
+	UFUNCTION(BlueprintCallable, Category = "IMU")
+	int32 ReadImuSamplesUntilDepthFrame(TArray<FAzureKinectImuSample>& OutSamples);
+
+	/**
+	 * Return a number of IMU samples dropped because they were not read in time.
+	 */
+	UFUNCTION(BlueprintCallable, Category = "IMU")
+	int32 GetNumImuOverruns() const;
+
+	/**
+	 * Return the device timestamp of the latest depth frame [usec].
+	 */
+	UFUNCTION(BlueprintCallable, Category = "IMU")
+	int64 GetLatestDepthTimestamp() const { return LatestDepthTimestampUsec.GetValue(); }
+
+	/**
+	 * Return the point cloud of the latest frame, or nullptr.
+	 * The frame is never modified while referenced, so it can be read from any thread.
+	 */
+	FAzureKinectPointCloudPtr GetLatestPointCloud() const;
+
+	/**
+	 * Start writing published skeletons into a compact skeleton stream file (*.ksk).
+	 * Device should be open with skeleton tracking.
+	 */
+	UFUNCTION(BlueprintCallable, Category = "Skeletons")
+	bool StartSkeletonRecording(const FString& FilePath);
+
+	/**
+	 * Write the frame index and close the skeleton stream file.
+	 */
+	UFUNCTION(BlueprintCallable, Category = "Skeletons")
+	void StopSkeletonRecording();
+
+	/**
+	 * Replay a skeleton stream file instead of a native device.
+	 * Skeletons are published in the same way as live tracking until StopDevice is called.
+	 */
+	UFUNCTION(BlueprintCallable, Category = "Skeletons")
+	bool StartSkeletonPlayback(const FString& FilePath, bool bLoop = true);
+
+	/**
+	 * Jump to given time from the beginning of the skeleton stream.
+	 */
+	UFUNCTION(BlueprintCallable, Category = "Skeletons")
+	void SeekSkeletonPlayback(float Seconds);
+
+	UFUNCTION(BlueprintCallable, Category = "Skeletons")
+	float GetSkeletonPlaybackDuration() const;
+
+	/**
+	 * Subscribe to every skeleton publication. The delegate is called on the capture thread
+	 * and should be cheap, e.g. copying joints into a preallocated buffer.
+	 */
+	FDelegateHandle AddSkeletonsPublishedListener(FOnAzureKinectSkeletonsPublished::FDelegate&& Delegate);
+	void RemoveSkeletonsPublishedListener(FDelegateHandle Handle);
+
+	/** Camera position in the space of published skeletons [cm], only valid inside a published listener. */
+	const FVector& GetPublishedCameraLocation() const { return PublishedCameraLocation; }
+
 	/** 
 	 * Update and process raw feed from Kinect Device asynchronously. 
 	 * Should be called out of main thread.
 	 */
 	void UpdateAsync();
 
-	TArray<TSharedPtr<FString>> DeviceList;
+	// UObject interface
+	virtual void BeginDestroy() override;
 
 private:
 	bool bOpen;
 
+#if WITH_AZUREKINECT_SDK
 	void CaptureColorImage();
 	void CaptureDepthImage();
 	void CaptureInflaredImage();
 	void CaptureBodyIndexImage(const k4abt::frame& BodyFrame);
+	void CapturePointCloud();
+	void CaptureForegroundMask();
+
+	/** Fit the floor to the latest point cloud on a background task, once per FloorDetection.UpdateInterval. */
+	void UpdateFloor();
+	/** IMU gravity rotated into Unreal co-ordinate system of the depth camera, or zero. */
+	FVector GetGravityUp() const;
+
+	/** Run DepthFilter over a copy of the captured depth, which GetDepthImage returns for the rest of the frame. */
+	void FilterDepthImage();
+	k4a::image GetDepthImage() const;
+
+	/** Convert captured color to BGRA, which GetColorImage returns for the rest of the frame. */
+	void ConvertColorImage();
+	k4a::image GetColorImage() const;
+	/** Return ColorFormat, or the fallback if it's not available at ColorMode. */
+	EKinectColorFormat ResolveColorFormat() const;
+
+	/** Allocate the textures at the resolutions of the applied modes, on the game thread before frames arrive. */
+	void PreallocateTextures();
 
-	static FTransform JointToTransform(const k4abt_joint_t& Joint, int32 Index);
 	void UpdateSkeletons();
+	/** Extract BodyGeometry of each body into BodyGeometries, in the same space as the joints. */
+	void ExtractBodyGeometry(const k4abt::frame& BodyFrame, const FTransform& Extrinsic);
+#endif
+
+	/** Make PendingSkeletons current, shared by live tracking and playback. */
+	void PublishSkeletons(int64 TimestampUsec);
+	void UpdatePlayback();
 	
 	void CalcFrameCount();
 
+#if WITH_AZUREKINECT_SDK
+	void StartCameras();
+	void LoadCalibration();
+	/** Return index to be opened from DeviceSerial or DeviceIndex, or -1. */
+	int32 ResolveDeviceIndex() const;
+
+	/** Check if the tracker has been made with current processing mode, GPU and model. */
+	bool IsTrackerConfigApplied() const;
+	/** Check if the tracker alive (or being loaded) has been made for given device and current settings. */
+	bool HasBodyTrackerFor(const FString& Serial) const;
+
+	/** Create the tracker on a background task unless a matching one is alive. */
+	void EnsureBodyTracker(const k4a::calibration& Calibration, const FString& Serial);
+	void CreateBodyTrackerAsync(const k4a::calibration& Calibration, const FString& Serial);
+
+	void StartImu();
+	void StopImu();
+#endif
+	void DestroyBodyTracker();
+
+	/** Remember the configuration the native device is currently running with. */
+	void StoreAppliedConfig();
+
+	/** Index actually opened, which can differ from DeviceIndex when opened by serial. */
+	int32 OpenedIndex;
+	FString OpenedSerial;
+
+	std::chrono::milliseconds FrameTime;
+#if WITH_AZUREKINECT_SDK
 	k4a::device NativeDevice;
 	k4a::capture Capture;
-	std::chrono::milliseconds FrameTime;
 	k4a::image RemapImage;
 	k4a::calibration KinectCalibration;
 	k4a::transformation KinectTransformation;
 	k4abt::tracker BodyTracker;
 
+	/** Reset by StopImu while the game thread reads samples, guarded by ImuCriticalSection. */
+	TUniquePtr<FAzureKinectImuReader> ImuReader;
+	mutable FCriticalSection ImuCriticalSection;
+#endif
+	FThreadSafeCounter64 LatestDepthTimestampUsec;
+
+	FAzureKinectTextureTarget DepthTarget { PF_R8G8B8A8, RTF_RGBA8, true };
+	FAzureKinectTextureTarget ColorTarget { PF_B8G8R8A8, RTF_RGBA8, false };
+	FAzureKinectTextureTarget InflaredTarget { PF_R8G8B8A8, RTF_RGBA8, true };
+	FAzureKinectTextureTarget BodyIndexTarget { PF_R8G8B8A8, RTF_RGBA8, true };
+	FAzureKinectTextureTarget ForegroundMaskTarget { PF_G8, RTF_R8, true };
+
+	FAzureKinectColorConverter ColorConverter;
+	TArray<FColor> ConvertedColor;
+#if WITH_AZUREKINECT_SDK
+	k4a::image ConvertedColorImage;
+#endif
+	TUniquePtr<FAzureKinectMjpegDecoder> MjpegDecoder;
+	/** Latest frame out of MjpegDecoder, kept until a newer one is decoded. */
+	FAzureKinectColorFramePtr DecodedColorFrame;
+
+	FAzureKinectDepthFilter DepthFilterChain;
+	TArray<uint16> FilteredDepth;
+#if WITH_AZUREKINECT_SDK
+	k4a::image FilteredDepthImage;
+#endif
+	FAzureKinectDepthFilterTiming LastDepthFilterTiming;
+
+	FAzureKinectBackgroundModel BackgroundModel;
+	TArray<uint8> ForegroundMask;
+	FThreadSafeCounter ForegroundPixelCount;
+	FThreadSafeBool bResetBackgroundRequested;
+
+#if WITH_AZUREKINECT_SDK
+	/** Body index map of the current frame, kept for the point cloud. */
+	k4a::image BodyIndexMap;
+#endif
+	int64 BodyIndexTimestampUsec;
+
+	FAzureKinectPointCloudPool PointCloudPool;
+	FAzureKinectPointCloudPtr LatestPointCloud;
+	TSharedPtr<class FAzureKinectPointCloudWriter> PointCloudWriter;
+	int32 LastDroppedPointCloudFrames;
+
+	FAzureKinectFloorDetector FloorDetector;
+	/** Background fit, at most one at a time. */
+	TFuture<void> FloorTask;
+	double LastFloorUpdateTime;
+
+	FAzureKinectBodyGeometryExtractor BodyGeometryExtractor;
+	TArray<FAzureKinectBodyGeometry> BodyGeometries;
+
+	/** Body frame skeletons and IDs read before selection, and the selected indices. */
+	TArray<k4abt_skeleton_t> NativeSkeletons;
+	TArray<uint32> NativeBodyIds;
+	TArray<int32> SelectedBodies;
+
+	/** Background task which loads the body tracking model into BodyTracker. */
+	TFuture<void> TrackerTask;
+	/** Loads of destroyed or replaced trackers, which finish on their own and are only waited for on BeginDestroy. */
+	TArray<TFuture<void>> PendingTrackerTasks;
+	/** Set once BodyTracker can be used from the capture thread. */
+	FThreadSafeBool bBodyTrackerReady;
+	/** Bumped on every tracker creation and destruction, a load only publishes its tracker if it's still current. */
+	uint32 TrackerGeneration = 0;
+	FCriticalSection TrackerCriticalSection;
+
+	/** Settings BodyTracker has been created for. */
+	FString TrackerSerial;
+	EKinectDepthMode TrackerDepthMode;
+	EKinectSensorOrientation TrackerOrientation;
+	EKinectTrackerProcessingMode TrackerMode;
+	int32 TrackerGpuId;
+	bool bTrackerLite;
+	/** Smoothing set on BodyTracker, negative until it has been set. */
+	float AppliedTrackerSmoothing;
+
+	/** Processing mode is written by the tracker task, inference times by the capture thread. */
+	FAzureKinectTrackerTiming TrackerTiming;
+	mutable FCriticalSection TrackerTimingCriticalSection;
+
+	double StartDeviceTime;
+	FAzureKinectStartupTiming StartupTiming;
+
 	FAzureKinectDeviceThread* Thread;
+
+	/** Held by the capture thread for a whole frame, and by ReconfigureDevice while rebuilding. */
+	FCriticalSection DeviceCriticalSection;
+
+	EKinectDepthMode AppliedDepthMode;
+	EKinectColorResolution AppliedColorMode;
+	EKinectColorFormat AppliedColorFormat;
+	/** Color request at the last camera start, to warn about the format fallback once per change. */
+	EKinectColorFormat LastRequestedColorFormat = EKinectColorFormat::BGRA32;
+	EKinectColorResolution LastRequestedColorMode = EKinectColorResolution::RESOLUTION_OFF;
+	EKinectFps AppliedFps;
+	EKinectRemap AppliedRemapMode;
+	EKinectSensorOrientation AppliedSensorOrientation;
+	bool bAppliedSkeletonTracking;
+	bool bAppliedImu;
+
+	FAzureKinectReconfigureTiming LastReconfigureTiming;
 	
 	int32 NumTrackedSkeletons;
 	TArray<FAzureKinectSkeleton> Skeletons;
+	/** Skeletons being built on the capture thread, swapped with Skeletons on publish. */
+	TArray<FAzureKinectSkeleton> PendingSkeletons;
+
+	FOnAzureKinectSkeletonsPublished SkeletonsPublishedEvent;
+	/** Set on the capture thread right before publishing. */
+	FVector PublishedCameraLocation;
+
+	TSharedPtr<class FAzureKinectSkeletonWriter> SkeletonWriter;
+	TSharedPtr<class FAzureKinectSkeletonReader> SkeletonReader;
+	bool bLoopPlayback;
+	int32 PlaybackFrame;
+	int64 PlaybackStartTimestamp;
+	double PlaybackStartTime;
 };
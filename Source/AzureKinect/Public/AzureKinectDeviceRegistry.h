@@ -0,0 +1,75 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Containers/Ticker.h"
+
+DECLARE_LOG_CATEGORY_EXTERN(AzureKinectRegistryLog, Log, All);
+
+DECLARE_MULTICAST_DELEGATE(FOnAzureKinectDevicesChanged);
+
+/**
+ * Cached information about a connected Azure Kinect,
+ * read once when the device is enumerated.
+ */
+struct FAzureKinectDeviceInfo
+{
+	/** Index to be passed to k4a::device::open at the time of enumeration. */
+	int32 Index = INDEX_NONE;
+
+	FString SerialNumber;
+
+	/** Firmware versions reported by k4a_hardware_version_t, "Major.Minor.Iteration". */
+	FString ColorFirmware;
+	FString DepthFirmware;
+	FString AudioFirmware;
+
+	/** True if the device was streaming when enumerated, so its cached info is kept as is. */
+	bool bInUse = false;
+};
+
+/**
+ * Module-wide registry of connected Azure Kinect devices.
+ * Opening a device to read its serial number takes a while and fails for a device
+ * already streaming, so enumeration is done once and again only on hotplug
+ * (polled from the core ticker) or on explicit Refresh.
+ * Shared by all UAzureKinectDevice instances and the editor customization.
+ */
+class AZUREKINECT_API FAzureKinectDeviceRegistry
+{
+public:
+	static FAzureKinectDeviceRegistry& Get();
+
+	/** Called by the module, start and stop polling for hotplug. */
+	void Startup();
+	void Shutdown();
+
+	/** Enumerate all connected devices again. */
+	void Refresh();
+
+	/** Return cached devices, enumerating them the first time only. */
+	TArray<FAzureKinectDeviceInfo> GetDevices();
+
+	/** Return device index for given serial number or INDEX_NONE. Enumerate again once if not found. */
+	int32 FindIndexBySerial(const FString& SerialNumber);
+
+	/** Tell the registry a device is streaming so enumeration never tries to open it. */
+	void NotifyDeviceOpened(int32 Index);
+	void NotifyDeviceClosed(int32 Index);
+
+	/** Broadcast on the game thread after each enumeration. */
+	FOnAzureKinectDevicesChanged& OnDevicesChanged() { return DevicesChangedEvent; }
+
+private:
+	bool Tick(float DeltaTime);
+	void Enumerate();
+
+	mutable FCriticalSection CriticalSection;
+
+	TArray<FAzureKinectDeviceInfo> Devices;
+	TSet<int32> OpenIndices;
+	bool bEnumerated = false;
+	uint32 LastInstalledCount = 0;
+
+	FDelegateHandle TickerHandle;
+	FOnAzureKinectDevicesChanged DevicesChangedEvent;
+};
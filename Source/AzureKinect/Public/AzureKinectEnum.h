@@ -29,6 +29,20 @@ enum class EKinectColorResolution : uint8
 	RESOLUTION_3072P		UMETA(DisplayName = "4096 x 3072 [4:3]"),		/**< Color captured at 4096 x 3072. */
 };
 
+/**
+ * Blueprintable enum defined based on color formats of k4a_image_format_t from k4atypes.h
+ *
+ * @note This should always have the same enum values as k4a_image_format_t
+ */
+UENUM(BlueprintType, Category = "Azure Kinect|Enums")
+enum class EKinectColorFormat : uint8
+{
+	MJPG = 0		UMETA(DisplayName = "MJPG"),		/**< Compressed by the camera, decoded by the plugin. Available at every resolution. */
+	NV12			UMETA(DisplayName = "NV12"),		/**< Planar Y and interleaved UV, converted by the plugin. 720p only. */
+	YUY2			UMETA(DisplayName = "YUY2"),		/**< Packed YUV 4:2:2, converted by the plugin. 720p only. */
+	BGRA32			UMETA(DisplayName = "BGRA32"),		/**< Decoded by the SDK on the capture thread. */
+};
+
 UENUM(BlueprintType, Category = "Azure Kinect|Enums")
 enum class EKinectFps : uint8
 {
@@ -96,4 +110,52 @@ enum class EKinectSensorOrientation : uint8
 	CLOCKWISE90			UMETA(DisplayName = "Clockwise 90"), /**< Clockwisely rotate the sensor 90 degree */
 	COUNTERCLOCKWISE90	UMETA(DisplayName = "Conter-clockwise 90"), /**< Counter-clockwisely rotate the sensor 90 degrees */
 	FLIP180				UMETA(DisplayName = "Flip 180"), /**< Mount the sensor upside-down */
-};
\ No newline at end of file
+};
+
+/**
+* This should always have the same enum values as k4abt_tracker_processing_mode_t
+*/
+UENUM(BlueprintType, Category = "Azure Kinect|Enums")
+enum class EKinectTrackerProcessingMode : uint8
+{
+	GPU = 0			UMETA(DisplayName = "GPU"), /**< SDK default, DirectML on Windows and CUDA on Linux */
+	CPU				UMETA(DisplayName = "CPU"),
+	GPU_CUDA		UMETA(DisplayName = "GPU CUDA"),
+	GPU_TENSORRT	UMETA(DisplayName = "GPU TensorRT"),
+	GPU_DIRECTML	UMETA(DisplayName = "GPU DirectML"),
+};
+
+/**
+ * Which bodies to keep when more than MaxTrackedBodies are in view.
+ */
+UENUM(BlueprintType, Category = "Azure Kinect|Enums")
+enum class EKinectBodySelection : uint8
+{
+	NEAREST = 0		UMETA(DisplayName = "Nearest"), /**< Pelvis closest to the camera */
+	MOST_CENTRAL	UMETA(DisplayName = "Most Central"), /**< Pelvis closest to the optical axis */
+	OLDEST_ID		UMETA(DisplayName = "Oldest ID"), /**< Tracked for the longest time */
+};
+
+/**
+ * Blueprintable enum defined based on k4abt_joint_confidence_level_t from k4abttypes.h
+ * This should always have the same enum values as k4abt_joint_confidence_level_t
+ */
+UENUM(BlueprintType, Category = "Azure Kinect|Enums")
+enum class EKinectJointConfidence : uint8
+{
+	NONE = 0		UMETA(DisplayName = "None"), /**< The joint is out of range (too far from depth camera) */
+	LOW				UMETA(DisplayName = "Low"), /**< The joint is not observed (likely due to occlusion), predicted joint pose */
+	MEDIUM			UMETA(DisplayName = "Medium"), /**< Medium confidence in joint pose */
+	HIGH			UMETA(DisplayName = "High"), /**< High confidence in joint pose */
+};
+
+/**
+ * Edge preserving smoothing applied by FAzureKinectDepthFilter after hole filling.
+ */
+UENUM(BlueprintType, Category = "Azure Kinect|Enums")
+enum class EKinectDepthSpatialFilter : uint8
+{
+	NONE = 0		UMETA(DisplayName = "None"),
+	MEDIAN_3X3		UMETA(DisplayName = "Median 3x3"), /**< Median of the valid pixel and its 8 neighbours */
+	BILATERAL_3X3	UMETA(DisplayName = "Bilateral 3x3"), /**< Gaussian weights, neighbours beyond BilateralRange are ignored */
+};
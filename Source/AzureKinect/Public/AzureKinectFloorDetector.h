@@ -0,0 +1,82 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "AzureKinectPointCloud.h"
+
+#include "AzureKinectFloorDetector.generated.h"
+
+USTRUCT(BlueprintType)
+struct FAzureKinectFloorSettings
+{
+	GENERATED_BODY()
+
+	/** Fit the floor plane to depth in the background. Generates a point cloud every frame. */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere)
+	bool bEnabled = false;
+
+	/** Move published skeletons into floor space, Z up with the floor at Z = 0 under the camera. */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere)
+	bool bApplyToSkeletons = true;
+
+	/** Seconds between fits. */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, meta = (ClampMin = "0.05"))
+	float UpdateInterval = 1.f;
+
+	/** Use every Nth point in both directions. */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, meta = (ClampMin = "1", ClampMax = "16"))
+	int32 SampleStride = 4;
+
+	/** Number of RANSAC hypotheses when the previous plane doesn't fit anymore. */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, meta = (ClampMin = "16", ClampMax = "1024"))
+	int32 Iterations = 128;
+
+	/** Distance of a point to count as on the plane [cm]. */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, meta = (ClampMin = "0.1"))
+	float InlierThreshold = 2.f;
+
+	/** Maximum angle between the floor normal and up, from IMU gravity if available or camera up otherwise [deg]. */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, meta = (ClampMin = "1", ClampMax = "89"))
+	float MaxTilt = 30.f;
+};
+
+/**
+ * Fits the floor plane to a depth point cloud with RANSAC over a downsampled point set,
+ * hypotheses are scored in parallel and the winner is refined with least squares.
+ * Once a plane is found, following updates only refine it while it keeps fitting.
+ * All geometry is in Unreal co-ordinate system of the depth camera [cm], as skeleton joints.
+ */
+class AZUREKINECT_API FAzureKinectFloorDetector
+{
+public:
+	/**
+	 * Fit the floor to a point cloud. Meant for a worker thread, one update at a time.
+	 * @param Up Gravity up in camera space, zero if unknown.
+	 * @return true if a floor is detected.
+	 */
+	bool Update(const FAzureKinectPointCloud& PointCloud, const FVector& Up, const FAzureKinectFloorSettings& Settings);
+
+	void Reset();
+
+	bool IsDetected() const;
+
+	/** Floor plane, its normal points to the camera. */
+	FPlane GetPlane() const;
+
+	/** Transform from camera space to floor space, identity until a floor is detected. */
+	FTransform GetCameraToFloor() const;
+
+private:
+	int32 CountInliers(const FPlane& Candidate, float Threshold) const;
+	bool Ransac(const FVector& Up, const FAzureKinectFloorSettings& Settings, FPlane& OutPlane);
+	FPlane Refine(const FPlane& Candidate, float Threshold) const;
+
+	/** Downsampled points of the frame being fitted. */
+	TArray<FVector> Points;
+	FRandomStream Random;
+	float LastInlierRatio = 0.f;
+
+	mutable FCriticalSection CriticalSection;
+	bool bDetected = false;
+	FPlane Plane = FPlane(0.f, 0.f, 1.f, 0.f);
+	FTransform CameraToFloor = FTransform::Identity;
+};
@@ -0,0 +1,119 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/EngineSubsystem.h"
+#include "Tickable.h"
+#include "Async/Future.h"
+#include "AzureKinectDevice.h"
+#include "AzureKinectSkeletonFusion.h"
+#include "AzureKinectVoxelGrid.h"
+
+#include "AzureKinectFusionSubsystem.generated.h"
+
+/**
+ * Fuses skeletons of several devices into one set, at the rate of the devices.
+ * Devices should publish in a shared world frame, see UAzureKinectDevice::CameraToWorld.
+ * A fusion runs on the capture thread of the device completing a set of one frame per device,
+ * or lapping the others when a device falls behind.
+ * Point clouds are merged into a voxel grid on the thread pool, kicked from the game thread tick.
+ */
+UCLASS()
+class AZUREKINECT_API UAzureKinectFusionSubsystem : public UEngineSubsystem, public FTickableGameObject
+{
+	GENERATED_BODY()
+
+public:
+	virtual void Deinitialize() override;
+
+	UFUNCTION(BlueprintCallable, Category = "Azure Kinect|Fusion")
+	bool AddDevice(UAzureKinectDevice* Device);
+
+	UFUNCTION(BlueprintCallable, Category = "Azure Kinect|Fusion")
+	void RemoveDevice(UAzureKinectDevice* Device);
+
+	UFUNCTION(BlueprintCallable, Category = "Azure Kinect|Fusion")
+	void RemoveAllDevices();
+
+	UFUNCTION(BlueprintCallable, Category = "Azure Kinect|Fusion")
+	int32 GetNumDevices() const;
+
+	/**
+	 * Return the latest fused skeletons. IDs are shared by all devices and kept across frames.
+	 */
+	UFUNCTION(BlueprintCallable, Category = "Azure Kinect|Fusion")
+	TArray<FAzureKinectSkeleton> GetFusedSkeletons() const;
+
+	UFUNCTION(BlueprintCallable, Category = "Azure Kinect|Fusion")
+	int32 GetNumFusedSkeletons() const;
+
+	/**
+	 * Subscribe to every fusion, called on a capture thread with the timestamp of the device completing the set.
+	 * Should be cheap, as with UAzureKinectDevice::AddSkeletonsPublishedListener.
+	 */
+	FDelegateHandle AddFusedSkeletonsListener(FOnAzureKinectSkeletonsPublished::FDelegate&& Delegate);
+	void RemoveFusedSkeletonsListener(FDelegateHandle Handle);
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Azure Kinect|Fusion")
+	FAzureKinectFusionSettings Settings;
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Azure Kinect|Fusion")
+	FAzureKinectVoxelGridSettings PointCloudFusion;
+
+	/**
+	 * Return the latest merged point cloud, or nullptr. It's never modified while referenced,
+	 * so a renderer can hold it while the next one is built.
+	 */
+	FAzureKinectFusedPointCloudPtr GetFusedPointCloud() const;
+
+	/**
+	 * Return point counts and build time of the latest merged point cloud.
+	 */
+	UFUNCTION(BlueprintCallable, Category = "Azure Kinect|Fusion")
+	FAzureKinectVoxelGridStats GetPointCloudFusionStats() const;
+
+	// FTickableGameObject interface
+	virtual void Tick(float DeltaTime) override;
+	virtual bool IsTickable() const override;
+	virtual TStatId GetStatId() const override;
+
+private:
+	struct FSource
+	{
+		/** Compared by index and serial number, so a destroyed device is still found. */
+		TWeakObjectPtr<UAzureKinectDevice> Device;
+		FDelegateHandle PublishedHandle;
+		double ReceivedTime = 0.0;
+		/** Received since the last fusion. */
+		bool bFresh = false;
+	};
+
+	void RemoveSource(const TWeakObjectPtr<UAzureKinectDevice>& Device);
+	void OnSkeletonsPublished(int64 TimestampUsec, const TArray<FAzureKinectSkeleton>& Skeletons, TWeakObjectPtr<UAzureKinectDevice> Device);
+	void FuseSources(int64 TimestampUsec);
+
+	/** Same order as Views. Views of stale sources are emptied before a fusion. */
+	TArray<FSource> Sources;
+	TArray<FAzureKinectSkeletonView> Views;
+	FAzureKinectSkeletonFusion Fusion;
+	TArray<FAzureKinectSkeleton> PendingSkeletons;
+	FOnAzureKinectSkeletonsPublished FusedEvent;
+	/** Held by capture threads while fusing, and while sources or listeners change. */
+	mutable FCriticalSection FusionCriticalSection;
+
+	TArray<FAzureKinectSkeleton> FusedSkeletons;
+	mutable FCriticalSection FusedCriticalSection;
+
+	/** Start a voxel grid build if a device has a new point cloud and the previous build is done. */
+	void UpdatePointCloudFusion();
+
+	FAzureKinectVoxelGrid VoxelGrid;
+	TFuture<void> PointCloudTask;
+	/** Point clouds of the latest build, to skip builds without new frames. */
+	TArray<FAzureKinectPointCloudPtr> LastPointClouds;
+
+	/** Published buffer, and the one being built which is swapped in when done. */
+	FAzureKinectFusedPointCloudPtr FrontPointCloud;
+	FAzureKinectFusedPointCloudPtr BackPointCloud;
+	FAzureKinectVoxelGridStats PointCloudStats;
+	mutable FCriticalSection PointCloudCriticalSection;
+};
@@ -0,0 +1,100 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HAL/Runnable.h"
+#include "HAL/RunnableThread.h"
+#include "HAL/ThreadSafeCounter.h"
+#include "Containers/CircularQueue.h"
+
+#include "AzureKinectSdk.h"
+
+#include "AzureKinectImuReader.generated.h"
+
+DECLARE_LOG_CATEGORY_EXTERN(AzureKinectImuLog, Log, All);
+
+/**
+ * A gyroscope and accelerometer sample, in the IMU co-ordinate system of the device.
+ */
+USTRUCT(BlueprintType)
+struct FAzureKinectImuSample
+{
+	GENERATED_BODY()
+
+	/** Device timestamp of the accelerometer sample [usec], same clock as image timestamps. */
+	UPROPERTY(BlueprintReadOnly)
+	int64 TimestampUsec = 0;
+
+	/** Device timestamp of the gyroscope sample [usec]. */
+	UPROPERTY(BlueprintReadOnly)
+	int64 GyroTimestampUsec = 0;
+
+	/** [m/s^2] */
+	UPROPERTY(BlueprintReadOnly)
+	FVector Acceleration = FVector::ZeroVector;
+
+	/** [rad/s] */
+	UPROPERTY(BlueprintReadOnly)
+	FVector AngularVelocity = FVector::ZeroVector;
+
+	/** [Celsius] */
+	UPROPERTY(BlueprintReadOnly)
+	float Temperature = 0.f;
+};
+
+#if WITH_AZUREKINECT_SDK
+
+/**
+ * Reads IMU samples on its own thread into a bounded lock-free ring.
+ * The IMU thread never waits: when readers fall behind, new samples are dropped and counted as overruns.
+ * Readers are serialized among themselves only.
+ */
+class AZUREKINECT_API FAzureKinectImuReader : public FRunnable
+{
+public:
+	FAzureKinectImuReader(k4a::device& InDevice, uint32 Capacity = 4096);
+
+	virtual ~FAzureKinectImuReader();
+
+	/** Start the IMU of the device and the reader thread. Cameras should be running. */
+	bool Start();
+
+	/** Stop the reader thread and the IMU. */
+	void EnsureCompletion();
+
+	/**
+	 * Move samples out of the ring, oldest first.
+	 * @param MaxSamples 0 reads all of them.
+	 * @return Number of samples appended to OutSamples.
+	 */
+	int32 Read(TArray<FAzureKinectImuSample>& OutSamples, int32 MaxSamples = 0);
+
+	/** Same as Read, stopping at the first sample newer than TimestampUsec. */
+	int32 ReadUntil(int64 TimestampUsec, TArray<FAzureKinectImuSample>& OutSamples);
+
+	int32 GetNumOverruns() const { return Overruns.GetValue(); }
+
+	/** Low-passed accelerometer [m/s^2], pointing up at rest. Zero until the first sample. */
+	FVector GetGravity() const;
+
+	// FRunnable interface
+	virtual uint32 Run() override;
+	virtual void Stop() override;
+
+private:
+	k4a::device& Device;
+
+	TCircularQueue<FAzureKinectImuSample> Ring;
+	FCriticalSection ReadCriticalSection;
+
+	FRunnableThread* Thread;
+	FThreadSafeCounter StopTaskCounter;
+	FThreadSafeCounter Overruns;
+	bool bImuStarted;
+
+	/** Filtered on the IMU thread, published without blocking it. */
+	FVector FilteredAcceleration;
+	FVector Gravity;
+	mutable FCriticalSection GravityCriticalSection;
+};
+
+#endif
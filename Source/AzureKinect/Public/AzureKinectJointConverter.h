@@ -0,0 +1,43 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "AzureKinectEnum.h"
+
+#include "AzureKinectSdk.h"
+
+DECLARE_LOG_CATEGORY_EXTERN(AzureKinectJointConverterLog, Log, All);
+
+/**
+ * Converts native joints to Unreal transforms with a camera extrinsic baked in.
+ * The axis swap, millimeter to centimeter scale and extrinsic are folded into one matrix,
+ * so a joint costs a 3x4 transform and a quaternion product on vector registers.
+ * Orientations are converted from Kinect's right handed system by negating x and y.
+ */
+class AZUREKINECT_API FAzureKinectJointConverter
+{
+public:
+	explicit FAzureKinectJointConverter(const FTransform& CameraToWorld = FTransform::Identity);
+
+	void Convert(const k4abt_joint_t* Joints, int32 NumJoints, FTransform* OutJoints) const;
+
+	/** Matrix from a Kinect depth camera point [mm] to world [cm], shared with point clouds. */
+	static FMatrix MakePointToWorld(const FTransform& CameraToWorld);
+
+	/**
+	 * Pick the bodies to convert, at most MaxBodies of them (all if MaxBodies <= 0).
+	 * @param OutIndices Indices of the kept bodies, in their original order.
+	 */
+	static void SelectBodies(const k4abt_skeleton_t* Skeletons, const uint32* IDs, int32 NumBodies, int32 MaxBodies, EKinectBodySelection Selection, TArray<int32>& OutIndices);
+
+	/**
+	 * Run selection and conversion over synthetic bodies.
+	 * @return Average cost per frame [us].
+	 */
+	static float Benchmark(int32 NumBodies, int32 MaxBodies, int32 NumFrames);
+
+private:
+	/** Rows of the Kinect [mm] to world [cm] matrix, translation in the last one. */
+	VectorRegister Rows[4];
+	VectorRegister Rotation;
+	FVector Scale;
+};
@@ -0,0 +1,79 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Async/Future.h"
+
+DECLARE_LOG_CATEGORY_EXTERN(AzureKinectMjpegDecoderLog, Log, All);
+
+class FAzureKinectColorConverter;
+
+/** A color frame decoded to BGRA. */
+struct FAzureKinectColorFrame
+{
+	/** Device timestamp of the color image [usec]. */
+	int64 TimestampUsec = 0;
+
+	int32 Width = 0;
+	int32 Height = 0;
+
+	/** MJPG bytes copied out of the capture, kept to reuse the allocation. */
+	TArray64<uint8> Compressed;
+
+	TArray<FColor> Pixels;
+};
+
+using FAzureKinectColorFramePtr = TSharedPtr<FAzureKinectColorFrame, ESPMode::ThreadSafe>;
+
+/**
+ * Decodes MJPG frames on the thread pool, one frame per task, and hands them back in submission order.
+ * Frames and decoders are recycled. Submit and PopLatest are meant to be called from a single (capture) thread.
+ */
+class AZUREKINECT_API FAzureKinectMjpegDecoder
+{
+public:
+	explicit FAzureKinectMjpegDecoder(int32 InMaxInFlight);
+	~FAzureKinectMjpegDecoder();
+
+	/**
+	 * Copy a compressed frame and start decoding it.
+	 * @return false if the frame has been dropped because MaxInFlight frames are being decoded.
+	 */
+	bool Submit(int64 TimestampUsec, const uint8* Data, int64 Size, int32 Width, int32 Height);
+
+	/** Return the newest decoded frame without breaking submission order, or nullptr. Older decoded frames are skipped. */
+	FAzureKinectColorFramePtr PopLatest();
+
+	/** Wait for all frames in flight. */
+	void Flush();
+
+	int32 GetMaxInFlight() const { return MaxInFlight; }
+	int32 GetNumDropped() const { return NumDropped; }
+
+	/**
+	 * Decode compressed frames with NumThreads frames in flight, 1 decodes serially on the calling thread.
+	 * @return Decoded frames per second.
+	 */
+	static float Benchmark(const TArray<TArray64<uint8>>& CompressedFrames, int32 Width, int32 Height, int32 NumThreads);
+
+private:
+	struct FPendingFrame
+	{
+		FAzureKinectColorFramePtr Frame;
+		TFuture<bool> Result;
+	};
+
+	FAzureKinectColorFramePtr AcquireFrame();
+	TUniquePtr<FAzureKinectColorConverter> AcquireConverter();
+	void ReleaseConverter(TUniquePtr<FAzureKinectColorConverter>&& Converter);
+
+	int32 MaxInFlight;
+	int32 NumDropped = 0;
+
+	/** In submission order. */
+	TArray<FPendingFrame> Pending;
+	TArray<FAzureKinectColorFramePtr> Frames;
+
+	/** Each converter keeps its own image wrapper, shared by worker tasks. */
+	TArray<TUniquePtr<FAzureKinectColorConverter>> Converters;
+	FCriticalSection ConverterCriticalSection;
+};
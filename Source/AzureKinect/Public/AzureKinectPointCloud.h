@@ -0,0 +1,66 @@
+#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+ * A point cloud organized on the depth camera grid.
+ * Positions are kept as depth_image_to_point_cloud returns them (int16 XYZ in millimeter,
+ * Kinect depth camera co-ordinate system), an invalid point has all components 0.
+ */
+struct FAzureKinectPointCloud
+{
+	/** Device timestamp of the depth image [usec]. */
+	int64 TimestampUsec = 0;
+
+	int32 Width = 0;
+	int32 Height = 0;
+
+	/** XYZ triplets, Width * Height * 3 samples. */
+	TArray<int16> Positions;
+
+	/** BGRA color per point, empty if color camera is off. */
+	TArray<FColor> Colors;
+
+	/** Body index per point (255 for none), empty without skeleton tracking or when tracking lags behind depth. */
+	TArray<uint8> BodyIndices;
+
+	int32 GetNumPoints() const { return Width * Height; }
+};
+
+using FAzureKinectPointCloudPtr = TSharedPtr<FAzureKinectPointCloud, ESPMode::ThreadSafe>;
+
+/**
+ * Recycles point cloud frames to avoid allocating several MB per frame.
+ * A frame is handed out again once nobody but the pool references it.
+ * Acquire is meant to be called from a single (capture) thread.
+ */
+class FAzureKinectPointCloudPool
+{
+public:
+	explicit FAzureKinectPointCloudPool(int32 InMaxFrames = 8) : MaxFrames(InMaxFrames) {}
+
+	/** Return a free frame, or nullptr if all MaxFrames frames are still referenced elsewhere. */
+	FAzureKinectPointCloudPtr Acquire()
+	{
+		for (const FAzureKinectPointCloudPtr& Frame : Frames)
+		{
+			if (Frame.GetSharedReferenceCount() == 1)
+			{
+				return Frame;
+			}
+		}
+
+		if (Frames.Num() < MaxFrames)
+		{
+			return Frames.Add_GetRef(MakeShared<FAzureKinectPointCloud, ESPMode::ThreadSafe>());
+		}
+
+		return nullptr;
+	}
+
+	void Reset() { Frames.Reset(); }
+
+private:
+	int32 MaxFrames;
+	TArray<FAzureKinectPointCloudPtr> Frames;
+};
@@ -0,0 +1,115 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HAL/Runnable.h"
+#include "HAL/RunnableThread.h"
+#include "HAL/ThreadSafeCounter.h"
+#include "Containers/CircularQueue.h"
+#include "AzureKinectPointCloud.h"
+
+DECLARE_LOG_CATEGORY_EXTERN(AzureKinectPointCloudLog, Log, All);
+
+/**
+ * Layout of the chunked point cloud file (*.kpc). All values are little endian,
+ * every chunk starts 16 byte aligned so the file can be memory mapped and read in place.
+ *
+ * FileHeader
+ * { FrameHeader, Positions[NumPoints], (padding), Colors[NumPoints], (padding) } * N
+ *
+ * Only valid points are stored. Positions are int16 XYZ in millimeter (Kinect depth camera space)
+ * when quantized, otherwise float XYZ in centimeter (Unreal co-ordinate system).
+ * Colors are BGRA8 and present only if the file header has HasColor flag.
+ * Every frame has the flags and size of the file header, frames that don't are not recorded.
+ */
+namespace AzureKinectPointCloudFormat
+{
+	constexpr uint32 FileMagic = 0x3143504B;	// "KPC1"
+	constexpr uint32 FrameMagic = 0x454D5246;	// "FRME"
+	constexpr uint32 Version = 1;
+	constexpr uint32 Alignment = 16;
+
+	enum EFlags : uint32
+	{
+		Quantized = 1 << 0,
+		HasColor = 1 << 1,
+	};
+
+	struct FFileHeader
+	{
+		uint32 Magic = FileMagic;
+		uint32 Version = AzureKinectPointCloudFormat::Version;
+		uint32 Flags = 0;
+		uint32 Width = 0;
+		uint32 Height = 0;
+		uint32 Reserved[3] = {};
+	};
+
+	struct FFrameHeader
+	{
+		uint32 Magic = FrameMagic;
+		uint32 NumPoints = 0;
+		int64 TimestampUsec = 0;
+		/** Bytes following this header up to the next frame header, including padding. */
+		uint64 PayloadSize = 0;
+		uint64 Reserved = 0;
+	};
+
+	static_assert(sizeof(FFileHeader) % Alignment == 0, "File header should keep chunks aligned.");
+	static_assert(sizeof(FFrameHeader) % Alignment == 0, "Frame header should keep chunks aligned.");
+}
+
+/**
+ * Writes point cloud frames to a *.kpc file on its own thread.
+ * Frames are handed over through a bounded lock-free queue; if the writer falls behind
+ * frames are dropped from the recording (and counted), the capture thread never waits.
+ */
+class AZUREKINECT_API FAzureKinectPointCloudWriter : public FRunnable
+{
+public:
+	FAzureKinectPointCloudWriter(const FString& InFilePath, bool bInQuantize, uint32 QueueCapacity = 16);
+	virtual ~FAzureKinectPointCloudWriter();
+
+	/** Open the file and start the writer thread. */
+	bool Start();
+
+	/** Write everything still queued, then close the file and stop the thread. */
+	void EnsureCompletion();
+
+	/** Queue a frame for writing, return false (and count a drop) if the queue is full. Called from a single thread. */
+	bool Enqueue(const FAzureKinectPointCloudPtr& Frame);
+
+	int32 GetNumWrittenFrames() const { return WrittenFrames.GetValue(); }
+	int32 GetNumDroppedFrames() const { return DroppedFrames.GetValue(); }
+	/** Frames not written because their color or size differs from the first frame's, which the file header describes. */
+	int32 GetNumMismatchedFrames() const { return MismatchedFrames.GetValue(); }
+
+	// FRunnable interface
+	virtual uint32 Run() override;
+	virtual void Stop() override;
+
+private:
+	void WriteFrame(const FAzureKinectPointCloud& Frame);
+	void WritePadding(int64 Size);
+
+	FString FilePath;
+	bool bQuantize;
+
+	TUniquePtr<FArchive> Writer;
+	bool bHeaderWritten;
+	bool bHeaderHasColor;
+	FIntPoint HeaderSize;
+
+	TCircularQueue<FAzureKinectPointCloudPtr> Queue;
+	FEvent* WorkEvent;
+
+	FRunnableThread* Thread;
+	FThreadSafeCounter StopTaskCounter;
+
+	FThreadSafeCounter WrittenFrames;
+	FThreadSafeCounter DroppedFrames;
+	FThreadSafeCounter MismatchedFrames;
+
+	/** Scratch buffers for valid points, reused between frames. */
+	TArray<uint8> PositionScratch;
+	TArray<FColor> ColorScratch;
+};
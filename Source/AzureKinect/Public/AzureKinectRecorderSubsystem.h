@@ -0,0 +1,110 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/EngineSubsystem.h"
+#include "BoneContainer.h"
+#include "AzureKinectDevice.h"
+
+#include "AzureKinectRecorderSubsystem.generated.h"
+
+class UAnimSequence;
+class USkeleton;
+
+DECLARE_LOG_CATEGORY_EXTERN(AzureKinectRecorderLog, Log, All);
+
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FOnAzureKinectAnimationBaked, UAnimSequence*, Animation);
+
+/**
+ * Fixed capacity ring of single body frames.
+ * Memory is allocated once on Reset, the oldest frame is overwritten when full.
+ */
+class FAzureKinectSkeletonRing
+{
+public:
+	struct FFrame
+	{
+		int64 TimestampUsec;
+		FQuat Rotations[static_cast<int32>(EKinectBodyJoint::COUNT)];
+	};
+
+	void Reset(int32 InCapacity);
+
+	void Push(int64 TimestampUsec, const FAzureKinectSkeleton& Skeleton);
+
+	int32 Num() const { return NumFrames; }
+
+	/** Return a frame by chronological index, 0 is the oldest one. */
+	const FFrame& operator[](int32 Index) const { return Frames[(Head + Index) % Frames.Num()]; }
+
+private:
+	TArray<FFrame> Frames;
+	int32 Head = 0;
+	int32 NumFrames = 0;
+};
+
+/**
+ * Records a tracked body from UAzureKinectDevice into a preallocated ring on the tracking thread,
+ * and bakes it into an UAnimSequence with the same bone mapping as FAnimNode_AzureKinectPose.
+ * Resampling and key reduction run on worker threads, only the asset creation is on the game thread.
+ * Baking needs editor only animation data, so it's available in editor builds only.
+ */
+UCLASS()
+class AZUREKINECT_API UAzureKinectRecorderSubsystem : public UEngineSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	virtual void Deinitialize() override;
+
+	/**
+	 * Start buffering skeletons published by the device.
+	 * @param MaxDuration Length of the ring [sec], older frames are overwritten.
+	 * @param BodyID Body to record, or -1 to follow the first tracked body.
+	 */
+	UFUNCTION(BlueprintCallable, Category = "Azure Kinect|Recorder")
+	bool StartRecording(UAzureKinectDevice* Device, float MaxDuration = 600.f, int32 BodyID = -1);
+
+	/**
+	 * Stop buffering and bake the ring into a new animation asset in the background.
+	 * OnAnimationBaked is broadcast on the game thread when done.
+	 * @param AssetPath Long package name of the asset, e.g. "/Game/Kinect/Take01".
+	 */
+	UFUNCTION(BlueprintCallable, Category = "Azure Kinect|Recorder")
+	bool StopRecording(USkeleton* Skeleton, const TMap<EKinectBodyJoint, FName>& BoneNames, const FString& AssetPath, float SampleRate = 30.f);
+
+	/** Same as StopRecording, taking FAnimNode_AzureKinectPose::BonesToModify. */
+	bool StopRecordingWithBoneReferences(USkeleton* Skeleton, const TMap<EKinectBodyJoint, FBoneReference>& BonesToModify, const FString& AssetPath, float SampleRate = 30.f);
+
+	UFUNCTION(BlueprintCallable, Category = "Azure Kinect|Recorder")
+	bool IsRecording() const { return RecordingDevice.IsValid(); }
+
+	UFUNCTION(BlueprintCallable, Category = "Azure Kinect|Recorder")
+	bool IsBaking() const { return bBaking; }
+
+	UFUNCTION(BlueprintCallable, Category = "Azure Kinect|Recorder")
+	int32 GetNumRecordedFrames() const;
+
+	UPROPERTY(BlueprintAssignable, Category = "Azure Kinect|Recorder")
+	FOnAzureKinectAnimationBaked OnAnimationBaked;
+
+	/** Position and rotation tolerance to collapse a track into a single key. */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Azure Kinect|Recorder")
+	float PositionTolerance = 0.01f;
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Azure Kinect|Recorder")
+	float RotationTolerance = 0.0001f;
+
+private:
+	void OnSkeletonsPublished(int64 TimestampUsec, const TArray<FAzureKinectSkeleton>& Skeletons);
+	void DetachDevice();
+
+	TWeakObjectPtr<UAzureKinectDevice> RecordingDevice;
+	FDelegateHandle PublishedHandle;
+
+	/** Written on the capture thread while recording, read by the bake task after. */
+	FAzureKinectSkeletonRing Ring;
+	mutable FCriticalSection RingCriticalSection;
+	int32 RecordingBodyID = -1;
+
+	FThreadSafeBool bBaking;
+};
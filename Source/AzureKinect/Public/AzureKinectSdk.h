@@ -0,0 +1,83 @@
+#pragma once
+
+/**
+ * Sensor and Body Tracking SDK headers.
+ * Without the SDK (WITH_AZUREKINECT_SDK is 0, e.g. on headless build machines), only the plain C types
+ * the processing pipeline shares with the SDK are declared, with the same layout,
+ * so everything but the native frame source still builds and runs.
+ */
+#if WITH_AZUREKINECT_SDK
+
+#include "k4a/k4a.hpp"
+#include "k4abt.hpp"
+
+#else
+
+// Brought in by k4a.hpp otherwise
+#include <chrono>
+
+typedef union
+{
+	struct _xy
+	{
+		float x;
+		float y;
+	} xy;
+	float v[2];
+} k4a_float2_t;
+
+typedef union
+{
+	struct _xyz
+	{
+		float x;
+		float y;
+		float z;
+	} xyz;
+	float v[3];
+} k4a_float3_t;
+
+typedef union
+{
+	struct _wxyz
+	{
+		float w;
+		float x;
+		float y;
+		float z;
+	} wxyz;
+	float v[4];
+} k4a_quaternion_t;
+
+/** Only the joints referred to by name in this module. */
+typedef enum
+{
+	K4ABT_JOINT_PELVIS = 0,
+	K4ABT_JOINT_COUNT = 32
+} k4abt_joint_id_t;
+
+typedef enum
+{
+	K4ABT_JOINT_CONFIDENCE_NONE = 0,
+	K4ABT_JOINT_CONFIDENCE_LOW = 1,
+	K4ABT_JOINT_CONFIDENCE_MEDIUM = 2,
+	K4ABT_JOINT_CONFIDENCE_HIGH = 3,
+	K4ABT_JOINT_CONFIDENCE_LEVELS_COUNT = 4
+} k4abt_joint_confidence_level_t;
+
+typedef struct
+{
+	k4a_float3_t position;
+	k4a_quaternion_t orientation;
+	k4abt_joint_confidence_level_t confidence_level;
+} k4abt_joint_t;
+
+typedef struct
+{
+	k4abt_joint_t joints[K4ABT_JOINT_COUNT];
+} k4abt_skeleton_t;
+
+#define K4ABT_DEFAULT_TRACKER_SMOOTHING_FACTOR 0.0f
+#define K4ABT_BODY_INDEX_MAP_BACKGROUND 255
+
+#endif
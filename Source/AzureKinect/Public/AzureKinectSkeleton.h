@@ -0,0 +1,27 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "AzureKinectEnum.h"
+#include "AzureKinectBodyGeometry.h"
+
+#include "AzureKinectSkeleton.generated.h"
+
+USTRUCT(BlueprintType)
+struct FAzureKinectSkeleton
+{
+	GENERATED_BODY()
+
+	UPROPERTY(BlueprintReadWrite)
+	int32 ID;
+
+	UPROPERTY(BlueprintReadWrite)
+	TArray<FTransform> Joints;
+
+	/** Confidence level of each joint, same order as Joints. */
+	UPROPERTY(BlueprintReadWrite)
+	TArray<EKinectJointConfidence> JointConfidences;
+
+	/** Bounds, centroid and contour of the body pixels, filled when the device has BodyGeometry enabled. */
+	UPROPERTY(BlueprintReadWrite)
+	FAzureKinectBodyGeometry Geometry;
+};
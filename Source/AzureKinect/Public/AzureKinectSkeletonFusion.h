@@ -0,0 +1,88 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "AzureKinectSkeleton.h"
+
+#include "AzureKinectSkeletonFusion.generated.h"
+
+DECLARE_LOG_CATEGORY_EXTERN(AzureKinectFusionLog, Log, All);
+
+USTRUCT(BlueprintType)
+struct FAzureKinectFusionSettings
+{
+	GENERATED_BODY()
+
+	/** Bodies of different devices whose pelvis are closer than this are the same person [cm]. */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, meta = (ClampMin = "1"))
+	float AssociationDistance = 40.f;
+
+	/**
+	 * Weight of a device seeing the body from behind, 1 is a device in front of it.
+	 * Kinect assumes bodies face the camera, so back views are mirrored and less reliable.
+	 */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, meta = (ClampMin = "0", ClampMax = "1"))
+	float MinViewWeight = 0.1f;
+
+	/** Frames older than this are left out of the fusion [sec]. */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, meta = (ClampMin = "0.001"))
+	float MaxFrameAge = 0.1f;
+};
+
+/** Skeletons of a single device in the shared world frame. */
+struct FAzureKinectSkeletonView
+{
+	/** Camera position in the same space as the skeletons [cm]. */
+	FVector CameraLocation = FVector::ZeroVector;
+
+	TArray<FAzureKinectSkeleton> Skeletons;
+};
+
+/**
+ * Merges skeletons seen by several devices into one set.
+ * Bodies are associated across views by pelvis distance, then every joint is averaged
+ * with a weight from its confidence and how frontal the view is. Fused bodies keep their IDs
+ * across frames by matching the previous result. Doesn't depend on the device, so it can be fed synthetic views.
+ */
+class AZUREKINECT_API FAzureKinectSkeletonFusion
+{
+public:
+	/** Fuse views into OutSkeletons, reusing its allocations. Not thread safe. */
+	void Fuse(const TArray<FAzureKinectSkeletonView>& Views, const FAzureKinectFusionSettings& Settings, TArray<FAzureKinectSkeleton>& OutSkeletons);
+
+	/** Forget fused IDs and facing. */
+	void Reset();
+
+	/**
+	 * Fuse synthetic views of NumBodies walking bodies with joint noise.
+	 * @param OutMeanError Mean distance of fused joints to the ground truth [cm].
+	 * @return Average cost of a fusion [ms].
+	 */
+	static float Benchmark(int32 NumViews, int32 NumBodies, int32 NumFrames, float& OutMeanError);
+
+private:
+	/** A fused body of the previous frame. */
+	struct FTrack
+	{
+		int32 ID;
+		FVector Pelvis;
+		FVector Forward;
+		int32 MissedFrames;
+	};
+
+	/** Bodies of one person, one per view at most. */
+	struct FCluster
+	{
+		FVector Pelvis;
+		/** Skeleton index in each view, INDEX_NONE if not seen. */
+		TArray<int32, TInlineAllocator<8>> Bodies;
+		int32 TrackIndex;
+	};
+
+	void Associate(const TArray<FAzureKinectSkeletonView>& Views, float Distance);
+	void MatchTracks(float Distance);
+	void MergeJoints(const TArray<FAzureKinectSkeletonView>& Views, const FCluster& Cluster, const FVector& Forward, float MinViewWeight, FAzureKinectSkeleton& OutSkeleton) const;
+
+	TArray<FTrack> Tracks;
+	TArray<FCluster> Clusters;
+	int32 NextID = 1;
+};
@@ -0,0 +1,139 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "AzureKinectSkeleton.h"
+
+DECLARE_LOG_CATEGORY_EXTERN(AzureKinectSkeletonStreamLog, Log, All);
+
+class IMappedFileHandle;
+class IMappedFileRegion;
+
+/**
+ * Layout of the skeleton stream file (*.ksk). All values are little endian.
+ *
+ * FileHeader
+ * { FrameHeader, BodyRecord[NumBodies] } * NumFrames
+ * FrameIndexEntry[NumFrames]
+ * Trailer
+ *
+ * Positions are Unreal co-ordinates quantized to int16 millimeter (+-32 m range),
+ * rotations are quaternion components quantized to int16 in [-1, 1].
+ * The frame index and trailer are written on Close; if they are missing (e.g. a crash)
+ * the reader rebuilds the index by scanning frames. A present trailer whose index or frames
+ * don't lie inside the file fails to open.
+ */
+namespace AzureKinectSkeletonFormat
+{
+	constexpr uint32 FileMagic = 0x314B534B;	// "KSK1"
+	constexpr uint32 TrailerMagic = 0x494B534B;	// "KSKI"
+	constexpr uint32 Version = 1;
+	constexpr uint32 JointCount = 32;
+	constexpr uint32 MaxBodies = 64;			// Bound for corrupt frame headers
+
+	constexpr float PositionScale = 10.f;		// cm to quantized mm
+	constexpr float RotationScale = 32767.f;
+
+	struct FFileHeader
+	{
+		uint32 Magic = FileMagic;
+		uint32 Version = AzureKinectSkeletonFormat::Version;
+		uint32 JointCount = AzureKinectSkeletonFormat::JointCount;
+		uint32 Reserved = 0;
+	};
+
+	struct FFrameHeader
+	{
+		int64 TimestampUsec = 0;
+		uint32 NumBodies = 0;
+		uint32 Reserved = 0;
+	};
+
+	struct FJointRecord
+	{
+		int16 Position[3];
+		int16 Rotation[4];
+		uint8 Confidence;
+		uint8 Reserved;
+	};
+
+	struct FBodyRecord
+	{
+		uint32 ID;
+		FJointRecord Joints[JointCount];
+	};
+
+	struct FFrameIndexEntry
+	{
+		uint64 Offset;
+		int64 TimestampUsec;
+	};
+
+	struct FTrailer
+	{
+		uint64 IndexOffset = 0;
+		uint32 NumFrames = 0;
+		uint32 Magic = TrailerMagic;
+	};
+
+	static_assert(sizeof(FJointRecord) == 16, "Joint record should be packed.");
+	static_assert(sizeof(FBodyRecord) == 4 + 16 * JointCount, "Body record should be packed.");
+}
+
+/**
+ * Writes published skeletons into a *.ksk file.
+ * Frames are a few KB at most, so it's cheap enough to be called from the tracking thread.
+ */
+class AZUREKINECT_API FAzureKinectSkeletonWriter
+{
+public:
+	~FAzureKinectSkeletonWriter();
+
+	bool Open(const FString& FilePath);
+
+	/** Write the frame index and trailer, then close the file. */
+	void Close();
+
+	void WriteFrame(int64 TimestampUsec, const TArray<FAzureKinectSkeleton>& Skeletons);
+
+	int32 GetNumFrames() const { return FrameIndex.Num(); }
+
+private:
+	TUniquePtr<FArchive> Writer;
+	TArray<AzureKinectSkeletonFormat::FFrameIndexEntry> FrameIndex;
+	TArray<AzureKinectSkeletonFormat::FBodyRecord> BodyScratch;
+};
+
+/**
+ * Reads a *.ksk file through a memory map, with random access to frames.
+ */
+class AZUREKINECT_API FAzureKinectSkeletonReader
+{
+public:
+	~FAzureKinectSkeletonReader();
+
+	bool Open(const FString& FilePath);
+	void Close();
+
+	int32 GetNumFrames() const { return FrameIndex.Num(); }
+	int64 GetFrameTimestamp(int32 FrameIndex) const;
+
+	/** Return the last frame at or before given timestamp (clamped to the first frame). */
+	int32 FindFrame(int64 TimestampUsec) const;
+
+	/** Decode a frame into skeletons, reusing the arrays of OutSkeletons. */
+	bool ReadFrame(int32 Frame, int64& OutTimestampUsec, TArray<FAzureKinectSkeleton>& OutSkeletons) const;
+
+private:
+	/** @param bOutHasTrailer Whether the file ends with a trailer, so the index isn't missing but corrupt. */
+	bool ReadIndex(bool& bOutHasTrailer);
+	bool ScanIndex();
+	/** Whether the frame at Offset, bodies included, lies between the file header and End. */
+	bool IsFrameInRange(uint64 Offset, int64 End) const;
+
+	TUniquePtr<IMappedFileHandle> MappedHandle;
+	TUniquePtr<IMappedFileRegion> MappedRegion;
+	const uint8* Data = nullptr;
+	int64 DataSize = 0;
+
+	TArray<AzureKinectSkeletonFormat::FFrameIndexEntry> FrameIndex;
+};
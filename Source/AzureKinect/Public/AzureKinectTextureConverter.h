@@ -0,0 +1,21 @@
+#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+ * Packs native depth, infrared and body index images into the RGBA8 texels of the device textures.
+ * Each texel is built as one little endian 32 bit word, over blocks of pixels on worker threads.
+ * Dst holds NumPixels * 4 bytes and is 4 byte aligned.
+ */
+class AZUREKINECT_API FAzureKinectTextureConverter
+{
+public:
+	/** R and G are the low and high byte of the depth [mm], B is 0xFF where depth is invalid. */
+	static void DepthToRGBA(const uint16* Src, int32 NumPixels, uint8* Dst);
+
+	/** R and G are the low and high byte of the IR value, pixels without IR are blue. */
+	static void InfraredToRGBA(const uint16* Src, int32 NumPixels, uint8* Dst);
+
+	/** The body index (255 for background) in R, G and B. */
+	static void BodyIndexToRGBA(const uint8* Src, int32 NumPixels, uint8* Dst);
+};
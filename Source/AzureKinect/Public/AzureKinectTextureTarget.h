@@ -0,0 +1,142 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Engine/TextureRenderTarget2D.h"
+#include "RHIResources.h"
+#include "Stats/Stats.h"
+
+DECLARE_STATS_GROUP(TEXT("AzureKinect"), STATGROUP_AzureKinect, STATCAT_Advanced);
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Texture allocations"), STAT_AzureKinectTextureAllocations, STATGROUP_AzureKinect, AZUREKINECT_API);
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Texture reallocations"), STAT_AzureKinectTextureReallocations, STATGROUP_AzureKinect, AZUREKINECT_API);
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Dropped texture uploads"), STAT_AzureKinectDroppedUploads, STATGROUP_AzureKinect, AZUREKINECT_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Texture upload"), STAT_AzureKinectTextureUpload, STATGROUP_AzureKinect, AZUREKINECT_API);
+
+/**
+ * Keeps a device render target at the size of the frames written into it.
+ * The resource is only created on the game thread: up front from the known mode resolution,
+ * or when a frame comes at another size, on request of the capture thread, which skips frames until it's done.
+ * The capture thread only compares the resource and size of the texture with the tracked ones, and never writes to it.
+ *
+ * Frames are uploaded through two slots that persist across frames, one written by the capture thread while the other is in flight.
+ * On D3D11 each slot is a CPU writable staging texture which the render thread keeps mapped: the capture thread writes
+ * texels straight into it, the render thread unmaps it and enqueues a GPU copy into the texture, and maps it again
+ * one frame later, once the copy is done. Render thread time doesn't depend on the frame size then.
+ * Other RHIs, or strides other than tightly packed rows, fall back to a CPU buffer per slot which the render thread
+ * uploads with RHIUpdateTexture2D, a copy proportional to the frame size. The RHI stages it through its own upload memory,
+ * and copies it into command list memory first when it runs on its own thread.
+ * Slots are created on first upload and only recreated when the frame size changes,
+ * and a render thread running behind drops frames instead of queuing more copies.
+ */
+class AZUREKINECT_API FAzureKinectTextureTarget
+{
+public:
+	FAzureKinectTextureTarget(EPixelFormat InFormat, ETextureRenderTargetFormat InRenderTargetFormat, bool bInForceLinearGamma);
+
+	/** Unmaps and releases staging textures on the render thread. */
+	~FAzureKinectTextureTarget();
+
+	/** Game thread. Allocate the texture for frames of given size, unless it already fits. Nothing for a zero size. */
+	void Preallocate(UTextureRenderTarget2D* Texture, const FIntPoint& Size);
+
+	/**
+	 * Capture thread. Reserve a slot for a Width x Height frame, to fill with tightly packed texels before EndUpload.
+	 * @return Where to write the frame, nullptr to skip it while the texture is resized or every slot is still in flight.
+	 */
+	uint8* BeginUpload(UTextureRenderTarget2D* Texture, int32 Width, int32 Height);
+
+	/** Capture thread. Copy the slot written since BeginUpload into the texture on the render thread. */
+	void EndUpload();
+
+	/** Resources recreated on request of the capture thread, 0 in steady state. */
+	int32 GetNumReallocations() const { return State->NumReallocations; }
+
+	/** Frames skipped because the render thread hadn't consumed any slot yet. */
+	int32 GetNumDroppedFrames() const { return State->NumDroppedFrames; }
+
+	/**
+	 * Exponential moving average of the render thread time spent submitting a frame [ms].
+	 * The GPU copy from a staging texture runs later and isn't included. In the fallback path it's the RHIUpdateTexture2D call,
+	 * which with a separate RHI thread only copies the frame into command list memory.
+	 */
+	float GetAverageUploadMs() const;
+
+	/** FPlatformTime::Seconds when the render thread last submitted a frame, 0 before the first one. */
+	double GetLastUploadTime() const;
+
+private:
+	static constexpr int32 NumSlots = 2;
+
+	/** Who owns the staging texture of a slot. */
+	enum class EStaging : uint8
+	{
+		/** Render thread: not created yet, or unmapped with a copy in flight. */
+		Unmapped,
+		/** Mapped, the capture thread may claim it. */
+		Mapped,
+		/** Claimed by the capture thread until the render thread unmaps it. */
+		Claimed,
+	};
+
+	struct FSlot
+	{
+		/** Fallback when the slot has no mapped staging texture. */
+		TArray<uint8> Data;
+		/** Set by the capture thread when the upload is enqueued, cleared by the render thread once the data is consumed. */
+		TAtomic<bool> bInFlight { false };
+
+		/** Render thread only, except for the mapped memory while claimed. */
+		FTexture2DRHIRef Staging;
+		FIntPoint StagingSize = FIntPoint::ZeroValue;
+		uint8* MappedData = nullptr;
+		TAtomic<EStaging> StagingState { EStaging::Unmapped };
+	};
+
+	/** Shared with pending game thread tasks and render commands, which may outlive the device. */
+	struct FState
+	{
+		EPixelFormat Format;
+		ETextureRenderTargetFormat RenderTargetFormat;
+		bool bForceLinearGamma;
+
+		FCriticalSection CriticalSection;
+		const UTextureRenderTarget2D* Texture = nullptr;
+		FTextureResource* Resource = nullptr;
+		FIntPoint Size = FIntPoint::ZeroValue;
+		bool bResizePending = false;
+
+		TAtomic<int32> NumReallocations { 0 };
+
+		FSlot Slots[NumSlots];
+		TAtomic<int32> NumDroppedFrames { 0 };
+
+		/** Render thread. Cleared for good once the RHI can't map a staging texture as tightly packed rows. */
+		bool bStaging = true;
+		bool bStagingChecked = false;
+
+		/** Render thread writes, any thread reads. */
+		mutable FCriticalSection TimingCriticalSection;
+		float AverageUploadMs = 0.f;
+		int32 NumUploads = 0;
+		double LastUploadTime = 0.0;
+	};
+
+	FTextureResource* GetResourceFor(UTextureRenderTarget2D* Texture, int32 Width, int32 Height);
+
+	/** @return Whether the resource had to be (re)created. */
+	static bool Allocate(FState& InState, UTextureRenderTarget2D* Texture, int32 Width, int32 Height);
+
+	/** Render thread. Map the staging texture of an unmapped slot for the next frame of given size, creating it if needed. */
+	static void MapStaging(FState& InState, FSlot& Slot, const FIntPoint& Size);
+
+	/** Render thread. Unmap and release a staging texture the capture thread won't use anymore. */
+	static void ReleaseStaging(FSlot& Slot);
+
+	TSharedRef<FState, ESPMode::ThreadSafe> State;
+
+	/** Capture thread only. Slots are taken in order, the render thread frees them in the same order. */
+	int32 NextSlot = 0;
+	int32 WritingSlot = INDEX_NONE;
+	bool bWritingStaging = false;
+	FTextureResource* WritingResource = nullptr;
+	FIntPoint WritingSize = FIntPoint::ZeroValue;
+};
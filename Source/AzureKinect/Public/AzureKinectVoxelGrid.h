@@ -0,0 +1,129 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "AzureKinectPointCloud.h"
+
+#include "AzureKinectVoxelGrid.generated.h"
+
+USTRUCT(BlueprintType)
+struct FAzureKinectVoxelGridSettings
+{
+	GENERATED_BODY()
+
+	/** Merge point clouds of all fused devices into FusedPointCloud. Devices should generate point clouds. */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere)
+	bool bEnabled = false;
+
+	/** Edge of a voxel, points inside one are averaged into a single point [cm]. */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, meta = (ClampMin = "0.1", ClampMax = "100"))
+	float VoxelSize = 1.f;
+
+	/** Voxels with less points are dropped as noise. */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, meta = (ClampMin = "1", ClampMax = "64"))
+	int32 MinPointsPerVoxel = 1;
+};
+
+USTRUCT(BlueprintType)
+struct FAzureKinectVoxelGridStats
+{
+	GENERATED_BODY()
+
+	/** Valid points of all devices. */
+	UPROPERTY(BlueprintReadOnly)
+	int32 PointsIn = 0;
+
+	/** Points after downsampling, one per voxel. */
+	UPROPERTY(BlueprintReadOnly)
+	int32 PointsOut = 0;
+
+	UPROPERTY(BlueprintReadOnly)
+	int32 NumDevices = 0;
+
+	/** [ms] */
+	UPROPERTY(BlueprintReadOnly)
+	float BuildMs = 0.f;
+};
+
+/** A merged point cloud in world space, one point per occupied voxel. */
+struct FAzureKinectFusedPointCloud
+{
+	/** Newest device timestamp of the sources [usec], device clocks are not shared. */
+	int64 TimestampUsec = 0;
+
+	/** World position [cm], centroid of the voxel points. */
+	TArray<FVector> Positions;
+
+	/**
+	 * Average color of the voxel points that have one, white where devices had no color.
+	 * Transparent white where none of them had, e.g. occluded from or outside the view of the color camera.
+	 */
+	TArray<FColor> Colors;
+};
+
+using FAzureKinectFusedPointCloudPtr = TSharedPtr<FAzureKinectFusedPointCloud, ESPMode::ThreadSafe>;
+
+/** A device point cloud with the transform of its depth camera. */
+struct FAzureKinectVoxelGridSource
+{
+	FAzureKinectPointCloudPtr PointCloud;
+	FTransform CameraToWorld;
+};
+
+/**
+ * Merges point clouds into a sparse voxel hash grid.
+ * Points are transformed and binned by voxel key in parallel, partitioned into shards by key hash,
+ * then each shard is reduced in its own hash map on a worker. Scratch buffers are kept between builds.
+ * Build is not reentrant.
+ */
+class AZUREKINECT_API FAzureKinectVoxelGrid
+{
+public:
+	void Build(const TArray<FAzureKinectVoxelGridSource>& Sources, const FAzureKinectVoxelGridSettings& Settings, FAzureKinectFusedPointCloud& OutCloud, FAzureKinectVoxelGridStats& OutStats);
+
+private:
+	struct FEntry
+	{
+		uint64 Key;
+		FVector Position;
+		FColor Color;
+	};
+
+	struct FVoxel
+	{
+		FVector PositionSum;
+		uint32 ColorSum[3];
+		int32 Count;
+		/** Points with a color, depth pixels the color camera doesn't see come with alpha 0. */
+		int32 ColorCount;
+	};
+
+	struct FShard
+	{
+		TMap<uint64, int32> Index;
+		TArray<FVoxel> Voxels;
+		/** Voxels with enough points, offset in the output. */
+		int32 NumOut;
+		int32 OutOffset;
+	};
+
+	/** A range of points of one source, processed by one task. */
+	struct FChunk
+	{
+		int32 Source;
+		int32 Start;
+		int32 End;
+		/** Index of Start in Entries. */
+		int32 EntryOffset;
+	};
+
+	TArray<FChunk> Chunks;
+	/** Per input point, Key is invalid for points without depth. */
+	TArray<FEntry> Entries;
+	/** Valid entries grouped by shard. */
+	TArray<FEntry> Partitioned;
+	/** Points per shard of each chunk, then write offsets into Partitioned. */
+	TArray<int32> ChunkShardCounts;
+	TArray<FShard> Shards;
+	/** First entry of each shard in Partitioned, and the end. */
+	TArray<int32> ShardStarts;
+};
@@ -0,0 +1,63 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "NiagaraDataInterface.h"
+#include "AzureKinectDevice.h"
+
+#include "NiagaraDataInterfaceAzureKinectPointCloud.generated.h"
+
+/** Per system instance view of the latest point cloud, shared with the device and other instances. */
+struct FNDIAzureKinectPointCloudInstanceData
+{
+	FAzureKinectPointCloudPtr PointCloud;
+	FMatrix PointToWorld;
+	int32 Stride;
+	/** Strided grid size. */
+	int32 Width;
+	int32 Height;
+};
+
+/**
+ * Reads the latest point cloud of a device in CPU emitters, without render targets or copies.
+ * Every system instance references the frame the device published, so any number of systems share it.
+ * The device should generate point clouds. Points are sampled on the depth grid with Stride,
+ * points without depth are reported as invalid so emitters can skip them.
+ */
+UCLASS(EditInlineNew, Category = "Azure Kinect", meta = (DisplayName = "Azure Kinect Point Cloud"))
+class AZUREKINECT_API UNiagaraDataInterfaceAzureKinectPointCloud : public UNiagaraDataInterface
+{
+	GENERATED_UCLASS_BODY()
+
+public:
+	UPROPERTY(EditAnywhere, Category = "Azure Kinect")
+	UAzureKinectDevice* Device;
+
+	/** Use every Nth point in both directions of the depth grid. */
+	UPROPERTY(EditAnywhere, Category = "Azure Kinect", meta = (ClampMin = "1", ClampMax = "16"))
+	int32 Stride;
+
+	/** Positions in world space with the transform of the device skeletons, depth camera space otherwise. */
+	UPROPERTY(EditAnywhere, Category = "Azure Kinect")
+	bool bWorldSpace;
+
+	// UObject interface
+	virtual void PostInitProperties() override;
+
+	// UNiagaraDataInterface interface
+	virtual void GetFunctions(TArray<FNiagaraFunctionSignature>& OutFunctions) override;
+	virtual void GetVMExternalFunction(const FVMExternalFunctionBindingInfo& BindingInfo, void* InstanceData, FVMExternalFunction& OutFunc) override;
+	virtual bool CanExecuteOnTarget(ENiagaraSimTarget Target) const override { return Target == ENiagaraSimTarget::CPUSim; }
+	virtual bool InitPerInstanceData(void* PerInstanceData, FNiagaraSystemInstance* SystemInstance) override;
+	virtual void DestroyPerInstanceData(void* PerInstanceData, FNiagaraSystemInstance* SystemInstance) override;
+	virtual int32 PerInstanceDataSize() const override { return sizeof(FNDIAzureKinectPointCloudInstanceData); }
+	virtual bool PerInstanceTick(void* PerInstanceData, FNiagaraSystemInstance* SystemInstance, float DeltaSeconds) override;
+	virtual bool Equals(const UNiagaraDataInterface* Other) const override;
+
+	void GetNumPoints(FVectorVMContext& Context);
+	void GetPointPosition(FVectorVMContext& Context);
+	void GetPointColor(FVectorVMContext& Context);
+	void GetPointBodyIndex(FVectorVMContext& Context);
+
+protected:
+	virtual bool CopyToInternal(UNiagaraDataInterface* Destination) const override;
+};
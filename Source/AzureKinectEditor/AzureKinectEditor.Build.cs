@@ -16,6 +16,7 @@ public class AzureKinectEditor : ModuleRules
 				"AzureKinectEditor/Private",
 				"AzureKinectEditor/Private/AnimNodes",
 				"AzureKinectEditor/Private/AssetTools",
+				"AzureKinectEditor/Private/Commandlets",
 				"AzureKinectEditor/Private/Customizations",
 				"AzureKinectEditor/Private/Factories",
 			});
@@ -34,6 +35,8 @@ public class AzureKinectEditor : ModuleRules
 				"UnrealEd",
 				"BlueprintGraph",
 				"AnimGraph",
+				"ImageWrapper",
+				"Json",
 			});
 
 	}
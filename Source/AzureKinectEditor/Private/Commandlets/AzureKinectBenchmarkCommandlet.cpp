@@ -0,0 +1,658 @@
+#include "AzureKinectBenchmarkCommandlet.h"
+#include "AzureKinectBackgroundModel.h"
+#include "AzureKinectBodyGeometry.h"
+#include "AzureKinectColorConverter.h"
+#include "AzureKinectDepthFilter.h"
+#include "AzureKinectDevice.h"
+#include "AzureKinectDepthMesher.h"
+#include "AzureKinectJointConverter.h"
+#include "AzureKinectSkeletonFusion.h"
+#include "AzureKinectTextureConverter.h"
+#include "AzureKinectVoxelGrid.h"
+#include "Dom/JsonObject.h"
+#include "HAL/MemoryBase.h"
+#include "IImageWrapper.h"
+#include "IImageWrapperModule.h"
+#include "Misc/FileHelper.h"
+#include "Policies/CondensedJsonPrintPolicy.h"
+#include "Serialization/JsonSerializer.h"
+#include "Serialization/JsonWriter.h"
+
+DEFINE_LOG_CATEGORY(AzureKinectBenchmarkLog);
+
+namespace
+{
+	/** Synthetic frames cycled through, so caches see changing content like live frames. */
+	constexpr int32 NumSourceFrames = 8;
+
+	enum EStage
+	{
+		StageDepthFilter,
+		StageBackground,
+		StageColor,
+		StageDepthTexture,
+		StageInfraredTexture,
+		StageBodyIndexTexture,
+		StageSkeletons,
+		StageSkeletonPublish,
+		StageBodyGeometry,
+		StageSkeletonFusion,
+		StageVoxelGrid,
+		StageDepthMesh,
+		NumStages
+	};
+
+	const TCHAR* const StageNames[NumStages] =
+	{
+		TEXT("DepthFilter"),
+		TEXT("BackgroundSubtraction"),
+		TEXT("ColorConversion"),
+		TEXT("DepthToRGBA"),
+		TEXT("InfraredToRGBA"),
+		TEXT("BodyIndexToRGBA"),
+		TEXT("Skeletons"),
+		TEXT("SkeletonPublish"),
+		TEXT("BodyGeometry"),
+		TEXT("SkeletonFusion"),
+		TEXT("VoxelGrid"),
+		TEXT("DepthMesh"),
+	};
+
+	/**
+	 * Forwards to the allocator it wraps and counts allocations on every thread while it's GMalloc.
+	 * Blocks allocated before it was installed or after it's removed are freed by the same inner allocator, so it can be swapped in and out at any time.
+	 */
+	class FCountingMalloc final : public FMalloc
+	{
+	public:
+		void SetInner(FMalloc* InInner) { Inner = InInner; }
+
+		int64 GetNumAllocs() const { return NumAllocs; }
+		int64 GetNumBytes() const { return NumBytes; }
+
+		virtual void* Malloc(SIZE_T Count, uint32 Alignment) override
+		{
+			Record(Count);
+			return Inner->Malloc(Count, Alignment);
+		}
+
+		virtual void* TryMalloc(SIZE_T Count, uint32 Alignment) override
+		{
+			Record(Count);
+			return Inner->TryMalloc(Count, Alignment);
+		}
+
+		virtual void* Realloc(void* Original, SIZE_T Count, uint32 Alignment) override
+		{
+			// Shrinking or freeing doesn't allocate
+			SIZE_T OriginalSize = 0;
+			if (Count > 0 && (!Original || !Inner->GetAllocationSize(Original, OriginalSize) || Count > OriginalSize))
+			{
+				Record(Count);
+			}
+			return Inner->Realloc(Original, Count, Alignment);
+		}
+
+		virtual void* TryRealloc(void* Original, SIZE_T Count, uint32 Alignment) override
+		{
+			return Realloc(Original, Count, Alignment);
+		}
+
+		virtual void Free(void* Original) override { Inner->Free(Original); }
+		virtual SIZE_T QuantizeSize(SIZE_T Count, uint32 Alignment) override { return Inner->QuantizeSize(Count, Alignment); }
+		virtual bool GetAllocationSize(void* Original, SIZE_T& SizeOut) override { return Inner->GetAllocationSize(Original, SizeOut); }
+		virtual void Trim(bool bTrimThreadCaches) override { Inner->Trim(bTrimThreadCaches); }
+		virtual void SetupTLSCachesOnCurrentThread() override { Inner->SetupTLSCachesOnCurrentThread(); }
+		virtual void ClearAndDisableTLSCachesOnCurrentThread() override { Inner->ClearAndDisableTLSCachesOnCurrentThread(); }
+		virtual void InitializeStatsMetadata() override { Inner->InitializeStatsMetadata(); }
+		virtual void UpdateStats() override { Inner->UpdateStats(); }
+		virtual void GetAllocatorStats(FGenericMemoryStats& OutStats) override { Inner->GetAllocatorStats(OutStats); }
+		virtual void DumpAllocatorStats(FOutputDevice& Ar) override { Inner->DumpAllocatorStats(Ar); }
+		virtual bool IsInternallyThreadSafe() const override { return Inner->IsInternallyThreadSafe(); }
+		virtual bool ValidateHeap() override { return Inner->ValidateHeap(); }
+		virtual const TCHAR* GetDescriptiveName() override { return Inner->GetDescriptiveName(); }
+
+	private:
+		FORCEINLINE void Record(SIZE_T Count)
+		{
+			NumAllocs++;
+			NumBytes += static_cast<int64>(Count);
+		}
+
+		FMalloc* Inner = nullptr;
+		TAtomic<int64> NumAllocs { 0 };
+		TAtomic<int64> NumBytes { 0 };
+	};
+
+	struct FStageSamples
+	{
+		TArray<double> Ms;
+		int64 NumAllocs = 0;
+		int64 NumBytes = 0;
+	};
+
+	/** Nearest rank percentile of sorted samples. */
+	double Percentile(const TArray<double>& Sorted, double P)
+	{
+		if (Sorted.Num() == 0)
+		{
+			return 0.0;
+		}
+		const int32 Rank = FMath::CeilToInt(P * Sorted.Num()) - 1;
+		return Sorted[FMath::Clamp(Rank, 0, Sorted.Num() - 1)];
+	}
+
+	TSharedRef<FJsonObject> MakeStageReport(const TCHAR* Name, const FStageSamples& Samples)
+	{
+		TArray<double> Sorted = Samples.Ms;
+		Sorted.Sort();
+
+		double Sum = 0.0;
+		for (double Ms : Sorted)
+		{
+			Sum += Ms;
+		}
+		const int32 NumFrames = FMath::Max(Sorted.Num(), 1);
+		const double MeanMs = Sum / NumFrames;
+
+		TSharedRef<FJsonObject> Stage = MakeShared<FJsonObject>();
+		Stage->SetStringField(TEXT("name"), Name);
+		Stage->SetNumberField(TEXT("meanMs"), MeanMs);
+		Stage->SetNumberField(TEXT("p50Ms"), Percentile(Sorted, 0.5));
+		Stage->SetNumberField(TEXT("p99Ms"), Percentile(Sorted, 0.99));
+		Stage->SetNumberField(TEXT("maxMs"), Sorted.Num() > 0 ? Sorted.Last() : 0.0);
+		Stage->SetNumberField(TEXT("framesPerSecond"), MeanMs > 0.0 ? 1000.0 / MeanMs : 0.0);
+		Stage->SetNumberField(TEXT("allocsPerFrame"), static_cast<double>(Samples.NumAllocs) / NumFrames);
+		Stage->SetNumberField(TEXT("bytesPerFrame"), static_cast<double>(Samples.NumBytes) / NumFrames);
+		return Stage;
+	}
+
+	bool ParseSize(const TCHAR* Params, const TCHAR* Match, FIntPoint& InOutSize)
+	{
+		FString Value, Width, Height;
+		if (!FParse::Value(Params, Match, Value))
+		{
+			return true;
+		}
+		if (!Value.Split(TEXT("x"), &Width, &Height))
+		{
+			return false;
+		}
+		InOutSize = FIntPoint(FCString::Atoi(*Width), FCString::Atoi(*Height));
+		return InOutSize.X > 0 && InOutSize.Y > 0;
+	}
+
+	/**
+	 * Color camera frames in the format the camera delivers them.
+	 * @return false if the format can't be made without a device.
+	 */
+	bool MakeColorSource(EKinectColorFormat Format, int32 Width, int32 Height, TArray64<uint8>& OutSource, int32& OutStride)
+	{
+		switch (Format)
+		{
+		case EKinectColorFormat::NV12:
+			OutStride = Width;
+			OutSource.SetNumUninitialized(static_cast<int64>(Width) * Height * 3 / 2);
+			break;
+		case EKinectColorFormat::YUY2:
+			OutStride = Width * 2;
+			OutSource.SetNumUninitialized(static_cast<int64>(OutStride) * Height);
+			break;
+		case EKinectColorFormat::MJPG:
+		{
+			// Gradients with some texture, so JPEG doesn't compress to nothing
+			TArray<FColor> Image;
+			Image.SetNumUninitialized(Width * Height);
+			for (int32 y = 0; y < Height; y++)
+			{
+				for (int32 x = 0; x < Width; x++)
+				{
+					Image[y * Width + x] = FColor(x & 0xFF, y & 0xFF, (x * y) >> 4 & 0xFF, 0xFF);
+				}
+			}
+			IImageWrapperModule& ImageWrapperModule = FModuleManager::LoadModuleChecked<IImageWrapperModule>(TEXT("ImageWrapper"));
+			TSharedPtr<IImageWrapper> Encoder = ImageWrapperModule.CreateImageWrapper(EImageFormat::JPEG);
+			if (!Encoder || !Encoder->SetRaw(Image.GetData(), Image.Num() * sizeof(FColor), Width, Height, ERGBFormat::BGRA, 8))
+			{
+				return false;
+			}
+			OutStride = Width * 4;
+			OutSource = Encoder->GetCompressed(90);
+			return true;
+		}
+		default:
+			return false;
+		}
+
+		for (int64 i = 0; i < OutSource.Num(); i++)
+		{
+			OutSource[i] = static_cast<uint8>(i * 7);
+		}
+		return true;
+	}
+
+	/**
+	 * A sloped wall with bodies walking in front of it, sensor noise and holes.
+	 * Each body is an upright ellipse at its own distance, with its joints stacked along its axis.
+	 */
+	struct FSyntheticScene
+	{
+		int32 Width;
+		int32 Height;
+		float FocalLength;
+		TArray<uint16> Depth[NumSourceFrames];
+		TArray<uint8> BodyIndices[NumSourceFrames];
+		TArray<k4abt_skeleton_t> Skeletons[NumSourceFrames];
+		TArray<uint32> BodyIds;
+		/** Unit depth ray per pixel, X and Y interleaved. */
+		TArray<float> XYTable;
+
+		void Init(int32 InWidth, int32 InHeight, int32 NumBodies)
+		{
+			Width = InWidth;
+			Height = InHeight;
+			FocalLength = Width * 0.79f;
+			const int32 Num = Width * Height;
+
+			XYTable.SetNumUninitialized(Num * 2);
+			for (int32 y = 0; y < Height; y++)
+			{
+				for (int32 x = 0; x < Width; x++)
+				{
+					XYTable[(y * Width + x) * 2] = (x - Width * 0.5f) / FocalLength;
+					XYTable[(y * Width + x) * 2 + 1] = (y - Height * 0.5f) / FocalLength;
+				}
+			}
+
+			BodyIds.SetNumUninitialized(NumBodies);
+			for (int32 b = 0; b < NumBodies; b++)
+			{
+				BodyIds[b] = b + 1;
+			}
+
+			FRandomStream Random(0x4B494E);
+			for (int32 f = 0; f < NumSourceFrames; f++)
+			{
+				TArray<uint16>& FrameDepth = Depth[f];
+				TArray<uint8>& FrameIndices = BodyIndices[f];
+				FrameDepth.SetNumUninitialized(Num);
+				FrameIndices.SetNumUninitialized(Num);
+				for (int32 y = 0; y < Height; y++)
+				{
+					for (int32 x = 0; x < Width; x++)
+					{
+						const int32 Value = 3000 + x + Random.RandRange(-10, 10);
+						FrameDepth[y * Width + x] = Random.FRand() < 0.02f ? 0 : static_cast<uint16>(Value);
+						FrameIndices[y * Width + x] = 255;
+					}
+				}
+
+				Skeletons[f].SetNumUninitialized(NumBodies);
+				for (int32 b = 0; b < NumBodies; b++)
+				{
+					const float BodyDepth = 1500.f + 600.f * b;
+					const float CenterX = Width * (0.25f + 0.5f * (b + 0.5f) / NumBodies) + Width * 0.05f * FMath::Sin(2.f * PI * f / NumSourceFrames + b);
+					const float CenterY = Height * 0.5f;
+					const float RadiusX = FocalLength * 250.f / BodyDepth;
+					const float RadiusY = FocalLength * 900.f / BodyDepth;
+
+					// Nearer bodies were drawn first and occlude the others
+					for (int32 y = FMath::Max(FMath::FloorToInt(CenterY - RadiusY), 0); y < FMath::Min(FMath::CeilToInt(CenterY + RadiusY), Height); y++)
+					{
+						for (int32 x = FMath::Max(FMath::FloorToInt(CenterX - RadiusX), 0); x < FMath::Min(FMath::CeilToInt(CenterX + RadiusX), Width); x++)
+						{
+							const float U = (x - CenterX) / RadiusX;
+							const float V = (y - CenterY) / RadiusY;
+							const int32 i = y * Width + x;
+							if (U * U + V * V > 1.f || FrameIndices[i] != 255) continue;
+
+							FrameIndices[i] = static_cast<uint8>(b);
+							FrameDepth[i] = Random.FRand() < 0.01f ? 0 : static_cast<uint16>(BodyDepth + 100.f * U * U + Random.RandRange(-5, 5));
+						}
+					}
+
+					const FVector Pelvis((CenterX - Width * 0.5f) / FocalLength * BodyDepth, (CenterY - Height * 0.5f) / FocalLength * BodyDepth, BodyDepth);
+					for (int32 j = 0; j < K4ABT_JOINT_COUNT; j++)
+					{
+						const FVector Position = Pelvis + FVector(Random.FRandRange(-150.f, 150.f), 800.f - j * 50.f, Random.FRandRange(-50.f, 50.f));
+						const FQuat Orientation(Random.GetUnitVector(), Random.FRandRange(-0.3f, 0.3f));
+						k4abt_joint_t& Joint = Skeletons[f][b].joints[j];
+						Joint.position = { { Position.X, Position.Y, Position.Z } };
+						Joint.orientation = { { Orientation.W, Orientation.X, Orientation.Y, Orientation.Z } };
+						Joint.confidence_level = K4ABT_JOINT_CONFIDENCE_MEDIUM;
+					}
+				}
+			}
+		}
+
+		/** What the SDK would return for the depth frame, as the device keeps it. */
+		void MakePointCloud(const uint16* FrameDepth, FAzureKinectPointCloud& OutPointCloud) const
+		{
+			OutPointCloud.Width = Width;
+			OutPointCloud.Height = Height;
+			OutPointCloud.Positions.SetNumUninitialized(Width * Height * 3, false);
+			for (int32 i = 0; i < Width * Height; i++)
+			{
+				const float D = FrameDepth[i];
+				OutPointCloud.Positions[i * 3] = static_cast<int16>(XYTable[i * 2] * D);
+				OutPointCloud.Positions[i * 3 + 1] = static_cast<int16>(XYTable[i * 2 + 1] * D);
+				OutPointCloud.Positions[i * 3 + 2] = static_cast<int16>(D);
+			}
+		}
+	};
+}
+
+UAzureKinectBenchmarkCommandlet::UAzureKinectBenchmarkCommandlet(const FObjectInitializer& ObjectInitializer) :
+	Super(ObjectInitializer)
+{
+	IsClient = false;
+	IsServer = false;
+	IsEditor = true;
+	LogToConsole = true;
+	ShowErrorCount = false;
+	HelpDescription = TEXT("Replay synthetic frames through the Azure Kinect processing pipeline and report per stage timings and allocations as JSON.");
+}
+
+int32 UAzureKinectBenchmarkCommandlet::Main(const FString& Params)
+{
+	int32 NumFrames = 300;
+	int32 NumWarmupFrames = 30;
+	int32 NumBodies = 2;
+	int32 MaxBodies = 0;
+	int32 NumDevices = 2;
+	FIntPoint DepthSize(640, 576);
+	FIntPoint ColorSize(1280, 720);
+	FString ColorFormatName = TEXT("NV12");
+	FString JsonPath;
+
+	FParse::Value(*Params, TEXT("frames="), NumFrames);
+	FParse::Value(*Params, TEXT("warmup="), NumWarmupFrames);
+	FParse::Value(*Params, TEXT("bodies="), NumBodies);
+	FParse::Value(*Params, TEXT("maxbodies="), MaxBodies);
+	FParse::Value(*Params, TEXT("devices="), NumDevices);
+	FParse::Value(*Params, TEXT("colorformat="), ColorFormatName);
+	FParse::Value(*Params, TEXT("json="), JsonPath);
+	NumFrames = FMath::Max(NumFrames, 1);
+	NumWarmupFrames = FMath::Max(NumWarmupFrames, 0);
+	// Body indices are bytes with 255 for background
+	NumBodies = FMath::Clamp(NumBodies, 0, 16);
+	NumDevices = FMath::Clamp(NumDevices, 1, 16);
+
+	if (!ParseSize(*Params, TEXT("depth="), DepthSize) || !ParseSize(*Params, TEXT("color="), ColorSize))
+	{
+		UE_LOG(AzureKinectBenchmarkLog, Error, TEXT("Sizes are given as <width>x<height>, e.g. -depth=640x576"));
+		return 1;
+	}
+
+	const int64 ColorFormatValue = StaticEnum<EKinectColorFormat>()->GetValueByNameString(ColorFormatName);
+	const EKinectColorFormat ColorFormat = static_cast<EKinectColorFormat>(ColorFormatValue);
+	TArray64<uint8> ColorSource;
+	int32 ColorStride = 0;
+	if (ColorFormatValue == INDEX_NONE || !MakeColorSource(ColorFormat, ColorSize.X, ColorSize.Y, ColorSource, ColorStride))
+	{
+		UE_LOG(AzureKinectBenchmarkLog, Error, TEXT("Color format %s can't be benchmarked, use MJPG, NV12 or YUY2"), *ColorFormatName);
+		return 1;
+	}
+
+	UE_LOG(AzureKinectBenchmarkLog, Display, TEXT("Depth %dx%d, color %s %dx%d, %d bodies, %d devices, %d frames after %d warmup frames"),
+		DepthSize.X, DepthSize.Y, *ColorFormatName, ColorSize.X, ColorSize.Y, NumBodies, NumDevices, NumFrames, NumWarmupFrames);
+
+	FSyntheticScene Scene;
+	Scene.Init(DepthSize.X, DepthSize.Y, NumBodies);
+	const int32 NumPixels = DepthSize.X * DepthSize.Y;
+
+	// Stages and their settings, as a device with every feature enabled runs them
+	FAzureKinectDepthFilter DepthFilter;
+	FAzureKinectDepthFilterSettings DepthFilterSettings;
+	DepthFilterSettings.bEnabled = true;
+	DepthFilterSettings.bTemporal = true;
+	TArray<uint16> FilteredDepth;
+	FilteredDepth.SetNumUninitialized(NumPixels);
+
+	FAzureKinectBackgroundModel BackgroundModel;
+	FAzureKinectBackgroundSettings BackgroundSettings;
+	BackgroundSettings.bEnabled = true;
+	TArray<uint8> ForegroundMask;
+	ForegroundMask.SetNumUninitialized(NumPixels);
+
+	FAzureKinectColorConverter ColorConverter;
+	TArray<FColor> ConvertedColor;
+	ConvertedColor.SetNumUninitialized(ColorSize.X * ColorSize.Y);
+
+	// Texels of the depth, infrared and body index textures
+	TArray<uint8> TextureTexels;
+	TextureTexels.SetNumUninitialized(NumPixels * 4);
+
+	const FAzureKinectJointConverter JointConverter;
+	TArray<int32> SelectedBodies;
+	TArray<FAzureKinectSkeleton> Skeletons;
+
+	// Listeners of a device feeding skeleton fusion and the animation recorder, as their handlers copy skeletons
+	FCriticalSection PublishCriticalSection;
+	TArray<FAzureKinectSkeleton> PublishedSkeletons;
+	TArray<FAzureKinectSkeleton> FusionViewSkeletons;
+	TArray<FQuat> RecordedRotations;
+	RecordedRotations.SetNumUninitialized(K4ABT_JOINT_COUNT);
+	FOnAzureKinectSkeletonsPublished SkeletonsPublishedEvent;
+	SkeletonsPublishedEvent.AddLambda([&FusionViewSkeletons](int64 TimestampUsec, const TArray<FAzureKinectSkeleton>& InSkeletons)
+	{
+		FusionViewSkeletons.SetNum(InSkeletons.Num(), false);
+		for (int32 i = 0; i < InSkeletons.Num(); i++)
+		{
+			FusionViewSkeletons[i] = InSkeletons[i];
+		}
+	});
+	SkeletonsPublishedEvent.AddLambda([&RecordedRotations](int64 TimestampUsec, const TArray<FAzureKinectSkeleton>& InSkeletons)
+	{
+		if (InSkeletons.Num() == 0) return;
+		for (int32 j = 0; j < K4ABT_JOINT_COUNT; j++)
+		{
+			RecordedRotations[j] = InSkeletons[0].Joints[j].GetRotation();
+		}
+	});
+
+	FAzureKinectBodyGeometryExtractor GeometryExtractor;
+	FAzureKinectBodyGeometrySettings GeometrySettings;
+	GeometrySettings.bEnabled = true;
+	GeometryExtractor.SetXYTable(TArray<float>(Scene.XYTable), DepthSize.X, DepthSize.Y);
+	const FMatrix PointToWorld = FAzureKinectJointConverter::MakePointToWorld(FTransform::Identity);
+	TArray<FAzureKinectBodyGeometry> Geometries;
+
+	// Devices on a circle around the stage, all seeing the same bodies
+	FAzureKinectSkeletonFusion SkeletonFusion;
+	FAzureKinectFusionSettings FusionSettings;
+	TArray<FAzureKinectSkeletonView> Views;
+	TArray<FAzureKinectSkeleton> FusedSkeletons;
+	Views.SetNum(NumDevices);
+
+	FAzureKinectVoxelGrid VoxelGrid;
+	FAzureKinectVoxelGridSettings VoxelGridSettings;
+	VoxelGridSettings.bEnabled = true;
+	FAzureKinectFusedPointCloud FusedPointCloud;
+	FAzureKinectVoxelGridStats VoxelGridStats;
+	FAzureKinectPointCloudPtr PointCloud = MakeShared<FAzureKinectPointCloud, ESPMode::ThreadSafe>();
+	TArray<FAzureKinectVoxelGridSource> VoxelGridSources;
+	VoxelGridSources.SetNum(NumDevices);
+
+	for (int32 v = 0; v < NumDevices; v++)
+	{
+		const float Angle = 2.f * PI * v / NumDevices;
+		const FVector Location(-FMath::Cos(Angle) * 300.f, -FMath::Sin(Angle) * 300.f, 100.f);
+		Views[v].CameraLocation = Location;
+		VoxelGridSources[v].PointCloud = PointCloud;
+		VoxelGridSources[v].CameraToWorld = FTransform(FRotator(0.f, FMath::RadiansToDegrees(Angle), 0.f), Location);
+	}
+
+	FAzureKinectDepthMesher DepthMesher;
+	FAzureKinectDepthMeshSettings DepthMeshSettings;
+
+	// Counts allocations of worker threads too. Kept alive, other threads may still be calling through it after it's removed.
+	static FCountingMalloc CountingMalloc;
+	FMalloc* const PreviousMalloc = GMalloc;
+	CountingMalloc.SetInner(PreviousMalloc);
+	GMalloc = &CountingMalloc;
+
+	FStageSamples Samples[NumStages];
+	TArray<double> TotalMs;
+	for (FStageSamples& Stage : Samples)
+	{
+		Stage.Ms.Reserve(NumFrames);
+	}
+	TotalMs.Reserve(NumFrames);
+
+	for (int32 Frame = -NumWarmupFrames; Frame < NumFrames; Frame++)
+	{
+		const int32 Source = (Frame + NumWarmupFrames) % NumSourceFrames;
+		const bool bRecord = Frame >= 0;
+		double FrameMs = 0.0;
+
+		auto Measure = [&](EStage Stage, TFunctionRef<void()> Work)
+		{
+			const int64 StartAllocs = CountingMalloc.GetNumAllocs();
+			const int64 StartBytes = CountingMalloc.GetNumBytes();
+			const double StartTime = FPlatformTime::Seconds();
+			Work();
+			const double Ms = (FPlatformTime::Seconds() - StartTime) * 1000.0;
+			if (bRecord)
+			{
+				Samples[Stage].Ms.Add(Ms);
+				Samples[Stage].NumAllocs += CountingMalloc.GetNumAllocs() - StartAllocs;
+				Samples[Stage].NumBytes += CountingMalloc.GetNumBytes() - StartBytes;
+				FrameMs += Ms;
+			}
+		};
+
+		FMemory::Memcpy(FilteredDepth.GetData(), Scene.Depth[Source].GetData(), NumPixels * sizeof(uint16));
+
+		Measure(StageDepthFilter, [&]()
+		{
+			DepthFilter.Process(FilteredDepth.GetData(), DepthSize.X, DepthSize.Y, DepthFilterSettings);
+		});
+
+		Measure(StageBackground, [&]()
+		{
+			BackgroundModel.Process(FilteredDepth.GetData(), DepthSize.X, DepthSize.Y, BackgroundSettings, ForegroundMask.GetData());
+		});
+
+		Measure(StageColor, [&]()
+		{
+			ColorConverter.Convert(ColorFormat, ColorSource.GetData(), ColorSource.Num(), ColorSize.X, ColorSize.Y, ColorStride, ConvertedColor.GetData());
+		});
+
+		Measure(StageDepthTexture, [&]()
+		{
+			FAzureKinectTextureConverter::DepthToRGBA(FilteredDepth.GetData(), NumPixels, TextureTexels.GetData());
+		});
+
+		// Raw depth stands in for infrared, same size and range
+		Measure(StageInfraredTexture, [&]()
+		{
+			FAzureKinectTextureConverter::InfraredToRGBA(Scene.Depth[Source].GetData(), NumPixels, TextureTexels.GetData());
+		});
+
+		Measure(StageBodyIndexTexture, [&]()
+		{
+			FAzureKinectTextureConverter::BodyIndexToRGBA(Scene.BodyIndices[Source].GetData(), NumPixels, TextureTexels.GetData());
+		});
+
+		// Same as UAzureKinectDevice::UpdateSkeletons
+		Measure(StageSkeletons, [&]()
+		{
+			const TArray<k4abt_skeleton_t>& NativeSkeletons = Scene.Skeletons[Source];
+			FAzureKinectJointConverter::SelectBodies(NativeSkeletons.GetData(), Scene.BodyIds.GetData(), NumBodies, MaxBodies, EKinectBodySelection::NEAREST, SelectedBodies);
+			Skeletons.SetNum(SelectedBodies.Num(), false);
+			for (int32 i = 0; i < SelectedBodies.Num(); i++)
+			{
+				const k4abt_skeleton_t& NativeSkeleton = NativeSkeletons[SelectedBodies[i]];
+				FAzureKinectSkeleton& Skeleton = Skeletons[i];
+				Skeleton.ID = Scene.BodyIds[SelectedBodies[i]];
+				Skeleton.Joints.SetNumUninitialized(K4ABT_JOINT_COUNT, false);
+				Skeleton.JointConfidences.SetNumUninitialized(K4ABT_JOINT_COUNT, false);
+				JointConverter.Convert(NativeSkeleton.joints, K4ABT_JOINT_COUNT, Skeleton.Joints.GetData());
+				for (int32 j = 0; j < K4ABT_JOINT_COUNT; j++)
+				{
+					Skeleton.JointConfidences[j] = static_cast<EKinectJointConfidence>(NativeSkeleton.joints[j].confidence_level);
+				}
+			}
+		});
+
+		// Same as UAzureKinectDevice::PublishSkeletons
+		Measure(StageSkeletonPublish, [&]()
+		{
+			{
+				FScopeLock Lock(&PublishCriticalSection);
+				Swap(PublishedSkeletons, Skeletons);
+			}
+			SkeletonsPublishedEvent.Broadcast(Frame, PublishedSkeletons);
+		});
+
+		// Body tracking segments the raw depth
+		Measure(StageBodyGeometry, [&]()
+		{
+			GeometryExtractor.Extract(Scene.BodyIndices[Source].GetData(), Scene.Depth[Source].GetData(), DepthSize.X, DepthSize.Y, PointToWorld, NumBodies, GeometrySettings, Geometries);
+		});
+
+		for (FAzureKinectSkeletonView& View : Views)
+		{
+			View.Skeletons = PublishedSkeletons;
+		}
+		Measure(StageSkeletonFusion, [&]()
+		{
+			SkeletonFusion.Fuse(Views, FusionSettings, FusedSkeletons);
+		});
+
+		Scene.MakePointCloud(FilteredDepth.GetData(), *PointCloud);
+		Measure(StageVoxelGrid, [&]()
+		{
+			VoxelGrid.Build(VoxelGridSources, VoxelGridSettings, FusedPointCloud, VoxelGridStats);
+		});
+
+		Measure(StageDepthMesh, [&]()
+		{
+			DepthMesher.Build(*PointCloud, DepthMeshSettings, PointToWorld);
+		});
+
+		if (bRecord)
+		{
+			TotalMs.Add(FrameMs);
+		}
+	}
+
+	GMalloc = PreviousMalloc;
+
+	TSharedRef<FJsonObject> Report = MakeShared<FJsonObject>();
+	Report->SetStringField(TEXT("platform"), FPlatformProperties::IniPlatformName());
+	Report->SetNumberField(TEXT("cores"), FPlatformMisc::NumberOfCoresIncludingHyperthreads());
+	Report->SetNumberField(TEXT("frames"), NumFrames);
+	Report->SetNumberField(TEXT("warmupFrames"), NumWarmupFrames);
+	Report->SetStringField(TEXT("depth"), FString::Printf(TEXT("%dx%d"), DepthSize.X, DepthSize.Y));
+	Report->SetStringField(TEXT("color"), FString::Printf(TEXT("%dx%d"), ColorSize.X, ColorSize.Y));
+	Report->SetStringField(TEXT("colorFormat"), StaticEnum<EKinectColorFormat>()->GetNameStringByValue(ColorFormatValue));
+	Report->SetNumberField(TEXT("bodies"), NumBodies);
+	Report->SetNumberField(TEXT("maxBodies"), MaxBodies);
+	Report->SetNumberField(TEXT("devices"), NumDevices);
+
+	TArray<TSharedPtr<FJsonValue>> Stages;
+	FStageSamples Total;
+	Total.Ms = MoveTemp(TotalMs);
+	for (int32 Stage = 0; Stage < NumStages; Stage++)
+	{
+		Stages.Add(MakeShared<FJsonValueObject>(MakeStageReport(StageNames[Stage], Samples[Stage])));
+		Total.NumAllocs += Samples[Stage].NumAllocs;
+		Total.NumBytes += Samples[Stage].NumBytes;
+	}
+	Report->SetArrayField(TEXT("stages"), Stages);
+	Report->SetObjectField(TEXT("total"), MakeStageReport(TEXT("Total"), Total));
+
+	FString Json;
+	TSharedRef<TJsonWriter<TCHAR, TCondensedJsonPrintPolicy<TCHAR>>> Writer = TJsonWriterFactory<TCHAR, TCondensedJsonPrintPolicy<TCHAR>>::Create(&Json);
+	FJsonSerializer::Serialize(Report, Writer);
+	UE_LOG(AzureKinectBenchmarkLog, Display, TEXT("%s"), *Json);
+
+	if (!JsonPath.IsEmpty() && !FFileHelper::SaveStringToFile(Json, *JsonPath))
+	{
+		UE_LOG(AzureKinectBenchmarkLog, Error, TEXT("Failed to write %s"), *JsonPath);
+		return 1;
+	}
+	return 0;
+}
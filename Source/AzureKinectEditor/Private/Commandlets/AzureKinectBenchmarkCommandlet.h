@@ -0,0 +1,27 @@
+#pragma once
+
+#include "Commandlets/Commandlet.h"
+
+#include "AzureKinectBenchmarkCommandlet.generated.h"
+
+DECLARE_LOG_CATEGORY_EXTERN(AzureKinectBenchmarkLog, Log, All);
+
+/**
+ * Headless benchmark of the capture processing pipeline, for regression tracking without a device.
+ * Synthetic depth, color and body frames are replayed through every device independent stage
+ * (depth filter, background subtraction, color conversion, depth, infrared and body index texels,
+ * body selection and joint conversion, skeleton publish and broadcast, body geometry, skeleton fusion, voxel grid, depth mesh),
+ * timing each stage per frame and counting the allocations it makes.
+ * The report is JSON with mean, p50, p99 and max per stage, logged and optionally written to a file.
+ *
+ * UE4Editor-Cmd <Project>.uproject -run=AzureKinectBenchmark -nullrhi -unattended [-frames=300] [-warmup=30]
+ *     [-depth=640x576] [-color=1280x720] [-colorformat=NV12] [-bodies=2] [-maxbodies=0] [-devices=2] [-json=<path>]
+ */
+UCLASS()
+class UAzureKinectBenchmarkCommandlet : public UCommandlet
+{
+	GENERATED_UCLASS_BODY()
+
+public:
+	virtual int32 Main(const FString& Params) override;
+};
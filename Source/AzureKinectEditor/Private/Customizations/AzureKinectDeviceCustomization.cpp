@@ -7,9 +7,15 @@
 #include "DetailWidgetRow.h"
 #include "Widgets/Input/SComboBox.h"
 #include "PropertyCustomizationHelpers.h"
+#include "AzureKinectDeviceRegistry.h"
 
 #define LOCTEXT_NAMESPACE "AzureKinectDeviceCustomization"
 
+FAzureKinectDeviceCustomization::~FAzureKinectDeviceCustomization()
+{
+	FAzureKinectDeviceRegistry::Get().OnDevicesChanged().Remove(DevicesChangedHandle);
+}
+
 TSharedRef<IDetailCustomization> FAzureKinectDeviceCustomization::MakeInstance()
 {
 	return MakeShareable(new FAzureKinectDeviceCustomization());
@@ -40,7 +46,9 @@ void FAzureKinectDeviceCustomization::CustomizeDetails(IDetailLayoutBuilder& Det
 
 	{
 		// Add Custom Row of Device selection
-		CurrentOption = AzureKinectDevice->DeviceList[0];
+		// Options come from the shared registry, so no device is opened here.
+		UpdateOptions();
+		DevicesChangedHandle = FAzureKinectDeviceRegistry::Get().OnDevicesChanged().AddRaw(this, &FAzureKinectDeviceCustomization::UpdateOptions);
 		
 		ConfigCategory.AddCustomRow(LOCTEXT("DeviceSelectionFilterString", "Device Selection"))
 			.NameContent()
@@ -50,9 +58,9 @@ void FAzureKinectDeviceCustomization::CustomizeDetails(IDetailLayoutBuilder& Det
 			]
 			.ValueContent()
 			[
-				SNew(SComboBox<TSharedPtr<FString>>)
+				SAssignNew(ComboBox, SComboBox<TSharedPtr<FString>>)
 				.IsEnabled(CheckDeviceOpen)
-				.OptionsSource(&(AzureKinectDevice->DeviceList))
+				.OptionsSource(&Options)
 				.OnSelectionChanged_Raw(this, &FAzureKinectDeviceCustomization::OnSelectionChanged)
 				.OnGenerateWidget_Raw(this, &FAzureKinectDeviceCustomization::MakeWidgetForOption)
 				.InitiallySelectedItem(CurrentOption)
@@ -68,17 +76,25 @@ void FAzureKinectDeviceCustomization::CustomizeDetails(IDetailLayoutBuilder& Det
 	// Below is a workarround how to make UProperty conditional without condition (Uproperty boolean)
 	auto DepthMode = DetailBuilder.GetProperty(GET_MEMBER_NAME_CHECKED(UAzureKinectDevice, DepthMode));
 	auto ColorMode = DetailBuilder.GetProperty(GET_MEMBER_NAME_CHECKED(UAzureKinectDevice, ColorMode));
+	auto ColorFormat = DetailBuilder.GetProperty(GET_MEMBER_NAME_CHECKED(UAzureKinectDevice, ColorFormat));
+	auto MjpegDecodeThreads = DetailBuilder.GetProperty(GET_MEMBER_NAME_CHECKED(UAzureKinectDevice, MjpegDecodeThreads));
 	auto Fps = DetailBuilder.GetProperty(GET_MEMBER_NAME_CHECKED(UAzureKinectDevice, Fps));
 	auto SensorOrientation = DetailBuilder.GetProperty(GET_MEMBER_NAME_CHECKED(UAzureKinectDevice, SensorOrientation));
 	auto RemapMode = DetailBuilder.GetProperty(GET_MEMBER_NAME_CHECKED(UAzureKinectDevice, RemapMode));
 	auto SkeletonTracking = DetailBuilder.GetProperty(GET_MEMBER_NAME_CHECKED(UAzureKinectDevice, bSkeletonTracking));
+	auto Imu = DetailBuilder.GetProperty(GET_MEMBER_NAME_CHECKED(UAzureKinectDevice, bImu));
 		
-	ConfigCategory.AddProperty(DepthMode).IsEnabled(CheckDeviceOpen);
-	ConfigCategory.AddProperty(ColorMode).IsEnabled(CheckDeviceOpen);
-	ConfigCategory.AddProperty(Fps).IsEnabled(CheckDeviceOpen);
-	ConfigCategory.AddProperty(SensorOrientation).IsEnabled(CheckDeviceOpen);
-	ConfigCategory.AddProperty(RemapMode).IsEnabled(CheckDeviceOpen);
-	ConfigCategory.AddProperty(SkeletonTracking).IsEnabled(CheckDeviceOpen);
+	// Stream settings stay editable while the device is open,
+	// they are applied with "Reconfigure" button without a full restart.
+	ConfigCategory.AddProperty(DepthMode);
+	ConfigCategory.AddProperty(ColorMode);
+	ConfigCategory.AddProperty(ColorFormat);
+	ConfigCategory.AddProperty(MjpegDecodeThreads);
+	ConfigCategory.AddProperty(Fps);
+	ConfigCategory.AddProperty(SensorOrientation);
+	ConfigCategory.AddProperty(RemapMode);
+	ConfigCategory.AddProperty(SkeletonTracking);
+	ConfigCategory.AddProperty(Imu);
 	
 
 	// Customize 'IO' category
@@ -136,6 +152,20 @@ void FAzureKinectDeviceCustomization::CustomizeDetails(IDetailLayoutBuilder& Det
 					return FReply::Handled();
 				})
 			]
+			+ SHorizontalBox::Slot()
+			.Padding(FMargin(0.f, 0, 10.f, 2.f))
+			.AutoWidth()
+			[
+				SNew(SButton)
+				.Text(LOCTEXT("ReconfigureButtonText", "Reconfigure"))
+				.Visibility_Lambda([this]() {
+					return AzureKinectDevice->IsOpen() ? EVisibility::Visible : EVisibility::Collapsed;
+				})
+				.OnClicked_Lambda([this]() {
+					AzureKinectDevice->ReconfigureDevice();
+					return FReply::Handled();
+				})
+			]
 		];
 
 }
@@ -145,18 +175,51 @@ TSharedRef<SWidget> FAzureKinectDeviceCustomization::MakeWidgetForOption(TShared
 	return SNew(STextBlock).Text(FText::FromString(*InOption));
 }
 
-void FAzureKinectDeviceCustomization::OnSelectionChanged(TSharedPtr<FString> NewValue, ESelectInfo::Type)
+void FAzureKinectDeviceCustomization::OnSelectionChanged(TSharedPtr<FString> NewValue, ESelectInfo::Type SelectInfo)
 {
 	CurrentOption = NewValue;
-	// Also update UAzureKinectDevice's current index
-	int32 IndexOfFound = AzureKinectDevice->DeviceList.Find(NewValue);
-	if (IndexOfFound == INDEX_NONE)
+
+	// Selection set from UpdateOptions should not overwrite the serial stored in the asset.
+	if (SelectInfo == ESelectInfo::Direct || !AzureKinectDevice.IsValid())
+	{
+		return;
+	}
+
+	// Also update UAzureKinectDevice's current index and serial
+	int32 IndexOfFound = Options.Find(NewValue);
+	if (IndexOfFound == INDEX_NONE || IndexOfFound == 0)
 	{
 		AzureKinectDevice->DeviceIndex = - 1;
+		AzureKinectDevice->DeviceSerial.Empty();
 	}
 	else
 	{
-		AzureKinectDevice->DeviceIndex = IndexOfFound - 1;
+		AzureKinectDevice->DeviceSerial = *NewValue;
+		AzureKinectDevice->DeviceIndex = FAzureKinectDeviceRegistry::Get().FindIndexBySerial(*NewValue);
+	}
+}
+
+void FAzureKinectDeviceCustomization::UpdateOptions()
+{
+	Options.Reset();
+	Options.Add(MakeShared<FString>("No Device"));
+	CurrentOption = Options[0];
+
+	for (const FAzureKinectDeviceInfo& Info : FAzureKinectDeviceRegistry::Get().GetDevices())
+	{
+		TSharedPtr<FString> Option = MakeShared<FString>(Info.SerialNumber);
+		Options.Add(Option);
+
+		if (AzureKinectDevice.IsValid() && AzureKinectDevice->DeviceSerial == Info.SerialNumber)
+		{
+			CurrentOption = Option;
+		}
+	}
+
+	if (ComboBox.IsValid())
+	{
+		ComboBox->RefreshOptions();
+		ComboBox->SetSelectedItem(CurrentOption);
 	}
 }
 
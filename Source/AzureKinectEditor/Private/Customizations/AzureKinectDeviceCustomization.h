@@ -4,6 +4,7 @@
 
 #include "CoreMinimal.h"
 #include "IDetailCustomization.h"
+#include "Widgets/Input/SComboBox.h"
 #include "AzureKinectDevice.h"
 /**
  * 
@@ -11,6 +12,8 @@
 class FAzureKinectDeviceCustomization : public IDetailCustomization
 {
 public:
+	virtual ~FAzureKinectDeviceCustomization();
+
 	static TSharedRef<IDetailCustomization> MakeInstance();
 	virtual void CustomizeDetails(IDetailLayoutBuilder& DetailBuilder) override;
 	
@@ -19,6 +22,12 @@ public:
 	FText GetCurrentItemLabel() const;
 
 private:
+	/** Rebuild combo box options from the device registry. */
+	void UpdateOptions();
+
+	TArray<TSharedPtr<FString>> Options;
+	TSharedPtr<SComboBox<TSharedPtr<FString>>> ComboBox;
+	FDelegateHandle DevicesChangedHandle;
 
 	TWeakObjectPtr<UAzureKinectDevice> AzureKinectDevice;
 	TSharedPtr<FString> CurrentOption;